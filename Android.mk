@@ -22,9 +22,11 @@ LOCAL_PATH:= $(call my-dir)
 
 main := Main.cpp
 sources := \
+    	compile/CompileCache.cpp \
     	compile/IdAssigner.cpp \
     	compile/InlineXmlFormatParser.cpp \
     	compile/NinePatch.cpp \
+    	compile/PackedCompiledFiles.cpp \
     	compile/Png.cpp \
     	compile/PngChunkFilter.cpp \
     	compile/PngCrunch.cpp \
@@ -54,6 +56,7 @@ sources := \
     	link/XmlNamespaceRemover.cpp \
     	link/XmlReferenceLinker.cpp \
     	optimize/ResourceDeduper.cpp \
+    	optimize/ResourcePathShortener.cpp \
     	optimize/VersionCollapser.cpp \
     	process/SymbolTable.cpp \
     	proto/ProtoHelpers.cpp \
@@ -64,11 +67,15 @@ sources := \
     	text/Utf8Iterator.cpp \
     	unflatten/BinaryResourceParser.cpp \
     	unflatten/ResChunkPullParser.cpp \
+    	unflatten/ResTableTypeReader.cpp \
+    	unflatten/TableSizeReport.cpp \
     	util/BigBuffer.cpp \
     	util/Files.cpp \
+    	util/Trace.cpp \
     	util/Util.cpp \
     	ConfigDescription.cpp \
     	Debug.cpp \
+    	Diagnostics.cpp \
     	DominatorTree.cpp \
     	Flags.cpp \
     	java/AnnotationProcessor.cpp \
@@ -88,6 +95,7 @@ sources := \
     	xml/XmlActionExecutor.cpp \
     	xml/XmlDom.cpp \
     	xml/XmlPullParser.cpp \
+    	xml/XmlTokenizer.cpp \
     	xml/XmlUtil.cpp \
     	Resources.proto \
     	ResourcesInternal.proto
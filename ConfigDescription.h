@@ -17,10 +17,12 @@
 #ifndef AAPT_CONFIG_DESCRIPTION_H
 #define AAPT_CONFIG_DESCRIPTION_H
 
+#include <functional>
 #include <ostream>
 
 #include "androidfw/ResourceTypes.h"
 #include "androidfw/StringPiece.h"
+#include "utils/JenkinsHash.h"
 
 namespace aapt {
 
@@ -177,4 +179,27 @@ inline ::std::ostream& operator<<(::std::ostream& out,
 
 }  // namespace aapt
 
+namespace std {
+
+// Hashes the packed axes that ResTable_config::compare() orders by, so that configs that compare
+// equal always hash equally. The locale script and variant are left out, since compare() ignores
+// computed scripts; configs that differ only by those collide.
+template <>
+struct hash<aapt::ConfigDescription> {
+  size_t operator()(const aapt::ConfigDescription& config) const {
+    android::hash_t h = 0;
+    h = android::JenkinsHashMix(h, config.imsi);
+    h = android::JenkinsHashMix(h, config.locale);
+    h = android::JenkinsHashMix(h, config.screenType);
+    h = android::JenkinsHashMix(h, config.input);
+    h = android::JenkinsHashMix(h, config.screenSize);
+    h = android::JenkinsHashMix(h, config.version);
+    h = android::JenkinsHashMix(h, config.screenConfig);
+    h = android::JenkinsHashMix(h, config.screenSizeDp);
+    return static_cast<size_t>(h);
+  }
+};
+
+}  // namespace std
+
 #endif  // AAPT_CONFIG_DESCRIPTION_H
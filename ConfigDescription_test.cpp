@@ -152,4 +152,15 @@ TEST(ConfigDescriptionTest, RangeQualifiersDoNotConflict) {
   EXPECT_FALSE(ParseConfigOrDie("600x400").ConflictsWith(ParseConfigOrDie("300x200")));
 }
 
+TEST(ConfigDescriptionTest, EqualConfigsHashEqually) {
+  using test::ParseConfigOrDie;
+
+  const std::hash<ConfigDescription> hasher;
+  EXPECT_EQ(hasher(ParseConfigOrDie("en-rUS-land-v21")),
+            hasher(ParseConfigOrDie("en-rUS-land-v21")));
+  EXPECT_EQ(hasher(ConfigDescription()), hasher(ConfigDescription::DefaultConfig()));
+  EXPECT_NE(hasher(ParseConfigOrDie("en-rUS")), hasher(ParseConfigOrDie("en-rGB")));
+  EXPECT_NE(hasher(ParseConfigOrDie("land")), hasher(ParseConfigOrDie("port")));
+}
+
 }  // namespace aapt
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Diagnostics.h"
+
+namespace aapt {
+
+static const char* LevelToString(IDiagnostics::Level level) {
+  switch (level) {
+    case IDiagnostics::Level::Error:
+      return "error";
+    case IDiagnostics::Level::Warn:
+      return "warn";
+    case IDiagnostics::Level::Note:
+      return "note";
+  }
+  return "";
+}
+
+void JsonDiagnostics::Log(Level level, DiagMessageActual& actual_msg) {
+  std::ostringstream line;
+  line << "{\"level\":\"" << LevelToString(level) << "\"";
+  if (!actual_msg.source.path.empty()) {
+    line << ",\"path\":";
+    util::WriteJsonString(actual_msg.source.path, &line);
+    if (actual_msg.source.line) {
+      line << ",\"line\":" << actual_msg.source.line.value();
+    }
+  }
+  line << ",\"message\":";
+  util::WriteJsonString(actual_msg.message, &line);
+  line << "}\n";
+
+  const std::string str = line.str();
+  out_->write(str.data(), str.size());
+}
+
+// Whether a word of a message names something, rather than being part of its wording.
+static bool IsNameLike(const std::string& word) {
+  for (char c : word) {
+    if (c == '/' || c == ':' || c == '.' || c == '@' || c == '_' || (c >= '0' && c <= '9')) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::string RepeatLimitingDiagnostics::MessageTemplate(const std::string& message) {
+  std::string result;
+  result.reserve(message.size());
+
+  size_t i = 0;
+  while (i < message.size()) {
+    const char c = message[i];
+    if (c == '\'' || c == '"' || c == '(') {
+      // Replace the quoted text, but keep the quotes so the template still reads naturally.
+      const char close = c == '(' ? ')' : c;
+      const size_t end = message.find(close, i + 1);
+      if (end != std::string::npos) {
+        result += c;
+        result += '*';
+        result += close;
+        i = end + 1;
+        continue;
+      }
+    }
+
+    if (c == ' ') {
+      result += c;
+      i++;
+      continue;
+    }
+
+    size_t end = message.find(' ', i);
+    if (end == std::string::npos) {
+      end = message.size();
+    }
+    const std::string word = message.substr(i, end - i);
+    result += IsNameLike(word) ? "*" : word;
+    i = end;
+  }
+  return result;
+}
+
+void RepeatLimitingDiagnostics::Log(Level level, DiagMessageActual& actual_msg) {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (limit_ == 0 || level != Level::Warn) {
+    diag_->Log(level, actual_msg);
+    return;
+  }
+
+  // The source is left out of the key, so the same warning reported for many files or lines
+  // counts as one kind of warning.
+  std::string message_template = MessageTemplate(actual_msg.message);
+  auto result = entry_index_.insert({message_template, entries_.size()});
+  if (result.second) {
+    entries_.push_back(Entry{level, std::move(message_template), 0u});
+  }
+
+  Entry& entry = entries_[result.first->second];
+  if (++entry.count <= limit_) {
+    diag_->Log(level, actual_msg);
+  }
+}
+
+void RepeatLimitingDiagnostics::Flush() {
+  std::lock_guard<std::mutex> lock(lock_);
+  for (const Entry& entry : entries_) {
+    if (entry.count > limit_) {
+      DiagMessageActual summary{Source(), ""};
+      std::ostringstream message;
+      message << "suppressed " << (entry.count - limit_) << " more of: " << entry.message_template;
+      summary.message = message.str();
+      diag_->Log(entry.level, summary);
+    }
+  }
+  entries_.clear();
+  entry_index_.clear();
+}
+
+void BufferedDiagnostics::FlushTo(IDiagnostics* diag) {
+  for (Message& message : messages_) {
+    diag->Log(message.level, message.actual_msg);
+  }
+  messages_.clear();
+}
+
+}  // namespace aapt
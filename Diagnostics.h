@@ -18,8 +18,11 @@
 #define AAPT_DIAGNOSTICS_H
 
 #include <iostream>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "android-base/macros.h"
 #include "androidfw/StringPiece.h"
@@ -113,10 +116,14 @@ class StdErrDiagnostics : public IDiagnostics {
         break;
     }
 
+    // std::cerr is unbuffered, so format the whole line first and write it with one call.
+    std::ostringstream line;
     if (!actual_msg.source.path.empty()) {
-      std::cerr << actual_msg.source << ": ";
+      line << actual_msg.source << ": ";
     }
-    std::cerr << tag << ": " << actual_msg.message << "." << std::endl;
+    line << tag << ": " << actual_msg.message << ".\n";
+    const std::string str = line.str();
+    std::cerr.write(str.data(), str.size());
   }
 
  private:
@@ -142,6 +149,105 @@ class SourcePathDiagnostics : public IDiagnostics {
   DISALLOW_COPY_AND_ASSIGN(SourcePathDiagnostics);
 };
 
+// Writes each message to a stream as a JSON object on a single line, for consumption by tools.
+class JsonDiagnostics : public IDiagnostics {
+ public:
+  explicit JsonDiagnostics(std::ostream* out) : out_(out) {}
+
+  void Log(Level level, DiagMessageActual& actual_msg) override;
+
+ private:
+  std::ostream* out_;
+
+  DISALLOW_COPY_AND_ASSIGN(JsonDiagnostics);
+};
+
+// Forwards messages to another IDiagnostics, but only the first few copies of each kind of
+// warning. Further copies are counted and summarized when Flush() is called. Errors and notes are
+// always forwarded, since notes such as the verbose per-file ones differ only by their source.
+//
+// Warnings are of the same kind when they are equal after the names in them are replaced by '*'
+// (see MessageTemplate()), so that the same warning about many resources is grouped too.
+// Messages may be logged from several threads at once.
+class RepeatLimitingDiagnostics : public IDiagnostics {
+ public:
+  explicit RepeatLimitingDiagnostics(IDiagnostics* diag) : diag_(diag) {}
+
+  ~RepeatLimitingDiagnostics() override {
+    Flush();
+  }
+
+  void SetDiagnostics(IDiagnostics* diag) {
+    std::lock_guard<std::mutex> lock(lock_);
+    diag_ = diag;
+  }
+
+  // The number of copies of each kind of warning to forward. 0 forwards everything.
+  void SetRepeatLimit(size_t limit) {
+    std::lock_guard<std::mutex> lock(lock_);
+    limit_ = limit;
+  }
+
+  void Log(Level level, DiagMessageActual& actual_msg) override;
+
+  // Reports how many copies of each kind of warning were dropped and resets the counts.
+  void Flush();
+
+  // Returns `message` with the text in quotes or parentheses, and the words that look like
+  // resource names, paths or numbers, replaced by '*'.
+  // For example "duplicate value for resource 'string/foo'" becomes
+  // "duplicate value for resource '*'".
+  static std::string MessageTemplate(const std::string& message);
+
+ private:
+  struct Entry {
+    Level level;
+    std::string message_template;
+    size_t count;
+  };
+
+  // Guards everything below, and keeps messages forwarded from several threads whole.
+  std::mutex lock_;
+
+  IDiagnostics* diag_;
+  size_t limit_ = 0;
+
+  // Kinds of warnings in the order they were first seen, so that the summary is deterministic.
+  std::vector<Entry> entries_;
+  std::unordered_map<std::string, size_t> entry_index_;
+
+  DISALLOW_COPY_AND_ASSIGN(RepeatLimitingDiagnostics);
+};
+
+// Holds messages until FlushTo() forwards them to another IDiagnostics. Work done on other threads
+// logs to one of these, so that its messages can be reported in a deterministic order.
+class BufferedDiagnostics : public IDiagnostics {
+ public:
+  BufferedDiagnostics() = default;
+
+  void Log(Level level, DiagMessageActual& actual_msg) override {
+    messages_.push_back(Message{level, actual_msg});
+  }
+
+  struct Message {
+    Level level;
+    DiagMessageActual actual_msg;
+  };
+
+  // The messages logged since the last FlushTo(), in the order they were logged.
+  const std::vector<Message>& messages() const {
+    return messages_;
+  }
+
+  // Forwards the messages in the order they were logged and clears them.
+  void FlushTo(IDiagnostics* diag);
+
+ private:
+  std::vector<Message> messages_;
+
+  DISALLOW_COPY_AND_ASSIGN(BufferedDiagnostics);
+};
+
 }  // namespace aapt
 
 #endif /* AAPT_DIAGNOSTICS_H */
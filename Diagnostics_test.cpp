@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Diagnostics.h"
+
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "test/Test.h"
+
+namespace aapt {
+
+TEST(DiagnosticsTest, JsonDiagnosticsWritesOneObjectPerLine) {
+  std::ostringstream out;
+  JsonDiagnostics diag(&out);
+  diag.Warn(DiagMessage(Source("res/values/a.xml", 12u)) << "bad \"value\"");
+  diag.Error(DiagMessage() << "failed");
+
+  EXPECT_EQ(
+      "{\"level\":\"warn\",\"path\":\"res/values/a.xml\",\"line\":12,"
+      "\"message\":\"bad \\\"value\\\"\"}\n"
+      "{\"level\":\"error\",\"message\":\"failed\"}\n",
+      out.str());
+}
+
+TEST(DiagnosticsTest, RepeatedWarningsAreSummarized) {
+  std::ostringstream out;
+  JsonDiagnostics json_diag(&out);
+  RepeatLimitingDiagnostics diag(&json_diag);
+  diag.SetRepeatLimit(1u);
+
+  diag.Warn(DiagMessage(Source("a.xml")) << "duplicate");
+  diag.Warn(DiagMessage(Source("b.xml")) << "duplicate");
+  diag.Warn(DiagMessage(Source("c.xml")) << "duplicate");
+  diag.Note(DiagMessage(Source("a.xml")) << "processing");
+  diag.Note(DiagMessage(Source("b.xml")) << "processing");
+  diag.Error(DiagMessage() << "failed");
+  diag.Error(DiagMessage() << "failed");
+  diag.Flush();
+
+  EXPECT_EQ(
+      "{\"level\":\"warn\",\"path\":\"a.xml\",\"message\":\"duplicate\"}\n"
+      "{\"level\":\"note\",\"path\":\"a.xml\",\"message\":\"processing\"}\n"
+      "{\"level\":\"note\",\"path\":\"b.xml\",\"message\":\"processing\"}\n"
+      "{\"level\":\"error\",\"message\":\"failed\"}\n"
+      "{\"level\":\"error\",\"message\":\"failed\"}\n"
+      "{\"level\":\"warn\",\"message\":\"suppressed 2 more of: duplicate\"}\n",
+      out.str());
+
+  // The counts start over after a flush.
+  out.str("");
+  diag.Warn(DiagMessage() << "duplicate");
+  EXPECT_EQ("{\"level\":\"warn\",\"message\":\"duplicate\"}\n", out.str());
+}
+
+TEST(DiagnosticsTest, WarningsThatDifferOnlyByNameAreSummarizedTogether) {
+  std::ostringstream out;
+  JsonDiagnostics json_diag(&out);
+  RepeatLimitingDiagnostics diag(&json_diag);
+  diag.SetRepeatLimit(2u);
+
+  for (int i = 0; i < 100; i++) {
+    diag.Warn(DiagMessage() << "duplicate value for resource 'string/name_" << i << "'");
+    diag.Warn(DiagMessage() << "ignoring package com.example.lib" << i);
+  }
+  diag.Warn(DiagMessage() << "ignoring configuration 'land' for attribute attr/foo");
+  diag.Flush();
+
+  EXPECT_EQ(
+      "{\"level\":\"warn\",\"message\":\"duplicate value for resource 'string/name_0'\"}\n"
+      "{\"level\":\"warn\",\"message\":\"ignoring package com.example.lib0\"}\n"
+      "{\"level\":\"warn\",\"message\":\"duplicate value for resource 'string/name_1'\"}\n"
+      "{\"level\":\"warn\",\"message\":\"ignoring package com.example.lib1\"}\n"
+      "{\"level\":\"warn\",\"message\":\"ignoring configuration 'land' for attribute attr/foo\"}\n"
+      "{\"level\":\"warn\",\"message\":\"suppressed 98 more of: duplicate value for resource "
+      "'*'\"}\n"
+      "{\"level\":\"warn\",\"message\":\"suppressed 98 more of: ignoring package *\"}\n",
+      out.str());
+}
+
+TEST(DiagnosticsTest, MessageTemplateReplacesNames) {
+  EXPECT_EQ("duplicate", RepeatLimitingDiagnostics::MessageTemplate("duplicate"));
+  EXPECT_EQ("resource '*' has a conflicting value for configuration (*)",
+            RepeatLimitingDiagnostics::MessageTemplate(
+                "resource 'com.app:string/foo' has a conflicting value for configuration (land)"));
+  EXPECT_EQ("* does not override an existing resource",
+            RepeatLimitingDiagnostics::MessageTemplate(
+                "string/foo does not override an existing resource"));
+  EXPECT_EQ("ignoring * files", RepeatLimitingDiagnostics::MessageTemplate("ignoring 12 files"));
+
+  // Unbalanced quotes are left alone.
+  EXPECT_EQ("it's *", RepeatLimitingDiagnostics::MessageTemplate("it's res/a.xml"));
+}
+
+TEST(DiagnosticsTest, RepeatedWarningsFromSeveralThreadsAreCounted) {
+  std::ostringstream out;
+  JsonDiagnostics json_diag(&out);
+  RepeatLimitingDiagnostics diag(&json_diag);
+  diag.SetRepeatLimit(1u);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&]() {
+      for (int i = 0; i < 100; i++) {
+        diag.Warn(DiagMessage() << "duplicate");
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  diag.Flush();
+
+  EXPECT_EQ(
+      "{\"level\":\"warn\",\"message\":\"duplicate\"}\n"
+      "{\"level\":\"warn\",\"message\":\"suppressed 399 more of: duplicate\"}\n",
+      out.str());
+}
+
+TEST(DiagnosticsTest, ZeroRepeatLimitForwardsEverything) {
+  std::ostringstream out;
+  JsonDiagnostics json_diag(&out);
+  RepeatLimitingDiagnostics diag(&json_diag);
+
+  diag.Warn(DiagMessage() << "duplicate");
+  diag.Warn(DiagMessage() << "duplicate");
+  diag.Flush();
+
+  EXPECT_EQ(
+      "{\"level\":\"warn\",\"message\":\"duplicate\"}\n"
+      "{\"level\":\"warn\",\"message\":\"duplicate\"}\n",
+      out.str());
+}
+
+TEST(DiagnosticsTest, BufferedMessagesAreForwardedInOrder) {
+  std::ostringstream out;
+  JsonDiagnostics json_diag(&out);
+  BufferedDiagnostics diag;
+
+  diag.Error(DiagMessage(Source("a.xml", 3u)) << "first");
+  diag.Warn(DiagMessage() << "second");
+  EXPECT_EQ("", out.str());
+
+  diag.FlushTo(&json_diag);
+  diag.FlushTo(&json_diag);
+  EXPECT_EQ(
+      "{\"level\":\"error\",\"path\":\"a.xml\",\"line\":3,\"message\":\"first\"}\n"
+      "{\"level\":\"warn\",\"message\":\"second\"}\n",
+      out.str());
+}
+
+}  // namespace aapt
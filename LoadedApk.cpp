@@ -22,9 +22,20 @@
 #include "flatten/TableFlattener.h"
 #include "io/BigBufferInputStream.h"
 #include "io/Util.h"
+#include "util/Util.h"
 
 namespace aapt {
 
+android::StringPiece LoadedApk::GetPathInApk(io::IFile* file) const {
+  const android::StringPiece path = file->GetSource().path;
+  const size_t prefix_len = source_.path.size() + 1;
+  if (path.size() < prefix_len || path[source_.path.size()] != '@' ||
+      !util::StartsWith(path, source_.path)) {
+    return path;
+  }
+  return path.substr(prefix_len, path.size() - prefix_len);
+}
+
 std::unique_ptr<LoadedApk> LoadedApk::LoadApkFromPath(IAaptContext* context,
                                                       const android::StringPiece& path) {
   Source source(path);
@@ -63,36 +74,63 @@ bool LoadedApk::WriteToArchive(IAaptContext* context, const TableFlattenerOption
 
 bool LoadedApk::WriteToArchive(IAaptContext* context, const TableFlattenerOptions& options,
                                FilterChain* filters, IArchiveWriter* writer) {
-  std::set<std::string> referenced_resources;
-  // List the files being referenced in the resource table.
+  // Maps the path of every file referenced in the resource table to the path it is written to.
+  // These differ when a reference was renamed after the APK was loaded.
+  std::map<std::string, std::string> referenced_resources;
   for (auto& pkg : table_->packages) {
     for (auto& type : pkg->types) {
       for (auto& entry : type->entries) {
         for (auto& config_value : entry->values) {
           FileReference* file_ref = ValueCast<FileReference>(config_value->value.get());
           if (file_ref) {
-            referenced_resources.insert(*file_ref->path);
+            const std::string path =
+                file_ref->file ? GetPathInApk(file_ref->file).to_string() : *file_ref->path;
+            referenced_resources[path] = *file_ref->path;
           }
         }
       }
     }
   }
 
+  // The resource table is written first, so that it starts the APK and is read with the least
+  // seeking. It needs to be re-serialized since it might have changed.
+  constexpr const char* kResourceTablePath = "resources.arsc";
+  if (apk_->FindFile(kResourceTablePath) != nullptr && filters->Keep(kResourceTablePath)) {
+    BigBuffer buffer(4096);
+    // TODO(adamlesinski): How to determine if there were sparse entries (and if to encode
+    // with sparse entries) b/35389232.
+    TableFlattener flattener(options, &buffer);
+    if (!flattener.Consume(context, table_.get())) {
+      return false;
+    }
+
+    io::BigBufferInputStream input_stream(&buffer);
+    if (!io::CopyInputStreamToArchive(context, &input_stream, kResourceTablePath,
+                                      ArchiveEntry::kAlign, writer)) {
+      return false;
+    }
+  }
+
   std::unique_ptr<io::IFileCollectionIterator> iterator = apk_->Iterator();
   while (iterator->HasNext()) {
     io::IFile* file = iterator->Next();
-
-    std::string path = file->GetSource().path;
-    // The name of the path has the format "<zip-file-name>@<path-to-file>".
-    path = path.substr(path.find("@") + 1);
+    const std::string path = GetPathInApk(file).to_string();
+    if (path == kResourceTablePath) {
+      continue;
+    }
+    std::string out_path = path;
 
     // Skip resources that are not referenced if requested.
-    if (path.find("res/") == 0 && referenced_resources.find(path) == referenced_resources.end()) {
-      if (context->IsVerbose()) {
-        context->GetDiagnostics()->Note(DiagMessage()
-                                        << "Removing resource '" << path << "' from APK.");
+    if (path.find("res/") == 0) {
+      auto iter = referenced_resources.find(path);
+      if (iter == referenced_resources.end()) {
+        if (context->IsVerbose()) {
+          context->GetDiagnostics()->Note(DiagMessage()
+                                          << "Removing resource '" << path << "' from APK.");
+        }
+        continue;
       }
-      continue;
+      out_path = iter->second;
     }
 
     if (!filters->Keep(path)) {
@@ -102,27 +140,9 @@ bool LoadedApk::WriteToArchive(IAaptContext* context, const TableFlattenerOption
       continue;
     }
 
-    // The resource table needs to be re-serialized since it might have changed.
-    if (path == "resources.arsc") {
-      BigBuffer buffer(4096);
-      // TODO(adamlesinski): How to determine if there were sparse entries (and if to encode
-      // with sparse entries) b/35389232.
-      TableFlattener flattener(options, &buffer);
-      if (!flattener.Consume(context, table_.get())) {
-        return false;
-      }
-
-      io::BigBufferInputStream input_stream(&buffer);
-      if (!io::CopyInputStreamToArchive(context, &input_stream, path, ArchiveEntry::kAlign,
-                                        writer)) {
-        return false;
-      }
-
-    } else {
-      uint32_t compression_flags = file->WasCompressed() ? ArchiveEntry::kCompress : 0u;
-      if (!io::CopyFileToArchive(context, file, path, compression_flags, writer)) {
-        return false;
-      }
+    uint32_t compression_flags = file->WasCompressed() ? ArchiveEntry::kCompress : 0u;
+    if (!io::CopyFileToArchive(context, file, out_path, compression_flags, writer)) {
+      return false;
     }
   }
   return true;
@@ -43,6 +43,13 @@ class LoadedApk {
 
   const Source& GetSource() { return source_; }
 
+  /**
+   * Returns the path of the entry `file` within this APK. The ZIP file collection names its
+   * files "<apk path>@<entry path>". The whole source path is returned for a file that is not
+   * an entry of this APK.
+   */
+  android::StringPiece GetPathInApk(io::IFile* file) const;
+
   /**
    * Writes the APK on disk at the given path, while also removing the resource
    * files that are not referenced in the resource table.
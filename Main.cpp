@@ -37,15 +37,9 @@ using ::android::base::StringPrintf;
 
 namespace aapt {
 
-// DO NOT UPDATE, this is more of a marketing version.
-static const char* sMajorVersion = "2";
-
-// Update minor version whenever a feature or flag is added.
-static const char* sMinorVersion = "19";
-
 static void PrintVersion() {
-  std::cerr << StringPrintf("Android Asset Packaging Tool (aapt) %s:%s", sMajorVersion,
-                            sMinorVersion)
+  std::cerr << StringPrintf("Android Asset Packaging Tool (aapt) %s:%s", util::GetMajorVersion(),
+                            util::GetMinorVersion())
             << std::endl;
 }
 
@@ -179,13 +179,13 @@ bool ResourceParser::FlattenXmlSubtree(
     if (event == xml::XmlPullParser::Event::kStartElement) {
       if (parser->element_namespace().empty()) {
         // This is an HTML tag which we encode as a span. Add it to the span stack.
-        std::string span_name = parser->element_name();
+        std::string span_name = parser->element_name().to_string();
         const auto end_attr_iter = parser->end_attributes();
         for (auto attr_iter = parser->begin_attributes(); attr_iter != end_attr_iter; ++attr_iter) {
           span_name += ";";
-          span_name += attr_iter->name;
+          span_name.append(attr_iter->name.data(), attr_iter->name.size());
           span_name += "=";
-          span_name += attr_iter->value;
+          span_name.append(attr_iter->value.data(), attr_iter->value.size());
         }
 
         // Make sure the string is representable in our binary format.
@@ -226,8 +226,9 @@ bool ResourceParser::FlattenXmlSubtree(
     } else if (event == xml::XmlPullParser::Event::kText) {
       // Record both the raw text and append to the builder to deal with escape sequences
       // and quotations.
-      out_raw_string->append(parser->text());
-      builder.Append(parser->text());
+      const StringPiece text = parser->text();
+      out_raw_string->append(text.data(), text.size());
+      builder.Append(text);
     } else if (event == xml::XmlPullParser::Event::kEndElement) {
       // Return one level from within the element.
       depth--;
@@ -295,7 +296,7 @@ bool ResourceParser::ParseResources(xml::XmlPullParser* parser) {
   while (xml::XmlPullParser::NextChildNode(parser, depth)) {
     const xml::XmlPullParser::Event event = parser->event();
     if (event == xml::XmlPullParser::Event::kComment) {
-      comment = parser->comment();
+      comment = parser->comment().to_string();
       continue;
     }
 
@@ -315,7 +316,7 @@ bool ResourceParser::ParseResources(xml::XmlPullParser* parser) {
       continue;
     }
 
-    std::string element_name = parser->element_name();
+    const StringPiece element_name = parser->element_name();
     if (element_name == "skip" || element_name == "eat-comment") {
       comment = "";
       continue;
@@ -401,7 +402,7 @@ bool ResourceParser::ParseResource(xml::XmlPullParser* parser,
       {"symbol", std::mem_fn(&ResourceParser::ParseSymbol)},
   });
 
-  std::string resource_type = parser->element_name();
+  std::string resource_type = parser->element_name().to_string();
 
   // The value format accepted for this resource.
   uint32_t resource_format = 0u;
@@ -775,8 +776,8 @@ bool ResourceParser::ParsePublicGroup(xml::XmlPullParser* parser,
     }
 
     const Source item_source = source_.WithLine(parser->line_number());
-    const std::string& element_namespace = parser->element_namespace();
-    const std::string& element_name = parser->element_name();
+    const StringPiece element_namespace = parser->element_namespace();
+    const StringPiece element_name = parser->element_name();
     if (element_namespace.empty() && element_name == "public") {
       Maybe<StringPiece> maybe_name =
           xml::FindNonEmptyAttribute(parser, "name");
@@ -957,8 +958,8 @@ bool ResourceParser::ParseAttrImpl(xml::XmlPullParser* parser,
     }
 
     const Source item_source = source_.WithLine(parser->line_number());
-    const std::string& element_namespace = parser->element_namespace();
-    const std::string& element_name = parser->element_name();
+    const StringPiece element_namespace = parser->element_namespace();
+    const StringPiece element_name = parser->element_name();
     if (element_namespace.empty() &&
         (element_name == "flag" || element_name == "enum")) {
       if (element_name == "enum") {
@@ -1140,8 +1141,8 @@ bool ResourceParser::ParseStyle(const ResourceType type, xml::XmlPullParser* par
       continue;
     }
 
-    const std::string& element_namespace = parser->element_namespace();
-    const std::string& element_name = parser->element_name();
+    const StringPiece element_namespace = parser->element_namespace();
+    const StringPiece element_name = parser->element_name();
     if (element_namespace == "" && element_name == "item") {
       error |= !ParseStyleItem(parser, style.get());
 
@@ -1209,8 +1210,8 @@ bool ResourceParser::ParseArrayImpl(xml::XmlPullParser* parser,
     }
 
     const Source item_source = source_.WithLine(parser->line_number());
-    const std::string& element_namespace = parser->element_namespace();
-    const std::string& element_name = parser->element_name();
+    const StringPiece element_namespace = parser->element_namespace();
+    const StringPiece element_name = parser->element_name();
     if (element_namespace.empty() && element_name == "item") {
       std::unique_ptr<Item> item = ParseXml(parser, typeMask, kNoRawString);
       if (!item) {
@@ -1252,8 +1253,8 @@ bool ResourceParser::ParsePlural(xml::XmlPullParser* parser,
     }
 
     const Source item_source = source_.WithLine(parser->line_number());
-    const std::string& element_namespace = parser->element_namespace();
-    const std::string& element_name = parser->element_name();
+    const StringPiece element_namespace = parser->element_namespace();
+    const StringPiece element_name = parser->element_name();
     if (element_namespace.empty() && element_name == "item") {
       Maybe<StringPiece> maybe_quantity =
           xml::FindNonEmptyAttribute(parser, "quantity");
@@ -1348,8 +1349,8 @@ bool ResourceParser::ParseDeclareStyleable(xml::XmlPullParser* parser,
     }
 
     const Source item_source = source_.WithLine(parser->line_number());
-    const std::string& element_namespace = parser->element_namespace();
-    const std::string& element_name = parser->element_name();
+    const StringPiece element_namespace = parser->element_namespace();
+    const StringPiece element_name = parser->element_name();
     if (element_namespace.empty() && element_name == "attr") {
       Maybe<StringPiece> maybe_name =
           xml::FindNonEmptyAttribute(parser, "name");
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "ResourceParser.h"
+
+#include "benchmark/benchmark.h"
+
+#include "ResourceTable.h"
+#include "io/StringInputStream.h"
+#include "test/Context.h"
+#include "test/CorpusGenerator.h"
+#include "xml/XmlPullParser.h"
+
+using ::aapt::io::StringInputStream;
+
+namespace aapt {
+
+static std::string GenerateValues(size_t entries) {
+  test::CorpusOptions options;
+  options.entries = entries;
+  options.locales = 0;
+  options.densities = 0;
+  options.layouts = 0;
+  options.drawables = 0;
+  return test::GenerateCorpus(options).front().contents;
+}
+
+static void BM_ResourceParserParseValues(benchmark::State& state) {
+  const std::string input = GenerateValues(state.range(0));
+
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder().Build();
+  while (state.KeepRunning()) {
+    ResourceTable table;
+    ResourceParser parser(context->GetDiagnostics(), &table, Source("values.xml"), {});
+    StringInputStream in(input);
+    xml::XmlPullParser xml_parser(&in);
+    if (!parser.Parse(&xml_parser)) {
+      state.SkipWithError("failed to parse values");
+      break;
+    }
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * input.size());
+}
+BENCHMARK(BM_ResourceParserParseValues)->Range(64, 16 << 10);
+
+// Parses the values in place, as `aapt2 compile` does with a mapping of the file.
+static void BM_ResourceParserParseValuesInPlace(benchmark::State& state) {
+  const std::string input = GenerateValues(state.range(0));
+
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder().Build();
+  while (state.KeepRunning()) {
+    ResourceTable table;
+    ResourceParser parser(context->GetDiagnostics(), &table, Source("values.xml"), {});
+    xml::XmlPullParser xml_parser(input.data(), input.size());
+    if (!parser.Parse(&xml_parser)) {
+      state.SkipWithError("failed to parse values");
+      break;
+    }
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * input.size());
+}
+BENCHMARK(BM_ResourceParserParseValuesInPlace)->Range(64, 16 << 10);
+
+}  // namespace aapt
@@ -74,8 +74,9 @@ class ResourceParserTest : public ::testing::Test {
     input += "<resources>\n";
     input.append(str.data(), str.size());
     input += "\n</resources>";
-    StringInputStream in(input);
-    xml::XmlPullParser xmlParser(&in);
+
+    // Parse in place, as `aapt2 compile` does.
+    xml::XmlPullParser xmlParser(input.data(), input.size());
     if (parser.Parse(&xmlParser)) {
       return ::testing::AssertionSuccess();
     }
@@ -90,6 +90,39 @@ ResourceTablePackage* ResourceTable::FindOrCreatePackage(const StringPiece& name
   return packages.emplace(iter, std::move(new_package))->get();
 }
 
+static void HashSymbol(const Symbol& symbol, util::Hasher* hasher) {
+  hasher->UpdateInt(static_cast<uint64_t>(symbol.state)).UpdateInt(symbol.allow_new ? 1u : 0u);
+}
+
+template <typename T>
+static void HashId(const Maybe<T>& id, util::Hasher* hasher) {
+  hasher->UpdateInt(id ? 1u : 0u).UpdateInt(id ? id.value() : 0u);
+}
+
+// Hashes each qualifier of the configuration.
+static void HashConfig(const ConfigDescription& config, util::Hasher* hasher) {
+  hasher->UpdateInt(config.imsi)
+      .UpdateInt(config.locale)
+      .UpdateInt(config.screenType)
+      .UpdateInt(config.input)
+      .UpdateInt(config.screenSize)
+      .UpdateInt(config.version)
+      .UpdateInt(config.screenConfig)
+      .UpdateInt(config.screenSizeDp)
+      .UpdateInt(config.screenConfig2)
+      .Update(config.localeScript, sizeof(config.localeScript))
+      .Update(config.localeVariant, sizeof(config.localeVariant));
+}
+
+void ResourceTablePackage::Hash(util::Hasher* hasher) const {
+  hasher->Update(name);
+  HashId(id, hasher);
+  hasher->UpdateInt(types.size());
+  for (const auto& type : types) {
+    type->Hash(hasher);
+  }
+}
+
 ResourceTableType* ResourceTablePackage::FindType(ResourceType type) {
   const auto last = types.end();
   auto iter = std::lower_bound(types.begin(), last, type, less_than_type);
@@ -128,6 +161,34 @@ ResourceEntry* ResourceTableType::FindOrCreateEntry(const StringPiece& name) {
   return entries.emplace(iter, new ResourceEntry(name))->get();
 }
 
+void ResourceTableType::Hash(util::Hasher* hasher) const {
+  HashHeader(hasher);
+  for (const auto& entry : entries) {
+    entry->Hash(hasher);
+  }
+}
+
+void ResourceTableType::HashHeader(util::Hasher* hasher) const {
+  hasher->UpdateInt(static_cast<uint64_t>(type));
+  HashId(id, hasher);
+  HashSymbol(symbol_status, hasher);
+  hasher->UpdateInt(entries.size());
+}
+
+void ResourceEntry::Hash(util::Hasher* hasher) const {
+  hasher->Update(name);
+  HashId(id, hasher);
+  HashSymbol(symbol_status, hasher);
+  hasher->UpdateInt(values.size());
+  for (const auto& config_value : values) {
+    HashConfig(config_value->config, hasher);
+    hasher->Update(config_value->product).UpdateInt(config_value->value ? 1u : 0u);
+    if (config_value->value) {
+      config_value->value->Hash(hasher);
+    }
+  }
+}
+
 ResourceConfigValue* ResourceEntry::FindValue(const ConfigDescription& config) {
   return FindValue(config, StringPiece());
 }
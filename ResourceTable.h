@@ -121,6 +121,12 @@ class ResourceEntry {
   std::vector<ResourceConfigValue*> FindValuesIf(
       const std::function<bool(ResourceConfigValue*)>& f);
 
+  /**
+   * Adds the name, ID, visibility and every configuration and value of this
+   * entry to `hasher`. Entries that hash equally are equal, barring collisions.
+   */
+  void Hash(util::Hasher* hasher) const;
+
  private:
   DISALLOW_COPY_AND_ASSIGN(ResourceEntry);
 };
@@ -157,6 +163,17 @@ class ResourceTableType {
   ResourceEntry* FindEntry(const android::StringPiece& name);
   ResourceEntry* FindOrCreateEntry(const android::StringPiece& name);
 
+  /**
+   * Adds the type, ID, visibility and every entry of this type to `hasher`.
+   */
+  void Hash(util::Hasher* hasher) const;
+
+  /**
+   * Adds the type, ID, visibility and number of entries of this type to
+   * `hasher`, but not the entries themselves.
+   */
+  void HashHeader(util::Hasher* hasher) const;
+
  private:
   DISALLOW_COPY_AND_ASSIGN(ResourceTableType);
 };
@@ -172,6 +189,11 @@ class ResourceTablePackage {
   ResourceTableType* FindType(ResourceType type);
   ResourceTableType* FindOrCreateType(const ResourceType type);
 
+  /**
+   * Adds the name, ID and every type of this package to `hasher`.
+   */
+  void Hash(util::Hasher* hasher) const;
+
  private:
   DISALLOW_COPY_AND_ASSIGN(ResourceTablePackage);
 };
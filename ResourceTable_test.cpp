@@ -141,4 +141,66 @@ TEST(ResourceTableTest, ProductVaryingValues) {
   EXPECT_EQ(std::string("tablet"), values[1]->product);
 }
 
+static uint64_t DigestOf(const ResourceTablePackage& package) {
+  util::Hasher hasher;
+  package.Hash(&hasher);
+  return hasher.Digest();
+}
+
+TEST(ResourceTableTest, EqualPackagesHashEqually) {
+  std::unique_ptr<ResourceTable> table_a = test::ResourceTableBuilder()
+                                               .SetPackageId("android", 0x01)
+                                               .AddString("android:string/foo", "foo")
+                                               .AddSimple("android:id/bar")
+                                               .Build();
+  std::unique_ptr<ResourceTable> table_b = test::ResourceTableBuilder()
+                                               .SetPackageId("android", 0x01)
+                                               .AddString("android:string/foo", "foo")
+                                               .AddSimple("android:id/bar")
+                                               .Build();
+  std::unique_ptr<ResourceTable> table_c =
+      test::ResourceTableBuilder()
+          .SetPackageId("android", 0x01)
+          .AddString("android:string/foo", "foo")
+          .AddString("android:string/foo", {}, test::ParseConfigOrDie("fr"), "le foo")
+          .AddSimple("android:id/bar")
+          .Build();
+
+  ResourceTablePackage* package_a = table_a->FindPackage("android");
+  ResourceTablePackage* package_b = table_b->FindPackage("android");
+  ResourceTablePackage* package_c = table_c->FindPackage("android");
+  ASSERT_THAT(package_a, NotNull());
+  ASSERT_THAT(package_b, NotNull());
+  ASSERT_THAT(package_c, NotNull());
+
+  EXPECT_EQ(DigestOf(*package_a), DigestOf(*package_b));
+  EXPECT_NE(DigestOf(*package_a), DigestOf(*package_c));
+}
+
+TEST(ResourceTableTest, ChangingOneValueChangesThePackageHash) {
+  test::ResourceTableBuilder builder_a;
+  test::ResourceTableBuilder builder_b;
+  builder_a.SetPackageId("android", 0x01);
+  builder_b.SetPackageId("android", 0x01);
+  for (int i = 0; i < 100; i++) {
+    const std::string name = "android:string/foo" + std::to_string(i);
+    builder_a.AddString(name, "foo");
+    builder_b.AddString(name, i == 57 ? "bar" : "foo");
+  }
+  std::unique_ptr<ResourceTable> table_a = builder_a.Build();
+  std::unique_ptr<ResourceTable> table_b = builder_b.Build();
+
+  ResourceTablePackage* package_a = table_a->FindPackage("android");
+  ResourceTablePackage* package_b = table_b->FindPackage("android");
+  ASSERT_THAT(package_a, NotNull());
+  ASSERT_THAT(package_b, NotNull());
+  EXPECT_NE(DigestOf(*package_a), DigestOf(*package_b));
+
+  // Changing the value back makes the packages hash equally again.
+  String* str = test::GetValue<String>(table_b.get(), "android:string/foo57");
+  ASSERT_THAT(str, NotNull());
+  str->value = table_b->string_pool.MakeRef("foo");
+  EXPECT_EQ(DigestOf(*package_a), DigestOf(*package_b));
+}
+
 }  // namespace aapt
@@ -54,6 +54,10 @@ bool RawString::Equals(const Value* value) const {
   return *this->value == *other->value;
 }
 
+void RawString::Hash(util::Hasher* hasher) const {
+  hasher->Update("raw string").Update(*value);
+}
+
 RawString* RawString::Clone(StringPool* new_pool) const {
   RawString* rs = new RawString(new_pool->MakeRef(value));
   rs->comment_ = comment_;
@@ -92,6 +96,21 @@ bool Reference::Equals(const Value* value) const {
          name == other->name;
 }
 
+void Reference::Hash(util::Hasher* hasher) const {
+  hasher->Update("reference")
+      .UpdateInt(static_cast<uint64_t>(reference_type))
+      .UpdateInt(private_reference ? 1u : 0u)
+      .UpdateInt(id ? 1u : 0u)
+      .UpdateInt(id ? id.value().id : 0u)
+      .UpdateInt(name ? 1u : 0u);
+  if (name) {
+    const ResourceName& res_name = name.value();
+    hasher->Update(res_name.package)
+        .UpdateInt(static_cast<uint64_t>(res_name.type))
+        .Update(res_name.entry);
+  }
+}
+
 bool Reference::Flatten(android::Res_value* out_value) const {
   const ResourceId resid = id.value_or_default(ResourceId(0));
   const bool dynamic = resid.is_valid_dynamic() && resid.package_id() != kFrameworkPackageId &&
@@ -149,6 +168,10 @@ bool Id::Equals(const Value* value) const {
   return ValueCast<Id>(value) != nullptr;
 }
 
+void Id::Hash(util::Hasher* hasher) const {
+  hasher->Update("id");
+}
+
 bool Id::Flatten(android::Res_value* out) const {
   out->dataType = android::Res_value::TYPE_INT_BOOLEAN;
   out->data = util::HostToDevice32(0);
@@ -161,6 +184,14 @@ void Id::Print(std::ostream* out) const { *out << "(id)"; }
 
 String::String(const StringPool::Ref& ref) : value(ref) {}
 
+static void HashUntranslatableSections(const std::vector<UntranslatableSection>& sections,
+                                       util::Hasher* hasher) {
+  hasher->UpdateInt(sections.size());
+  for (const UntranslatableSection& section : sections) {
+    hasher->UpdateInt(section.start).UpdateInt(section.end);
+  }
+}
+
 bool String::Equals(const Value* value) const {
   const String* other = ValueCast<String>(value);
   if (!other) {
@@ -185,6 +216,11 @@ bool String::Equals(const Value* value) const {
   return true;
 }
 
+void String::Hash(util::Hasher* hasher) const {
+  hasher->Update("string").Update(*value);
+  HashUntranslatableSections(untranslatable_sections, hasher);
+}
+
 bool String::Flatten(android::Res_value* out_value) const {
   // Verify that our StringPool index is within encode-able limits.
   if (value.index() > std::numeric_limits<uint32_t>::max()) {
@@ -234,6 +270,14 @@ bool StyledString::Equals(const Value* value) const {
   return true;
 }
 
+void StyledString::Hash(util::Hasher* hasher) const {
+  hasher->Update("styled string").Update(value->value).UpdateInt(value->spans.size());
+  for (const StringPool::Span& span : value->spans) {
+    hasher->Update(*span.name).UpdateInt(span.first_char).UpdateInt(span.last_char);
+  }
+  HashUntranslatableSections(untranslatable_sections, hasher);
+}
+
 bool StyledString::Flatten(android::Res_value* out_value) const {
   if (value.index() > std::numeric_limits<uint32_t>::max()) {
     return false;
@@ -269,6 +313,10 @@ bool FileReference::Equals(const Value* value) const {
   return path == other->path;
 }
 
+void FileReference::Hash(util::Hasher* hasher) const {
+  hasher->Update("file").Update(*path);
+}
+
 bool FileReference::Flatten(android::Res_value* out_value) const {
   if (path.index() > std::numeric_limits<uint32_t>::max()) {
     return false;
@@ -307,6 +355,10 @@ bool BinaryPrimitive::Equals(const Value* value) const {
          this->value.data == other->value.data;
 }
 
+void BinaryPrimitive::Hash(util::Hasher* hasher) const {
+  hasher->Update("primitive").UpdateInt(value.dataType).UpdateInt(value.data);
+}
+
 bool BinaryPrimitive::Flatten(android::Res_value* out_value) const {
   out_value->dataType = value.dataType;
   out_value->data = util::HostToDevice32(value.data);
@@ -409,6 +461,27 @@ bool Attribute::Equals(const Value* value) const {
                     });
 }
 
+void Attribute::Hash(util::Hasher* hasher) const {
+  hasher->Update("attribute")
+      .UpdateInt(type_mask)
+      .UpdateInt(static_cast<uint32_t>(min_int))
+      .UpdateInt(static_cast<uint32_t>(max_int))
+      .UpdateInt(symbols.size());
+
+  // Equals() ignores the order of the symbols.
+  std::vector<const Symbol*> sorted_symbols;
+  std::transform(symbols.begin(), symbols.end(), std::back_inserter(sorted_symbols),
+                 add_pointer<const Symbol>);
+  std::sort(sorted_symbols.begin(), sorted_symbols.end(),
+            [](const Symbol* a, const Symbol* b) -> bool {
+              return a->symbol.name < b->symbol.name;
+            });
+  for (const Symbol* symbol : sorted_symbols) {
+    symbol->symbol.Hash(hasher);
+    hasher->UpdateInt(symbol->value);
+  }
+}
+
 Attribute* Attribute::Clone(StringPool* /*new_pool*/) const {
   return new Attribute(*this);
 }
@@ -715,6 +788,22 @@ bool Style::Equals(const Value* value) const {
                     });
 }
 
+void Style::Hash(util::Hasher* hasher) const {
+  hasher->Update("style").UpdateInt(parent ? 1u : 0u);
+  if (parent) {
+    parent.value().Hash(hasher);
+  }
+
+  // Equals() ignores the order of the entries.
+  std::vector<const Entry*> sorted_entries = ToPointerVec(entries);
+  std::sort(sorted_entries.begin(), sorted_entries.end(), KeyNameComparator);
+  hasher->UpdateInt(sorted_entries.size());
+  for (const Entry* entry : sorted_entries) {
+    entry->key.Hash(hasher);
+    entry->value->Hash(hasher);
+  }
+}
+
 Style* Style::Clone(StringPool* new_pool) const {
   Style* style = new Style();
   style->parent = parent;
@@ -815,6 +904,13 @@ bool Array::Equals(const Value* value) const {
                     });
 }
 
+void Array::Hash(util::Hasher* hasher) const {
+  hasher->Update("array").UpdateInt(elements.size());
+  for (const std::unique_ptr<Item>& element : elements) {
+    element->Hash(hasher);
+  }
+}
+
 Array* Array::Clone(StringPool* new_pool) const {
   Array* array = new Array();
   array->comment_ = comment_;
@@ -852,6 +948,16 @@ bool Plural::Equals(const Value* value) const {
   return true;
 }
 
+void Plural::Hash(util::Hasher* hasher) const {
+  hasher->Update("plural");
+  for (const std::unique_ptr<Item>& item : values) {
+    hasher->UpdateInt(item ? 1u : 0u);
+    if (item) {
+      item->Hash(hasher);
+    }
+  }
+}
+
 Plural* Plural::Clone(StringPool* new_pool) const {
   Plural* p = new Plural();
   p->comment_ = comment_;
@@ -908,6 +1014,13 @@ bool Styleable::Equals(const Value* value) const {
                     });
 }
 
+void Styleable::Hash(util::Hasher* hasher) const {
+  hasher->Update("styleable").UpdateInt(entries.size());
+  for (const Reference& entry : entries) {
+    entry.Hash(hasher);
+  }
+}
+
 Styleable* Styleable::Clone(StringPool* /*new_pool*/) const {
   return new Styleable(*this);
 }
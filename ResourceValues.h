@@ -30,6 +30,7 @@
 #include "StringPool.h"
 #include "io/File.h"
 #include "util/Maybe.h"
+#include "util/Util.h"
 
 namespace aapt {
 
@@ -73,6 +74,10 @@ class Value {
 
   virtual bool Equals(const Value* value) const = 0;
 
+  // Adds everything that Equals() compares to `hasher`, so that equal values hash equally. The
+  // source, comment and weakness are left out, as they are by Equals().
+  virtual void Hash(util::Hasher* hasher) const = 0;
+
   // Calls the appropriate overload of ValueVisitor.
   virtual void Accept(RawValueVisitor* visitor) = 0;
 
@@ -134,6 +139,7 @@ struct Reference : public BaseItem<Reference> {
   Reference(const ResourceNameRef& n, const ResourceId& i);
 
   bool Equals(const Value* value) const override;
+  void Hash(util::Hasher* hasher) const override;
   bool Flatten(android::Res_value* out_value) const override;
   Reference* Clone(StringPool* new_pool) const override;
   void Print(std::ostream* out) const override;
@@ -146,6 +152,7 @@ bool operator==(const Reference&, const Reference&);
 struct Id : public BaseItem<Id> {
   Id() { weak_ = true; }
   bool Equals(const Value* value) const override;
+  void Hash(util::Hasher* hasher) const override;
   bool Flatten(android::Res_value* out) const override;
   Id* Clone(StringPool* new_pool) const override;
   void Print(std::ostream* out) const override;
@@ -159,6 +166,7 @@ struct RawString : public BaseItem<RawString> {
   explicit RawString(const StringPool::Ref& ref);
 
   bool Equals(const Value* value) const override;
+  void Hash(util::Hasher* hasher) const override;
   bool Flatten(android::Res_value* out_value) const override;
   RawString* Clone(StringPool* new_pool) const override;
   void Print(std::ostream* out) const override;
@@ -193,6 +201,7 @@ struct String : public BaseItem<String> {
   explicit String(const StringPool::Ref& ref);
 
   bool Equals(const Value* value) const override;
+  void Hash(util::Hasher* hasher) const override;
   bool Flatten(android::Res_value* out_value) const override;
   String* Clone(StringPool* new_pool) const override;
   void Print(std::ostream* out) const override;
@@ -209,6 +218,7 @@ struct StyledString : public BaseItem<StyledString> {
   explicit StyledString(const StringPool::StyleRef& ref);
 
   bool Equals(const Value* value) const override;
+  void Hash(util::Hasher* hasher) const override;
   bool Flatten(android::Res_value* out_value) const override;
   StyledString* Clone(StringPool* new_pool) const override;
   void Print(std::ostream* out) const override;
@@ -225,6 +235,7 @@ struct FileReference : public BaseItem<FileReference> {
   explicit FileReference(const StringPool::Ref& path);
 
   bool Equals(const Value* value) const override;
+  void Hash(util::Hasher* hasher) const override;
   bool Flatten(android::Res_value* out_value) const override;
   FileReference* Clone(StringPool* new_pool) const override;
   void Print(std::ostream* out) const override;
@@ -239,6 +250,7 @@ struct BinaryPrimitive : public BaseItem<BinaryPrimitive> {
   BinaryPrimitive(uint8_t dataType, uint32_t data);
 
   bool Equals(const Value* value) const override;
+  void Hash(util::Hasher* hasher) const override;
   bool Flatten(android::Res_value* out_value) const override;
   BinaryPrimitive* Clone(StringPool* new_pool) const override;
   void Print(std::ostream* out) const override;
@@ -261,6 +273,7 @@ struct Attribute : public BaseValue<Attribute> {
   explicit Attribute(bool w, uint32_t t = 0u);
 
   bool Equals(const Value* value) const override;
+  void Hash(util::Hasher* hasher) const override;
   Attribute* Clone(StringPool* new_pool) const override;
   void PrintMask(std::ostream* out) const;
   void Print(std::ostream* out) const override;
@@ -283,6 +296,7 @@ struct Style : public BaseValue<Style> {
   std::vector<Entry> entries;
 
   bool Equals(const Value* value) const override;
+  void Hash(util::Hasher* hasher) const override;
   Style* Clone(StringPool* new_pool) const override;
   void Print(std::ostream* out) const override;
 
@@ -295,6 +309,7 @@ struct Array : public BaseValue<Array> {
   std::vector<std::unique_ptr<Item>> elements;
 
   bool Equals(const Value* value) const override;
+  void Hash(util::Hasher* hasher) const override;
   Array* Clone(StringPool* new_pool) const override;
   void Print(std::ostream* out) const override;
 };
@@ -305,6 +320,7 @@ struct Plural : public BaseValue<Plural> {
   std::array<std::unique_ptr<Item>, Count> values;
 
   bool Equals(const Value* value) const override;
+  void Hash(util::Hasher* hasher) const override;
   Plural* Clone(StringPool* new_pool) const override;
   void Print(std::ostream* out) const override;
 };
@@ -313,6 +329,7 @@ struct Styleable : public BaseValue<Styleable> {
   std::vector<Reference> entries;
 
   bool Equals(const Value* value) const override;
+  void Hash(util::Hasher* hasher) const override;
   Styleable* Clone(StringPool* newPool) const override;
   void Print(std::ostream* out) const override;
   void MergeWith(Styleable* styleable);
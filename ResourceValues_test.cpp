@@ -24,6 +24,12 @@ using ::testing::StrEq;
 
 namespace aapt {
 
+static uint64_t DigestOf(const Value& value) {
+  util::Hasher hasher;
+  value.Hash(&hasher);
+  return hasher.Digest();
+}
+
 TEST(ResourceValuesTest, PluralEquals) {
   StringPool pool;
 
@@ -258,4 +264,59 @@ TEST(ResourcesValuesTest, AttributeMatches) {
   EXPECT_FALSE(attr4.Matches(BinaryPrimitive(TYPE_INT_DEC, 0x02u)));
 }
 
+TEST(ResourceValuesTest, EqualValuesHashEqually) {
+  StringPool pool_a;
+  Array a;
+  a.elements.push_back(util::make_unique<String>(pool_a.MakeRef("one")));
+  a.elements.push_back(util::make_unique<Reference>(test::ParseNameOrDie("android:string/two")));
+
+  StringPool pool_b;
+  Array b;
+  b.elements.push_back(util::make_unique<String>(pool_b.MakeRef("one")));
+  b.elements.push_back(util::make_unique<Reference>(test::ParseNameOrDie("android:string/two")));
+
+  Array c;
+  c.elements.push_back(util::make_unique<RawString>(pool_b.MakeRef("one")));
+  c.elements.push_back(util::make_unique<Reference>(test::ParseNameOrDie("android:string/two")));
+
+  ASSERT_TRUE(a.Equals(&b));
+  EXPECT_EQ(DigestOf(a), DigestOf(b));
+
+  ASSERT_FALSE(a.Equals(&c));
+  EXPECT_NE(DigestOf(a), DigestOf(c));
+}
+
+TEST(ResourceValuesTest, StyleHashIgnoresEntryOrder) {
+  std::unique_ptr<Style> a = test::StyleBuilder()
+      .SetParent("android:style/Parent")
+      .AddItem("android:attr/foo", ResourceUtils::TryParseInt("1"))
+      .AddItem("android:attr/bar", ResourceUtils::TryParseInt("2"))
+      .Build();
+
+  std::unique_ptr<Style> b = test::StyleBuilder()
+      .SetParent("android:style/Parent")
+      .AddItem("android:attr/bar", ResourceUtils::TryParseInt("2"))
+      .AddItem("android:attr/foo", ResourceUtils::TryParseInt("1"))
+      .Build();
+
+  std::unique_ptr<Style> c = test::StyleBuilder()
+      .SetParent("android:style/Parent")
+      .AddItem("android:attr/foo", ResourceUtils::TryParseInt("1"))
+      .AddItem("android:attr/bar", ResourceUtils::TryParseInt("3"))
+      .Build();
+
+  ASSERT_TRUE(a->Equals(b.get()));
+  EXPECT_EQ(DigestOf(*a), DigestOf(*b));
+  EXPECT_NE(DigestOf(*a), DigestOf(*c));
+}
+
+TEST(ResourceValuesTest, StyledStringsCompareEverySpan) {
+  StringPool pool;
+  StyledString a(pool.MakeRef(StyleString{"hello", {Span{"b", 0u, 1u}, Span{"i", 2u, 3u}}}));
+  StyledString b(pool.MakeRef(StyleString{"hello", {Span{"b", 0u, 1u}, Span{"u", 2u, 3u}}}));
+
+  EXPECT_FALSE(a.Equals(&b));
+  EXPECT_NE(DigestOf(a), DigestOf(b));
+}
+
 } // namespace aapt
@@ -137,6 +137,7 @@ bool StringPool::StyleRef::operator==(const StyleRef& rhs) const {
         span.name != rhs_span.name) {
       return false;
     }
+    ++rhs_iter;
   }
   return true;
 }
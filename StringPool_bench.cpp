@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "StringPool.h"
+
+#include "benchmark/benchmark.h"
+
+#include "test/Context.h"
+#include "test/CorpusGenerator.h"
+#include "util/BigBuffer.h"
+
+namespace aapt {
+
+// Flattens the value string pool of a corpus table, which holds every string and file path.
+static void BM_StringPoolFlatten(benchmark::State& state,
+                                 bool (*flatten)(BigBuffer*, const StringPool&)) {
+  std::unique_ptr<IAaptContext> context =
+      test::ContextBuilder().SetCompilationPackage("com.app.test").SetPackageId(0x7f).Build();
+  test::CorpusOptions options;
+  options.entries = state.range(0);
+  std::unique_ptr<ResourceTable> table =
+      test::BuildCorpusTable(context.get(), test::GenerateCorpus(options));
+  if (!table) {
+    state.SkipWithError("failed to build corpus table");
+    return;
+  }
+
+  while (state.KeepRunning()) {
+    BigBuffer buffer(1024);
+    flatten(&buffer, table->string_pool);
+    benchmark::DoNotOptimize(buffer.size());
+  }
+}
+
+static void BM_StringPoolFlattenUtf8(benchmark::State& state) {
+  BM_StringPoolFlatten(state, StringPool::FlattenUtf8);
+}
+BENCHMARK(BM_StringPoolFlattenUtf8)->Range(64, 16 << 10);
+
+static void BM_StringPoolFlattenUtf16(benchmark::State& state) {
+  BM_StringPoolFlatten(state, StringPool::FlattenUtf16);
+}
+BENCHMARK(BM_StringPoolFlattenUtf16)->Range(64, 16 << 10);
+
+}  // namespace aapt
@@ -16,6 +16,9 @@
 
 #include <dirent.h>
 
+#include <cstring>
+#include <iterator>
+#include <map>
 #include <string>
 
 #include "android-base/errors.h"
@@ -30,8 +33,11 @@
 #include "Flags.h"
 #include "ResourceParser.h"
 #include "ResourceTable.h"
+#include "ResourceUtils.h"
+#include "compile/CompileCache.h"
 #include "compile/IdAssigner.h"
 #include "compile/InlineXmlFormatParser.h"
+#include "compile/PackedCompiledFiles.h"
 #include "compile/Png.h"
 #include "compile/PseudolocaleGenerator.h"
 #include "compile/XmlIdCollector.h"
@@ -40,9 +46,11 @@
 #include "io/BigBufferOutputStream.h"
 #include "io/FileInputStream.h"
 #include "io/Util.h"
+#include "process/IResourceTableConsumer.h"
 #include "proto/ProtoSerialize.h"
 #include "util/Files.h"
 #include "util/Maybe.h"
+#include "util/Trace.h"
 #include "util/Util.h"
 #include "xml/XmlDom.h"
 #include "xml/XmlPullParser.h"
@@ -110,12 +118,18 @@ static Maybe<ResourcePathData> ExtractResourcePathData(const std::string& path,
 struct CompileOptions {
   std::string output_path;
   Maybe<std::string> res_dir;
+  bool packed = false;
   bool pseudolocalize = false;
   bool no_png_crunch = false;
   bool legacy_mode = false;
   bool verbose = false;
+  Maybe<std::string> cache_dir;
 };
 
+// Bump whenever the contents of a compiled file change without a change to aapt2's version,
+// so that stale entries in existing caches are no longer found.
+constexpr const uint64_t kCompileCacheFormat = 3u;
+
 static std::string BuildIntermediateFilename(const ResourcePathData& data) {
   std::stringstream name;
   name << data.resource_dir;
@@ -134,7 +148,39 @@ static bool IsHidden(const StringPiece& filename) {
   return util::StartsWith(filename, ".");
 }
 
-// Walks the res directory structure, looking for resource files.
+// Lists the resource files in the type directory `dir`, such as res/drawable-hdpi.
+static bool LoadInputFilesFromTypeDir(const std::string& dir, IDiagnostics* diag,
+                                      std::vector<ResourcePathData>* out_path_data) {
+  std::unique_ptr<DIR, decltype(closedir)*> d(opendir(dir.data()), closedir);
+  if (!d) {
+    diag->Error(DiagMessage(dir) << "failed to open directory: "
+                                 << android::base::SystemErrorCodeToString(errno));
+    return false;
+  }
+
+  while (struct dirent* entry = readdir(d.get())) {
+    if (IsHidden(entry->d_name)) {
+      continue;
+    }
+
+    std::string full_path = dir;
+    file::AppendPath(&full_path, entry->d_name);
+
+    std::string err_str;
+    Maybe<ResourcePathData> path_data = ExtractResourcePathData(full_path, &err_str);
+    if (!path_data) {
+      diag->Error(DiagMessage(full_path) << err_str);
+      return false;
+    }
+
+    out_path_data->push_back(std::move(path_data.value()));
+  }
+  return true;
+}
+
+// Walks the res directory structure, looking for resource files. The type directories are listed
+// on one thread per core, and their files are returned in the order the type directories were
+// read, the same as when listing them one after the other.
 static bool LoadInputFilesFromDir(IAaptContext* context, const CompileOptions& options,
                                   std::vector<ResourcePathData>* out_path_data) {
   const std::string& root_dir = options.res_dir.value();
@@ -145,6 +191,7 @@ static bool LoadInputFilesFromDir(IAaptContext* context, const CompileOptions& o
     return false;
   }
 
+  std::vector<std::string> type_dirs;
   while (struct dirent* entry = readdir(d.get())) {
     if (IsHidden(entry->d_name)) {
       continue;
@@ -153,34 +200,26 @@ static bool LoadInputFilesFromDir(IAaptContext* context, const CompileOptions& o
     std::string prefix_path = root_dir;
     file::AppendPath(&prefix_path, entry->d_name);
 
-    if (file::GetFileType(prefix_path) != file::FileType::kDirectory) {
-      continue;
+    if (file::GetFileType(prefix_path, d.get(), entry) == file::FileType::kDirectory) {
+      type_dirs.push_back(std::move(prefix_path));
     }
+  }
 
-    std::unique_ptr<DIR, decltype(closedir)*> subdir(opendir(prefix_path.data()), closedir);
-    if (!subdir) {
-      context->GetDiagnostics()->Error(DiagMessage(prefix_path) << "failed to open directory: "
-                                       << android::base::SystemErrorCodeToString(errno));
+  std::vector<std::vector<ResourcePathData>> path_data(type_dirs.size());
+  std::vector<std::unique_ptr<BufferedDiagnostics>> diagnostics(type_dirs.size());
+  std::vector<char> loaded(type_dirs.size(), false);
+  util::ParallelFor(type_dirs.size(), 0u, [&](size_t i) {
+    diagnostics[i] = util::make_unique<BufferedDiagnostics>();
+    loaded[i] = LoadInputFilesFromTypeDir(type_dirs[i], diagnostics[i].get(), &path_data[i]);
+  });
+
+  for (size_t i = 0u; i < type_dirs.size(); i++) {
+    diagnostics[i]->FlushTo(context->GetDiagnostics());
+    if (!loaded[i]) {
       return false;
     }
-
-    while (struct dirent* leaf_entry = readdir(subdir.get())) {
-      if (IsHidden(leaf_entry->d_name)) {
-        continue;
-      }
-
-      std::string full_path = prefix_path;
-      file::AppendPath(&full_path, leaf_entry->d_name);
-
-      std::string err_str;
-      Maybe<ResourcePathData> path_data = ExtractResourcePathData(full_path, &err_str);
-      if (!path_data) {
-        context->GetDiagnostics()->Error(DiagMessage(full_path) << err_str);
-        return false;
-      }
-
-      out_path_data->push_back(std::move(path_data.value()));
-    }
+    out_path_data->insert(out_path_data->end(), std::make_move_iterator(path_data[i].begin()),
+                          std::make_move_iterator(path_data[i].end()));
   }
   return true;
 }
@@ -190,15 +229,17 @@ static bool CompileTable(IAaptContext* context, const CompileOptions& options,
                          const std::string& output_path) {
   ResourceTable table;
   {
-    FileInputStream fin(path_data.source.path);
-    if (fin.HadError()) {
+    std::string error_str;
+    Maybe<android::FileMap> f = file::MmapPath(path_data.source.path, &error_str);
+    if (!f) {
       context->GetDiagnostics()->Error(DiagMessage(path_data.source)
-                                       << "failed to open file: " << fin.GetError());
+                                       << "failed to open file: " << error_str);
       return false;
     }
 
-    // Parse the values file from XML.
-    xml::XmlPullParser xml_parser(&fin);
+    // Parse the values file from XML, in place. The ResourceParser copies everything it keeps,
+    // so the mapping only has to outlive the parse.
+    xml::XmlPullParser xml_parser(f.value().getDataPtr(), f.value().getDataLength());
 
     ResourceParserOptions parser_options;
     parser_options.error_on_positional_arguments = !options.legacy_mode;
@@ -450,6 +491,123 @@ static bool CompileXml(IAaptContext* context, const CompileOptions& options,
   return true;
 }
 
+// Decodes the PNG in `content` and re-encodes it as compactly as possible into `out_buffer`.
+// 9-patch images have their border stripped and their 9-patch data encoded in PNG chunks.
+static bool CrunchPng(IAaptContext* context, const ResourcePathData& path_data,
+                      const std::string& content, const PngOptions& png_options,
+                      BigBuffer* out_buffer) {
+  BigBuffer crunched_png_buffer(4096);
+  io::BigBufferOutputStream crunched_png_buffer_out(&crunched_png_buffer);
+
+  // Ensure that we only keep the chunks we care about if we end up
+  // using the original PNG instead of the crunched one.
+  PngChunkFilter png_chunk_filter(content);
+  std::unique_ptr<Image> image = ReadPng(context, path_data.source, &png_chunk_filter);
+  if (!image) {
+    return false;
+  }
+
+  std::unique_ptr<NinePatch> nine_patch;
+  if (path_data.extension == "9.png") {
+    std::string err;
+    nine_patch = NinePatch::Create(image->rows.get(), image->width, image->height, &err);
+    if (!nine_patch) {
+      context->GetDiagnostics()->Error(DiagMessage() << err);
+      return false;
+    }
+
+    // Remove the 1px border around the NinePatch.
+    // Basically the row array is shifted up by 1, and the length is treated
+    // as height - 2.
+    // For each row, shift the array to the left by 1, and treat the length as
+    // width - 2.
+    image->width -= 2;
+    image->height -= 2;
+    memmove(image->rows.get(), image->rows.get() + 1, image->height * sizeof(uint8_t**));
+    for (int32_t h = 0; h < image->height; h++) {
+      memmove(image->rows[h], image->rows[h] + 4, image->width * 4);
+    }
+
+    if (context->IsVerbose()) {
+      context->GetDiagnostics()->Note(DiagMessage(path_data.source) << "9-patch: "
+                                                                    << *nine_patch);
+    }
+  }
+
+  // Write the crunched PNG.
+  if (!WritePng(context, image.get(), nine_patch.get(), &crunched_png_buffer_out, png_options)) {
+    return false;
+  }
+
+  if (nine_patch != nullptr ||
+      crunched_png_buffer_out.ByteCount() <= png_chunk_filter.ByteCount()) {
+    // No matter what, we must use the re-encoded PNG, even if it is larger.
+    // 9-patch images must be re-encoded since their borders are stripped.
+    out_buffer->AppendBuffer(std::move(crunched_png_buffer));
+  } else {
+    // The re-encoded PNG is larger than the original, and there is
+    // no mandatory transformation. Use the original.
+    if (context->IsVerbose()) {
+      context->GetDiagnostics()->Note(DiagMessage(path_data.source)
+                                      << "original PNG is smaller than crunched PNG"
+                                      << ", using original");
+    }
+
+    png_chunk_filter.Rewind();
+    BigBuffer filtered_png_buffer(4096);
+    io::BigBufferOutputStream filtered_png_buffer_out(&filtered_png_buffer);
+    io::Copy(&filtered_png_buffer_out, &png_chunk_filter);
+    out_buffer->AppendBuffer(std::move(filtered_png_buffer));
+  }
+
+  if (context->IsVerbose()) {
+    // For debugging only, use the legacy PNG cruncher and compare the resulting file sizes.
+    // This will help catch exotic cases where the new code may generate larger PNGs.
+    std::stringstream legacy_stream(content);
+    BigBuffer legacy_buffer(4096);
+    Png png(context->GetDiagnostics());
+    if (!png.process(path_data.source, &legacy_stream, &legacy_buffer, {})) {
+      return false;
+    }
+
+    context->GetDiagnostics()->Note(DiagMessage(path_data.source)
+                                    << "legacy=" << legacy_buffer.size()
+                                    << " new=" << out_buffer->size());
+  }
+  return true;
+}
+
+// Returns the warnings logged to `diagnostics`, to be stored with a cache entry and replayed when
+// the entry is used.
+static std::vector<DiagMessageActual> GetWarnings(const BufferedDiagnostics& diagnostics) {
+  std::vector<DiagMessageActual> warnings;
+  for (const BufferedDiagnostics::Message& message : diagnostics.messages()) {
+    if (message.level == IDiagnostics::Level::Warn) {
+      warnings.push_back(message.actual_msg);
+    }
+  }
+  return warnings;
+}
+
+// Describes what a crunched PNG depends on besides the bytes of the image. Unlike compiled files,
+// crunched PNGs don't record where they came from, so this leaves out the path. This lets identical
+// images share an entry across modules.
+static std::string DescribePngCacheInputs(const ResourcePathData& path_data,
+                                          const std::string& content,
+                                          const PngOptions& png_options) {
+  std::ostringstream inputs;
+  inputs << "version=" << util::GetMajorVersion() << "-" << util::GetMinorVersion() << "\n"
+         << "format=" << kCompileCacheFormat << "\n"
+         << "nine-patch=" << (path_data.extension == "9.png") << "\n"
+         << "grayscale-tolerance=" << png_options.grayscale_tolerance << "\n"
+         << "size=" << content.size() << "\n";
+  return inputs.str();
+}
+
+static std::string BuildPngCacheKey(const std::string& inputs, const std::string& content) {
+  return util::Hasher().Update(inputs).Update(content).HexDigest() + ".png";
+}
+
 static bool CompilePng(IAaptContext* context, const CompileOptions& options,
                        const ResourcePathData& path_data, IArchiveWriter* writer,
                        const std::string& output_path) {
@@ -473,83 +631,39 @@ static bool CompilePng(IAaptContext* context, const CompileOptions& options,
       return false;
     }
 
-    BigBuffer crunched_png_buffer(4096);
-    io::BigBufferOutputStream crunched_png_buffer_out(&crunched_png_buffer);
-
-    // Ensure that we only keep the chunks we care about if we end up
-    // using the original PNG instead of the crunched one.
-    PngChunkFilter png_chunk_filter(content);
-    std::unique_ptr<Image> image = ReadPng(context, path_data.source, &png_chunk_filter);
-    if (!image) {
-      return false;
-    }
-
-    std::unique_ptr<NinePatch> nine_patch;
-    if (path_data.extension == "9.png") {
-      std::string err;
-      nine_patch = NinePatch::Create(image->rows.get(), image->width, image->height, &err);
-      if (!nine_patch) {
-        context->GetDiagnostics()->Error(DiagMessage() << err);
+    PngOptions png_options;
+    if (!options.cache_dir) {
+      if (!CrunchPng(context, path_data, content, png_options, &buffer)) {
         return false;
       }
-
-      // Remove the 1px border around the NinePatch.
-      // Basically the row array is shifted up by 1, and the length is treated
-      // as height - 2.
-      // For each row, shift the array to the left by 1, and treat the length as
-      // width - 2.
-      image->width -= 2;
-      image->height -= 2;
-      memmove(image->rows.get(), image->rows.get() + 1, image->height * sizeof(uint8_t**));
-      for (int32_t h = 0; h < image->height; h++) {
-        memmove(image->rows[h], image->rows[h] + 4, image->width * 4);
-      }
-
-      if (context->IsVerbose()) {
-        context->GetDiagnostics()->Note(DiagMessage(path_data.source) << "9-patch: "
-                                                                      << *nine_patch);
-      }
-    }
-
-    // Write the crunched PNG.
-    if (!WritePng(context, image.get(), nine_patch.get(), &crunched_png_buffer_out, {})) {
-      return false;
-    }
-
-    if (nine_patch != nullptr ||
-        crunched_png_buffer_out.ByteCount() <= png_chunk_filter.ByteCount()) {
-      // No matter what, we must use the re-encoded PNG, even if it is larger.
-      // 9-patch images must be re-encoded since their borders are stripped.
-      buffer.AppendBuffer(std::move(crunched_png_buffer));
     } else {
-      // The re-encoded PNG is larger than the original, and there is
-      // no mandatory transformation. Use the original.
-      if (context->IsVerbose()) {
-        context->GetDiagnostics()->Note(DiagMessage(path_data.source)
-                                        << "original PNG is smaller than crunched PNG"
-                                        << ", using original");
-      }
+      const CompileCache cache(options.cache_dir.value());
+      const std::string inputs = DescribePngCacheInputs(path_data, content, png_options);
+      const std::string cache_key = BuildPngCacheKey(inputs, content);
+      if (Maybe<CompileCache::Entry> cached = cache.Find(cache_key, inputs)) {
+        if (context->IsVerbose()) {
+          context->GetDiagnostics()->Note(DiagMessage(path_data.source) << "using cached PNG");
+        }
 
-      png_chunk_filter.Rewind();
-      BigBuffer filtered_png_buffer(4096);
-      io::BigBufferOutputStream filtered_png_buffer_out(&filtered_png_buffer);
-      io::Copy(&filtered_png_buffer_out, &png_chunk_filter);
-      buffer.AppendBuffer(std::move(filtered_png_buffer));
-    }
+        cached.value().ReplayWarnings(context->GetDiagnostics());
+        const size_t len = cached.value().size();
+        memcpy(buffer.NextBlock<uint8_t>(len), cached.value().data(), len);
+      } else {
+        BufferedDiagnostics diagnostics;
+        DiagnosticsOverrideContext crunch_context(context, &diagnostics);
+        const bool crunched = CrunchPng(&crunch_context, path_data, content, png_options, &buffer);
+        const std::vector<DiagMessageActual> warnings = GetWarnings(diagnostics);
+        diagnostics.FlushTo(context->GetDiagnostics());
+        if (!crunched) {
+          return false;
+        }
 
-    if (context->IsVerbose()) {
-      // For debugging only, use the legacy PNG cruncher and compare the resulting file sizes.
-      // This will help catch exotic cases where the new code may generate larger PNGs.
-      std::stringstream legacy_stream(content);
-      BigBuffer legacy_buffer(4096);
-      Png png(context->GetDiagnostics());
-      if (!png.process(path_data.source, &legacy_stream, &legacy_buffer, {})) {
-        return false;
+        std::string error_str;
+        if (!cache.Store(cache_key, inputs, warnings, buffer, &error_str)) {
+          context->GetDiagnostics()->Warn(DiagMessage(path_data.source)
+                                          << "failed to write PNG cache entry: " << error_str);
+        }
       }
-
-      context->GetDiagnostics()->Note(DiagMessage(path_data.source)
-                                      << "legacy=" << legacy_buffer.size()
-                                      << " new=" << buffer.size());
     }
   }
 
@@ -588,6 +702,283 @@ static bool CompileFile(IAaptContext* context, const CompileOptions& options,
   return true;
 }
 
+using CompileFunc = bool (*)(IAaptContext* context, const CompileOptions& options,
+                             const ResourcePathData& path_data, IArchiveWriter* writer,
+                             const std::string& output_path);
+
+// Returns the digest of the contents of the file at `path` and sets `out_size` to its size. When
+// `snapshot` recorded the digest of the file and its stat fields are unchanged since, the file
+// isn't read at all.
+static Maybe<uint64_t> DigestFileContents(const std::string& path, FileDigestSnapshot* snapshot,
+                                          uint64_t* out_size, std::string* out_error) {
+  Maybe<FileDigestSnapshot::FileStat> stat = FileDigestSnapshot::Stat(path);
+  if (stat) {
+    if (Maybe<uint64_t> digest = snapshot->FindDigest(path, stat.value())) {
+      *out_size = stat.value().size;
+      return digest;
+    }
+  }
+
+  Maybe<android::FileMap> f = file::MmapPath(path, out_error);
+  if (!f) {
+    return {};
+  }
+
+  util::Hasher hasher;
+  hasher.UpdateInt(f.value().getDataLength());
+  if (f.value().getDataLength() != 0) {
+    hasher.Update(f.value().getDataPtr(), f.value().getDataLength());
+  }
+
+  if (stat) {
+    snapshot->SetDigest(path, stat.value(), hasher.Digest());
+  }
+  *out_size = f.value().getDataLength();
+  return hasher.Digest();
+}
+
+// Digests everything that determines the compiled output of `path_data`: the bytes of the file,
+// the path (it is recorded in the output as the source), the options that affect compilation and
+// the version of aapt2 doing the compiling. Sets `out_inputs` to a description of all of it but
+// the bytes of the file, which the cache entry records.
+static Maybe<std::string> BuildCacheKey(const CompileOptions& options,
+                                        const ResourcePathData& path_data,
+                                        FileDigestSnapshot* snapshot, std::string* out_inputs,
+                                        std::string* out_error) {
+  uint64_t size = 0u;
+  Maybe<uint64_t> content_digest =
+      DigestFileContents(path_data.source.path, snapshot, &size, out_error);
+  if (!content_digest) {
+    return {};
+  }
+
+  std::ostringstream inputs;
+  inputs << "version=" << util::GetMajorVersion() << "-" << util::GetMinorVersion() << "\n"
+         << "format=" << kCompileCacheFormat << "\n"
+         << "path=" << path_data.source.path << "\n"
+         << "resource=" << path_data.resource_dir << "/" << path_data.name << "."
+         << path_data.extension << "\n"
+         << "config=" << path_data.config_str << "\n"
+         << "options=" << (options.pseudolocalize ? " --pseudo-localize" : "")
+         << (options.no_png_crunch ? " --no-crunch" : "")
+         << (options.legacy_mode ? " --legacy" : "") << "\n"
+         << "size=" << size << "\n";
+  *out_inputs = inputs.str();
+
+  // Keep the extension so that the entries are easy to identify when inspecting the cache.
+  return util::Hasher().Update(*out_inputs).UpdateInt(content_digest.value()).HexDigest() + ".flat";
+}
+
+// Copies the compiled output of `path_data` from the cache if present, replaying the warnings that
+// compiling it reported. Otherwise compiles it with `compile_func` and stores the result and its
+// warnings in the cache for next time.
+static bool CompileWithCache(IAaptContext* context, const CompileOptions& options,
+                             CompileCache* cache, FileDigestSnapshot* snapshot,
+                             CompileFunc compile_func, const ResourcePathData& path_data,
+                             IArchiveWriter* writer, const std::string& output_path) {
+  std::string inputs;
+  std::string error_str;
+  Maybe<std::string> key = BuildCacheKey(options, path_data, snapshot, &inputs, &error_str);
+  if (!key) {
+    context->GetDiagnostics()->Error(DiagMessage(path_data.source) << "failed to mmap file: "
+                                     << error_str);
+    return false;
+  }
+
+  if (Maybe<CompileCache::Entry> cached = cache->Find(key.value(), inputs)) {
+    if (context->IsVerbose()) {
+      context->GetDiagnostics()->Note(DiagMessage(path_data.source) << "using cached output");
+    }
+    cached.value().ReplayWarnings(context->GetDiagnostics());
+
+    if (!writer->StartEntry(output_path, 0)) {
+      context->GetDiagnostics()->Error(DiagMessage(output_path) << "failed to open file");
+      return false;
+    }
+
+    if (!writer->Write(cached.value().data(), static_cast<int>(cached.value().size()))) {
+      context->GetDiagnostics()->Error(DiagMessage(output_path) << "failed to write data");
+      return false;
+    }
+
+    if (!writer->FinishEntry()) {
+      context->GetDiagnostics()->Error(DiagMessage(output_path) << "failed to finish writing data");
+      return false;
+    }
+    return true;
+  }
+
+  BufferedDiagnostics diagnostics;
+  DiagnosticsOverrideContext compile_context(context, &diagnostics);
+  RecordingArchiveWriter recording_writer(writer);
+  const bool compiled =
+      compile_func(&compile_context, options, path_data, &recording_writer, output_path);
+  const std::vector<DiagMessageActual> warnings = GetWarnings(diagnostics);
+  diagnostics.FlushTo(context->GetDiagnostics());
+  if (!compiled) {
+    return false;
+  }
+
+  // Failing to populate the cache only costs us the next compile, so don't fail this one.
+  if (!cache->Store(key.value(), inputs, warnings, recording_writer.GetRecordedData(),
+                    &error_str)) {
+    context->GetDiagnostics()->Warn(DiagMessage(path_data.source)
+                                    << "failed to write compile cache entry: " << error_str);
+  }
+  return true;
+}
+
+// Returns whether `path_data` is a PNG that gets crunched, which is by far the slowest kind of file
+// to compile.
+static bool IsCrunchedPng(const CompileOptions& options, const ResourcePathData& path_data) {
+  if (options.no_png_crunch || (path_data.extension != "png" && path_data.extension != "9.png")) {
+    return false;
+  }
+  const ResourceType* type = ParseResourceType(path_data.resource_dir);
+  return type != nullptr && *type != ResourceType::kRaw;
+}
+
+// An IArchiveWriter that keeps the entries written to it in memory until WriteTo() writes them to
+// another archive.
+class BufferedArchiveWriter : public IArchiveWriter {
+ public:
+  BufferedArchiveWriter() = default;
+
+  bool WriteFile(const StringPiece& path, uint32_t flags, io::InputStream* in) override {
+    if (!StartEntry(path, flags)) {
+      return false;
+    }
+
+    const void* data = nullptr;
+    size_t len = 0;
+    while (in->Next(&data, &len)) {
+      if (!Write(data, static_cast<int>(len))) {
+        return false;
+      }
+    }
+
+    if (in->HadError()) {
+      error_ = in->GetError();
+      return false;
+    }
+    return FinishEntry();
+  }
+
+  bool StartEntry(const StringPiece& path, uint32_t flags) override {
+    entries_.push_back(Entry{path.to_string(), flags, BigBuffer(4096)});
+    return true;
+  }
+
+  bool FinishEntry() override {
+    return !entries_.empty();
+  }
+
+  bool Write(const void* data, int len) override {
+    if (entries_.empty()) {
+      error_ = "no entry started";
+      return false;
+    }
+
+    if (len > 0) {
+      memcpy(entries_.back().data.NextBlock<uint8_t>(static_cast<size_t>(len)), data, len);
+    }
+    return true;
+  }
+
+  bool HadError() const override {
+    return !error_.empty();
+  }
+
+  std::string GetError() const override {
+    return error_;
+  }
+
+  // Writes the buffered entries to `writer` in the order they were written here.
+  bool WriteTo(IArchiveWriter* writer, IDiagnostics* diag) const {
+    for (const Entry& entry : entries_) {
+      if (!writer->StartEntry(entry.path, entry.flags)) {
+        diag->Error(DiagMessage(entry.path) << "failed to open file");
+        return false;
+      }
+
+      for (const auto& block : entry.data) {
+        if (!writer->Write(block.buffer.get(), static_cast<int>(block.size))) {
+          diag->Error(DiagMessage(entry.path) << "failed to write data");
+          return false;
+        }
+      }
+
+      if (!writer->FinishEntry()) {
+        diag->Error(DiagMessage(entry.path) << "failed to finish writing data");
+        return false;
+      }
+    }
+    return true;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(BufferedArchiveWriter);
+
+  struct Entry {
+    std::string path;
+    uint32_t flags;
+    BigBuffer data;
+  };
+
+  std::vector<Entry> entries_;
+  std::string error_;
+};
+
+// A PNG crunched ahead of the compile loop, with what it logged, until the loop gets to it.
+struct PrecompiledPng {
+  BufferedDiagnostics diagnostics;
+  BufferedArchiveWriter writer;
+  bool compiled = false;
+};
+
+// How many PNGs PrecompilePngs() crunches at a time, which bounds the crunched PNGs held in memory.
+constexpr static const size_t kPngBatchSize = 256u;
+
+// Crunches the next kPngBatchSize PNGs in `input_data`, starting at `begin`, on one thread per
+// core, and adds them to `out_pngs` by their index in `input_data`. Returns the index after the
+// last input looked at.
+static size_t PrecompilePngs(IAaptContext* context, const CompileOptions& options,
+                             CompileCache* cache, FileDigestSnapshot* snapshot,
+                             TraceRecorder* trace, const std::vector<ResourcePathData>& input_data,
+                             size_t begin,
+                             std::map<size_t, std::unique_ptr<PrecompiledPng>>* out_pngs) {
+  std::vector<size_t> indices;
+  std::vector<PrecompiledPng*> pngs;
+  size_t end = begin;
+  for (; end < input_data.size() && indices.size() < kPngBatchSize; end++) {
+    if (IsCrunchedPng(options, input_data[end])) {
+      std::unique_ptr<PrecompiledPng>& png = (*out_pngs)[end];
+      png = util::make_unique<PrecompiledPng>();
+      indices.push_back(end);
+      pngs.push_back(png.get());
+    }
+  }
+
+  util::ParallelFor(indices.size(), 0u, [&](size_t i) {
+    const ResourcePathData& path_data = input_data[indices[i]];
+    TraceSpan span(trace, "compile", path_data.source.path);
+    PrecompiledPng* png = pngs[i];
+    DiagnosticsOverrideContext png_context(context, &png->diagnostics);
+    if (!IsValidFile(&png_context, path_data.source.path)) {
+      return;
+    }
+
+    const std::string output_filename = BuildIntermediateFilename(path_data);
+    if (cache != nullptr) {
+      png->compiled = CompileWithCache(&png_context, options, cache, snapshot, &CompilePng,
+                                       path_data, &png->writer, output_filename);
+    } else {
+      png->compiled = CompilePng(&png_context, options, path_data, &png->writer, output_filename);
+    }
+  });
+  return end;
+}
+
 class CompileContext : public IAaptContext {
  public:
   CompileContext(IDiagnostics* diagnostics) : diagnostics_(diagnostics) {
@@ -643,14 +1034,24 @@ class CompileContext : public IAaptContext {
  * correct steps.
  */
 int Compile(const std::vector<StringPiece>& args, IDiagnostics* diagnostics) {
-  CompileContext context(diagnostics);
+  JsonDiagnostics json_diagnostics(&std::cerr);
+  RepeatLimitingDiagnostics limited_diagnostics(diagnostics);
+  CompileContext context(&limited_diagnostics);
   CompileOptions options;
 
   bool verbose = false;
+  bool diagnostics_json = false;
+  Maybe<std::string> warn_repeat_limit;
+  Maybe<std::string> trace_file;
   Flags flags =
       Flags()
           .RequiredFlag("-o", "Output path", &options.output_path)
           .OptionalFlag("--dir", "Directory to scan for resources", &options.res_dir)
+          .OptionalSwitch("--packed",
+                          "With --dir, writes a packed container instead of a ZIP archive.\n"
+                          "It stores the headers of all compiled files in one index with a\n"
+                          "shared string dictionary, so link reads it faster",
+                          &options.packed)
           .OptionalSwitch("--pseudo-localize",
                           "Generate resources for pseudo-locales "
                           "(en-XA and ar-XB)",
@@ -658,13 +1059,48 @@ int Compile(const std::vector<StringPiece>& args, IDiagnostics* diagnostics) {
           .OptionalSwitch("--no-crunch", "Disables PNG processing", &options.no_png_crunch)
           .OptionalSwitch("--legacy", "Treat errors that used to be valid in AAPT as warnings",
                           &options.legacy_mode)
+          .OptionalFlag("--cache-dir",
+                        "Directory in which to cache compiled files. Inputs that were\n"
+                        "compiled before with the same contents and options are copied\n"
+                        "from the cache instead of being compiled again. Crunched PNGs\n"
+                        "are shared by all images with the same contents",
+                        &options.cache_dir)
+          .OptionalFlag("--trace-file",
+                        "Writes the time spent compiling each file to a Chrome\n"
+                        "trace-event JSON file that can be loaded into chrome://tracing",
+                        &trace_file)
+          .OptionalFlag("--warn-repeat-limit",
+                        "Prints each kind of warning at most this many times. Warnings\n"
+                        "that differ only by names are of the same kind. Further copies\n"
+                        "are counted and summarized at the end",
+                        &warn_repeat_limit)
+          .OptionalSwitch("--diagnostics-json",
+                          "Prints errors and warnings as JSON objects, one per line",
+                          &diagnostics_json)
           .OptionalSwitch("-v", "Enables verbose logging", &verbose);
   if (!flags.Parse("aapt2 compile", args, &std::cerr)) {
     return 1;
   }
 
+  if (diagnostics_json) {
+    limited_diagnostics.SetDiagnostics(&json_diagnostics);
+  }
+
+  if (warn_repeat_limit) {
+    Maybe<uint32_t> limit = ResourceUtils::ParseInt(warn_repeat_limit.value());
+    if (!limit || static_cast<int32_t>(limit.value()) < 0) {
+      context.GetDiagnostics()->Error(DiagMessage() << "invalid --warn-repeat-limit '"
+                                                    << warn_repeat_limit.value() << "'");
+      return 1;
+    }
+    limited_diagnostics.SetRepeatLimit(limit.value());
+  }
+
   context.SetVerbose(verbose);
 
+  TraceRecorder trace_recorder;
+  TraceRecorder* trace = trace_file ? &trace_recorder : nullptr;
+
   std::unique_ptr<IArchiveWriter> archive_writer;
 
   std::vector<ResourcePathData> input_data;
@@ -676,13 +1112,27 @@ int Compile(const std::vector<StringPiece>& args, IDiagnostics* diagnostics) {
       return 1;
     }
 
+    TraceSpan scan_span(trace, "compile", "scan");
     if (!LoadInputFilesFromDir(&context, options, &input_data)) {
       return 1;
     }
+    scan_span.AddArg("files", input_data.size());
+    scan_span.End();
 
-    archive_writer = CreateZipFileArchiveWriter(context.GetDiagnostics(), options.output_path);
+    if (options.packed) {
+      archive_writer =
+          CreatePackedCompiledFileWriter(context.GetDiagnostics(), options.output_path);
+    } else {
+      archive_writer = CreateZipFileArchiveWriter(context.GetDiagnostics(), options.output_path);
+    }
 
   } else {
+    if (options.packed) {
+      context.GetDiagnostics()->Error(DiagMessage() << "--packed requires --dir");
+      flags.Usage("aapt2 compile", &std::cerr);
+      return 1;
+    }
+
     input_data.reserve(flags.GetArgs().size());
 
     // Collect data from the path for each input file.
@@ -703,54 +1153,116 @@ int Compile(const std::vector<StringPiece>& args, IDiagnostics* diagnostics) {
     return 1;
   }
 
+  std::unique_ptr<CompileCache> cache;
+  FileDigestSnapshot snapshot;
+  std::string snapshot_path;
+  if (options.cache_dir) {
+    cache = util::make_unique<CompileCache>(options.cache_dir.value());
+
+    // The digests of this invocation's inputs, so that unchanged inputs needn't be read to look
+    // them up. Named after the output so that modules sharing the cache don't overwrite each
+    // other's snapshots.
+    snapshot_path = options.cache_dir.value();
+    file::AppendPath(&snapshot_path,
+                     "digests-" + util::Hasher().Update(options.output_path).HexDigest());
+    snapshot.Load(snapshot_path);
+  }
+
+  // PNGs are crunched ahead of the loop, a batch at a time, on one thread per core. The loop writes
+  // their outputs and replays what they logged in input order, so neither depends on scheduling.
+  std::map<size_t, std::unique_ptr<PrecompiledPng>> precompiled_pngs;
+  size_t next_png_batch = 0u;
+
   bool error = false;
-  for (ResourcePathData& path_data : input_data) {
+  for (size_t i = 0u; i < input_data.size(); i++) {
+    ResourcePathData& path_data = input_data[i];
+    if (i >= next_png_batch && IsCrunchedPng(options, path_data)) {
+      TraceSpan batch_span(trace, "compile", "crunch PNGs");
+      next_png_batch = PrecompilePngs(&context, options, cache.get(), &snapshot, trace, input_data,
+                                      i, &precompiled_pngs);
+      batch_span.AddArg("files", precompiled_pngs.size());
+    }
+
     if (options.verbose) {
       context.GetDiagnostics()->Note(DiagMessage(path_data.source) << "processing");
     }
 
+    // The span of a precompiled PNG was recorded by the thread that crunched it.
+    auto precompiled_iter = precompiled_pngs.find(i);
+    if (precompiled_iter != precompiled_pngs.end()) {
+      std::unique_ptr<PrecompiledPng> png = std::move(precompiled_iter->second);
+      precompiled_pngs.erase(precompiled_iter);
+      png->diagnostics.FlushTo(context.GetDiagnostics());
+      if (!png->compiled || !png->writer.WriteTo(archive_writer.get(), context.GetDiagnostics())) {
+        error = true;
+      }
+      continue;
+    }
+
+    TraceSpan span(trace, "compile", path_data.source.path);
     if (!IsValidFile(&context, path_data.source.path)) {
       error = true;
       continue;
     }
 
+    CompileFunc compile_func = nullptr;
     if (path_data.resource_dir == "values") {
       // Overwrite the extension.
       path_data.extension = "arsc";
-
-      const std::string output_filename = BuildIntermediateFilename(path_data);
-      if (!CompileTable(&context, options, path_data, archive_writer.get(), output_filename)) {
-        error = true;
-      }
-
-    } else {
-      const std::string output_filename = BuildIntermediateFilename(path_data);
-      if (const ResourceType* type = ParseResourceType(path_data.resource_dir)) {
-        if (*type != ResourceType::kRaw) {
-          if (path_data.extension == "xml") {
-            if (!CompileXml(&context, options, path_data, archive_writer.get(), output_filename)) {
-              error = true;
-            }
-          } else if (!options.no_png_crunch &&
-                     (path_data.extension == "png" || path_data.extension == "9.png")) {
-            if (!CompilePng(&context, options, path_data, archive_writer.get(), output_filename)) {
-              error = true;
-            }
-          } else {
-            if (!CompileFile(&context, options, path_data, archive_writer.get(), output_filename)) {
-              error = true;
-            }
-          }
+      compile_func = &CompileTable;
+    } else if (const ResourceType* type = ParseResourceType(path_data.resource_dir)) {
+      if (*type != ResourceType::kRaw) {
+        if (path_data.extension == "xml") {
+          compile_func = &CompileXml;
+        } else if (!options.no_png_crunch &&
+                   (path_data.extension == "png" || path_data.extension == "9.png")) {
+          compile_func = &CompilePng;
         } else {
-          if (!CompileFile(&context, options, path_data, archive_writer.get(), output_filename)) {
-            error = true;
-          }
+          compile_func = &CompileFile;
         }
       } else {
-        context.GetDiagnostics()->Error(DiagMessage() << "invalid file path '" << path_data.source
-                                                      << "'");
+        compile_func = &CompileFile;
+      }
+    } else {
+      context.GetDiagnostics()->Error(DiagMessage() << "invalid file path '" << path_data.source
+                                                    << "'");
+      error = true;
+      continue;
+    }
+
+    const std::string output_filename = BuildIntermediateFilename(path_data);
+    if (cache != nullptr) {
+      if (!CompileWithCache(&context, options, cache.get(), &snapshot, compile_func, path_data,
+                            archive_writer.get(), output_filename)) {
         error = true;
       }
+    } else if (!compile_func(&context, options, path_data, archive_writer.get(),
+                             output_filename)) {
+      error = true;
+    }
+  }
+
+  // Errors writing entries were already reported, so only report what finishing adds.
+  if (!archive_writer->Finish() && !error) {
+    context.GetDiagnostics()->Error(DiagMessage(options.output_path)
+                                    << "failed to write output: " << archive_writer->GetError());
+    error = true;
+  }
+
+  if (cache != nullptr) {
+    std::string error_str;
+    if (!snapshot.Save(snapshot_path, &error_str)) {
+      context.GetDiagnostics()->Warn(DiagMessage(snapshot_path)
+                                     << "failed to write file digest snapshot: " << error_str);
+    }
+  }
+
+  if (trace_file) {
+    std::string error_str;
+    if (!trace_recorder.WriteToFile(trace_file.value(), &error_str)) {
+      context.GetDiagnostics()->Error(DiagMessage(trace_file.value())
+                                      << "failed to write trace: " << error_str);
+      error = true;
     }
   }
 
@@ -14,10 +14,13 @@
  * limitations under the License.
  */
 
+#include "cmd/Diff.h"
+
+#include <unordered_map>
+
 #include "android-base/macros.h"
 
 #include "Flags.h"
-#include "LoadedApk.h"
 #include "ValueVisitor.h"
 #include "process/IResourceTableConsumer.h"
 #include "process/SymbolTable.h"
@@ -26,6 +29,41 @@ using android::StringPiece;
 
 namespace aapt {
 
+// The digests of the types and entries of the resource tables being compared. They are computed
+// once for each table before it is walked. The digest of a type is made from the digests of its
+// entries, so that every value is hashed only once.
+class TableDigests {
+ public:
+  void AddTable(const ResourceTable& table) {
+    for (const auto& package : table.packages) {
+      for (const auto& type : package->types) {
+        util::Hasher type_hasher;
+        type->HashHeader(&type_hasher);
+        for (const auto& entry : type->entries) {
+          util::Hasher entry_hasher;
+          entry->Hash(&entry_hasher);
+          const uint64_t entry_digest = entry_hasher.Digest();
+          entry_digests_[entry.get()] = entry_digest;
+          type_hasher.UpdateInt(entry_digest);
+        }
+        type_digests_[type.get()] = type_hasher.Digest();
+      }
+    }
+  }
+
+  uint64_t GetDigest(const ResourceTableType* type) const {
+    return type_digests_.at(type);
+  }
+
+  uint64_t GetDigest(const ResourceEntry* entry) const {
+    return entry_digests_.at(entry);
+  }
+
+ private:
+  std::unordered_map<const ResourceTableType*, uint64_t> type_digests_;
+  std::unordered_map<const ResourceEntry*, uint64_t> entry_digests_;
+};
+
 class DiffContext : public IAaptContext {
  public:
   DiffContext() : name_mangler_({}), symbol_table_(&name_mangler_) {
@@ -64,17 +102,45 @@ class DiffContext : public IAaptContext {
     return 0;
   }
 
+  void SetOutput(std::ostream* out, bool json_output) {
+    out_ = out;
+    json_output_ = json_output;
+  }
+
+  // Reports a difference found in `source`. In JSON mode, each difference is written as an object
+  // on its own line, with `kind` being one of "missing", "new", "visibility", "id", "value" or
+  // "file".
+  void EmitDiff(const Source& source, const StringPiece& kind, const StringPiece& message) {
+    if (!json_output_) {
+      *out_ << source << ": " << message << "\n";
+      return;
+    }
+
+    std::ostringstream out;
+    out << "{\"apk\":";
+    util::WriteJsonString(source.path, &out);
+    out << ",\"kind\":";
+    util::WriteJsonString(kind, &out);
+    out << ",\"message\":";
+    util::WriteJsonString(message, &out);
+    out << "}\n";
+    *out_ << out.str();
+  }
+
+  TableDigests* GetDigests() {
+    return &digests_;
+  }
+
  private:
   std::string empty_;
+  std::ostream* out_ = &std::cerr;
+  bool json_output_ = false;
+  TableDigests digests_;
   StdErrDiagnostics diagnostics_;
   NameMangler name_mangler_;
   SymbolTable symbol_table_;
 };
 
-static void EmitDiffLine(const Source& source, const StringPiece& message) {
-  std::cerr << source << ": " << message << "\n";
-}
-
 static bool IsSymbolVisibilityDifferent(const Symbol& symbol_a, const Symbol& symbol_b) {
   return symbol_a.state != symbol_b.state;
 }
@@ -88,7 +154,7 @@ static bool IsIdDiff(const Symbol& symbol_a, const Maybe<Id>& id_a, const Symbol
   return false;
 }
 
-static bool EmitResourceConfigValueDiff(IAaptContext* context, LoadedApk* apk_a,
+static bool EmitResourceConfigValueDiff(DiffContext* context, LoadedApk* apk_a,
                                         ResourceTablePackage* pkg_a, ResourceTableType* type_a,
                                         ResourceEntry* entry_a, ResourceConfigValue* config_value_a,
                                         LoadedApk* apk_b, ResourceTablePackage* pkg_b,
@@ -103,13 +169,13 @@ static bool EmitResourceConfigValueDiff(IAaptContext* context, LoadedApk* apk_a,
     value_a->Print(&str_stream);
     str_stream << "\n vs \n";
     value_b->Print(&str_stream);
-    EmitDiffLine(apk_b->GetSource(), str_stream.str());
+    context->EmitDiff(apk_b->GetSource(), "value", str_stream.str());
     return true;
   }
   return false;
 }
 
-static bool EmitResourceEntryDiff(IAaptContext* context, LoadedApk* apk_a,
+static bool EmitResourceEntryDiff(DiffContext* context, LoadedApk* apk_a,
                                   ResourceTablePackage* pkg_a, ResourceTableType* type_a,
                                   ResourceEntry* entry_a, LoadedApk* apk_b,
                                   ResourceTablePackage* pkg_b, ResourceTableType* type_b,
@@ -121,7 +187,7 @@ static bool EmitResourceEntryDiff(IAaptContext* context, LoadedApk* apk_a,
       std::stringstream str_stream;
       str_stream << "missing " << pkg_a->name << ":" << type_a->type << "/" << entry_a->name
                  << " config=" << config_value_a->config;
-      EmitDiffLine(apk_b->GetSource(), str_stream.str());
+      context->EmitDiff(apk_b->GetSource(), "missing", str_stream.str());
       diff = true;
     } else {
       diff |=
@@ -137,14 +203,14 @@ static bool EmitResourceEntryDiff(IAaptContext* context, LoadedApk* apk_a,
       std::stringstream str_stream;
       str_stream << "new config " << pkg_b->name << ":" << type_b->type << "/" << entry_b->name
                  << " config=" << config_value_b->config;
-      EmitDiffLine(apk_b->GetSource(), str_stream.str());
+      context->EmitDiff(apk_b->GetSource(), "new", str_stream.str());
       diff = true;
     }
   }
-  return false;
+  return diff;
 }
 
-static bool EmitResourceTypeDiff(IAaptContext* context, LoadedApk* apk_a,
+static bool EmitResourceTypeDiff(DiffContext* context, LoadedApk* apk_a,
                                  ResourceTablePackage* pkg_a, ResourceTableType* type_a,
                                  LoadedApk* apk_b, ResourceTablePackage* pkg_b,
                                  ResourceTableType* type_b) {
@@ -154,8 +220,11 @@ static bool EmitResourceTypeDiff(IAaptContext* context, LoadedApk* apk_a,
     if (!entry_b) {
       std::stringstream str_stream;
       str_stream << "missing " << pkg_a->name << ":" << type_a->type << "/" << entry_a->name;
-      EmitDiffLine(apk_b->GetSource(), str_stream.str());
+      context->EmitDiff(apk_b->GetSource(), "missing", str_stream.str());
       diff = true;
+    } else if (context->GetDigests()->GetDigest(entry_a.get()) ==
+               context->GetDigests()->GetDigest(entry_b)) {
+      continue;
     } else {
       if (IsSymbolVisibilityDifferent(entry_a->symbol_status, entry_b->symbol_status)) {
         std::stringstream str_stream;
@@ -173,7 +242,7 @@ static bool EmitResourceTypeDiff(IAaptContext* context, LoadedApk* apk_a,
           str_stream << "PRIVATE";
         }
         str_stream << ")";
-        EmitDiffLine(apk_b->GetSource(), str_stream.str());
+        context->EmitDiff(apk_b->GetSource(), "visibility", str_stream.str());
         diff = true;
       } else if (IsIdDiff(entry_a->symbol_status, entry_a->id, entry_b->symbol_status,
                           entry_b->id)) {
@@ -192,7 +261,7 @@ static bool EmitResourceTypeDiff(IAaptContext* context, LoadedApk* apk_a,
           str_stream << "none";
         }
         str_stream << ")";
-        EmitDiffLine(apk_b->GetSource(), str_stream.str());
+        context->EmitDiff(apk_b->GetSource(), "id", str_stream.str());
         diff = true;
       }
       diff |= EmitResourceEntryDiff(context, apk_a, pkg_a, type_a, entry_a.get(), apk_b, pkg_b,
@@ -206,14 +275,14 @@ static bool EmitResourceTypeDiff(IAaptContext* context, LoadedApk* apk_a,
     if (!entry_a) {
       std::stringstream str_stream;
       str_stream << "new entry " << pkg_b->name << ":" << type_b->type << "/" << entry_b->name;
-      EmitDiffLine(apk_b->GetSource(), str_stream.str());
+      context->EmitDiff(apk_b->GetSource(), "new", str_stream.str());
       diff = true;
     }
   }
   return diff;
 }
 
-static bool EmitResourcePackageDiff(IAaptContext* context, LoadedApk* apk_a,
+static bool EmitResourcePackageDiff(DiffContext* context, LoadedApk* apk_a,
                                     ResourceTablePackage* pkg_a, LoadedApk* apk_b,
                                     ResourceTablePackage* pkg_b) {
   bool diff = false;
@@ -222,8 +291,13 @@ static bool EmitResourcePackageDiff(IAaptContext* context, LoadedApk* apk_a,
     if (!type_b) {
       std::stringstream str_stream;
       str_stream << "missing " << pkg_a->name << ":" << type_a->type;
-      EmitDiffLine(apk_a->GetSource(), str_stream.str());
+      context->EmitDiff(apk_a->GetSource(), "missing", str_stream.str());
       diff = true;
+    } else if (context->GetDigests()->GetDigest(type_a.get()) ==
+               context->GetDigests()->GetDigest(type_b)) {
+      // Structurally identical, so there is nothing to report for any of its entries. This saves
+      // looking up and comparing every entry and value pairwise.
+      continue;
     } else {
       if (IsSymbolVisibilityDifferent(type_a->symbol_status, type_b->symbol_status)) {
         std::stringstream str_stream;
@@ -240,7 +314,7 @@ static bool EmitResourcePackageDiff(IAaptContext* context, LoadedApk* apk_a,
           str_stream << "PRIVATE";
         }
         str_stream << ")";
-        EmitDiffLine(apk_b->GetSource(), str_stream.str());
+        context->EmitDiff(apk_b->GetSource(), "visibility", str_stream.str());
         diff = true;
       } else if (IsIdDiff(type_a->symbol_status, type_a->id, type_b->symbol_status, type_b->id)) {
         std::stringstream str_stream;
@@ -257,7 +331,7 @@ static bool EmitResourcePackageDiff(IAaptContext* context, LoadedApk* apk_a,
           str_stream << "none";
         }
         str_stream << ")";
-        EmitDiffLine(apk_b->GetSource(), str_stream.str());
+        context->EmitDiff(apk_b->GetSource(), "id", str_stream.str());
         diff = true;
       }
       diff |= EmitResourceTypeDiff(context, apk_a, pkg_a, type_a.get(), apk_b, pkg_b, type_b);
@@ -270,14 +344,14 @@ static bool EmitResourcePackageDiff(IAaptContext* context, LoadedApk* apk_a,
     if (!type_a) {
       std::stringstream str_stream;
       str_stream << "new type " << pkg_b->name << ":" << type_b->type;
-      EmitDiffLine(apk_b->GetSource(), str_stream.str());
+      context->EmitDiff(apk_b->GetSource(), "new", str_stream.str());
       diff = true;
     }
   }
   return diff;
 }
 
-static bool EmitResourceTableDiff(IAaptContext* context, LoadedApk* apk_a, LoadedApk* apk_b) {
+static bool EmitResourceTableDiff(DiffContext* context, LoadedApk* apk_a, LoadedApk* apk_b) {
   ResourceTable* table_a = apk_a->GetResourceTable();
   ResourceTable* table_b = apk_b->GetResourceTable();
 
@@ -287,7 +361,7 @@ static bool EmitResourceTableDiff(IAaptContext* context, LoadedApk* apk_a, Loade
     if (!pkg_b) {
       std::stringstream str_stream;
       str_stream << "missing package " << pkg_a->name;
-      EmitDiffLine(apk_b->GetSource(), str_stream.str());
+      context->EmitDiff(apk_b->GetSource(), "missing", str_stream.str());
       diff = true;
     } else {
       if (pkg_a->id != pkg_b->id) {
@@ -305,7 +379,7 @@ static bool EmitResourceTableDiff(IAaptContext* context, LoadedApk* apk_a, Loade
           str_stream << "none";
         }
         str_stream << ")";
-        EmitDiffLine(apk_b->GetSource(), str_stream.str());
+        context->EmitDiff(apk_b->GetSource(), "id", str_stream.str());
         diff = true;
       }
       diff |= EmitResourcePackageDiff(context, apk_a, pkg_a.get(), apk_b, pkg_b);
@@ -318,7 +392,58 @@ static bool EmitResourceTableDiff(IAaptContext* context, LoadedApk* apk_a, Loade
     if (!pkg_a) {
       std::stringstream str_stream;
       str_stream << "new package " << pkg_b->name;
-      EmitDiffLine(apk_b->GetSource(), str_stream.str());
+      context->EmitDiff(apk_b->GetSource(), "new", str_stream.str());
+      diff = true;
+    }
+  }
+  return diff;
+}
+
+// Compares the files of both APKs by the CRC-32 recorded in the ZIP central directory, so no file
+// needs to be read or inflated. The resource table is compared structurally instead.
+static bool EmitFileDiff(DiffContext* context, LoadedApk* apk_a, LoadedApk* apk_b) {
+  constexpr const char* kResourceTablePath = "resources.arsc";
+  io::IFileCollection* files_a = apk_a->GetFileCollection();
+  io::IFileCollection* files_b = apk_b->GetFileCollection();
+
+  bool diff = false;
+  std::unique_ptr<io::IFileCollectionIterator> iter = files_a->Iterator();
+  while (iter->HasNext()) {
+    io::IFile* file_a = iter->Next();
+    const StringPiece path = apk_a->GetPathInApk(file_a);
+    if (path == kResourceTablePath) {
+      continue;
+    }
+
+    io::IFile* file_b = files_b->FindFile(path);
+    if (!file_b) {
+      std::stringstream str_stream;
+      str_stream << "missing file " << path;
+      context->EmitDiff(apk_b->GetSource(), "missing", str_stream.str());
+      diff = true;
+      continue;
+    }
+
+    const Maybe<uint32_t> crc_a = file_a->GetCrc32();
+    const Maybe<uint32_t> crc_b = file_b->GetCrc32();
+    if (crc_a && crc_b && crc_a.value() != crc_b.value()) {
+      std::stringstream str_stream;
+      str_stream << "file " << path << " has different contents (crc32 0x" << std::hex
+                 << crc_b.value() << " vs 0x" << crc_a.value() << ")";
+      context->EmitDiff(apk_b->GetSource(), "file", str_stream.str());
+      diff = true;
+    }
+  }
+
+  // Check for any newly added files.
+  iter = files_b->Iterator();
+  while (iter->HasNext()) {
+    io::IFile* file_b = iter->Next();
+    const StringPiece path = apk_b->GetPathInApk(file_b);
+    if (path != kResourceTablePath && !files_a->FindFile(path)) {
+      std::stringstream str_stream;
+      str_stream << "new file " << path;
+      context->EmitDiff(apk_b->GetSource(), "new", str_stream.str());
       diff = true;
     }
   }
@@ -343,10 +468,38 @@ static void ZeroOutAppReferences(ResourceTable* table) {
   VisitAllValuesInTable(table, &visitor);
 }
 
+bool DiffApks(LoadedApk* apk_a, LoadedApk* apk_b, const DiffOptions& options, std::ostream* out) {
+  DiffContext context;
+  context.SetOutput(out, options.json_output);
+
+  // Zero out Application IDs in references.
+  ZeroOutAppReferences(apk_a->GetResourceTable());
+  ZeroOutAppReferences(apk_b->GetResourceTable());
+
+  context.GetDigests()->AddTable(*apk_a->GetResourceTable());
+  context.GetDigests()->AddTable(*apk_b->GetResourceTable());
+
+  bool diff = EmitResourceTableDiff(&context, apk_a, apk_b);
+  if (options.compare_files) {
+    diff |= EmitFileDiff(&context, apk_a, apk_b);
+  }
+  return diff;
+}
+
 int Diff(const std::vector<StringPiece>& args) {
   DiffContext context;
 
-  Flags flags;
+  DiffOptions options;
+  Flags flags =
+      Flags()
+          .OptionalSwitch("--compare-files",
+                          "Also compares every file in the APKs by the CRC-32 recorded in\n"
+                          "the ZIP central directory. Binary XML files that reference\n"
+                          "resources by ID will differ if those IDs changed.",
+                          &options.compare_files)
+          .OptionalSwitch("--json",
+                          "Writes each difference to stdout as a JSON object on its own line.",
+                          &options.json_output);
   if (!flags.Parse("aapt2 diff", args, &std::cerr)) {
     return 1;
   }
@@ -363,11 +516,8 @@ int Diff(const std::vector<StringPiece>& args) {
     return 1;
   }
 
-  // Zero out Application IDs in references.
-  ZeroOutAppReferences(apk_a->GetResourceTable());
-  ZeroOutAppReferences(apk_b->GetResourceTable());
-
-  if (EmitResourceTableDiff(&context, apk_a.get(), apk_b.get())) {
+  std::ostream* out = options.json_output ? &std::cout : &std::cerr;
+  if (DiffApks(apk_a.get(), apk_b.get(), options, out)) {
     // We emitted a diff, so return 1 (failure).
     return 1;
   }
@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAPT_CMD_DIFF_H
+#define AAPT_CMD_DIFF_H
+
+#include <ostream>
+
+#include "LoadedApk.h"
+
+namespace aapt {
+
+struct DiffOptions {
+  // Also compares every file of the APKs other than the resource table, by its CRC-32.
+  bool compare_files = false;
+
+  // Writes each difference as a JSON object on its own line, rather than as text.
+  bool json_output = false;
+};
+
+// Writes each difference between `apk_a` and `apk_b` to `out`. The IDs of references to the app's
+// own resources are cleared in both resource tables first, since they may be assigned differently
+// by each build. Returns true if there is any difference.
+bool DiffApks(LoadedApk* apk_a, LoadedApk* apk_b, const DiffOptions& options, std::ostream* out);
+
+}  // namespace aapt
+
+#endif  // AAPT_CMD_DIFF_H
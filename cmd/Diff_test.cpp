@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cmd/Diff.h"
+
+#include <map>
+#include <sstream>
+
+#include "test/Test.h"
+
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+using ::testing::IsEmpty;
+
+namespace aapt {
+
+namespace {
+
+// An entry of an APK, whose CRC-32 is known as it would be from the ZIP central directory.
+class CrcFile : public io::IFile {
+ public:
+  CrcFile(const std::string& path, uint32_t crc) : source_(path), crc_(crc) {}
+
+  std::unique_ptr<io::IData> OpenAsData() override {
+    return {};
+  }
+
+  const Source& GetSource() const override {
+    return source_;
+  }
+
+  Maybe<uint32_t> GetCrc32() override {
+    return crc_;
+  }
+
+ private:
+  Source source_;
+  uint32_t crc_;
+};
+
+class CrcFileCollection : public io::IFileCollection {
+ public:
+  // Adds the entry `path` of the APK `apk_path`.
+  void AddFile(const std::string& apk_path, const std::string& path, uint32_t crc) {
+    files_[path] = util::make_unique<CrcFile>(apk_path + "@" + path, crc);
+  }
+
+  io::IFile* FindFile(const android::StringPiece& path) override {
+    auto iter = files_.find(path.to_string());
+    return iter != files_.end() ? iter->second.get() : nullptr;
+  }
+
+  std::unique_ptr<io::IFileCollectionIterator> Iterator() override {
+    return util::make_unique<Iter>(files_);
+  }
+
+ private:
+  class Iter : public io::IFileCollectionIterator {
+   public:
+    explicit Iter(const std::map<std::string, std::unique_ptr<CrcFile>>& files)
+        : current_(files.begin()), end_(files.end()) {}
+
+    bool HasNext() override {
+      return current_ != end_;
+    }
+
+    io::IFile* Next() override {
+      return (current_++)->second.get();
+    }
+
+   private:
+    std::map<std::string, std::unique_ptr<CrcFile>>::const_iterator current_, end_;
+  };
+
+  std::map<std::string, std::unique_ptr<CrcFile>> files_;
+};
+
+std::unique_ptr<LoadedApk> MakeApk(const std::string& path, std::unique_ptr<ResourceTable> table,
+                                   const std::map<std::string, uint32_t>& file_crcs = {}) {
+  auto files = util::make_unique<CrcFileCollection>();
+  for (const auto& entry : file_crcs) {
+    files->AddFile(path, entry.first, entry.second);
+  }
+  return util::make_unique<LoadedApk>(Source(path), std::move(files), std::move(table));
+}
+
+std::vector<std::string> SplitLines(const std::string& str) {
+  std::vector<std::string> lines;
+  std::istringstream in(str);
+  std::string line;
+  while (std::getline(in, line)) {
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+}  // namespace
+
+TEST(DiffTest, EqualApksHaveNoDifferences) {
+  std::unique_ptr<LoadedApk> apk_a = MakeApk(
+      "a.apk", test::ResourceTableBuilder().AddString("com.app.a:string/foo", "foo").Build(),
+      {{"res/drawable/icon.png", 0x1234u}});
+  std::unique_ptr<LoadedApk> apk_b = MakeApk(
+      "b.apk", test::ResourceTableBuilder().AddString("com.app.a:string/foo", "foo").Build(),
+      {{"res/drawable/icon.png", 0x1234u}});
+
+  DiffOptions options;
+  options.compare_files = true;
+  std::ostringstream out;
+  EXPECT_FALSE(DiffApks(apk_a.get(), apk_b.get(), options, &out));
+  EXPECT_THAT(out.str(), IsEmpty());
+}
+
+TEST(DiffTest, ValueOnlyDifferenceIsADifference) {
+  // Only the value of an entry differs, which used to be reported without failing the diff.
+  std::unique_ptr<LoadedApk> apk_a = MakeApk(
+      "a.apk", test::ResourceTableBuilder().AddString("com.app.a:string/foo", "foo").Build());
+  std::unique_ptr<LoadedApk> apk_b = MakeApk(
+      "b.apk", test::ResourceTableBuilder().AddString("com.app.a:string/foo", "bar").Build());
+
+  std::ostringstream out;
+  EXPECT_TRUE(DiffApks(apk_a.get(), apk_b.get(), DiffOptions{}, &out));
+  EXPECT_THAT(out.str(), HasSubstr("value com.app.a:string/foo config= does not match"));
+}
+
+TEST(DiffTest, JsonOutputHasOneObjectPerDifference) {
+  std::unique_ptr<LoadedApk> apk_a =
+      MakeApk("a.apk", test::ResourceTableBuilder()
+                           .AddString("com.app.a:string/changed", "old")
+                           .AddString("com.app.a:string/removed", "removed")
+                           .AddString("com.app.a:string/same", "same")
+                           .Build());
+  std::unique_ptr<LoadedApk> apk_b =
+      MakeApk("b.apk", test::ResourceTableBuilder()
+                           .AddString("com.app.a:string/added", "added")
+                           .AddString("com.app.a:string/changed", "new")
+                           .AddString("com.app.a:string/same", "same")
+                           .Build());
+
+  DiffOptions options;
+  options.json_output = true;
+  std::ostringstream out;
+  EXPECT_TRUE(DiffApks(apk_a.get(), apk_b.get(), options, &out));
+
+  const std::vector<std::string> lines = SplitLines(out.str());
+  ASSERT_EQ(3u, lines.size()) << out.str();
+  EXPECT_THAT(lines[0], HasSubstr("{\"apk\":\"b.apk\",\"kind\":\"value\",\"message\":\"value "
+                                  "com.app.a:string/changed config= does not match:\\n"));
+  EXPECT_EQ(
+      "{\"apk\":\"b.apk\",\"kind\":\"missing\",\"message\":\"missing "
+      "com.app.a:string/removed\"}",
+      lines[1]);
+  EXPECT_EQ("{\"apk\":\"b.apk\",\"kind\":\"new\",\"message\":\"new entry com.app.a:string/added\"}",
+            lines[2]);
+}
+
+TEST(DiffTest, FilesAreComparedByCrcOnlyWhenAsked) {
+  // The resources are identical, only the contents of a file differ.
+  std::unique_ptr<LoadedApk> apk_a = MakeApk(
+      "a.apk", test::ResourceTableBuilder().AddString("com.app.a:string/foo", "foo").Build(),
+      {{"res/drawable/icon.png", 0x1234u}, {"resources.arsc", 0x1u}});
+  std::unique_ptr<LoadedApk> apk_b = MakeApk(
+      "b.apk", test::ResourceTableBuilder().AddString("com.app.a:string/foo", "foo").Build(),
+      {{"res/drawable/icon.png", 0xabcdu}, {"resources.arsc", 0x2u}});
+
+  std::ostringstream out;
+  EXPECT_FALSE(DiffApks(apk_a.get(), apk_b.get(), DiffOptions{}, &out));
+  EXPECT_THAT(out.str(), IsEmpty());
+
+  // The resource table is compared by its resources, not by its CRC.
+  DiffOptions options;
+  options.compare_files = true;
+  options.json_output = true;
+  EXPECT_TRUE(DiffApks(apk_a.get(), apk_b.get(), options, &out));
+  EXPECT_THAT(SplitLines(out.str()),
+              ElementsAre("{\"apk\":\"b.apk\",\"kind\":\"file\",\"message\":\"file "
+                          "res/drawable/icon.png has different contents (crc32 0xabcd vs "
+                          "0x1234)\"}"));
+}
+
+}  // namespace aapt
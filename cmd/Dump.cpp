@@ -14,9 +14,12 @@
  * limitations under the License.
  */
 
+#include <map>
+#include <utility>
 #include <vector>
 
 #include "androidfw/StringPiece.h"
+#include "ziparchive/zip_archive.h"
 
 #include "Debug.h"
 #include "Diagnostics.h"
@@ -25,6 +28,7 @@
 #include "process/IResourceTableConsumer.h"
 #include "proto/ProtoSerialize.h"
 #include "unflatten/BinaryResourceParser.h"
+#include "unflatten/TableSizeReport.h"
 #include "util/Files.h"
 
 using ::android::StringPiece;
@@ -147,6 +151,88 @@ bool TryDumpFile(IAaptContext* context, const std::string& file_path) {
   return true;
 }
 
+// Reports the breakdown of the resources.arsc of the APK at `file_path`, followed by the
+// compressed size of every file in it. A file referenced by a resource is reported under the name
+// and configuration of that resource. A file that is not a ZIP archive is reported as a binary
+// resource table.
+bool DumpSizeReport(IAaptContext* context, const std::string& file_path,
+                    SizeReportPrinter* printer) {
+  ZipArchiveHandle handle;
+  int32_t result = OpenArchive(file_path.c_str(), &handle);
+  if (result != 0) {
+    CloseArchive(handle);
+
+    std::string err;
+    Maybe<android::FileMap> file = file::MmapPath(file_path, &err);
+    if (!file) {
+      context->GetDiagnostics()->Error(DiagMessage(file_path) << err);
+      return false;
+    }
+    return PrintTableSizeReport(context, Source(file_path), file.value().getDataPtr(),
+                                file.value().getDataLength(), printer);
+  }
+
+  using ArchiveCloser = std::unique_ptr<void, decltype(CloseArchive)*>;
+  ArchiveCloser archive_closer(handle, CloseArchive);
+
+  void* cookie = nullptr;
+  result = StartIteration(handle, &cookie, nullptr, nullptr);
+  if (result != 0) {
+    context->GetDiagnostics()->Error(DiagMessage(file_path) << ErrorCodeString(result));
+    return false;
+  }
+
+  using IterationEnder = std::unique_ptr<void, decltype(EndIteration)*>;
+  IterationEnder iteration_ender(cookie, EndIteration);
+
+  // The files are only reported once the table says which resources they belong to.
+  std::vector<std::pair<std::string, size_t>> files;
+  ZipString zip_entry_name;
+  ZipEntry zip_entry;
+  Maybe<ZipEntry> table_entry;
+  while ((result = Next(cookie, &zip_entry, &zip_entry_name)) == 0) {
+    std::string path(reinterpret_cast<const char*>(zip_entry_name.name),
+                     zip_entry_name.name_length);
+    if (path == "resources.arsc") {
+      table_entry = zip_entry;
+    }
+    files.push_back({std::move(path), zip_entry.compressed_length});
+  }
+
+  if (result != -1) {
+    context->GetDiagnostics()->Error(DiagMessage(file_path) << ErrorCodeString(result));
+    return false;
+  }
+
+  std::map<std::string, SizeReportFileOwner> file_owners;
+  if (table_entry) {
+    const size_t len = table_entry.value().uncompressed_length;
+    std::unique_ptr<uint8_t[]> data(new uint8_t[len]);
+    result = ExtractToMemory(handle, &table_entry.value(), data.get(), static_cast<uint32_t>(len));
+    if (result != 0) {
+      context->GetDiagnostics()->Error(DiagMessage(file_path)
+                                       << "failed to extract resources.arsc: "
+                                       << ErrorCodeString(result));
+      return false;
+    }
+
+    if (!PrintTableSizeReport(context, Source(file_path + "@resources.arsc"), data.get(), len,
+                              printer, &file_owners)) {
+      return false;
+    }
+  }
+
+  for (const auto& file : files) {
+    auto iter = file_owners.find(file.first);
+    if (iter != file_owners.end()) {
+      printer->PrintRow("file", iter->second.name, iter->second.config, file.second, file.first);
+    } else {
+      printer->PrintRow("file", file.first, {}, file.second, file.first);
+    }
+  }
+  return true;
+}
+
 class DumpContext : public IAaptContext {
  public:
   PackageType GetPackageType() override {
@@ -199,7 +285,15 @@ class DumpContext : public IAaptContext {
  */
 int Dump(const std::vector<StringPiece>& args) {
   bool verbose = false;
-  Flags flags = Flags().OptionalSwitch("-v", "increase verbosity of output", &verbose);
+  Maybe<std::string> size_report;
+  Flags flags =
+      Flags()
+          .OptionalSwitch("-v", "increase verbosity of output", &verbose)
+          .OptionalFlag("--size-report",
+                        "Instead of printing the table, prints the bytes taken by every file\n"
+                        "and by every chunk, string pool and entry of resources.arsc.\n"
+                        "The format is either 'csv' or 'json' (one object per line).",
+                        &size_report);
   if (!flags.Parse("aapt2 dump", args, &std::cerr)) {
     return 1;
   }
@@ -207,6 +301,27 @@ int Dump(const std::vector<StringPiece>& args) {
   DumpContext context;
   context.SetVerbose(verbose);
 
+  if (size_report) {
+    SizeReportFormat format;
+    if (size_report.value() == "csv") {
+      format = SizeReportFormat::kCsv;
+    } else if (size_report.value() == "json") {
+      format = SizeReportFormat::kJson;
+    } else {
+      context.GetDiagnostics()->Error(DiagMessage() << "invalid --size-report format '"
+                                                    << size_report.value() << "'");
+      return 1;
+    }
+
+    SizeReportPrinter printer(&std::cout, format);
+    for (const std::string& arg : flags.GetArgs()) {
+      if (!DumpSizeReport(&context, arg, &printer)) {
+        return 1;
+      }
+    }
+    return 0;
+  }
+
   for (const std::string& arg : flags.GetArgs()) {
     if (!TryDumpFile(&context, arg)) {
       return 1;
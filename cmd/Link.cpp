@@ -16,8 +16,10 @@
 
 #include <sys/stat.h>
 
+#include <algorithm>
 #include <fstream>
 #include <queue>
+#include <sstream>
 #include <unordered_map>
 #include <vector>
 
@@ -29,12 +31,14 @@
 
 #include "AppInfo.h"
 #include "Debug.h"
+#include "Diagnostics.h"
 #include "Flags.h"
 #include "Locale.h"
 #include "NameMangler.h"
 #include "ResourceUtils.h"
 #include "cmd/Util.h"
 #include "compile/IdAssigner.h"
+#include "compile/PackedCompiledFiles.h"
 #include "filter/ConfigFilter.h"
 #include "flatten/Archive.h"
 #include "flatten/TableFlattener.h"
@@ -60,6 +64,7 @@
 #include "split/TableSplitter.h"
 #include "unflatten/BinaryResourceParser.h"
 #include "util/Files.h"
+#include "util/Trace.h"
 #include "xml/XmlDom.h"
 
 using ::aapt::io::FileInputStream;
@@ -77,6 +82,12 @@ struct LinkOptions {
   bool output_to_directory = false;
   bool auto_add_overlay = false;
 
+  // How the data of uncompressed entries is aligned in the output APK.
+  ArchiveAlignment alignment = ArchiveAlignment::kDefault;
+
+  // Path to write a Chrome trace-event JSON file to.
+  Maybe<std::string> trace_file;
+
   // Java/Proguard options.
   Maybe<std::string> generate_java_class_path;
   Maybe<std::string> custom_java_package;
@@ -84,6 +95,7 @@ struct LinkOptions {
   Maybe<std::string> generate_text_symbols_path;
   Maybe<std::string> generate_proguard_rules_path;
   Maybe<std::string> generate_main_dex_proguard_rules_path;
+  Maybe<std::string> proguard_cache_path;
   bool generate_non_final_ids = false;
   std::vector<std::string> javadoc_annotations;
   Maybe<std::string> private_symbols;
@@ -333,8 +345,9 @@ struct R {
 
 class ResourceFileFlattener {
  public:
+  // `keep_rule_cache` may be null, in which case the keep rules of every XML file are collected.
   ResourceFileFlattener(const ResourceFileFlattenerOptions& options, IAaptContext* context,
-                        proguard::KeepSet* keep_set);
+                        proguard::KeepSet* keep_set, proguard::KeepRuleCache* keep_rule_cache);
 
   bool Flatten(ResourceTable* table, IArchiveWriter* archive_writer);
 
@@ -351,6 +364,9 @@ class ResourceFileFlattener {
     // The XML to process and flatten.
     std::unique_ptr<xml::XmlResource> xml_to_flatten;
 
+    // The digest of the compiled XML, which its cached keep rules are looked up by.
+    uint64_t content_digest = 0u;
+
     // The destination to write this file to.
     std::string dst_path;
   };
@@ -363,12 +379,17 @@ class ResourceFileFlattener {
   ResourceFileFlattenerOptions options_;
   IAaptContext* context_;
   proguard::KeepSet* keep_set_;
+  proguard::KeepRuleCache* keep_rule_cache_;
   XmlCompatVersioner::Rules rules_;
 };
 
 ResourceFileFlattener::ResourceFileFlattener(const ResourceFileFlattenerOptions& options,
-                                             IAaptContext* context, proguard::KeepSet* keep_set)
-    : options_(options), context_(context), keep_set_(keep_set) {
+                                             IAaptContext* context, proguard::KeepSet* keep_set,
+                                             proguard::KeepRuleCache* keep_rule_cache)
+    : options_(options),
+      context_(context),
+      keep_set_(keep_set),
+      keep_rule_cache_(keep_rule_cache) {
   SymbolTable* symm = context_->GetExternalSymbols();
 
   // Build up the rules for degrading newer attributes to older ones.
@@ -466,8 +487,14 @@ std::vector<std::unique_ptr<xml::XmlResource>> ResourceFileFlattener::LinkAndVer
     return {};
   }
 
-  if (options_.update_proguard_spec && !proguard::CollectProguardRules(src, doc, keep_set_)) {
-    return {};
+  if (options_.update_proguard_spec) {
+    const bool collected =
+        keep_rule_cache_ != nullptr
+            ? keep_rule_cache_->CollectProguardRules(file_op->content_digest, src, doc, keep_set_)
+            : proguard::CollectProguardRules(src, doc, keep_set_);
+    if (!collected) {
+      return {};
+    }
   }
 
   if (options_.no_xml_namespaces) {
@@ -547,6 +574,9 @@ bool ResourceFileFlattener::Flatten(ResourceTable* table, IArchiveWriter* archiv
 
             file_op.xml_to_flatten = xml::Inflate(data->data(), data->size(),
                                                   context_->GetDiagnostics(), file->GetSource());
+            if (options_.update_proguard_spec && keep_rule_cache_ != nullptr) {
+              file_op.content_digest = util::Hasher().Update(data->data(), data->size()).Digest();
+            }
 
             if (!file_op.xml_to_flatten) {
               return false;
@@ -686,11 +716,13 @@ static bool LoadStableIdMap(IDiagnostics* diag, const std::string& path,
 
 class LinkCommand {
  public:
-  LinkCommand(LinkContext* context, const LinkOptions& options)
+  LinkCommand(LinkContext* context, const LinkOptions& options, TraceRecorder* trace = nullptr)
       : options_(options),
         context_(context),
+        trace_(trace),
         final_table_(),
         file_collection_(util::make_unique<io::FileCollection>()) {
+    options_.table_flattener_options.trace = trace;
   }
 
   /**
@@ -897,17 +929,19 @@ class LinkCommand {
     if (options_.output_to_directory) {
       return CreateDirectoryArchiveWriter(context_->GetDiagnostics(), out);
     } else {
-      return CreateZipFileArchiveWriter(context_->GetDiagnostics(), out);
+      return CreateZipFileArchiveWriter(context_->GetDiagnostics(), out, options_.alignment);
     }
   }
 
   bool FlattenTable(ResourceTable* table, IArchiveWriter* writer) {
+    TraceSpan span(trace_, "link", "flatten table");
     BigBuffer buffer(1024);
     TableFlattener flattener(options_.table_flattener_options, &buffer);
     if (!flattener.Consume(context_, table)) {
       context_->GetDiagnostics()->Error(DiagMessage() << "failed to flatten resource table");
       return false;
     }
+    span.AddArg("bytes", buffer.size());
 
     io::BigBufferInputStream input_stream(&buffer);
     return io::CopyInputStreamToArchive(context_, &input_stream, "resources.arsc",
@@ -1031,7 +1065,22 @@ class LinkCommand {
       return true;
     }
 
+    std::ostringstream rules;
+    proguard::WriteKeepSet(&rules, keep_set);
+    const std::string rules_str = rules.str();
+
+    // Leave the file untouched when the rules have not changed, so that build systems keying off
+    // its timestamp don't rerun ProGuard.
     const std::string& out_path = out.value();
+    std::string existing_rules;
+    if (android::base::ReadFileToString(out_path, &existing_rules) &&
+        existing_rules == rules_str) {
+      if (context_->IsVerbose()) {
+        context_->GetDiagnostics()->Note(DiagMessage(out_path) << "proguard rules are unchanged");
+      }
+      return true;
+    }
+
     std::ofstream fout(out_path, std::ofstream::binary);
     if (!fout) {
       context_->GetDiagnostics()->Error(DiagMessage()
@@ -1040,7 +1089,7 @@ class LinkCommand {
       return false;
     }
 
-    proguard::WriteKeepSet(&fout, keep_set);
+    fout.write(rules_str.data(), rules_str.size());
     if (!fout) {
       context_->GetDiagnostics()->Error(DiagMessage()
                                         << "failed writing to '" << out_path
@@ -1057,45 +1106,70 @@ class LinkCommand {
     if (!collection) {
       return {};
     }
-    return LoadTablePbFromCollection(collection.get());
+    return LoadTablePbFromCollection(collection.get(), context_->GetDiagnostics());
   }
 
-  std::unique_ptr<ResourceTable> LoadTablePbFromCollection(io::IFileCollection* collection) {
+  std::unique_ptr<ResourceTable> LoadTablePbFromCollection(io::IFileCollection* collection,
+                                                           IDiagnostics* diag) {
     io::IFile* file = collection->FindFile("resources.arsc.flat");
     if (!file) {
       return {};
     }
 
     std::unique_ptr<io::IData> data = file->OpenAsData();
-    return LoadTableFromPb(file->GetSource(), data->data(), data->size(),
-                           context_->GetDiagnostics());
+    if (!data) {
+      diag->Error(DiagMessage(file->GetSource()) << "failed to open");
+      return {};
+    }
+    return LoadTableFromPb(file->GetSource(), data->data(), data->size(), diag);
   }
 
-  bool MergeStaticLibrary(const std::string& input, bool override) {
+  // A static library that is loaded to be merged.
+  struct StaticLibraryToMerge {
+    std::unique_ptr<io::ZipFileCollection> collection;
+    std::unique_ptr<ResourceTable> table;
+    ResourceTablePackage* package = nullptr;
+  };
+
+  // Opens the static library `input` and loads its table. Only reports to `diag`, so that several
+  // libraries can be loaded at once.
+  bool LoadStaticLibraryToMerge(const std::string& input, IDiagnostics* diag,
+                                StaticLibraryToMerge* out_library) {
     if (context_->IsVerbose()) {
-      context_->GetDiagnostics()->Note(DiagMessage() << "merging static library " << input);
+      diag->Note(DiagMessage() << "merging static library " << input);
     }
 
     std::string error_str;
-    std::unique_ptr<io::ZipFileCollection> collection =
-        io::ZipFileCollection::Create(input, &error_str);
-    if (!collection) {
-      context_->GetDiagnostics()->Error(DiagMessage(input) << error_str);
+    out_library->collection = io::ZipFileCollection::Create(input, &error_str);
+    if (!out_library->collection) {
+      diag->Error(DiagMessage(input) << error_str);
       return false;
     }
 
-    std::unique_ptr<ResourceTable> table = LoadTablePbFromCollection(collection.get());
-    if (!table) {
-      context_->GetDiagnostics()->Error(DiagMessage(input) << "invalid static library");
+    out_library->table = LoadTablePbFromCollection(out_library->collection.get(), diag);
+    if (!out_library->table) {
+      diag->Error(DiagMessage(input) << "invalid static library");
+      return false;
+    }
+
+    out_library->package = out_library->table->FindPackageById(kAppPackageId);
+    if (!out_library->package) {
+      diag->Error(DiagMessage(input) << "static library has no package");
       return false;
     }
+    return true;
+  }
 
-    ResourceTablePackage* pkg = table->FindPackageById(kAppPackageId);
-    if (!pkg) {
-      context_->GetDiagnostics()->Error(DiagMessage(input) << "static library has no package");
+  bool MergeStaticLibrary(const std::string& input, bool override) {
+    StaticLibraryToMerge library;
+    if (!LoadStaticLibraryToMerge(input, context_->GetDiagnostics(), &library)) {
       return false;
     }
 
+    std::unique_ptr<io::ZipFileCollection> collection = std::move(library.collection);
+    std::unique_ptr<ResourceTable> table = std::move(library.table);
+    ResourceTablePackage* pkg = library.package;
+
     bool result;
     if (options_.no_static_lib_packages) {
       // Merge all resources as if they were in the compilation package. This is
@@ -1130,6 +1204,49 @@ class LinkCommand {
     return true;
   }
 
+  // Merges static libraries that are listed one after the other as MergeStaticLibrary() would
+  // merge them in order. The libraries are loaded on one thread per core and merged with
+  // TableMerger::MergeAndMangleAll(). Only used when the package names of the libraries are kept.
+  bool MergeStaticLibraries(const std::vector<std::string>& inputs) {
+    TraceSpan span(trace_, "merge", "static libraries");
+    span.AddArg("libraries", inputs.size());
+
+    std::vector<StaticLibraryToMerge> libraries(inputs.size());
+    std::vector<std::unique_ptr<BufferedDiagnostics>> diagnostics(inputs.size());
+    std::vector<char> loaded(inputs.size(), false);
+    util::ParallelFor(inputs.size(), 0u, [&](size_t i) {
+      diagnostics[i] = util::make_unique<BufferedDiagnostics>();
+      loaded[i] = LoadStaticLibraryToMerge(inputs[i], diagnostics[i].get(), &libraries[i]);
+    });
+
+    bool error = false;
+    for (size_t i = 0u; i < inputs.size(); i++) {
+      diagnostics[i]->FlushTo(context_->GetDiagnostics());
+      if (!loaded[i]) {
+        error = true;
+      }
+    }
+    if (error) {
+      return false;
+    }
+
+    std::vector<TableMerger::StaticLibrary> static_libraries;
+    for (size_t i = 0u; i < inputs.size(); i++) {
+      static_libraries.push_back(TableMerger::StaticLibrary{
+          Source(inputs[i]), libraries[i].package->name, libraries[i].table.get(),
+          libraries[i].collection.get()});
+    }
+    if (!table_merger_->MergeAndMangleAll(static_libraries)) {
+      return false;
+    }
+
+    // Make sure to move the collections into the set of IFileCollections.
+    for (StaticLibraryToMerge& library : libraries) {
+      collections_.push_back(std::move(library.collection));
+    }
+    return true;
+  }
+
   bool MergeResourceTable(io::IFile* file, bool override) {
     if (context_->IsVerbose()) {
       context_->GetDiagnostics()->Note(DiagMessage() << "merging resource table "
@@ -1235,6 +1352,34 @@ class LinkCommand {
     return !error;
   }
 
+  // Merges the compiled files and tables of the packed container `file`, whose contents are `data`.
+  bool MergePackedCompiledFiles(io::IFile* file, io::IData* data, bool override) {
+    if (context_->IsVerbose()) {
+      context_->GetDiagnostics()->Note(DiagMessage() << "merging packed container "
+                                                     << file->GetSource());
+    }
+
+    std::vector<PackedCompiledFile> packed_files;
+    if (!ReadPackedCompiledFiles(data->data(), data->size(), file->GetSource(),
+                                 context_->GetDiagnostics(), &packed_files)) {
+      return false;
+    }
+
+    bool error = false;
+    for (PackedCompiledFile& packed_file : packed_files) {
+      io::IFile* segment = file->CreateFileSegment(static_cast<size_t>(packed_file.offset),
+                                                   static_cast<size_t>(packed_file.size));
+      if (!packed_file.file) {
+        if (!MergeResourceTable(segment, override)) {
+          error = true;
+        }
+      } else if (!MergeCompiledFile(segment, packed_file.file.get(), override)) {
+        error = true;
+      }
+    }
+    return !error;
+  }
+
   /**
    * Takes a path to load and merge into the master ResourceTable. If override
    * is true,
@@ -1248,6 +1393,17 @@ class LinkCommand {
    * Otherwise the files is processed on its own.
    */
   bool MergePath(const std::string& path, bool override) {
+    TraceSpan span(trace_, "merge", path);
+    if (util::EndsWith(path, ".flata")) {
+      // A packed container, written by `aapt2 compile --dir --packed`, is told apart from a ZIP
+      // archive by its magic. If the file can't be opened, merging it as an archive reports why.
+      io::IFile* file = file_collection_->InsertFile(path);
+      std::unique_ptr<io::IData> data = file->OpenAsData();
+      if (data && IsPackedCompiledFiles(data->data(), data->size())) {
+        return MergePackedCompiledFiles(file, data.get(), override);
+      }
+    }
+
     if (util::EndsWith(path, ".flata") || util::EndsWith(path, ".jar") ||
         util::EndsWith(path, ".jack") || util::EndsWith(path, ".zip")) {
       return MergeArchive(path, override);
@@ -1383,6 +1539,7 @@ class LinkCommand {
    */
   bool WriteApk(IArchiveWriter* writer, proguard::KeepSet* keep_set, xml::XmlResource* manifest,
                 ResourceTable* table) {
+    TraceSpan span(trace_, "link", "write apk");
     const bool keep_raw_values = context_->GetPackageType() == PackageType::kStaticLib;
     bool result = FlattenXml(context_, manifest, "AndroidManifest.xml", keep_raw_values,
                              true /*utf16*/, writer);
@@ -1401,12 +1558,15 @@ class LinkCommand {
     file_flattener_options.update_proguard_spec =
         static_cast<bool>(options_.generate_proguard_rules_path);
 
-    ResourceFileFlattener file_flattener(file_flattener_options, context_, keep_set);
+    ResourceFileFlattener file_flattener(file_flattener_options, context_, keep_set,
+                                         keep_rule_cache_.get());
 
+    TraceSpan files_span(trace_, "link", "flatten files");
     if (!file_flattener.Flatten(table, writer)) {
       context_->GetDiagnostics()->Error(DiagMessage() << "failed linking file resources");
       return false;
     }
+    files_span.End();
 
     if (context_->GetPackageType() == PackageType::kStaticLib) {
       if (!FlattenTableToPb(table, writer)) {
@@ -1422,6 +1582,8 @@ class LinkCommand {
   }
 
   int Run(const std::vector<std::string>& input_files) {
+    TraceSpan manifest_span(trace_, "link", "load manifest");
+
     // Load the AndroidManifest.xml
     std::unique_ptr<xml::XmlResource> manifest_xml =
         LoadXml(options_.manifest_path, context_->GetDiagnostics());
@@ -1451,6 +1613,7 @@ class LinkCommand {
     context_->SetMinSdkVersion(app_info.min_sdk_version.value_or_default(0));
 
     context_->SetNameManglerPolicy(NameManglerPolicy{context_->GetCompilationPackage()});
+    manifest_span.End();
 
     // Override the package ID when it is "android".
     if (context_->GetCompilationPackage() == "android") {
@@ -1464,9 +1627,11 @@ class LinkCommand {
       }
     }
 
+    TraceSpan include_span(trace_, "link", "load includes");
     if (!LoadSymbolsFromIncludePaths()) {
       return 1;
     }
+    include_span.End();
 
     TableMergerOptions table_merger_options;
     table_merger_options.auto_add_overlay = options_.auto_add_overlay;
@@ -1479,8 +1644,26 @@ class LinkCommand {
                                                        context_->GetPackageId()));
     }
 
-    for (const std::string& input : input_files) {
-      if (!MergePath(input, false)) {
+    TraceSpan merge_span(trace_, "link", "merge");
+    merge_span.AddArg("inputs", input_files.size());
+    merge_span.AddArg("overlays", options_.overlay_files.size());
+    for (auto iter = input_files.begin(); iter != input_files.end();) {
+      // Static libraries that are listed one after the other don't depend on each other, so they
+      // are loaded and merged together on several threads.
+      auto libraries_end = std::find_if(iter, input_files.end(), [&](const std::string& input) {
+        return options_.no_static_lib_packages || !util::EndsWith(input, ".apk");
+      });
+
+      bool result;
+      if (libraries_end - iter > 1) {
+        result = MergeStaticLibraries(std::vector<std::string>(iter, libraries_end));
+        iter = libraries_end;
+      } else {
+        result = MergePath(*iter, false);
+        ++iter;
+      }
+
+      if (!result) {
         context_->GetDiagnostics()->Error(DiagMessage() << "failed parsing input");
         return 1;
       }
@@ -1496,7 +1679,9 @@ class LinkCommand {
     if (!VerifyNoExternalPackages()) {
       return 1;
     }
+    merge_span.End();
 
+    TraceSpan id_span(trace_, "link", "assign ids");
     if (context_->GetPackageType() != PackageType::kStaticLib) {
       PrivateAttributeMover mover;
       if (!mover.Consume(context_, &final_table_)) {
@@ -1537,6 +1722,7 @@ class LinkCommand {
         return 1;
       }
     }
+    id_span.End();
 
     // Add the names to mangle based on our source merge earlier.
     context_->SetNameManglerPolicy(
@@ -1559,11 +1745,15 @@ class LinkCommand {
           util::make_unique<FeatureSplitSymbolTableDelegate>(context_));
     }
 
-    ReferenceLinker linker;
+    TraceSpan linker_span(trace_, "link", "link references");
+    ReferenceLinker linker(0u, trace_);
     if (!linker.Consume(context_, &final_table_)) {
       context_->GetDiagnostics()->Error(DiagMessage() << "failed linking references");
       return 1;
     }
+    linker_span.End();
+
+    TraceSpan process_span(trace_, "link", "process table");
 
     if (context_->GetPackageType() == PackageType::kStaticLib) {
       if (!options_.products.empty()) {
@@ -1607,9 +1797,16 @@ class LinkCommand {
       }
     }
 
+    process_span.End();
+
     proguard::KeepSet proguard_keep_set;
     proguard::KeepSet proguard_main_dex_keep_set;
 
+    if (options_.proguard_cache_path) {
+      keep_rule_cache_ = util::make_unique<proguard::KeepRuleCache>();
+      keep_rule_cache_->Load(options_.proguard_cache_path.value());
+    }
+
     if (context_->GetPackageType() == PackageType::kStaticLib) {
       if (options_.table_splitter_options.config_filter != nullptr ||
           !options_.table_splitter_options.preferred_densities.empty()) {
@@ -1724,10 +1921,13 @@ class LinkCommand {
       return 1;
     }
 
+    TraceSpan assets_span(trace_, "link", "copy assets");
     if (!CopyAssetsDirsToApk(archive_writer.get())) {
       return 1;
     }
+    assets_span.End();
 
+    TraceSpan java_span(trace_, "link", "generate java");
     if (options_.generate_java_class_path) {
       // The set of packages whose R class to call in the main classes
       // onResourcesLoaded callback.
@@ -1799,6 +1999,9 @@ class LinkCommand {
       }
     }
 
+    java_span.End();
+
+    TraceSpan proguard_span(trace_, "link", "write proguard");
     if (!WriteProguardFile(options_.generate_proguard_rules_path, proguard_keep_set)) {
       return 1;
     }
@@ -1807,12 +2010,31 @@ class LinkCommand {
                            proguard_main_dex_keep_set)) {
       return 1;
     }
+
+    if (keep_rule_cache_ != nullptr) {
+      if (context_->IsVerbose()) {
+        context_->GetDiagnostics()->Note(DiagMessage() << "reused the keep rules of "
+                                                       << keep_rule_cache_->hit_count()
+                                                       << " XML files");
+      }
+
+      // Failing to write the cache only costs us the next link, so don't fail this one.
+      std::string error_str;
+      if (!keep_rule_cache_->Save(options_.proguard_cache_path.value(), &error_str)) {
+        context_->GetDiagnostics()->Warn(DiagMessage(options_.proguard_cache_path.value())
+                                         << "failed to write proguard cache: " << error_str);
+      }
+    }
     return 0;
   }
 
  private:
   LinkOptions options_;
   LinkContext* context_;
+
+  // Receives the spans of each link phase. nullptr when tracing is disabled.
+  TraceRecorder* trace_;
+
   ResourceTable final_table_;
 
   std::unique_ptr<TableMerger> table_merger_;
@@ -1830,10 +2052,15 @@ class LinkCommand {
 
   // The set of shared libraries being used, mapping their assigned package ID to package name.
   std::map<size_t, std::string> shared_libs_;
+
+  // The keep rules of the XML files of previous links, if --proguard-cache is given.
+  std::unique_ptr<proguard::KeepRuleCache> keep_rule_cache_;
 };
 
 int Link(const std::vector<StringPiece>& args, IDiagnostics* diagnostics) {
-  LinkContext context(diagnostics);
+  JsonDiagnostics json_diagnostics(&std::cerr);
+  RepeatLimitingDiagnostics limited_diagnostics(diagnostics);
+  LinkContext context(&limited_diagnostics);
   LinkOptions options;
   std::vector<std::string> overlay_arg_list;
   std::vector<std::string> extra_java_packages;
@@ -1844,6 +2071,10 @@ int Link(const std::vector<StringPiece>& args, IDiagnostics* diagnostics) {
   bool legacy_x_flag = false;
   bool require_localization = false;
   bool verbose = false;
+  bool diagnostics_json = false;
+  Maybe<std::string> warn_repeat_limit;
+  Maybe<std::string> sparse_lookup_cost;
+  bool page_align = false;
   bool shared_lib = false;
   bool static_lib = false;
   Maybe<std::string> stable_id_file_path;
@@ -1872,6 +2103,11 @@ int Link(const std::vector<StringPiece>& args, IDiagnostics* diagnostics) {
           .OptionalFlag("--proguard-main-dex",
                         "Output file for generated Proguard rules for the main dex.",
                         &options.generate_main_dex_proguard_rules_path)
+          .OptionalFlag("--proguard-cache",
+                        "File in which to keep the Proguard rules of each XML file across\n"
+                        "links, so that only files that changed are scanned for rules again.\n"
+                        "Requires --proguard.",
+                        &options.proguard_cache_path)
           .OptionalSwitch("--no-auto-version",
                           "Disables automatic style and layout SDK versioning.",
                           &options.no_auto_version)
@@ -1889,8 +2125,20 @@ int Link(const std::vector<StringPiece>& args, IDiagnostics* diagnostics) {
                           &options.no_resource_deduping)
           .OptionalSwitch("--enable-sparse-encoding",
                           "Enables encoding sparse entries using a binary search tree.\n"
-                          "This decreases APK size at the cost of resource retrieval performance.",
+                          "This decreases APK size at the cost of resource retrieval performance.\n"
+                          "Each type is sparse encoded only when that makes it smaller.",
                           &options.table_flattener_options.use_sparse_entries)
+          .OptionalFlag("--sparse-encoding-lookup-cost",
+                        "The number of bytes sparse encoding must save on a type for every\n"
+                        "step of binary search it adds to lookups, with\n"
+                        "--enable-sparse-encoding. Defaults to 0, which picks the smallest\n"
+                        "encoding. Types that are at least 60% defined are never sparse.",
+                        &sparse_lookup_cost)
+          .OptionalSwitch("--enable-compact-entries",
+                          "Encodes simple values as 8 byte compact entries and uses 16 bit entry\n"
+                          "offsets where possible. Only applies when minSdk is 34 (U) or\n"
+                          "higher, or to configurations of API 34 or higher.",
+                          &options.table_flattener_options.use_compact_entries)
           .OptionalSwitch("-x", "Legacy flag that specifies to use the package identifier 0x01.",
                           &legacy_x_flag)
           .OptionalSwitch("-z", "Require localization of strings marked 'suggested'.",
@@ -1906,6 +2154,10 @@ int Link(const std::vector<StringPiece>& args, IDiagnostics* diagnostics) {
           .OptionalSwitch("--output-to-dir",
                           "Outputs the APK contents to a directory specified by -o.",
                           &options.output_to_directory)
+          .OptionalSwitch("--page-align-uncompressed",
+                          "Aligns the data of every uncompressed entry, including\n"
+                          "resources.arsc, to a 4KiB page so that it can be mmapped directly.",
+                          &page_align)
           .OptionalSwitch("--no-xml-namespaces",
                           "Removes XML namespace prefix and URI information from\n"
                           "AndroidManifest.xml and XML binaries in res/*.",
@@ -1973,12 +2225,51 @@ int Link(const std::vector<StringPiece>& args, IDiagnostics* diagnostics) {
                             "Syntax: path/to/output.apk:<config>[,<config>[...]].\n"
                             "On Windows, use a semicolon ';' separator instead.",
                             &split_args)
+          .OptionalFlag("--trace-file",
+                        "Writes the time spent in each link phase to a Chrome trace-event JSON\n"
+                        "file that can be loaded into chrome://tracing.",
+                        &options.trace_file)
+          .OptionalFlag("--warn-repeat-limit",
+                        "Prints each kind of warning at most this many times. Warnings that\n"
+                        "differ only by names are of the same kind. Further copies are\n"
+                        "counted and summarized at the end.",
+                        &warn_repeat_limit)
+          .OptionalSwitch("--diagnostics-json",
+                          "Prints errors and warnings as JSON objects, one per line.",
+                          &diagnostics_json)
           .OptionalSwitch("-v", "Enables verbose logging.", &verbose);
 
   if (!flags.Parse("aapt2 link", args, &std::cerr)) {
     return 1;
   }
 
+  if (diagnostics_json) {
+    limited_diagnostics.SetDiagnostics(&json_diagnostics);
+  }
+
+  if (warn_repeat_limit) {
+    Maybe<uint32_t> limit = ResourceUtils::ParseInt(warn_repeat_limit.value());
+    if (!limit || static_cast<int32_t>(limit.value()) < 0) {
+      context.GetDiagnostics()->Error(DiagMessage() << "invalid --warn-repeat-limit '"
+                                                    << warn_repeat_limit.value() << "'");
+      return 1;
+    }
+    limited_diagnostics.SetRepeatLimit(limit.value());
+  }
+
+  if (page_align) {
+    options.alignment = ArchiveAlignment::kPage;
+  }
+  if (sparse_lookup_cost) {
+    Maybe<uint32_t> cost = ResourceUtils::ParseInt(sparse_lookup_cost.value());
+    if (!cost || static_cast<int32_t>(cost.value()) < 0) {
+      context.GetDiagnostics()->Error(DiagMessage() << "invalid --sparse-encoding-lookup-cost '"
+                                                    << sparse_lookup_cost.value() << "'");
+      return 1;
+    }
+    options.table_flattener_options.sparse_lookup_step_cost = cost.value();
+  }
+
   // Expand all argument-files passed into the command line. These start with '@'.
   std::vector<std::string> arg_list;
   for (const std::string& arg : flags.GetArgs()) {
@@ -2012,6 +2303,11 @@ int Link(const std::vector<StringPiece>& args, IDiagnostics* diagnostics) {
     context.SetVerbose(verbose);
   }
 
+  if (options.proguard_cache_path && !options.generate_proguard_rules_path) {
+    context.GetDiagnostics()->Error(DiagMessage() << "--proguard-cache requires --proguard");
+    return 1;
+  }
+
   if (shared_lib && static_lib) {
     context.GetDiagnostics()->Error(DiagMessage()
                                     << "only one of --shared-lib and --static-lib can be defined");
@@ -2118,8 +2414,23 @@ int Link(const std::vector<StringPiece>& args, IDiagnostics* diagnostics) {
     options.no_version_transitions = true;
   }
 
-  LinkCommand cmd(&context, options);
-  return cmd.Run(arg_list);
+  TraceRecorder trace_recorder;
+  LinkCommand cmd(&context, options, options.trace_file ? &trace_recorder : nullptr);
+  int result;
+  {
+    TraceSpan span(options.trace_file ? &trace_recorder : nullptr, "link", "link");
+    result = cmd.Run(arg_list);
+  }
+
+  if (options.trace_file) {
+    std::string error;
+    if (!trace_recorder.WriteToFile(options.trace_file.value(), &error)) {
+      context.GetDiagnostics()->Error(DiagMessage(options.trace_file.value())
+                                      << "failed to write trace: " << error);
+      return 1;
+    }
+  }
+  return result;
 }
 
 }  // namespace aapt
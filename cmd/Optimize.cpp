@@ -14,9 +14,13 @@
  * limitations under the License.
  */
 
+#include <map>
 #include <memory>
+#include <set>
+#include <sstream>
 #include <vector>
 
+#include "android-base/file.h"
 #include "android-base/stringprintf.h"
 #include "androidfw/StringPiece.h"
 
@@ -29,14 +33,17 @@
 #include "cmd/Util.h"
 #include "configuration/ConfigurationParser.h"
 #include "filter/AbiFilter.h"
+#include "flatten/Archive.h"
 #include "flatten/TableFlattener.h"
 #include "flatten/XmlFlattener.h"
 #include "io/BigBufferInputStream.h"
 #include "io/Util.h"
 #include "optimize/ResourceDeduper.h"
+#include "optimize/ResourcePathShortener.h"
 #include "optimize/VersionCollapser.h"
 #include "split/TableSplitter.h"
 #include "util/Files.h"
+#include "util/Trace.h"
 
 using ::aapt::configuration::Abi;
 using ::aapt::configuration::Artifact;
@@ -66,6 +73,22 @@ struct OptimizeOptions {
 
   TableFlattenerOptions table_flattener_options;
 
+  // Path to write the name and ID of every resource whose name is collapsed to.
+  Maybe<std::string> resource_name_map_path;
+
+  // Whether to rename the files of resources to short names derived from their paths.
+  bool shorten_resource_paths = false;
+
+  // Path to write the original and shortened path of every renamed file.
+  Maybe<std::string> shortened_path_map_path;
+
+  // Whether to copy the entries of the input APK that are not modified as they are encoded,
+  // instead of inflating and compressing them again.
+  bool copy_unmodified_entries = false;
+
+  // How the data of uncompressed entries is aligned in the output APKs.
+  ArchiveAlignment alignment = ArchiveAlignment::kDefault;
+
   Maybe<PostProcessingConfiguration> configuration;
 };
 
@@ -128,8 +151,10 @@ class OptimizeContext : public IAaptContext {
 
 class OptimizeCommand {
  public:
-  OptimizeCommand(OptimizeContext* context, const OptimizeOptions& options)
-      : options_(options), context_(context) {
+  OptimizeCommand(OptimizeContext* context, const OptimizeOptions& options,
+                  TraceRecorder* trace = nullptr)
+      : options_(options), context_(context), trace_(trace) {
+    options_.table_flattener_options.trace = trace;
   }
 
   int Run(std::unique_ptr<LoadedApk> apk) {
@@ -137,16 +162,42 @@ class OptimizeCommand {
       context_->GetDiagnostics()->Note(DiagMessage() << "Optimizing APK...");
     }
 
+    TraceSpan collapse_span(trace_, "optimize", "collapse versions");
     VersionCollapser collapser;
     if (!collapser.Consume(context_, apk->GetResourceTable())) {
       return 1;
     }
+    collapse_span.End();
 
+    TraceSpan dedupe_span(trace_, "optimize", "dedupe");
     ResourceDeduper deduper;
     if (!deduper.Consume(context_, apk->GetResourceTable())) {
       context_->GetDiagnostics()->Error(DiagMessage() << "failed deduping resources");
       return 1;
     }
+    dedupe_span.End();
+
+    if (options_.shorten_resource_paths) {
+      TraceSpan shorten_span(trace_, "optimize", "shorten resource paths");
+      std::map<std::string, std::string> path_map;
+      ResourcePathShortener shortener(&path_map);
+      if (!shortener.Consume(context_, apk->GetResourceTable())) {
+        context_->GetDiagnostics()->Error(DiagMessage() << "failed shortening resource paths");
+        return 1;
+      }
+
+      if (options_.shortened_path_map_path &&
+          !WriteShortenedPathMap(path_map, options_.shortened_path_map_path.value())) {
+        return 1;
+      }
+    }
+
+    if (options_.table_flattener_options.collapse_key_stringpool &&
+        options_.resource_name_map_path) {
+      if (!WriteResourceNameMap(apk->GetResourceTable(), options_.resource_name_map_path.value())) {
+        return 1;
+      }
+    }
 
     // Adjust the SplitConstraints so that their SDK version is stripped if it is less than or
     // equal to the minSdk.
@@ -164,6 +215,7 @@ class OptimizeCommand {
     auto path_iter = options_.split_paths.begin();
     auto split_constraints_iter = options_.split_constraints.begin();
     for (std::unique_ptr<ResourceTable>& split_table : splitter.splits()) {
+      TraceSpan split_span(trace_, "optimize", *path_iter);
       if (context_->IsVerbose()) {
         context_->GetDiagnostics()->Note(
             DiagMessage(*path_iter) << "generating split with configurations '"
@@ -173,13 +225,13 @@ class OptimizeCommand {
       // Generate an AndroidManifest.xml for each split.
       std::unique_ptr<xml::XmlResource> split_manifest =
           GenerateSplitManifest(options_.app_info, *split_constraints_iter);
-      std::unique_ptr<IArchiveWriter> split_writer =
-          CreateZipFileArchiveWriter(context_->GetDiagnostics(), *path_iter);
+      std::unique_ptr<IArchiveWriter> split_writer = CreateArchiveWriter(*path_iter);
       if (!split_writer) {
         return 1;
       }
 
-      if (!WriteSplitApk(split_table.get(), split_manifest.get(), split_writer.get())) {
+      if (!WriteSplitApk(split_table.get(), split_manifest.get(), split_writer.get()) ||
+          !FinishArchive(split_writer.get(), *path_iter)) {
         return 1;
       }
 
@@ -216,11 +268,15 @@ class OptimizeCommand {
           std::string out = options_.output_dir.value();
           file::AppendPath(&out, file_name);
 
-          std::unique_ptr<IArchiveWriter> writer =
-              CreateZipFileArchiveWriter(context_->GetDiagnostics(), out);
+          TraceSpan artifact_span(trace_, "optimize", out);
+          std::unique_ptr<IArchiveWriter> writer = CreateArchiveWriter(out);
+          if (!writer) {
+            return 1;
+          }
 
           if (!apk->WriteToArchive(context_, options_.table_flattener_options, &filters,
-                                   writer.get())) {
+                                   writer.get()) ||
+              !FinishArchive(writer.get(), out)) {
             return 1;
           }
         }
@@ -228,9 +284,14 @@ class OptimizeCommand {
     }
 
     if (options_.output_path) {
-      std::unique_ptr<IArchiveWriter> writer =
-          CreateZipFileArchiveWriter(context_->GetDiagnostics(), options_.output_path.value());
-      if (!apk->WriteToArchive(context_, options_.table_flattener_options, writer.get())) {
+      TraceSpan write_span(trace_, "optimize", options_.output_path.value());
+      std::unique_ptr<IArchiveWriter> writer = CreateArchiveWriter(options_.output_path.value());
+      if (!writer) {
+        return 1;
+      }
+
+      if (!apk->WriteToArchive(context_, options_.table_flattener_options, writer.get()) ||
+          !FinishArchive(writer.get(), options_.output_path.value())) {
         return 1;
       }
     }
@@ -239,7 +300,87 @@ class OptimizeCommand {
   }
 
  private:
+  // Entries of the input APK that are not modified are copied verbatim when
+  // --copy-unmodified-entries is given.
+  std::unique_ptr<IArchiveWriter> CreateArchiveWriter(const std::string& path) {
+    if (options_.copy_unmodified_entries) {
+      return CreateEntryCopyingZipFileArchiveWriter(context_->GetDiagnostics(), path,
+                                                    options_.alignment);
+    }
+    return CreateZipFileArchiveWriter(context_->GetDiagnostics(), path, options_.alignment);
+  }
+
+  // Completes the archive at `path`, so that a failure to write its end is reported.
+  bool FinishArchive(IArchiveWriter* writer, const std::string& path) {
+    if (!writer->Finish()) {
+      context_->GetDiagnostics()->Error(DiagMessage(path) << "failed to write archive: "
+                                                          << writer->GetError());
+      return false;
+    }
+    return true;
+  }
+
+  // Writes one "<original path> -> <shortened path>" line for every renamed file.
+  bool WriteShortenedPathMap(const std::map<std::string, std::string>& path_map,
+                             const std::string& path) {
+    std::ostringstream out;
+    for (const auto& entry : path_map) {
+      if (entry.first != entry.second) {
+        out << entry.first << " -> " << entry.second << "\n";
+      }
+    }
+
+    if (!android::base::WriteStringToFile(out.str(), path)) {
+      context_->GetDiagnostics()->Error(DiagMessage(path) << "failed writing shortened path map");
+      return false;
+    }
+    return true;
+  }
+
+  // Writes the name and ID of every resource whose name is collapsed, in the format of a stable ID
+  // file, so that names can be recovered from IDs (and kept stable by `aapt2 link`).
+  bool WriteResourceNameMap(ResourceTable* table, const std::string& path) {
+    const std::set<ResourceName>& whitelist =
+        options_.table_flattener_options.whitelisted_resources;
+    std::ostringstream out;
+    for (auto& package : table->packages) {
+      for (auto& type : package->types) {
+        for (auto& entry : type->entries) {
+          if (!package->id || !type->id || !entry->id) {
+            continue;
+          }
+
+          if (whitelist.find(ResourceName({}, type->type, entry->name)) != whitelist.end()) {
+            continue;
+          }
+
+          out << ResourceNameRef(package->name, type->type, entry->name) << " = "
+              << ResourceId(package->id.value(), type->id.value(), entry->id.value()) << "\n";
+        }
+      }
+    }
+
+    if (!android::base::WriteStringToFile(out.str(), path)) {
+      context_->GetDiagnostics()->Error(DiagMessage(path) << "failed writing resource name map");
+      return false;
+    }
+    return true;
+  }
+
   bool WriteSplitApk(ResourceTable* table, xml::XmlResource* manifest, IArchiveWriter* writer) {
+    // Write the resource table first, as LoadedApk does.
+    BigBuffer table_buffer(4096);
+    TableFlattener table_flattener(options_.table_flattener_options, &table_buffer);
+    if (!table_flattener.Consume(context_, table)) {
+      return false;
+    }
+
+    io::BigBufferInputStream table_buffer_in(&table_buffer);
+    if (!io::CopyInputStreamToArchive(context_, &table_buffer_in, "resources.arsc",
+                                      ArchiveEntry::kAlign, writer)) {
+      return false;
+    }
+
     BigBuffer manifest_buffer(4096);
     XmlFlattener xml_flattener(&manifest_buffer, {});
     if (!xml_flattener.Consume(context_, manifest)) {
@@ -289,25 +430,44 @@ class OptimizeCommand {
         }
       }
     }
-
-    BigBuffer table_buffer(4096);
-    TableFlattener table_flattener(options_.table_flattener_options, &table_buffer);
-    if (!table_flattener.Consume(context_, table)) {
-      return false;
-    }
-
-    io::BigBufferInputStream table_buffer_in(&table_buffer);
-    if (!io::CopyInputStreamToArchive(context_, &table_buffer_in, "resources.arsc",
-                                      ArchiveEntry::kAlign, writer)) {
-      return false;
-    }
     return true;
   }
 
   OptimizeOptions options_;
   OptimizeContext* context_;
+
+  // Receives the spans of each optimize phase. nullptr when tracing is disabled.
+  TraceRecorder* trace_;
 };
 
+// Reads the resources whose names must not be collapsed, one `[package:]type/name` per line. Empty
+// lines and lines starting with '#' are skipped.
+static bool LoadResourceNameWhitelist(IDiagnostics* diag, const std::string& path,
+                                      std::set<ResourceName>* out_whitelist) {
+  std::string content;
+  if (!android::base::ReadFileToString(path, &content, true /*follow_symlinks*/)) {
+    diag->Error(DiagMessage(path) << "failed reading whitelist file");
+    return false;
+  }
+
+  size_t line_no = 0;
+  for (StringPiece line : util::Tokenize(content, '\n')) {
+    line_no++;
+    line = util::TrimWhitespace(line);
+    if (line.empty() || *line.begin() == '#') {
+      continue;
+    }
+
+    ResourceNameRef name;
+    if (!ResourceUtils::ParseResourceName(line, &name)) {
+      diag->Error(DiagMessage(Source(path, line_no)) << "invalid resource name '" << line << "'");
+      return false;
+    }
+    out_whitelist->insert(ResourceName({}, name.type, name.entry));
+  }
+  return true;
+}
+
 bool ExtractAppDataFromManifest(OptimizeContext* context, LoadedApk* apk,
                                 OptimizeOptions* out_options) {
   io::IFile* manifest_file = apk->GetFileCollection()->FindFile("AndroidManifest.xml");
@@ -351,6 +511,10 @@ int Optimize(const std::vector<StringPiece>& args) {
   Maybe<std::string> target_densities;
   std::vector<std::string> configs;
   std::vector<std::string> split_args;
+  Maybe<std::string> trace_file;
+  Maybe<std::string> whitelist_path;
+  Maybe<std::string> sparse_lookup_cost;
+  bool page_align = false;
   bool verbose = false;
   Flags flags =
       Flags()
@@ -374,24 +538,87 @@ int Optimize(const std::vector<StringPiece>& args) {
                             &split_args)
           .OptionalSwitch("--enable-sparse-encoding",
                           "Enables encoding sparse entries using a binary search tree.\n"
-                          "This decreases APK size at the cost of resource retrieval performance.",
+                          "This decreases APK size at the cost of resource retrieval performance.\n"
+                          "Each type is sparse encoded only when that makes it smaller.",
                           &options.table_flattener_options.use_sparse_entries)
+          .OptionalFlag("--sparse-encoding-lookup-cost",
+                        "The number of bytes sparse encoding must save on a type for every\n"
+                        "step of binary search it adds to lookups, with\n"
+                        "--enable-sparse-encoding. Defaults to 0, which picks the smallest\n"
+                        "encoding. Types that are at least 60% defined are never sparse.",
+                        &sparse_lookup_cost)
+          .OptionalSwitch("--enable-compact-entries",
+                          "Encodes simple values as 8 byte compact entries and uses 16 bit entry\n"
+                          "offsets where possible. Only applies when minSdk is 34 (U) or\n"
+                          "higher, or to configurations of API 34 or higher.",
+                          &options.table_flattener_options.use_compact_entries)
+          .OptionalSwitch("--collapse-resource-names",
+                          "Replaces the name of every resource entry with a single shared key,\n"
+                          "except for those in the --whitelist-path file. Resources can no\n"
+                          "longer be looked up by name (for example with getIdentifier()).",
+                          &options.table_flattener_options.collapse_key_stringpool)
+          .OptionalFlag("--whitelist-path",
+                        "Path to a file listing resources whose names are kept by\n"
+                        "--collapse-resource-names, one type/name per line.",
+                        &whitelist_path)
+          .OptionalFlag("--resource-name-map",
+                        "Path to write the name and ID of every resource collapsed by\n"
+                        "--collapse-resource-names, in the format of a stable ID file.",
+                        &options.resource_name_map_path)
+          .OptionalSwitch("--shorten-resource-paths",
+                          "Renames the files of resources to short names, such as res/Xq.png,\n"
+                          "to shrink the zip central directory and the resource table.",
+                          &options.shorten_resource_paths)
+          .OptionalFlag("--resource-path-shortening-map",
+                        "Path to write the original and shortened path of every file renamed\n"
+                        "by --shorten-resource-paths.",
+                        &options.shortened_path_map_path)
+          .OptionalSwitch("--copy-unmodified-entries",
+                          "Copies the entries of the input APK that are not modified as they\n"
+                          "are, instead of inflating and compressing them again.",
+                          &options.copy_unmodified_entries)
+          .OptionalSwitch("--page-align-uncompressed",
+                          "Aligns the data of every uncompressed entry, including\n"
+                          "resources.arsc, to a 4KiB page so that it can be mmapped directly.",
+                          &page_align)
+          .OptionalFlag("--trace-file",
+                        "Writes the time spent in each optimize phase to a Chrome trace-event\n"
+                        "JSON file that can be loaded into chrome://tracing.",
+                        &trace_file)
           .OptionalSwitch("-v", "Enables verbose logging", &verbose);
 
   if (!flags.Parse("aapt2 optimize", args, &std::cerr)) {
     return 1;
   }
 
+  if (page_align) {
+    options.alignment = ArchiveAlignment::kPage;
+  }
+  if (sparse_lookup_cost) {
+    Maybe<uint32_t> cost = ResourceUtils::ParseInt(sparse_lookup_cost.value());
+    if (!cost || static_cast<int32_t>(cost.value()) < 0) {
+      context.GetDiagnostics()->Error(DiagMessage() << "invalid --sparse-encoding-lookup-cost '"
+                                                    << sparse_lookup_cost.value() << "'");
+      return 1;
+    }
+    options.table_flattener_options.sparse_lookup_step_cost = cost.value();
+  }
+
   if (flags.GetArgs().size() != 1u) {
     std::cerr << "must have one APK as argument.\n\n";
     flags.Usage("aapt2 optimize", &std::cerr);
     return 1;
   }
 
+  TraceRecorder trace_recorder;
+  TraceRecorder* trace = trace_file ? &trace_recorder : nullptr;
+
+  TraceSpan load_span(trace, "optimize", "load apk");
   std::unique_ptr<LoadedApk> apk = LoadedApk::LoadApkFromPath(&context, flags.GetArgs()[0]);
   if (!apk) {
     return 1;
   }
+  load_span.End();
 
   context.SetVerbose(verbose);
 
@@ -426,6 +653,13 @@ int Optimize(const std::vector<StringPiece>& args) {
     }
   }
 
+  if (whitelist_path) {
+    if (!LoadResourceNameWhitelist(context.GetDiagnostics(), whitelist_path.value(),
+                                   &options.table_flattener_options.whitelisted_resources)) {
+      return 1;
+    }
+  }
+
   if (config_path) {
     if (!options.output_dir) {
       context.GetDiagnostics()->Error(
@@ -446,8 +680,22 @@ int Optimize(const std::vector<StringPiece>& args) {
     return 1;
   }
 
-  OptimizeCommand cmd(&context, options);
-  return cmd.Run(std::move(apk));
+  OptimizeCommand cmd(&context, options, trace);
+  int result;
+  {
+    TraceSpan span(trace, "optimize", "optimize");
+    result = cmd.Run(std::move(apk));
+  }
+
+  if (trace_file) {
+    std::string error;
+    if (!trace_recorder.WriteToFile(trace_file.value(), &error)) {
+      context.GetDiagnostics()->Error(DiagMessage(trace_file.value())
+                                      << "failed to write trace: " << error);
+      return 1;
+    }
+  }
+  return result;
 }
 
 }  // namespace aapt
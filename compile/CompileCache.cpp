@@ -0,0 +1,397 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "compile/CompileCache.h"
+
+#include <sys/stat.h>
+
+#include <cinttypes>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "android-base/errors.h"
+#include "android-base/utf8.h"
+
+#include "util/Files.h"
+
+using ::android::FileMap;
+using ::android::StringPiece;
+using ::android::base::SystemErrorCodeToString;
+
+namespace aapt {
+
+// Writes `path` through `write_func` into a temporary file, then renames it into place, so that
+// other processes sharing the directory never see a partial file. The temporary file is named
+// after the process and the thread, since PNGs are crunched and stored on several threads.
+static bool WriteFileAtomically(const std::string& path,
+                                const std::function<bool(FILE*)>& write_func,
+                                std::string* out_error) {
+  const std::string tmp_path =
+      path + ".tmp" + std::to_string(getpid()) + "-" +
+      std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+  {
+    std::unique_ptr<FILE, decltype(fclose)*> f = {::android::base::utf8::fopen(tmp_path.c_str(),
+                                                                              "wb"),
+                                                  fclose};
+    if (!f) {
+      if (out_error) *out_error = SystemErrorCodeToString(errno);
+      return false;
+    }
+
+    if (!write_func(f.get())) {
+      if (out_error) *out_error = SystemErrorCodeToString(errno);
+      f.reset();
+      ::android::base::utf8::unlink(tmp_path.c_str());
+      return false;
+    }
+  }
+
+  if (rename(tmp_path.c_str(), path.c_str()) != 0) {
+    // Another process may have stored the same file first, which is just as good.
+    ::android::base::utf8::unlink(tmp_path.c_str());
+    if (file::GetFileType(path) != file::FileType::kRegular) {
+      if (out_error) *out_error = SystemErrorCodeToString(errno);
+      return false;
+    }
+  }
+  return true;
+}
+
+std::string CompileCache::GetEntryPath(const std::string& key) const {
+  std::string path = dir_;
+  file::AppendPath(&path, key);
+  return path;
+}
+
+// Identifies the format of an entry file, which is followed by the inputs, the warnings and then
+// the cached data. Lengths and counts are 32-bit little-endian integers.
+static constexpr const char kEntryMagic[8] = {'A', 'A', 'P', 'T', 'C', 'C', 'E', '1'};
+
+static void AppendUint32(uint32_t value, std::string* out) {
+  for (int i = 0; i < 4; i++) {
+    out->push_back(static_cast<char>((value >> (i * 8)) & 0xff));
+  }
+}
+
+static void AppendString(const std::string& str, std::string* out) {
+  AppendUint32(static_cast<uint32_t>(str.size()), out);
+  out->append(str);
+}
+
+// Reads the header of an entry file, failing on anything truncated or out of bounds.
+class EntryHeaderReader {
+ public:
+  EntryHeaderReader(const uint8_t* data, size_t len) : data_(data), len_(len) {
+  }
+
+  bool ReadUint32(uint32_t* out_value) {
+    if (len_ - offset_ < 4u) {
+      return false;
+    }
+    *out_value = 0u;
+    for (int i = 0; i < 4; i++) {
+      *out_value |= static_cast<uint32_t>(data_[offset_++]) << (i * 8);
+    }
+    return true;
+  }
+
+  bool ReadString(std::string* out_str) {
+    uint32_t size;
+    if (!ReadUint32(&size) || len_ - offset_ < size) {
+      return false;
+    }
+    out_str->assign(reinterpret_cast<const char*>(data_ + offset_), size);
+    offset_ += size;
+    return true;
+  }
+
+  bool Skip(size_t size) {
+    if (len_ - offset_ < size) {
+      return false;
+    }
+    offset_ += size;
+    return true;
+  }
+
+  size_t offset() const {
+    return offset_;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(EntryHeaderReader);
+
+  const uint8_t* data_;
+  size_t len_;
+  size_t offset_ = 0u;
+};
+
+void CompileCache::Entry::ReplayWarnings(IDiagnostics* diag) const {
+  for (const DiagMessageActual& warning : warnings_) {
+    DiagMessageActual actual_msg = warning;
+    diag->Log(IDiagnostics::Level::Warn, actual_msg);
+  }
+}
+
+Maybe<CompileCache::Entry> CompileCache::Find(const std::string& key,
+                                              const std::string& inputs) const {
+  const std::string path = GetEntryPath(key);
+  if (file::GetFileType(path) != file::FileType::kRegular) {
+    return {};
+  }
+
+  Maybe<FileMap> map = file::MmapPath(path, nullptr);
+  if (!map) {
+    return {};
+  }
+
+  // A corrupt entry, or one stored for other inputs whose key collides, is treated as a miss.
+  EntryHeaderReader reader(static_cast<const uint8_t*>(map.value().getDataPtr()),
+                           map.value().getDataLength());
+  if (!reader.Skip(sizeof(kEntryMagic)) ||
+      memcmp(map.value().getDataPtr(), kEntryMagic, sizeof(kEntryMagic)) != 0) {
+    return {};
+  }
+
+  std::string entry_inputs;
+  uint32_t warning_count;
+  if (!reader.ReadString(&entry_inputs) || entry_inputs != inputs ||
+      !reader.ReadUint32(&warning_count)) {
+    return {};
+  }
+
+  std::vector<DiagMessageActual> warnings;
+  for (uint32_t i = 0u; i < warning_count; i++) {
+    DiagMessageActual warning;
+    uint32_t line;
+    if (!reader.ReadString(&warning.source.path) || !reader.ReadUint32(&line) ||
+        !reader.ReadString(&warning.message)) {
+      return {};
+    }
+
+    // Lines are stored off by one, so that 0 means there is none.
+    if (line != 0u) {
+      warning.source.line = line - 1u;
+    }
+    warnings.push_back(std::move(warning));
+  }
+
+  if (reader.offset() == map.value().getDataLength()) {
+    // Nothing we produce is empty, so this is a corrupt entry.
+    return {};
+  }
+  return Entry(std::move(map.value()), reader.offset(), std::move(warnings));
+}
+
+bool CompileCache::Store(const std::string& key, const std::string& inputs,
+                         const std::vector<DiagMessageActual>& warnings, const BigBuffer& data,
+                         std::string* out_error) const {
+  if (!file::mkdirs(dir_)) {
+    if (out_error) {
+      *out_error = "failed to create cache directory: " + SystemErrorCodeToString(errno);
+    }
+    return false;
+  }
+
+  std::string header(kEntryMagic, sizeof(kEntryMagic));
+  AppendString(inputs, &header);
+  AppendUint32(static_cast<uint32_t>(warnings.size()), &header);
+  for (const DiagMessageActual& warning : warnings) {
+    AppendString(warning.source.path, &header);
+    AppendUint32(warning.source.line ? static_cast<uint32_t>(warning.source.line.value() + 1u) : 0u,
+                 &header);
+    AppendString(warning.message, &header);
+  }
+
+  auto write_func = [&](FILE* f) -> bool {
+    if (fwrite(header.data(), 1, header.size(), f) != header.size()) {
+      return false;
+    }
+    for (const auto& block : data) {
+      if (fwrite(block.buffer.get(), 1, block.size, f) != block.size) {
+        return false;
+      }
+    }
+    return true;
+  };
+  return WriteFileAtomically(GetEntryPath(key), write_func, out_error);
+}
+
+static constexpr const char* kSnapshotHeader = "aapt2-file-digests";
+static constexpr const int kSnapshotVersion = 2;
+
+// File systems record mtimes with as little as two seconds of precision. A file modified within
+// this long before it was digested may be modified again without its mtime changing.
+static constexpr const int64_t kRacyWindowNs = 2000000000;
+
+static int64_t NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+Maybe<FileDigestSnapshot::FileStat> FileDigestSnapshot::Stat(const std::string& path) {
+#ifdef _WIN32
+  // Inode numbers and nanosecond timestamps aren't available, so every file is read.
+  return {};
+#else
+  struct stat sb;
+  if (stat(path.c_str(), &sb) != 0) {
+    return {};
+  }
+
+  FileStat file_stat;
+  file_stat.size = static_cast<uint64_t>(sb.st_size);
+  file_stat.inode = static_cast<uint64_t>(sb.st_ino);
+#ifdef __APPLE__
+  file_stat.mtime_ns =
+      static_cast<int64_t>(sb.st_mtimespec.tv_sec) * 1000000000 + sb.st_mtimespec.tv_nsec;
+#else
+  file_stat.mtime_ns = static_cast<int64_t>(sb.st_mtim.tv_sec) * 1000000000 + sb.st_mtim.tv_nsec;
+#endif
+  return file_stat;
+#endif
+}
+
+void FileDigestSnapshot::Load(const std::string& path) {
+  records_.clear();
+
+  std::ifstream fin(path, std::ifstream::binary);
+  std::string line;
+  if (!fin || !std::getline(fin, line)) {
+    return;
+  }
+
+  char header[32] = {};
+  int version = 0;
+  if (sscanf(line.c_str(), "%31s %d", header, &version) != 2 ||
+      strcmp(header, kSnapshotHeader) != 0 || version != kSnapshotVersion) {
+    return;
+  }
+
+  while (std::getline(fin, line)) {
+    Record record;
+    int path_offset = 0;
+    if (sscanf(line.c_str(), "%" SCNu64 " %" SCNd64 " %" SCNu64 " %" SCNd64 " %" SCNx64 " %n",
+               &record.stat.size, &record.stat.mtime_ns, &record.stat.inode,
+               &record.digest_time_ns, &record.digest, &path_offset) != 5 ||
+        path_offset == 0 || static_cast<size_t>(path_offset) >= line.size()) {
+      // A corrupt snapshot only costs us reading the files again.
+      records_.clear();
+      return;
+    }
+    records_[line.substr(path_offset)] = record;
+  }
+}
+
+Maybe<uint64_t> FileDigestSnapshot::FindDigest(const std::string& path, const FileStat& stat) {
+  std::lock_guard<std::mutex> lock(lock_);
+  auto iter = records_.find(path);
+  if (iter == records_.end()) {
+    return {};
+  }
+
+  Record& record = iter->second;
+  record.used = true;
+  if (record.stat.size != stat.size || record.stat.mtime_ns != stat.mtime_ns ||
+      record.stat.inode != stat.inode ||
+      stat.mtime_ns >= record.digest_time_ns - kRacyWindowNs) {
+    return {};
+  }
+  return record.digest;
+}
+
+void FileDigestSnapshot::SetDigest(const std::string& path, const FileStat& stat,
+                                   uint64_t digest) {
+  std::lock_guard<std::mutex> lock(lock_);
+  Record& record = records_[path];
+  record.stat = stat;
+  record.digest = digest;
+  record.digest_time_ns = NowNs();
+  record.used = true;
+}
+
+bool FileDigestSnapshot::Save(const std::string& path, std::string* out_error) const {
+  auto write_func = [&](FILE* f) -> bool {
+    if (fprintf(f, "%s %d\n", kSnapshotHeader, kSnapshotVersion) < 0) {
+      return false;
+    }
+
+    for (const auto& entry : records_) {
+      const Record& record = entry.second;
+      if (!record.used) {
+        continue;
+      }
+
+      if (fprintf(f, "%" PRIu64 " %" PRId64 " %" PRIu64 " %" PRId64 " %016" PRIx64 " %s\n",
+                  record.stat.size, record.stat.mtime_ns, record.stat.inode,
+                  record.digest_time_ns, record.digest, entry.first.c_str()) < 0) {
+        return false;
+      }
+    }
+    return true;
+  };
+  return WriteFileAtomically(path, write_func, out_error);
+}
+
+bool RecordingArchiveWriter::WriteFile(const StringPiece& path, uint32_t flags,
+                                       io::InputStream* in) {
+  if (!StartEntry(path, flags)) {
+    return false;
+  }
+
+  const void* data = nullptr;
+  size_t len = 0;
+  while (in->Next(&data, &len)) {
+    if (!Write(data, static_cast<int>(len))) {
+      return false;
+    }
+  }
+
+  if (in->HadError()) {
+    return false;
+  }
+  return FinishEntry();
+}
+
+bool RecordingArchiveWriter::StartEntry(const StringPiece& path, uint32_t flags) {
+  recorded_ = util::make_unique<BigBuffer>(recorded_->block_size());
+  return writer_->StartEntry(path, flags);
+}
+
+bool RecordingArchiveWriter::FinishEntry() {
+  return writer_->FinishEntry();
+}
+
+bool RecordingArchiveWriter::Write(const void* data, int len) {
+  if (len > 0) {
+    memcpy(recorded_->NextBlock<uint8_t>(static_cast<size_t>(len)), data, len);
+  }
+  return writer_->Write(data, len);
+}
+
+}  // namespace aapt
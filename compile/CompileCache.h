@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAPT_COMPILE_COMPILECACHE_H
+#define AAPT_COMPILE_COMPILECACHE_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "android-base/macros.h"
+#include "androidfw/StringPiece.h"
+#include "utils/FileMap.h"
+
+#include "Diagnostics.h"
+#include "flatten/Archive.h"
+#include "util/BigBuffer.h"
+#include "util/Maybe.h"
+#include "util/Util.h"
+
+namespace aapt {
+
+// A directory of previously produced outputs, each stored in a file named after a key that
+// digests everything the output depends on. Entries are never invalidated; a change to any input
+// produces a different key.
+//
+// Since a key is only a 64-bit digest, each entry also records a description of the inputs the key
+// was computed from (everything but contents too large to keep, such as the bytes of the input
+// file, whose size is described instead). An entry is only used if its description matches.
+class CompileCache {
+ public:
+  // An entry returned by Find().
+  class Entry {
+   public:
+    Entry(android::FileMap map, size_t data_offset, std::vector<DiagMessageActual> warnings)
+        : map_(std::move(map)), data_offset_(data_offset), warnings_(std::move(warnings)) {
+    }
+
+    // The cached output.
+    const void* data() const {
+      return static_cast<const uint8_t*>(map_.getDataPtr()) + data_offset_;
+    }
+
+    size_t size() const {
+      return map_.getDataLength() - data_offset_;
+    }
+
+    // Reports the warnings that producing the output reported, as if it was produced again.
+    void ReplayWarnings(IDiagnostics* diag) const;
+
+   private:
+    android::FileMap map_;
+    size_t data_offset_;
+    std::vector<DiagMessageActual> warnings_;
+  };
+
+  explicit CompileCache(const std::string& dir) : dir_(dir) {
+  }
+
+  // Returns the entry for `key`, or nothing if there is no usable entry or the entry was stored
+  // for different `inputs`.
+  Maybe<Entry> Find(const std::string& key, const std::string& inputs) const;
+
+  // Stores `data` as the entry for `key`, along with the `inputs` the key digests and the
+  // `warnings` reported while producing the data. The entry is written to a temporary file first
+  // and then renamed into place, so that other processes sharing the cache never see a partial
+  // entry.
+  bool Store(const std::string& key, const std::string& inputs,
+             const std::vector<DiagMessageActual>& warnings, const BigBuffer& data,
+             std::string* out_error) const;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(CompileCache);
+
+  std::string GetEntryPath(const std::string& key) const;
+
+  std::string dir_;
+};
+
+// Remembers the content digest of each input file along with the stat() fields that change
+// whenever the file is written, so that a later run can skip reading inputs that haven't changed.
+class FileDigestSnapshot {
+ public:
+  struct FileStat {
+    uint64_t size = 0;
+    int64_t mtime_ns = 0;
+    uint64_t inode = 0;
+  };
+
+  // Returns the stat() fields of the file at `path`, or nothing if they can't be read.
+  static Maybe<FileStat> Stat(const std::string& path);
+
+  FileDigestSnapshot() = default;
+
+  // Loads a snapshot written by Save(). A missing or unreadable snapshot leaves this one empty.
+  void Load(const std::string& path);
+
+  // Returns the recorded digest of `path` if the file still has the stat fields it had when it
+  // was digested. FindDigest() and SetDigest() may be called from several threads at once. Files modified around the time they were digested are never trusted, since a
+  // second write in the same timestamp tick would be invisible.
+  Maybe<uint64_t> FindDigest(const std::string& path, const FileStat& stat);
+
+  // Records the digest of `path`, taken from its contents as of now.
+  void SetDigest(const std::string& path, const FileStat& stat, uint64_t digest);
+
+  // Writes the records of the paths looked up or digested since Load() to a temporary file and
+  // renames it into place. Records of paths that were not used are dropped.
+  bool Save(const std::string& path, std::string* out_error) const;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(FileDigestSnapshot);
+
+  struct Record {
+    FileStat stat;
+    uint64_t digest = 0;
+
+    // When the digest was taken, in nanoseconds since the epoch.
+    int64_t digest_time_ns = 0;
+
+    // Whether the path was looked up or digested since the snapshot was loaded.
+    bool used = false;
+  };
+
+  // Guards records_ in FindDigest() and SetDigest().
+  std::mutex lock_;
+  std::unordered_map<std::string, Record> records_;
+};
+
+// An IArchiveWriter that forwards everything to another writer, keeping a copy of the bytes
+// written to the most recent entry.
+class RecordingArchiveWriter : public IArchiveWriter {
+ public:
+  explicit RecordingArchiveWriter(IArchiveWriter* writer)
+      : writer_(writer), recorded_(util::make_unique<BigBuffer>(4096)) {
+  }
+
+  bool WriteFile(const android::StringPiece& path, uint32_t flags, io::InputStream* in) override;
+  bool StartEntry(const android::StringPiece& path, uint32_t flags) override;
+  bool FinishEntry() override;
+  bool Write(const void* data, int len) override;
+
+  bool HadError() const override {
+    return writer_->HadError();
+  }
+
+  std::string GetError() const override {
+    return writer_->GetError();
+  }
+
+  // The bytes of the last entry started with StartEntry() or WriteFile().
+  const BigBuffer& GetRecordedData() const {
+    return *recorded_;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(RecordingArchiveWriter);
+
+  IArchiveWriter* writer_;
+  std::unique_ptr<BigBuffer> recorded_;
+};
+
+}  // namespace aapt
+
+#endif  // AAPT_COMPILE_COMPILECACHE_H
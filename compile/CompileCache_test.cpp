@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "compile/CompileCache.h"
+
+#include <cstring>
+
+#include "android-base/file.h"
+#include "android-base/test_utils.h"
+
+#include "test/Test.h"
+#include "util/Files.h"
+
+using ::testing::Eq;
+using ::testing::SizeIs;
+
+namespace aapt {
+
+static FileDigestSnapshot::FileStat MakeStat(uint64_t size, int64_t mtime_ns, uint64_t inode) {
+  FileDigestSnapshot::FileStat stat;
+  stat.size = size;
+  stat.mtime_ns = mtime_ns;
+  stat.inode = inode;
+  return stat;
+}
+
+static std::string GetData(const CompileCache::Entry& entry) {
+  return std::string(static_cast<const char*>(entry.data()), entry.size());
+}
+
+TEST(CompileCacheTest, HitReplaysWarnings) {
+  TemporaryDir cache_dir;
+  const CompileCache cache(cache_dir.path);
+
+  BigBuffer data(16u);
+  memcpy(data.NextBlock<char>(4u), "data", 4u);
+  const std::vector<DiagMessageActual> warnings = {
+      DiagMessageActual{Source("res/drawable/icon.png"), "iCCP: known incorrect sRGB profile"},
+      DiagMessageActual{Source("res/values/strings.xml", 3u), "string has no translations"},
+  };
+  std::string error;
+  ASSERT_TRUE(cache.Store("key", "size=4\n", warnings, data, &error)) << error;
+
+  Maybe<CompileCache::Entry> entry = cache.Find("key", "size=4\n");
+  ASSERT_TRUE(entry);
+  EXPECT_THAT(GetData(entry.value()), Eq("data"));
+
+  BufferedDiagnostics diag;
+  entry.value().ReplayWarnings(&diag);
+  ASSERT_THAT(diag.messages(), SizeIs(2u));
+  EXPECT_THAT(diag.messages()[0].level, Eq(IDiagnostics::Level::Warn));
+  EXPECT_THAT(diag.messages()[0].actual_msg.source, Eq(Source("res/drawable/icon.png")));
+  EXPECT_THAT(diag.messages()[0].actual_msg.message, Eq("iCCP: known incorrect sRGB profile"));
+  EXPECT_THAT(diag.messages()[1].level, Eq(IDiagnostics::Level::Warn));
+  EXPECT_THAT(diag.messages()[1].actual_msg.source, Eq(Source("res/values/strings.xml", 3u)));
+  EXPECT_THAT(diag.messages()[1].actual_msg.message, Eq("string has no translations"));
+}
+
+TEST(CompileCacheTest, EntriesStoredForOtherInputsAreMisses) {
+  TemporaryDir cache_dir;
+  const CompileCache cache(cache_dir.path);
+
+  BigBuffer data(16u);
+  memcpy(data.NextBlock<char>(4u), "data", 4u);
+  std::string error;
+  ASSERT_TRUE(cache.Store("key", "size=4\n", {}, data, &error)) << error;
+
+  // A key that collides with the key of other inputs must not return their output.
+  EXPECT_FALSE(cache.Find("key", "size=5\n"));
+  EXPECT_FALSE(cache.Find("other", "size=4\n"));
+  EXPECT_TRUE(cache.Find("key", "size=4\n"));
+
+  // Entries in an older format are treated as misses.
+  std::string path = cache_dir.path;
+  file::AppendPath(&path, "old");
+  ASSERT_TRUE(android::base::WriteStringToFile("data", path));
+  EXPECT_FALSE(cache.Find("old", ""));
+}
+
+TEST(FileDigestSnapshotTest, SavedDigestsAreFoundForUnchangedFiles) {
+  const FileDigestSnapshot::FileStat stat = MakeStat(12u, 1000000000, 42u);
+
+  TemporaryFile snapshot_file;
+  FileDigestSnapshot snapshot;
+  snapshot.SetDigest("res/values/strings.xml", stat, 0x0123456789abcdefu);
+  snapshot.SetDigest("res/drawable/my icon.png", stat, 7u);
+  std::string error;
+  ASSERT_TRUE(snapshot.Save(snapshot_file.path, &error)) << error;
+
+  FileDigestSnapshot loaded;
+  loaded.Load(snapshot_file.path);
+
+  Maybe<uint64_t> digest = loaded.FindDigest("res/values/strings.xml", stat);
+  ASSERT_TRUE(digest);
+  EXPECT_THAT(digest.value(), Eq(0x0123456789abcdefu));
+
+  digest = loaded.FindDigest("res/drawable/my icon.png", stat);
+  ASSERT_TRUE(digest);
+  EXPECT_THAT(digest.value(), Eq(7u));
+
+  EXPECT_FALSE(loaded.FindDigest("res/values/strings.xml", MakeStat(13u, 1000000000, 42u)));
+  EXPECT_FALSE(loaded.FindDigest("res/values/strings.xml", MakeStat(12u, 2000000000, 42u)));
+  EXPECT_FALSE(loaded.FindDigest("res/values/strings.xml", MakeStat(12u, 1000000000, 43u)));
+  EXPECT_FALSE(loaded.FindDigest("res/values/colors.xml", stat));
+}
+
+TEST(FileDigestSnapshotTest, FilesModifiedWhenSavedAreNotTrusted) {
+  TemporaryFile snapshot_file;
+  Maybe<FileDigestSnapshot::FileStat> stat = FileDigestSnapshot::Stat(snapshot_file.path);
+  ASSERT_TRUE(stat);
+
+  FileDigestSnapshot snapshot;
+  snapshot.SetDigest(snapshot_file.path, stat.value(), 1u);
+  std::string error;
+  ASSERT_TRUE(snapshot.Save(snapshot_file.path, &error)) << error;
+
+  FileDigestSnapshot loaded;
+  loaded.Load(snapshot_file.path);
+  EXPECT_FALSE(loaded.FindDigest(snapshot_file.path, stat.value()));
+}
+
+TEST(FileDigestSnapshotTest, RacyDigestsStayUntrustedWhenSavedAgain) {
+  TemporaryFile snapshot_file;
+  Maybe<FileDigestSnapshot::FileStat> stat = FileDigestSnapshot::Stat(snapshot_file.path);
+  ASSERT_TRUE(stat);
+
+  FileDigestSnapshot snapshot;
+  snapshot.SetDigest(snapshot_file.path, stat.value(), 1u);
+  std::string error;
+  ASSERT_TRUE(snapshot.Save(snapshot_file.path, &error)) << error;
+
+  // Saving the loaded record again must not make it look like it was digested later.
+  FileDigestSnapshot loaded;
+  loaded.Load(snapshot_file.path);
+  EXPECT_FALSE(loaded.FindDigest(snapshot_file.path, stat.value()));
+  ASSERT_TRUE(loaded.Save(snapshot_file.path, &error)) << error;
+
+  FileDigestSnapshot reloaded;
+  reloaded.Load(snapshot_file.path);
+  EXPECT_FALSE(reloaded.FindDigest(snapshot_file.path, stat.value()));
+}
+
+TEST(FileDigestSnapshotTest, UnusedRecordsAreDropped) {
+  const FileDigestSnapshot::FileStat stat = MakeStat(12u, 1000000000, 42u);
+
+  TemporaryFile snapshot_file;
+  FileDigestSnapshot snapshot;
+  snapshot.SetDigest("res/values/strings.xml", stat, 1u);
+  snapshot.SetDigest("res/values/colors.xml", stat, 2u);
+  std::string error;
+  ASSERT_TRUE(snapshot.Save(snapshot_file.path, &error)) << error;
+
+  FileDigestSnapshot loaded;
+  loaded.Load(snapshot_file.path);
+  ASSERT_TRUE(loaded.FindDigest("res/values/strings.xml", stat));
+  ASSERT_TRUE(loaded.Save(snapshot_file.path, &error)) << error;
+
+  FileDigestSnapshot reloaded;
+  reloaded.Load(snapshot_file.path);
+  EXPECT_TRUE(reloaded.FindDigest("res/values/strings.xml", stat));
+  EXPECT_FALSE(reloaded.FindDigest("res/values/colors.xml", stat));
+}
+
+TEST(FileDigestSnapshotTest, CorruptSnapshotIsEmpty) {
+  TemporaryFile snapshot_file;
+  ASSERT_TRUE(android::base::WriteStringToFile("aapt2-file-digests 2\ngarbage\n",
+                                               snapshot_file.path));
+
+  FileDigestSnapshot loaded;
+  loaded.Load(snapshot_file.path);
+  EXPECT_FALSE(loaded.FindDigest("garbage", MakeStat(0u, 0, 0u)));
+}
+
+}  // namespace aapt
@@ -16,6 +16,7 @@
 
 #include "compile/Image.h"
 
+#include <cstring>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -100,6 +101,13 @@ static bool FillRanges(const ImageLine* image_line,
   uint32_t last_color = 0xffffffffu;
   for (int32_t idx = 1; idx < length - 1; idx++) {
     const uint32_t color = image_line->GetColor(idx);
+
+    // Borders are mostly long runs of one color, which was validated at the
+    // start of the run.
+    if (color == last_color && idx != 1) {
+      continue;
+    }
+
     if (!color_validator->IsValidColor(color)) {
       *out_err = "found an invalid color";
       return false;
@@ -301,26 +309,43 @@ static int32_t CalculateSegmentCount(const std::vector<Range>& stretch_regions,
 
 static uint32_t GetRegionColor(uint8_t** rows, const Bounds& region) {
   // Sample the first pixel to compare against.
-  const uint32_t expected_color =
-      NinePatch::PackRGBA(rows[region.top] + region.left * 4);
-  for (int32_t y = region.top; y < region.bottom; y++) {
-    const uint8_t* row = rows[y];
-    for (int32_t x = region.left; x < region.right; x++) {
-      const uint32_t color = NinePatch::PackRGBA(row + x * 4);
-      if (get_alpha(color) == 0) {
-        // The color is transparent.
-        // If the expectedColor is not transparent, NO_COLOR.
-        if (get_alpha(expected_color) != 0) {
-          return android::Res_png_9patch::NO_COLOR;
-        }
-      } else if (color != expected_color) {
+  const uint8_t* first_pixel = rows[region.top] + region.left * 4;
+  const uint32_t expected_color = NinePatch::PackRGBA(first_pixel);
+  const int32_t region_width = region.right - region.left;
+
+  // The rows are scanned without branching on each pixel, so that the compiler can vectorize
+  // the inner loops. We only check whether to bail out once per row.
+  if (get_alpha(expected_color) == 0) {
+    // The region is transparent if every pixel is, regardless of its color channels.
+    for (int32_t y = region.top; y < region.bottom; y++) {
+      const uint8_t* row = rows[y] + region.left * 4;
+      uint8_t alpha = 0;
+      for (int32_t x = 0; x < region_width; x++) {
+        alpha |= row[x * 4 + 3];
+      }
+
+      if (alpha != 0) {
         return android::Res_png_9patch::NO_COLOR;
       }
     }
+    return android::Res_png_9patch::TRANSPARENT_COLOR;
   }
 
-  if (get_alpha(expected_color) == 0) {
-    return android::Res_png_9patch::TRANSPARENT_COLOR;
+  // Otherwise every pixel must be exactly the same color as the first one.
+  uint32_t expected_pixel;
+  memcpy(&expected_pixel, first_pixel, sizeof(expected_pixel));
+  for (int32_t y = region.top; y < region.bottom; y++) {
+    const uint8_t* row = rows[y] + region.left * 4;
+    uint32_t difference = 0;
+    for (int32_t x = 0; x < region_width; x++) {
+      uint32_t pixel;
+      memcpy(&pixel, row + x * 4, sizeof(pixel));
+      difference |= pixel ^ expected_pixel;
+    }
+
+    if (difference != 0) {
+      return android::Res_png_9patch::NO_COLOR;
+    }
   }
   return expected_color;
 }
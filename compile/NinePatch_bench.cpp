@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "compile/Image.h"
+
+#include <cstring>
+#include <string>
+
+#include "benchmark/benchmark.h"
+
+#include "util/Util.h"
+
+namespace aapt {
+
+// Returns a square 9-patch of `size` pixels per side, border included, that stretches in the
+// middle third and pads by a quarter on each side. Its content is `color` (0xRRGGBBAA) all
+// over, so that every region is scanned to the end.
+static std::unique_ptr<Image> MakeNinePatchImage(int32_t size, uint32_t color) {
+  const uint8_t kWhite[] = {0xff, 0xff, 0xff, 0xff};
+  const uint8_t kBlack[] = {0x00, 0x00, 0x00, 0xff};
+  const uint8_t content[] = {static_cast<uint8_t>(color >> 24), static_cast<uint8_t>(color >> 16),
+                             static_cast<uint8_t>(color >> 8), static_cast<uint8_t>(color)};
+
+  std::unique_ptr<Image> image = util::make_unique<Image>();
+  image->width = size;
+  image->height = size;
+  image->data = std::unique_ptr<uint8_t[]>(new uint8_t[size * size * 4]);
+  image->rows = std::unique_ptr<uint8_t* []>(new uint8_t*[size]);
+  for (int32_t y = 0; y < size; y++) {
+    uint8_t* row = image->rows[y] = image->data.get() + y * size * 4;
+    for (int32_t x = 0; x < size; x++) {
+      const bool on_border = x == 0 || y == 0 || x == size - 1 || y == size - 1;
+      const int32_t along = (x == 0 || x == size - 1) ? y : x;
+      const uint8_t* pixel = content;
+      if (on_border) {
+        pixel = kWhite;
+        const bool top_or_left = x == 0 || y == 0;
+        if (along > 0 && along < size - 1) {
+          if (top_or_left && along > size / 3 && along < 2 * size / 3) {
+            pixel = kBlack;
+          } else if (!top_or_left && along > size / 4 && along < 3 * size / 4) {
+            pixel = kBlack;
+          }
+        }
+      }
+      memcpy(row + x * 4, pixel, 4);
+    }
+  }
+  return image;
+}
+
+static void BM_NinePatchCreate(benchmark::State& state, uint32_t color) {
+  std::unique_ptr<Image> image = MakeNinePatchImage(state.range(0), color);
+
+  while (state.KeepRunning()) {
+    std::string err;
+    if (NinePatch::Create(image->rows.get(), image->width, image->height, &err) == nullptr) {
+      state.SkipWithError(err.c_str());
+      break;
+    }
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * image->width *
+                          image->height * 4);
+}
+BENCHMARK_CAPTURE(BM_NinePatchCreate, opaque, 0x3f51b5ffu)->Range(16, 2048);
+BENCHMARK_CAPTURE(BM_NinePatchCreate, transparent, 0x00000000u)->Range(16, 2048);
+
+}  // namespace aapt
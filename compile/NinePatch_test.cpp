@@ -31,6 +31,7 @@ namespace aapt {
 #define BLACK "\x00\x00\x00\xff"
 #define WHITE "\xff\xff\xff\xff"
 #define TRANS "\x00\x00\x00\x00"
+#define TRANS_WHITE "\xff\xff\xff\x00"
 
 static uint8_t* k2x2[] = {
     (uint8_t*)WHITE WHITE, (uint8_t*)WHITE WHITE,
@@ -118,6 +119,14 @@ static uint8_t* kColorfulImage5x5[] = {
     (uint8_t*)WHITE WHITE WHITE WHITE WHITE,
 };
 
+static uint8_t* kMultiPixelRegions7x5[] = {
+    (uint8_t*)WHITE WHITE WHITE BLACK BLACK WHITE WHITE,
+    (uint8_t*)BLACK TRANS TRANS_WHITE RED RED BLUE WHITE,
+    (uint8_t*)BLACK TRANS_WHITE TRANS RED RED BLUE WHITE,
+    (uint8_t*)WHITE RED BLUE BLACK BLACK TRANS WHITE,
+    (uint8_t*)WHITE WHITE WHITE WHITE WHITE WHITE WHITE,
+};
+
 static uint8_t* kOutlineOpaque10x10[] = {
     (uint8_t*)WHITE BLACK BLACK BLACK BLACK BLACK BLACK BLACK BLACK WHITE,
     (uint8_t*)WHITE TRANS TRANS TRANS TRANS TRANS TRANS TRANS TRANS WHITE,
@@ -181,6 +190,16 @@ static uint8_t* kStretchAndPadding5x5[] = {
     (uint8_t*)WHITE WHITE BLACK WHITE WHITE,
 };
 
+static uint8_t* kWhiteRunOnTransparentNeutralBorder5x3[] = {
+    (uint8_t*)TRANS WHITE WHITE WHITE TRANS, (uint8_t*)TRANS RED RED RED TRANS,
+    (uint8_t*)TRANS TRANS TRANS TRANS TRANS,
+};
+
+static uint8_t* kBlueAfterBlackRun6x3[] = {
+    (uint8_t*)WHITE BLACK BLACK BLUE BLUE WHITE, (uint8_t*)WHITE RED RED RED RED WHITE,
+    (uint8_t*)WHITE WHITE WHITE WHITE WHITE WHITE,
+};
+
 TEST(NinePatchTest, Minimum3x3) {
   std::string err;
   EXPECT_EQ(nullptr, NinePatch::Create(k2x2, 2, 2, &err));
@@ -193,6 +212,16 @@ TEST(NinePatchTest, MixedNeutralColors) {
   EXPECT_FALSE(err.empty());
 }
 
+TEST(NinePatchTest, InvalidColorsInBorderRunsAreRejected) {
+  std::string err;
+  EXPECT_EQ(nullptr, NinePatch::Create(kWhiteRunOnTransparentNeutralBorder5x3, 5, 3, &err));
+  EXPECT_FALSE(err.empty());
+
+  err.clear();
+  EXPECT_EQ(nullptr, NinePatch::Create(kBlueAfterBlackRun6x3, 6, 3, &err));
+  EXPECT_FALSE(err.empty());
+}
+
 TEST(NinePatchTest, TransparentNeutralColor) {
   std::string err;
   EXPECT_NE(nullptr,
@@ -296,6 +325,24 @@ TEST(NinePatchTest, RegionColorsAreCorrect) {
   EXPECT_EQ(expected_colors, nine_patch->region_colors);
 }
 
+TEST(NinePatchTest, MultiPixelRegionColorsAreCorrect) {
+  std::string err;
+  std::unique_ptr<NinePatch> nine_patch =
+      NinePatch::Create(kMultiPixelRegions7x5, 7, 5, &err);
+  ASSERT_NE(nullptr, nine_patch);
+
+  // Transparent pixels count as transparent whatever their color channels are.
+  std::vector<uint32_t> expected_colors = {
+      (uint32_t)android::Res_png_9patch::TRANSPARENT_COLOR,
+      NinePatch::PackRGBA((uint8_t*)RED),
+      NinePatch::PackRGBA((uint8_t*)BLUE),
+      (uint32_t)android::Res_png_9patch::NO_COLOR,
+      NinePatch::PackRGBA((uint8_t*)BLACK),
+      (uint32_t)android::Res_png_9patch::TRANSPARENT_COLOR,
+  };
+  EXPECT_EQ(expected_colors, nine_patch->region_colors);
+}
+
 TEST(NinePatchTest, OutlineFromOpaqueImage) {
   std::string err;
   std::unique_ptr<NinePatch> nine_patch =
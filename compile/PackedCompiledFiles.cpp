@@ -0,0 +1,540 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "compile/PackedCompiledFiles.h"
+
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+#include "android-base/errors.h"
+#include "android-base/macros.h"
+#include "android-base/utf8.h"
+#include "androidfw/ResourceTypes.h"
+
+#include "ResourceUtils.h"
+#include "proto/ProtoSerialize.h"
+#include "util/Util.h"
+
+using ::android::StringPiece;
+using ::android::base::SystemErrorCodeToString;
+
+namespace aapt {
+
+namespace {
+
+constexpr uint32_t kPackedMagic = 0x46435041u;  // "APCF"
+constexpr uint32_t kPackedVersion = 1u;
+
+constexpr size_t kHeaderSize = 24u;
+constexpr size_t kIndexHeaderSize = 16u;
+// A record is its kind, the string indices of its entry path, resource name, configuration and
+// source path, the index of its first exported symbol and its symbol count, 4 reserved bytes and
+// the 64 bit offset and size of its data. A symbol is the string index of its name and its line.
+constexpr size_t kRecordSize = 48u;
+constexpr size_t kSymbolSize = 8u;
+
+// The kinds of record.
+constexpr uint32_t kRecordTable = 0u;
+constexpr uint32_t kRecordFile = 1u;
+
+// The string index of the fields that a table record doesn't have.
+constexpr uint32_t kNoString = 0xffffffffu;
+
+void AppendLittleEndian32(uint32_t value, std::string* out) {
+  for (int i = 0; i < 4; i++) {
+    out->push_back(static_cast<char>((value >> (i * 8)) & 0xffu));
+  }
+}
+
+void AppendLittleEndian64(uint64_t value, std::string* out) {
+  AppendLittleEndian32(static_cast<uint32_t>(value), out);
+  AppendLittleEndian32(static_cast<uint32_t>(value >> 32), out);
+}
+
+uint32_t ReadLittleEndian32(const uint8_t* data) {
+  return static_cast<uint32_t>(data[0]) | static_cast<uint32_t>(data[1]) << 8 |
+         static_cast<uint32_t>(data[2]) << 16 | static_cast<uint32_t>(data[3]) << 24;
+}
+
+uint64_t ReadLittleEndian64(const uint8_t* data) {
+  return static_cast<uint64_t>(ReadLittleEndian32(data)) |
+         static_cast<uint64_t>(ReadLittleEndian32(data + 4)) << 32;
+}
+
+class PackedCompiledFileWriter : public IArchiveWriter {
+ public:
+  PackedCompiledFileWriter() = default;
+
+  ~PackedCompiledFileWriter() {
+    if (file_) {
+      Finish();
+    }
+  }
+
+  bool Open(const StringPiece& path) {
+    file_ = {::android::base::utf8::fopen(path.to_string().c_str(), "wb"), fclose};
+    if (!file_) {
+      error_ = SystemErrorCodeToString(errno);
+      return false;
+    }
+
+    // The header is written again by Finish(), once the location of the index is known.
+    return WriteRaw(std::string(kHeaderSize, '\0'));
+  }
+
+  bool StartEntry(const StringPiece& path, uint32_t flags) override {
+    if (!file_ || in_entry_) {
+      return false;
+    }
+    entry_path_ = path.to_string();
+    entry_data_.clear();
+    in_entry_ = true;
+    return true;
+  }
+
+  bool Write(const void* data, int len) override {
+    if (!in_entry_) {
+      return false;
+    }
+    entry_data_.append(static_cast<const char*>(data), static_cast<size_t>(len));
+    return true;
+  }
+
+  bool FinishEntry() override {
+    if (!in_entry_) {
+      return false;
+    }
+    in_entry_ = false;
+
+    if (util::EndsWith(entry_path_, ".arsc.flat")) {
+      return AddRecord(kRecordTable, nullptr, entry_data_.data(), entry_data_.size());
+    } else if (!util::EndsWith(entry_path_, ".flat")) {
+      error_ = "can't pack '" + entry_path_ + "', which is not a compiled file";
+      return false;
+    }
+
+    CompiledFileInputStream input(entry_data_.data(), entry_data_.size());
+    uint32_t num_files = 0u;
+    if (!input.ReadLittleEndian32(&num_files)) {
+      error_ = "failed to read the number of files in '" + entry_path_ + "'";
+      return false;
+    }
+
+    for (uint32_t i = 0; i < num_files; i++) {
+      pb::internal::CompiledFile compiled_file;
+      uint64_t offset, len;
+      if (!input.ReadCompiledFile(&compiled_file) || !input.ReadDataMetaData(&offset, &len)) {
+        error_ = "failed to read compiled file header of '" + entry_path_ + "'";
+        return false;
+      }
+
+      if (!AddRecord(kRecordFile, &compiled_file, entry_data_.data() + offset, len)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool WriteFile(const StringPiece& path, uint32_t flags, io::InputStream* in) override {
+    if (!StartEntry(path, flags)) {
+      return false;
+    }
+
+    const void* data = nullptr;
+    size_t len = 0;
+    while (in->Next(&data, &len)) {
+      if (!Write(data, static_cast<int>(len))) {
+        return false;
+      }
+    }
+    return !in->HadError() && FinishEntry();
+  }
+
+  bool Finish() override {
+    if (!file_) {
+      return !HadError();
+    }
+
+    if (!HadError()) {
+      WriteIndex();
+    }
+
+    if (fclose(file_.release()) != 0 && error_.empty()) {
+      error_ = SystemErrorCodeToString(errno);
+    }
+    return !HadError();
+  }
+
+  bool HadError() const override {
+    return !error_.empty();
+  }
+
+  std::string GetError() const override {
+    return error_;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(PackedCompiledFileWriter);
+
+  bool WriteRaw(const void* data, size_t len) {
+    if (len != 0 && fwrite(data, 1, len, file_.get()) != len) {
+      error_ = SystemErrorCodeToString(errno);
+      return false;
+    }
+    offset_ += len;
+    return true;
+  }
+
+  bool WriteRaw(const std::string& data) {
+    return WriteRaw(data.data(), data.size());
+  }
+
+  // Pads the output so that what is written next starts at a multiple of 4 bytes.
+  bool Align() {
+    const size_t padding = (4u - offset_ % 4u) % 4u;
+    return WriteRaw(std::string(padding, '\0'));
+  }
+
+  // Returns the index of `str` in the dictionary, adding it if it isn't there yet.
+  uint32_t Intern(const std::string& str) {
+    auto result = string_ids_.insert({str, static_cast<uint32_t>(strings_.size())});
+    if (result.second) {
+      strings_.push_back(&result.first->first);
+    }
+    return result.first->second;
+  }
+
+  bool AddRecord(uint32_t kind, const pb::internal::CompiledFile* compiled_file, const char* data,
+                 size_t len) {
+    if (!Align()) {
+      return false;
+    }
+    const uint64_t data_offset = offset_;
+    if (!WriteRaw(data, len)) {
+      return false;
+    }
+
+    AppendLittleEndian32(kind, &records_);
+    AppendLittleEndian32(Intern(entry_path_), &records_);
+    if (compiled_file) {
+      AppendLittleEndian32(Intern(compiled_file->resource_name()), &records_);
+      AppendLittleEndian32(Intern(compiled_file->config().data()), &records_);
+      AppendLittleEndian32(Intern(compiled_file->source_path()), &records_);
+      AppendLittleEndian32(symbol_count_, &records_);
+      AppendLittleEndian32(compiled_file->exported_symbol_size(), &records_);
+      for (const pb::internal::CompiledFile_Symbol& symbol : compiled_file->exported_symbol()) {
+        AppendLittleEndian32(Intern(symbol.resource_name()), &symbols_);
+        AppendLittleEndian32(symbol.source().line_number(), &symbols_);
+        symbol_count_++;
+      }
+    } else {
+      AppendLittleEndian32(kNoString, &records_);
+      AppendLittleEndian32(kNoString, &records_);
+      AppendLittleEndian32(kNoString, &records_);
+      AppendLittleEndian32(0u, &records_);
+      AppendLittleEndian32(0u, &records_);
+    }
+    AppendLittleEndian32(0u, &records_);
+    AppendLittleEndian64(data_offset, &records_);
+    AppendLittleEndian64(len, &records_);
+    record_count_++;
+    return true;
+  }
+
+  void WriteIndex() {
+    std::string offsets;
+    size_t string_data_size = 0u;
+    for (const std::string* str : strings_) {
+      AppendLittleEndian32(static_cast<uint32_t>(string_data_size), &offsets);
+      string_data_size += str->size();
+    }
+    AppendLittleEndian32(static_cast<uint32_t>(string_data_size), &offsets);
+
+    if (string_data_size > std::numeric_limits<uint32_t>::max()) {
+      error_ = "too many strings to pack";
+      return;
+    }
+
+    if (!Align()) {
+      return;
+    }
+    const uint64_t index_offset = offset_;
+
+    std::string index_header;
+    AppendLittleEndian32(static_cast<uint32_t>(strings_.size()), &index_header);
+    AppendLittleEndian32(record_count_, &index_header);
+    AppendLittleEndian32(symbol_count_, &index_header);
+    AppendLittleEndian32(static_cast<uint32_t>(string_data_size), &index_header);
+    if (!WriteRaw(index_header) || !WriteRaw(offsets) || !WriteRaw(records_) ||
+        !WriteRaw(symbols_)) {
+      return;
+    }
+
+    for (const std::string* str : strings_) {
+      if (!WriteRaw(*str)) {
+        return;
+      }
+    }
+
+    std::string header;
+    AppendLittleEndian32(kPackedMagic, &header);
+    AppendLittleEndian32(kPackedVersion, &header);
+    AppendLittleEndian64(index_offset, &header);
+    AppendLittleEndian64(offset_ - index_offset, &header);
+    if (fseek(file_.get(), 0, SEEK_SET) != 0) {
+      error_ = SystemErrorCodeToString(errno);
+      return;
+    }
+    WriteRaw(header);
+  }
+
+  std::unique_ptr<FILE, decltype(fclose)*> file_ = {nullptr, fclose};
+  uint64_t offset_ = 0u;
+  std::string error_;
+
+  bool in_entry_ = false;
+  std::string entry_path_;
+  std::string entry_data_;
+
+  std::unordered_map<std::string, uint32_t> string_ids_;
+
+  // The keys of `string_ids_` in the order they were added, which is the order of the dictionary.
+  std::vector<const std::string*> strings_;
+
+  std::string records_;
+  uint32_t record_count_ = 0u;
+  std::string symbols_;
+  uint32_t symbol_count_ = 0u;
+};
+
+// Reads the index of a packed container, parsing each string of the dictionary at most once.
+class PackedCompiledFileReader {
+ public:
+  PackedCompiledFileReader(const Source& source, IDiagnostics* diag)
+      : source_(source), diag_(diag) {
+  }
+
+  bool Read(const uint8_t* data, size_t len, std::vector<PackedCompiledFile>* out_files) {
+    if (!IsPackedCompiledFiles(data, len)) {
+      return Corrupt("bad magic");
+    }
+
+    if (ReadLittleEndian32(data + 4) != kPackedVersion) {
+      diag_->Error(DiagMessage(source_) << "unsupported packed container version "
+                                        << ReadLittleEndian32(data + 4));
+      return false;
+    }
+
+    const uint64_t index_offset = ReadLittleEndian64(data + 8);
+    const uint64_t index_size = ReadLittleEndian64(data + 16);
+    if (index_offset < kHeaderSize || index_offset > len || index_size > len - index_offset ||
+        index_size < kIndexHeaderSize) {
+      return Corrupt("index out of bounds");
+    }
+
+    const uint8_t* index = data + index_offset;
+    string_count_ = ReadLittleEndian32(index);
+    const uint32_t record_count = ReadLittleEndian32(index + 4);
+    symbol_count_ = ReadLittleEndian32(index + 8);
+    string_data_size_ = ReadLittleEndian32(index + 12);
+
+    const uint64_t offsets_size = (static_cast<uint64_t>(string_count_) + 1u) * 4u;
+    const uint64_t records_size = static_cast<uint64_t>(record_count) * kRecordSize;
+    const uint64_t symbols_size = static_cast<uint64_t>(symbol_count_) * kSymbolSize;
+    if (kIndexHeaderSize + offsets_size + records_size + symbols_size + string_data_size_ !=
+        index_size) {
+      return Corrupt("index size mismatch");
+    }
+
+    string_offsets_ = index + kIndexHeaderSize;
+    const uint8_t* records = string_offsets_ + offsets_size;
+    symbols_ = records + records_size;
+    string_data_ = symbols_ + symbols_size;
+
+    out_files->reserve(out_files->size() + record_count);
+    for (uint32_t i = 0; i < record_count; i++) {
+      const uint8_t* record = records + i * kRecordSize;
+      PackedCompiledFile packed_file;
+
+      StringPiece path;
+      if (!GetString(ReadLittleEndian32(record + 4), &path)) {
+        return false;
+      }
+      packed_file.path = path.to_string();
+
+      packed_file.offset = ReadLittleEndian64(record + 32);
+      packed_file.size = ReadLittleEndian64(record + 40);
+      if (packed_file.offset < kHeaderSize || packed_file.offset > index_offset ||
+          packed_file.size > index_offset - packed_file.offset) {
+        return Corrupt("data out of bounds");
+      }
+
+      const uint32_t kind = ReadLittleEndian32(record);
+      if (kind == kRecordFile) {
+        packed_file.file = ReadFile(record);
+        if (!packed_file.file) {
+          return false;
+        }
+      } else if (kind != kRecordTable) {
+        return Corrupt("unknown record kind");
+      }
+      out_files->push_back(std::move(packed_file));
+    }
+    return true;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(PackedCompiledFileReader);
+
+  bool Corrupt(const StringPiece& what) {
+    diag_->Error(DiagMessage(source_) << "corrupt packed container: " << what);
+    return false;
+  }
+
+  bool GetString(uint32_t idx, StringPiece* out_str) {
+    if (idx >= string_count_) {
+      return Corrupt("string index out of bounds");
+    }
+
+    const uint32_t start = ReadLittleEndian32(string_offsets_ + idx * 4u);
+    const uint32_t end = ReadLittleEndian32(string_offsets_ + idx * 4u + 4u);
+    if (start > end || end > string_data_size_) {
+      return Corrupt("string out of bounds");
+    }
+    *out_str = StringPiece(reinterpret_cast<const char*>(string_data_) + start, end - start);
+    return true;
+  }
+
+  const ResourceName* GetResourceName(uint32_t idx) {
+    auto iter = names_.find(idx);
+    if (iter != names_.end()) {
+      return &iter->second;
+    }
+
+    StringPiece str;
+    if (!GetString(idx, &str)) {
+      return nullptr;
+    }
+
+    ResourceNameRef name_ref;
+    if (!ResourceUtils::ParseResourceName(str, &name_ref)) {
+      diag_->Error(DiagMessage(source_) << "invalid resource name in packed container: " << str);
+      return nullptr;
+    }
+    return &names_.insert({idx, name_ref.ToResourceName()}).first->second;
+  }
+
+  const ConfigDescription* GetConfig(uint32_t idx) {
+    auto iter = configs_.find(idx);
+    if (iter != configs_.end()) {
+      return &iter->second;
+    }
+
+    StringPiece str;
+    if (!GetString(idx, &str)) {
+      return nullptr;
+    }
+
+    // The configuration is stored as the flattened ResTable_config, the same way
+    // pb::ConfigDescription stores it.
+    android::ResTable_config flat_config;
+    if (str.size() > sizeof(flat_config)) {
+      Corrupt("invalid configuration");
+      return nullptr;
+    }
+    memset(&flat_config, 0, sizeof(flat_config));
+    memcpy(&flat_config, str.data(), str.size());
+
+    ConfigDescription config;
+    config.copyFromDtoH(flat_config);
+    return &configs_.insert({idx, config}).first->second;
+  }
+
+  std::unique_ptr<ResourceFile> ReadFile(const uint8_t* record) {
+    std::unique_ptr<ResourceFile> file = util::make_unique<ResourceFile>();
+
+    const ResourceName* name = GetResourceName(ReadLittleEndian32(record + 8));
+    const ConfigDescription* config = GetConfig(ReadLittleEndian32(record + 12));
+    StringPiece source_path;
+    if (!name || !config || !GetString(ReadLittleEndian32(record + 16), &source_path)) {
+      return {};
+    }
+    file->name = *name;
+    file->config = *config;
+    file->source.path = source_path.to_string();
+
+    const uint32_t first_symbol = ReadLittleEndian32(record + 20);
+    const uint32_t symbol_count = ReadLittleEndian32(record + 24);
+    if (first_symbol > symbol_count_ || symbol_count > symbol_count_ - first_symbol) {
+      Corrupt("symbols out of bounds");
+      return {};
+    }
+
+    file->exported_symbols.reserve(symbol_count);
+    for (uint32_t i = first_symbol; i < first_symbol + symbol_count; i++) {
+      const uint8_t* symbol = symbols_ + i * kSymbolSize;
+      const ResourceName* symbol_name = GetResourceName(ReadLittleEndian32(symbol));
+      if (!symbol_name) {
+        return {};
+      }
+      file->exported_symbols.push_back(
+          SourcedResourceName{*symbol_name, ReadLittleEndian32(symbol + 4)});
+    }
+    return file;
+  }
+
+  Source source_;
+  IDiagnostics* diag_;
+
+  uint32_t string_count_ = 0u;
+  uint32_t symbol_count_ = 0u;
+  uint32_t string_data_size_ = 0u;
+  const uint8_t* string_offsets_ = nullptr;
+  const uint8_t* symbols_ = nullptr;
+  const uint8_t* string_data_ = nullptr;
+
+  // Parsed strings of the dictionary, keyed by their index.
+  std::unordered_map<uint32_t, ResourceName> names_;
+  std::unordered_map<uint32_t, ConfigDescription> configs_;
+};
+
+}  // namespace
+
+std::unique_ptr<IArchiveWriter> CreatePackedCompiledFileWriter(IDiagnostics* diag,
+                                                               const StringPiece& path) {
+  std::unique_ptr<PackedCompiledFileWriter> writer =
+      util::make_unique<PackedCompiledFileWriter>();
+  if (!writer->Open(path)) {
+    diag->Error(DiagMessage(path) << writer->GetError());
+    return {};
+  }
+  return std::move(writer);
+}
+
+bool IsPackedCompiledFiles(const void* data, size_t len) {
+  return len >= kHeaderSize &&
+         ReadLittleEndian32(static_cast<const uint8_t*>(data)) == kPackedMagic;
+}
+
+bool ReadPackedCompiledFiles(const void* data, size_t len, const Source& source,
+                             IDiagnostics* diag, std::vector<PackedCompiledFile>* out_files) {
+  PackedCompiledFileReader reader(source, diag);
+  return reader.Read(static_cast<const uint8_t*>(data), len, out_files);
+}
+
+}  // namespace aapt
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAPT_COMPILE_PACKEDCOMPILEDFILES_H
+#define AAPT_COMPILE_PACKEDCOMPILEDFILES_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "androidfw/StringPiece.h"
+
+#include "Diagnostics.h"
+#include "Resource.h"
+#include "Source.h"
+#include "flatten/Archive.h"
+
+namespace aapt {
+
+// A packed container holds the output of compiling a whole resource directory in one file, as an
+// alternative to a ZIP archive of .flat files. The headers of all compiled files are stored in one
+// index at the end of the container, and every string they use (resource names, configurations,
+// source paths and exported symbols) is stored once in a dictionary that the index refers to.
+// Reading a container doesn't parse any protobuf message, and the data of each compiled file is
+// stored uncompressed and 4 byte aligned, so it can be used directly from a mapping of the
+// container.
+//
+// All values are little endian:
+//
+//   Header   magic ("APCF"), version, index offset (64 bit), index size (64 bit)
+//   Data     the data of every compiled file and table
+//   Index    string count, record count, symbol count, string data size
+//            string offsets (string count + 1 of them; string i ends where string i + 1 starts)
+//            records, one per compiled file or table
+//            symbols, the exported symbols of every record
+//            string data
+
+// Creates an IArchiveWriter that packs the entries written to it into a container at `path`.
+// Entries must be compiled files (.flat) or compiled tables (.arsc.flat), written exactly as they
+// would be written to a ZIP archive.
+std::unique_ptr<IArchiveWriter> CreatePackedCompiledFileWriter(IDiagnostics* diag,
+                                                               const android::StringPiece& path);
+
+// Returns true if `data` starts like a packed container.
+bool IsPackedCompiledFiles(const void* data, size_t len);
+
+// A compiled file or table of a packed container.
+struct PackedCompiledFile {
+  // The path of the .flat or .arsc.flat entry that this came from.
+  std::string path;
+
+  // The header of a compiled file, or nullptr for a compiled table.
+  std::unique_ptr<ResourceFile> file;
+
+  // Where the data is within the container.
+  uint64_t offset = 0u;
+  uint64_t size = 0u;
+};
+
+// Reads the index of the packed container in `data`. Configurations and resource names that
+// several files share are only parsed once. Returns false and logs to `diag` if the container is
+// corrupt.
+bool ReadPackedCompiledFiles(const void* data, size_t len, const Source& source,
+                             IDiagnostics* diag, std::vector<PackedCompiledFile>* out_files);
+
+}  // namespace aapt
+
+#endif  // AAPT_COMPILE_PACKEDCOMPILEDFILES_H
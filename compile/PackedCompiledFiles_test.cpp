@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "compile/PackedCompiledFiles.h"
+
+#include <cstring>
+
+#include "android-base/file.h"
+#include "android-base/test_utils.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+
+#include "proto/ProtoSerialize.h"
+#include "test/Test.h"
+
+using ::google::protobuf::io::CopyingOutputStreamAdaptor;
+using ::testing::Eq;
+using ::testing::IsNull;
+using ::testing::NotNull;
+
+namespace aapt {
+
+static ResourceFile MakeResourceFile(const std::string& name, const std::string& config) {
+  ResourceFile file;
+  file.name = test::ParseNameOrDie(name);
+  file.config = test::ParseConfigOrDie(config);
+  file.source.path = "res/" + name + ".xml";
+  file.exported_symbols.push_back(SourcedResourceName{test::ParseNameOrDie("id/foo"), 3u});
+  file.exported_symbols.push_back(SourcedResourceName{test::ParseNameOrDie("id/bar"), 7u});
+  return file;
+}
+
+// Writes `files` to `writer` as one .flat entry, the way `aapt2 compile` does.
+static void WriteCompiledFiles(const std::string& path, const std::vector<ResourceFile>& files,
+                               const std::string& data, IArchiveWriter* writer) {
+  ASSERT_TRUE(writer->StartEntry(path, 0u));
+  {
+    CopyingOutputStreamAdaptor copying_adaptor(writer);
+    CompiledFileOutputStream output_stream(&copying_adaptor);
+    output_stream.WriteLittleEndian32(files.size());
+    for (const ResourceFile& file : files) {
+      std::unique_ptr<pb::internal::CompiledFile> pb_file = SerializeCompiledFileToPb(file);
+      output_stream.WriteCompiledFile(pb_file.get());
+      output_stream.WriteData(data.data(), data.size());
+    }
+    ASSERT_FALSE(output_stream.HadError());
+  }
+  ASSERT_TRUE(writer->FinishEntry());
+}
+
+static std::string GetData(const std::string& contents, const PackedCompiledFile& file) {
+  return contents.substr(file.offset, file.size);
+}
+
+TEST(PackedCompiledFilesTest, CompiledFilesAndTablesAreReadBack) {
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder().Build();
+  TemporaryFile packed_file;
+  std::unique_ptr<IArchiveWriter> writer =
+      CreatePackedCompiledFileWriter(context->GetDiagnostics(), packed_file.path);
+  ASSERT_THAT(writer, NotNull());
+
+  WriteCompiledFiles(
+      "layout-land_main.xml.flat",
+      {MakeResourceFile("layout/main", "land"), MakeResourceFile("layout/inline", "land")}, "main",
+      writer.get());
+  const std::string table = "table data";
+  ASSERT_TRUE(writer->StartEntry("values_strings.arsc.flat", 0u));
+  ASSERT_TRUE(writer->Write(table.data(), table.size()));
+  ASSERT_TRUE(writer->FinishEntry());
+  WriteCompiledFiles("layout_other.xml.flat", {MakeResourceFile("layout/other", "")}, "other!",
+                     writer.get());
+  ASSERT_TRUE(writer->Finish()) << writer->GetError();
+
+  std::string contents;
+  ASSERT_TRUE(android::base::ReadFileToString(packed_file.path, &contents));
+  ASSERT_TRUE(IsPackedCompiledFiles(contents.data(), contents.size()));
+
+  std::vector<PackedCompiledFile> files;
+  ASSERT_TRUE(ReadPackedCompiledFiles(contents.data(), contents.size(), Source(packed_file.path),
+                                      context->GetDiagnostics(), &files));
+  ASSERT_THAT(files.size(), Eq(4u));
+
+  EXPECT_THAT(files[0].path, Eq("layout-land_main.xml.flat"));
+  ASSERT_THAT(files[0].file, NotNull());
+  EXPECT_THAT(files[0].file->name, Eq(test::ParseNameOrDie("layout/main")));
+  EXPECT_THAT(files[0].file->config, Eq(test::ParseConfigOrDie("land")));
+  EXPECT_THAT(files[0].file->source.path, Eq("res/layout/main.xml"));
+  ASSERT_THAT(files[0].file->exported_symbols.size(), Eq(2u));
+  EXPECT_THAT(files[0].file->exported_symbols[0].name, Eq(test::ParseNameOrDie("id/foo")));
+  EXPECT_THAT(files[0].file->exported_symbols[0].line, Eq(3u));
+  EXPECT_THAT(files[0].file->exported_symbols[1].name, Eq(test::ParseNameOrDie("id/bar")));
+  EXPECT_THAT(files[0].file->exported_symbols[1].line, Eq(7u));
+  EXPECT_THAT(GetData(contents, files[0]), Eq("main"));
+  EXPECT_THAT(files[0].offset % 4u, Eq(0u));
+
+  EXPECT_THAT(files[1].path, Eq("layout-land_main.xml.flat"));
+  ASSERT_THAT(files[1].file, NotNull());
+  EXPECT_THAT(files[1].file->name, Eq(test::ParseNameOrDie("layout/inline")));
+  EXPECT_THAT(files[1].file->exported_symbols.size(), Eq(2u));
+  EXPECT_THAT(GetData(contents, files[1]), Eq("main"));
+
+  EXPECT_THAT(files[2].path, Eq("values_strings.arsc.flat"));
+  EXPECT_THAT(files[2].file, IsNull());
+  EXPECT_THAT(GetData(contents, files[2]), Eq(table));
+
+  EXPECT_THAT(files[3].path, Eq("layout_other.xml.flat"));
+  ASSERT_THAT(files[3].file, NotNull());
+  EXPECT_THAT(files[3].file->name, Eq(test::ParseNameOrDie("layout/other")));
+  EXPECT_THAT(files[3].file->config, Eq(ConfigDescription::DefaultConfig()));
+  EXPECT_THAT(GetData(contents, files[3]), Eq("other!"));
+  EXPECT_THAT(files[3].offset % 4u, Eq(0u));
+}
+
+TEST(PackedCompiledFilesTest, SharedStringsAreStoredOnce) {
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder().Build();
+  TemporaryFile one_file;
+  TemporaryFile two_files;
+  std::unique_ptr<IArchiveWriter> one_writer =
+      CreatePackedCompiledFileWriter(context->GetDiagnostics(), one_file.path);
+  std::unique_ptr<IArchiveWriter> two_writer =
+      CreatePackedCompiledFileWriter(context->GetDiagnostics(), two_files.path);
+  ASSERT_THAT(one_writer, NotNull());
+  ASSERT_THAT(two_writer, NotNull());
+
+  WriteCompiledFiles("a.flat", {MakeResourceFile("layout/a", "land")}, "data", one_writer.get());
+  WriteCompiledFiles("a.flat", {MakeResourceFile("layout/a", "land")}, "data", two_writer.get());
+  WriteCompiledFiles("b.flat", {MakeResourceFile("layout/b", "land")}, "data", two_writer.get());
+  ASSERT_TRUE(one_writer->Finish());
+  ASSERT_TRUE(two_writer->Finish());
+
+  std::string one_contents;
+  std::string two_contents;
+  ASSERT_TRUE(android::base::ReadFileToString(one_file.path, &one_contents));
+  ASSERT_TRUE(android::base::ReadFileToString(two_files.path, &two_contents));
+
+  // The second file only adds its data, its record and the strings that are its own: its path,
+  // name and source. The configuration and the exported symbols are shared.
+  const size_t record_size = 48u + 2u * 8u;
+  const size_t own_strings_size =
+      strlen("b.flat") + strlen("layout/b") + strlen("res/layout/b.xml");
+  EXPECT_THAT(two_contents.size() - one_contents.size(),
+              Eq(4u /* data */ + record_size + 3u * 4u /* string offsets */ + own_strings_size));
+}
+
+TEST(PackedCompiledFilesTest, CorruptIndexIsRejected) {
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder().Build();
+  TemporaryFile packed_file;
+  std::unique_ptr<IArchiveWriter> writer =
+      CreatePackedCompiledFileWriter(context->GetDiagnostics(), packed_file.path);
+  ASSERT_THAT(writer, NotNull());
+  WriteCompiledFiles("a.flat", {MakeResourceFile("layout/a", "")}, "data", writer.get());
+  ASSERT_TRUE(writer->Finish());
+
+  std::string contents;
+  ASSERT_TRUE(android::base::ReadFileToString(packed_file.path, &contents));
+
+  std::vector<PackedCompiledFile> files;
+  const std::string truncated = contents.substr(0u, contents.size() - 1u);
+  EXPECT_FALSE(ReadPackedCompiledFiles(truncated.data(), truncated.size(),
+                                       Source(packed_file.path), context->GetDiagnostics(),
+                                       &files));
+
+  const std::string zip = "PK\x03\x04 not a packed container";
+  EXPECT_FALSE(IsPackedCompiledFiles(zip.data(), zip.size()));
+}
+
+TEST(PackedCompiledFilesTest, OnlyCompiledFilesCanBePacked) {
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder().Build();
+  TemporaryFile packed_file;
+  std::unique_ptr<IArchiveWriter> writer =
+      CreatePackedCompiledFileWriter(context->GetDiagnostics(), packed_file.path);
+  ASSERT_THAT(writer, NotNull());
+
+  ASSERT_TRUE(writer->StartEntry("res/layout/main.xml", 0u));
+  EXPECT_FALSE(writer->FinishEntry());
+  EXPECT_TRUE(writer->HadError());
+  EXPECT_FALSE(writer->Finish());
+}
+
+}  // namespace aapt
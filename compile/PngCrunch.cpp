@@ -20,8 +20,12 @@
 #include <zlib.h>
 
 #include <algorithm>
-#include <unordered_map>
-#include <unordered_set>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "android-base/errors.h"
 #include "android-base/logging.h"
@@ -366,67 +370,269 @@ static int PickColorType(int32_t width, int32_t height, bool grayscale,
   return PNG_COLOR_TYPE_RGBA;
 }
 
-// Assigns indices to the color and alpha palettes, encodes them, and then invokes
-// png_set_PLTE/png_set_tRNS.
-// This must be done before writing image data.
-// Image data must be transformed to use the indices assigned within the palette.
-static void WritePalette(png_structp write_ptr, png_infop write_info_ptr,
-                         std::unordered_map<uint32_t, int>* color_palette,
-                         std::unordered_set<uint32_t>* alpha_palette) {
-  CHECK(color_palette->size() <= 256);
-  CHECK(alpha_palette->size() <= 256);
+// The maximum number of colors a PNG palette can hold.
+constexpr static const size_t kMaxPaletteSize = 256u;
 
-  // Populate the PNG palette struct and assign indices to the color palette.
+// Properties of the image that decide which color types it can be encoded with.
+// For the purposes of palettes and grayscale optimization, the color channels of
+// completely transparent pixels are treated as 0x00.
+struct ImageStats {
+  // Whether some pixel has R != G or R != B.
+  bool has_non_gray_pixels = false;
 
-  // Colors in the alpha palette should have smaller indices.
-  // This will ensure that we can truncate the alpha palette if it is
-  // smaller than the color palette.
-  int index = 0;
-  for (uint32_t color : *alpha_palette) {
-    (*color_palette)[color] = index++;
+  // Whether some pixel has A != 255.
+  bool has_translucent_pixels = false;
+
+  // Whether some pixel has A == 0 but non-zero color channels.
+  bool has_colored_transparent_pixels = false;
+
+  // The largest difference between two color channels of a pixel.
+  int max_gray_deviation = 0;
+};
+
+#if defined(__SSE2__)
+// Returns the absolute difference of each unsigned byte of `a` and `b`.
+static inline __m128i AbsDiffEpu8(__m128i a, __m128i b) {
+  return _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+}
+
+// Accumulates the ImageStats of `count` RGBA pixels, a multiple of 4, four pixels at a time.
+static void AnalyzePixelsSse2(const uint8_t* pixels, int32_t count, ImageStats* stats) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i alpha_mask = _mm_set1_epi32(static_cast<int>(0xff000000u));
+  const __m128i color_mask = _mm_set1_epi32(0x00ffffff);
+  const __m128i low_byte_mask = _mm_set1_epi32(0x000000ff);
+  const __m128i low_two_bytes_mask = _mm_set1_epi32(0x0000ffff);
+
+  __m128i max_deviation = zero;
+  __m128i min_channels = _mm_set1_epi8(static_cast<char>(0xff));
+  __m128i colored_transparent = zero;
+  for (int32_t x = 0; x < count; x += 4) {
+    // Each 32-bit lane holds a pixel, with R, G, B and A in bytes 0 to 3.
+    const __m128i rgba = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + x * 4));
+
+    // All ones in the lanes of completely transparent pixels.
+    const __m128i transparent = _mm_cmpeq_epi32(_mm_and_si128(rgba, alpha_mask), zero);
+    colored_transparent =
+        _mm_or_si128(colored_transparent, _mm_and_si128(_mm_and_si128(rgba, transparent),
+                                                        color_mask));
+    min_channels = _mm_min_epu8(min_channels, rgba);
+
+    // Lining the pixels up with themselves shifted by one and two channels puts |R - G| and
+    // |G - B| in bytes 0 and 1 of the first difference, and |R - B| in byte 0 of the second.
+    const __m128i visible = _mm_andnot_si128(transparent, rgba);
+    const __m128i next_deviation =
+        _mm_and_si128(AbsDiffEpu8(visible, _mm_srli_epi32(visible, 8)), low_two_bytes_mask);
+    const __m128i skip_deviation =
+        _mm_and_si128(AbsDiffEpu8(visible, _mm_srli_epi32(visible, 16)), low_byte_mask);
+    max_deviation = _mm_max_epu8(max_deviation, _mm_max_epu8(next_deviation, skip_deviation));
+  }
+
+  uint8_t deviations[16];
+  uint8_t channels[16];
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(deviations), max_deviation);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(channels), min_channels);
+  int max_gray_deviation = 0;
+  int min_alpha = 0xff;
+  for (int i = 0; i < 16; i++) {
+    max_gray_deviation = std::max<int>(max_gray_deviation, deviations[i]);
+    if (i % 4 == 3) {
+      min_alpha = std::min<int>(min_alpha, channels[i]);
+    }
   }
 
-  // Assign the rest of the entries.
-  for (auto& entry : *color_palette) {
-    if (entry.second == -1) {
-      entry.second = index++;
+  // A pixel is gray exactly when none of its channels deviate.
+  stats->max_gray_deviation = std::max(stats->max_gray_deviation, max_gray_deviation);
+  stats->has_non_gray_pixels |= max_gray_deviation != 0;
+  stats->has_translucent_pixels |= min_alpha != 0xff;
+  stats->has_colored_transparent_pixels |=
+      _mm_movemask_epi8(_mm_cmpeq_epi8(colored_transparent, zero)) != 0xffff;
+}
+#endif
+
+// Accumulates the ImageStats of a row of RGBA pixels.
+// This runs over every pixel of every PNG we compile. With SSE2, which every x86-64 host has,
+// four pixels are analyzed at a time. The remaining pixels, or all of them on other hosts, are
+// analyzed with branch-free arithmetic that the compiler can vectorize.
+static void AnalyzeRow(const uint8_t* row, int32_t width, ImageStats* stats) {
+  int32_t x = 0;
+#if defined(__SSE2__)
+  x = width & ~3;
+  AnalyzePixelsSse2(row, x, stats);
+#endif
+
+  int max_gray_deviation = stats->max_gray_deviation;
+  int non_gray = 0;
+  int min_alpha = 0xff;
+  int colored_transparent = 0;
+  for (; x < width; x++) {
+    const int red = row[x * 4];
+    const int green = row[x * 4 + 1];
+    const int blue = row[x * 4 + 2];
+    const int alpha = row[x * 4 + 3];
+
+    // All ones when the pixel is visible, zero when it is completely transparent.
+    const int visible_mask = -static_cast<int>(alpha != 0);
+    const int rr = red & visible_mask;
+    const int gg = green & visible_mask;
+    const int bb = blue & visible_mask;
+
+    colored_transparent |= (red | green | blue) & ~visible_mask;
+    non_gray |= (rr ^ gg) | (rr ^ bb);
+    min_alpha = std::min(min_alpha, alpha);
+
+    max_gray_deviation = std::max(std::abs(rr - gg), max_gray_deviation);
+    max_gray_deviation = std::max(std::abs(gg - bb), max_gray_deviation);
+    max_gray_deviation = std::max(std::abs(bb - rr), max_gray_deviation);
+  }
+
+  stats->max_gray_deviation = max_gray_deviation;
+  stats->has_non_gray_pixels |= non_gray != 0;
+  stats->has_translucent_pixels |= min_alpha != 0xff;
+  stats->has_colored_transparent_pixels |= colored_transparent != 0;
+}
+
+// The distinct colors of an image in the order in which they first appear, up to the
+// kMaxPaletteSize colors that a PNG palette can hold. Colors are found through a small
+// open-addressed hash table, which is much cheaper than a std::unordered_map for so few colors.
+class ColorPalette {
+ public:
+  ColorPalette() {
+    memset(slots_, 0, sizeof(slots_));
+    colors_.reserve(kMaxPaletteSize);
+  }
+
+  // Adds `color` if it isn't in the palette yet. Returns false if the palette is full.
+  bool Insert(uint32_t color) {
+    uint16_t* slot = &slots_[FindSlot(color)];
+    if (*slot != 0u) {
+      return true;
+    } else if (colors_.size() == kMaxPaletteSize) {
+      return false;
     }
+    colors_.push_back(color);
+    *slot = static_cast<uint16_t>(colors_.size());
+    return true;
+  }
+
+  // Returns the position of `color` in colors(), or -1 if it isn't in the palette.
+  int Find(uint32_t color) const {
+    return static_cast<int>(slots_[FindSlot(color)]) - 1;
   }
 
-  // Create the PNG color palette struct.
-  auto color_palette_bytes = std::unique_ptr<png_color[]>(new png_color[color_palette->size()]);
+  const std::vector<uint32_t>& colors() const {
+    return colors_;
+  }
 
-  std::unique_ptr<png_byte[]> alpha_palette_bytes;
-  if (!alpha_palette->empty()) {
-    alpha_palette_bytes = std::unique_ptr<png_byte[]>(new png_byte[alpha_palette->size()]);
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ColorPalette);
+
+  // Twice as many slots as colors keeps the probe sequences short.
+  static constexpr const int kSlotBits = 9;
+  static constexpr const size_t kSlotCount = 1u << kSlotBits;
+  static_assert(kSlotCount == 2u * kMaxPaletteSize, "palette hash table size");
+
+  // Returns the slot that holds `color`, or the empty slot where it belongs.
+  size_t FindSlot(uint32_t color) const {
+    size_t slot = (color * 0x9e3779b1u) >> (32 - kSlotBits);
+    while (slots_[slot] != 0u && colors_[slots_[slot] - 1u] != color) {
+      slot = (slot + 1u) & (kSlotCount - 1u);
+    }
+    return slot;
   }
 
-  for (const auto& entry : *color_palette) {
-    const uint32_t color = entry.first;
-    const int index = entry.second;
-    CHECK(index >= 0);
-    CHECK(static_cast<size_t>(index) < color_palette->size());
+  // The position of the color in colors_ plus one, or 0 for an empty slot.
+  uint16_t slots_[kSlotCount];
+  std::vector<uint32_t> colors_;
+};
 
-    png_colorp slot = color_palette_bytes.get() + index;
-    slot->red = color >> 24;
-    slot->green = color >> 16;
-    slot->blue = color >> 8;
+// Collects the distinct colors of the image into `palette`.
+// Returns false, leaving the palette incomplete, as soon as there are more colors than a PNG
+// palette can hold, since the palette is of no use after that.
+static bool CollectPalette(const Image* image, ColorPalette* palette) {
+  // Neighbouring pixels are very often the same color, so skip the hash lookup for runs.
+  bool has_last_color = false;
+  uint32_t last_color = 0;
+  for (int32_t y = 0; y < image->height; y++) {
+    const uint8_t* row = image->rows[y];
+    for (int32_t x = 0; x < image->width; x++) {
+      int red = *row++;
+      int green = *row++;
+      int blue = *row++;
+      int alpha = *row++;
 
-    const png_byte alpha = color & 0x000000ff;
-    if (alpha != 0xff && alpha_palette_bytes) {
-      CHECK(static_cast<size_t>(index) < alpha_palette->size());
-      alpha_palette_bytes[index] = alpha;
+      if (alpha == 0) {
+        // The color is completely transparent.
+        red = green = blue = 0;
+      }
+
+      const uint32_t color = red << 24 | green << 16 | blue << 8 | alpha;
+      if (has_last_color && color == last_color) {
+        continue;
+      }
+      has_last_color = true;
+      last_color = color;
+
+      if (!palette->Insert(color)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Returns the number of colors in `palette` that aren't opaque, which make up the alpha palette.
+static size_t CountAlphaPaletteColors(const ColorPalette& palette) {
+  return std::count_if(palette.colors().begin(), palette.colors().end(),
+                       [](uint32_t color) { return (color & 0x000000ff) != 0xff; });
+}
+
+// Assigns indices to the colors of the palette, encodes the color and alpha palettes, and then
+// invokes png_set_PLTE/png_set_tRNS. Sets `out_indices` to the index assigned to each color of
+// palette.colors().
+// This must be done before writing image data.
+// Image data must be transformed to use the indices assigned within the palette.
+static void WritePalette(png_structp write_ptr, png_infop write_info_ptr,
+                         const ColorPalette& palette, std::vector<png_byte>* out_indices) {
+  const std::vector<uint32_t>& colors = palette.colors();
+  CHECK(colors.size() <= kMaxPaletteSize);
+
+  auto color_palette_bytes = std::unique_ptr<png_color[]>(new png_color[colors.size()]);
+  std::vector<png_byte> alpha_palette_bytes;
+  out_indices->resize(colors.size());
+
+  // Colors in the alpha palette should have smaller indices.
+  // This will ensure that we can truncate the alpha palette if it is
+  // smaller than the color palette. Both groups keep the order in which
+  // the colors appear, so the output doesn't depend on hashing.
+  size_t index = 0;
+  for (const bool translucent : {true, false}) {
+    for (size_t i = 0; i < colors.size(); i++) {
+      const uint32_t color = colors[i];
+      const png_byte alpha = color & 0x000000ff;
+      if ((alpha != 0xff) != translucent) {
+        continue;
+      }
+
+      png_colorp slot = color_palette_bytes.get() + index;
+      slot->red = color >> 24;
+      slot->green = color >> 16;
+      slot->blue = color >> 8;
+      if (translucent) {
+        alpha_palette_bytes.push_back(alpha);
+      }
+      (*out_indices)[i] = static_cast<png_byte>(index++);
     }
   }
 
   // The bytes get copied here, so it is safe to release color_palette_bytes at
   // the end of function
   // scope.
-  png_set_PLTE(write_ptr, write_info_ptr, color_palette_bytes.get(), color_palette->size());
+  png_set_PLTE(write_ptr, write_info_ptr, color_palette_bytes.get(), colors.size());
 
-  if (alpha_palette_bytes) {
-    png_set_tRNS(write_ptr, write_info_ptr, alpha_palette_bytes.get(), alpha_palette->size(),
-                 nullptr);
+  if (!alpha_palette_bytes.empty()) {
+    png_set_tRNS(write_ptr, write_info_ptr, alpha_palette_bytes.data(),
+                 alpha_palette_bytes.size(), nullptr);
   }
 }
 
@@ -521,60 +727,36 @@ bool WritePng(IAaptContext* context, const Image* image,
   // 1. Every pixel has R == G == B (grayscale)
   // 2. Every pixel has A == 255 (opaque)
   // 3. There are no more than 256 distinct RGBA colors (palette).
-  std::unordered_map<uint32_t, int> color_palette;
-  std::unordered_set<uint32_t> alpha_palette;
-  bool needs_to_zero_rgb_channels_of_transparent_pixels = false;
-  bool grayscale = true;
-  int max_gray_deviation = 0;
-
+  ImageStats stats;
   for (int32_t y = 0; y < image->height; y++) {
-    const uint8_t* row = image->rows[y];
-    for (int32_t x = 0; x < image->width; x++) {
-      int red = *row++;
-      int green = *row++;
-      int blue = *row++;
-      int alpha = *row++;
-
-      if (alpha == 0) {
-        // The color is completely transparent.
-        // For purposes of palettes and grayscale optimization,
-        // treat all channels as 0x00.
-        needs_to_zero_rgb_channels_of_transparent_pixels =
-            needs_to_zero_rgb_channels_of_transparent_pixels ||
-            (red != 0 || green != 0 || blue != 0);
-        red = green = blue = 0;
-      }
-
-      // Insert the color into the color palette.
-      const uint32_t color = red << 24 | green << 16 | blue << 8 | alpha;
-      color_palette[color] = -1;
+    AnalyzeRow(image->rows[y], image->width, &stats);
+  }
 
-      // If the pixel has non-opaque alpha, insert it into the
-      // alpha palette.
-      if (alpha != 0xff) {
-        alpha_palette.insert(color);
-      }
+  const bool grayscale = !stats.has_non_gray_pixels;
+  const bool needs_to_zero_rgb_channels_of_transparent_pixels =
+      stats.has_colored_transparent_pixels;
+  const int max_gray_deviation = stats.max_gray_deviation;
 
-      // Check if the image is indeed grayscale.
-      if (grayscale) {
-        if (red != green || red != blue) {
-          grayscale = false;
-        }
-      }
+  // 9-patch images are never encoded with a palette (see PickColorType), so don't bother
+  // collecting one for them.
+  ColorPalette palette;
+  const bool fits_in_palette = nine_patch == nullptr && CollectPalette(image, &palette);
 
-      // Calculate the gray scale deviation so that it can be compared
-      // with the threshold.
-      max_gray_deviation = std::max(std::abs(red - green), max_gray_deviation);
-      max_gray_deviation = std::max(std::abs(green - blue), max_gray_deviation);
-      max_gray_deviation = std::max(std::abs(blue - red), max_gray_deviation);
-    }
-  }
+  // When the colors don't fit in a palette, the only thing that matters about the alpha
+  // palette is whether it is empty.
+  const size_t color_palette_size = fits_in_palette ? palette.colors().size() : kMaxPaletteSize + 1;
+  const size_t alpha_palette_size = fits_in_palette ? CountAlphaPaletteColors(palette)
+                                                    : (stats.has_translucent_pixels ? 1u : 0u);
 
   if (context->IsVerbose()) {
     DiagMessage msg;
-    msg << " paletteSize=" << color_palette.size()
-        << " alphaPaletteSize=" << alpha_palette.size()
-        << " maxGrayDeviation=" << max_gray_deviation
+    msg << " paletteSize=";
+    if (fits_in_palette) {
+      msg << color_palette_size << " alphaPaletteSize=" << alpha_palette_size;
+    } else {
+      msg << ">" << kMaxPaletteSize;
+    }
+    msg << " maxGrayDeviation=" << max_gray_deviation
         << " grayScale=" << (grayscale ? "true" : "false");
     context->GetDiagnostics()->Note(msg);
   }
@@ -583,7 +765,7 @@ bool WritePng(IAaptContext* context, const Image* image,
 
   const int new_color_type = PickColorType(
       image->width, image->height, grayscale, convertible_to_grayscale,
-      nine_patch != nullptr, color_palette.size(), alpha_palette.size());
+      nine_patch != nullptr, color_palette_size, alpha_palette_size);
 
   if (context->IsVerbose()) {
     DiagMessage msg;
@@ -618,10 +800,11 @@ bool WritePng(IAaptContext* context, const Image* image,
                new_color_type, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
                PNG_FILTER_TYPE_DEFAULT);
 
+  std::vector<png_byte> palette_indices;
   if (new_color_type & PNG_COLOR_MASK_PALETTE) {
     // Assigns indices to the palette, and writes the encoded palette to the
     // libpng writePtr.
-    WritePalette(write_ptr, write_info_ptr, &color_palette, &alpha_palette);
+    WritePalette(write_ptr, write_info_ptr, palette, &palette_indices);
     png_set_filter(write_ptr, 0, PNG_NO_FILTERS);
   } else {
     png_set_filter(write_ptr, 0, PNG_ALL_FILTERS);
@@ -639,6 +822,9 @@ bool WritePng(IAaptContext* context, const Image* image,
     // 1 byte/pixel.
     auto out_row = std::unique_ptr<png_byte[]>(new png_byte[image->width]);
 
+    // Neighbouring pixels are very often the same color, so remember the last lookup.
+    uint32_t last_color = 0;
+    int last_idx = -1;
     for (int32_t y = 0; y < image->height; y++) {
       png_const_bytep in_row = image->rows[y];
       for (int32_t x = 0; x < image->width; x++) {
@@ -652,9 +838,13 @@ bool WritePng(IAaptContext* context, const Image* image,
         }
 
         const uint32_t color = rr << 24 | gg << 16 | bb << 8 | aa;
-        const int idx = color_palette[color];
-        CHECK(idx != -1);
-        out_row[x] = static_cast<png_byte>(idx);
+        if (last_idx == -1 || color != last_color) {
+          const int position = palette.Find(color);
+          CHECK(position != -1);
+          last_color = color;
+          last_idx = palette_indices[position];
+        }
+        out_row[x] = static_cast<png_byte>(last_idx);
       }
       png_write_row(write_ptr, out_row.get());
     }
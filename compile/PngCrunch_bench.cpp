@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "compile/Png.h"
+
+#include <random>
+
+#include "benchmark/benchmark.h"
+
+#include "io/BigBufferOutputStream.h"
+#include "test/Context.h"
+#include "util/BigBuffer.h"
+
+namespace aapt {
+
+// The kinds of images that end up with each of the color types WritePng picks from.
+enum class ImageKind {
+  // A gray gradient, like a shadow.
+  kGray,
+  // A handful of flat colors, like an icon.
+  kFewColors,
+  // Noise on a color gradient, like a photograph.
+  kManyColors,
+};
+
+// Returns a square image of `size` pixels per side.
+static std::unique_ptr<Image> MakeImage(ImageKind kind, int32_t size) {
+  const uint32_t kFlatColors[] = {0xffffffff, 0x3f51b5ff, 0xff4081ff, 0x00000000, 0x3f51b580};
+
+  std::unique_ptr<Image> image = util::make_unique<Image>();
+  image->width = size;
+  image->height = size;
+  image->data = std::unique_ptr<uint8_t[]>(new uint8_t[size * size * 4]);
+  image->rows = std::unique_ptr<uint8_t* []>(new uint8_t*[size]);
+
+  std::mt19937 random(size);
+  for (int32_t y = 0; y < size; y++) {
+    uint8_t* row = image->rows[y] = image->data.get() + y * size * 4;
+    for (int32_t x = 0; x < size; x++) {
+      uint32_t color = 0;
+      switch (kind) {
+        case ImageKind::kGray: {
+          const uint32_t gray = (x + y) * 255 / (2 * size);
+          color = gray << 24 | gray << 16 | gray << 8 | 0xff;
+          break;
+        }
+        case ImageKind::kFewColors:
+          // Runs of a few pixels, as the edges of shapes produce.
+          color = kFlatColors[((x / 8) ^ (y / 8)) % 5];
+          break;
+        case ImageKind::kManyColors:
+          color = ((x * 255 / size) << 24 | (y * 255 / size) << 16) ^ (random() & 0x0f0f0f00u);
+          color |= 0xff;
+          break;
+      }
+      row[x * 4] = color >> 24;
+      row[x * 4 + 1] = color >> 16;
+      row[x * 4 + 2] = color >> 8;
+      row[x * 4 + 3] = color;
+    }
+  }
+  return image;
+}
+
+static void BM_WritePng(benchmark::State& state, ImageKind kind) {
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder().Build();
+  std::unique_ptr<Image> image = MakeImage(kind, state.range(0));
+
+  while (state.KeepRunning()) {
+    BigBuffer buffer(4096);
+    io::BigBufferOutputStream out(&buffer);
+    if (!WritePng(context.get(), image.get(), nullptr, &out, PngOptions{})) {
+      state.SkipWithError("failed to write PNG");
+      break;
+    }
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * image->width *
+                          image->height * 4);
+}
+BENCHMARK_CAPTURE(BM_WritePng, gray, ImageKind::kGray)->Range(48, 1024);
+BENCHMARK_CAPTURE(BM_WritePng, few_colors, ImageKind::kFewColors)->Range(48, 1024);
+BENCHMARK_CAPTURE(BM_WritePng, many_colors, ImageKind::kManyColors)->Range(48, 1024);
+
+}  // namespace aapt
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "compile/Png.h"
+
+#include <png.h>
+
+#include <functional>
+#include <random>
+
+#include "io/BigBufferOutputStream.h"
+#include "io/StringInputStream.h"
+#include "test/Test.h"
+
+using ::testing::Eq;
+using ::testing::Gt;
+using ::testing::NotNull;
+
+namespace aapt {
+
+// Returns a `width` by `height` image whose pixels are `pixel_func(x, y)`, as 0xRRGGBBAA.
+static std::unique_ptr<Image> MakeImage(
+    int32_t width, int32_t height, const std::function<uint32_t(int32_t, int32_t)>& pixel_func) {
+  std::unique_ptr<Image> image = util::make_unique<Image>();
+  image->width = width;
+  image->height = height;
+  image->data = std::unique_ptr<uint8_t[]>(new uint8_t[width * height * 4]);
+  image->rows = std::unique_ptr<uint8_t* []>(new uint8_t*[height]);
+  for (int32_t y = 0; y < height; y++) {
+    image->rows[y] = image->data.get() + y * width * 4;
+    for (int32_t x = 0; x < width; x++) {
+      const uint32_t color = pixel_func(x, y);
+      image->rows[y][x * 4] = color >> 24;
+      image->rows[y][x * 4 + 1] = color >> 16;
+      image->rows[y][x * 4 + 2] = color >> 8;
+      image->rows[y][x * 4 + 3] = color;
+    }
+  }
+  return image;
+}
+
+static std::string WritePngToString(IAaptContext* context, const Image& image) {
+  BigBuffer buffer(4096);
+  {
+    io::BigBufferOutputStream out(&buffer);
+    EXPECT_TRUE(WritePng(context, &image, nullptr, &out, PngOptions{}));
+  }
+
+  std::string png;
+  for (const auto& block : buffer) {
+    png.append(reinterpret_cast<const char*>(block.buffer.get()), block.size);
+  }
+  return png;
+}
+
+// Returns the color type in the IHDR chunk, which always comes right after the signature.
+static int GetColorType(const std::string& png) {
+  const size_t kColorTypeOffset = kPngSignatureSize + 8u /* chunk header */ + 9u;
+  EXPECT_THAT(png.size(), Gt(kColorTypeOffset));
+  return static_cast<uint8_t>(png[kColorTypeOffset]);
+}
+
+// Expects that `png` decodes to exactly the pixels of `image`. The color channels of completely
+// transparent pixels aren't compared, since the encoder is free to change them.
+static void ExpectDecodesTo(IAaptContext* context, const std::string& png, const Image& image) {
+  io::StringInputStream in(png);
+  std::unique_ptr<Image> decoded = ReadPng(context, Source("test.png"), &in);
+  ASSERT_THAT(decoded, NotNull());
+  ASSERT_THAT(decoded->width, Eq(image.width));
+  ASSERT_THAT(decoded->height, Eq(image.height));
+  for (int32_t y = 0; y < image.height; y++) {
+    for (int32_t x = 0; x < image.width; x++) {
+      const uint8_t* expected = image.rows[y] + x * 4;
+      const uint8_t* actual = decoded->rows[y] + x * 4;
+      const int first_channel = expected[3] == 0 ? 3 : 0;
+      for (int c = first_channel; c < 4; c++) {
+        ASSERT_THAT(actual[c], Eq(expected[c])) << "pixel (" << x << ", " << y << ") channel " << c;
+      }
+    }
+  }
+}
+
+TEST(PngCrunchTest, GrayImagesAreEncodedAsGray) {
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder().Build();
+
+  // An odd width puts pixels on both sides of each group of four that are analyzed together.
+  std::unique_ptr<Image> image = MakeImage(67, 33, [](int32_t x, int32_t y) -> uint32_t {
+    const uint32_t gray = (x * 7 + y * 3) & 0xff;
+    return gray << 24 | gray << 16 | gray << 8 | 0xff;
+  });
+  std::string png = WritePngToString(context.get(), *image);
+  EXPECT_THAT(GetColorType(png), Eq(PNG_COLOR_TYPE_GRAY));
+  ExpectDecodesTo(context.get(), png, *image);
+
+  // The color channels of completely transparent pixels don't count.
+  image->rows[5][66 * 4] = 0xff;
+  image->rows[5][66 * 4 + 3] = 0x00;
+  png = WritePngToString(context.get(), *image);
+  EXPECT_THAT(GetColorType(png), Eq(PNG_COLOR_TYPE_GRAY_ALPHA));
+  ExpectDecodesTo(context.get(), png, *image);
+}
+
+TEST(PngCrunchTest, OneColoredPixelMakesTheImageRgb) {
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder().Build();
+
+  // Put the colored pixel in each position of a group of four, and in the pixels after the last
+  // group.
+  for (int32_t colored_x = 0; colored_x < 7; colored_x++) {
+    std::unique_ptr<Image> image = MakeImage(7, 40, [&](int32_t x, int32_t y) -> uint32_t {
+      if (x == colored_x && y == 20) {
+        return 0x102030ff;
+      }
+      const uint32_t gray = (x * 31 + y * 17) & 0xff;
+      return gray << 24 | gray << 16 | gray << 8 | 0xff;
+    });
+    const std::string png = WritePngToString(context.get(), *image);
+    EXPECT_THAT(GetColorType(png), Eq(PNG_COLOR_TYPE_RGB)) << "colored pixel at " << colored_x;
+    ExpectDecodesTo(context.get(), png, *image);
+  }
+}
+
+TEST(PngCrunchTest, ImagesWithFewColorsAreEncodedWithAPalette) {
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder().Build();
+
+  const uint32_t colors[] = {0xff0000ff, 0x00ff0080, 0x0000ffff, 0x12345600, 0xabcdef01};
+  std::mt19937 random(42u);
+  std::unique_ptr<Image> image = MakeImage(256, 256, [&](int32_t, int32_t) -> uint32_t {
+    return colors[random() % 5u];
+  });
+  const std::string png = WritePngToString(context.get(), *image);
+  EXPECT_THAT(GetColorType(png), Eq(PNG_COLOR_TYPE_PALETTE));
+  ExpectDecodesTo(context.get(), png, *image);
+}
+
+TEST(PngCrunchTest, PaletteHoldsAtMost256Colors) {
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder().Build();
+
+  for (uint32_t color_count : {256u, 257u}) {
+    std::unique_ptr<Image> image = MakeImage(256, 256, [&](int32_t x, int32_t y) -> uint32_t {
+      const uint32_t i = static_cast<uint32_t>(y * 256 + x) % color_count;
+      return i << 8 | 0xff;
+    });
+    const std::string png = WritePngToString(context.get(), *image);
+    EXPECT_THAT(GetColorType(png),
+                Eq(color_count <= 256u ? PNG_COLOR_TYPE_PALETTE : PNG_COLOR_TYPE_RGB))
+        << color_count << " colors";
+    ExpectDecodesTo(context.get(), png, *image);
+  }
+}
+
+TEST(PngCrunchTest, ImagesWithManyColorsAreEncodedAsRgbOrRgba) {
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder().Build();
+
+  std::mt19937 random(7u);
+  std::unique_ptr<Image> image =
+      MakeImage(61, 45, [&](int32_t, int32_t) -> uint32_t { return random() | 0xff; });
+  std::string png = WritePngToString(context.get(), *image);
+  EXPECT_THAT(GetColorType(png), Eq(PNG_COLOR_TYPE_RGB));
+  ExpectDecodesTo(context.get(), png, *image);
+
+  image->rows[44][60 * 4 + 3] = 0x80;
+  png = WritePngToString(context.get(), *image);
+  EXPECT_THAT(GetColorType(png), Eq(PNG_COLOR_TYPE_RGB_ALPHA));
+  ExpectDecodesTo(context.get(), png, *image);
+}
+
+}  // namespace aapt
@@ -36,6 +36,7 @@ void AxisConfigFilter::AddConfig(ConfigDescription config) {
 
   configs_.insert(std::make_pair(config, diff_mask));
   config_mask_ |= diff_mask;
+  match_cache_.clear();
 }
 
 // Returns true if the locale script of the config should be considered matching
@@ -76,6 +77,14 @@ static bool ScriptsMatch(const ConfigDescription& config, const ConfigDescriptio
 }
 
 bool AxisConfigFilter::Match(const ConfigDescription& config) const {
+  auto iter = match_cache_.find(config);
+  if (iter == match_cache_.end()) {
+    iter = match_cache_.insert(std::make_pair(config, MatchAxes(config))).first;
+  }
+  return iter->second;
+}
+
+bool AxisConfigFilter::MatchAxes(const ConfigDescription& config) const {
   const uint32_t mask = ConfigDescription::DefaultConfig().diff(config);
   if ((config_mask_ & mask) == 0) {
     // The two configurations don't have any common axis.
@@ -18,6 +18,7 @@
 #define AAPT_FILTER_CONFIGFILTER_H
 
 #include <set>
+#include <unordered_map>
 #include <utility>
 
 #include "ConfigDescription.h"
@@ -55,8 +56,14 @@ class AxisConfigFilter : public IConfigFilter {
   bool Match(const ConfigDescription& config) const override;
 
  private:
+  bool MatchAxes(const ConfigDescription& config) const;
+
   std::set<std::pair<ConfigDescription, uint32_t>> configs_;
   uint32_t config_mask_ = 0;
+
+  // Match() is called for every value in a table, but there are only a handful of distinct
+  // configs, so the result is computed once per config.
+  mutable std::unordered_map<ConfigDescription, bool> match_cache_;
 };
 
 }  // namespace aapt
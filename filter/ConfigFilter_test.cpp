@@ -41,6 +41,16 @@ TEST(ConfigFilterTest, MatchesConfigWithSameValueAxis) {
   EXPECT_TRUE(filter.Match(test::ParseConfigOrDie("fr")));
 }
 
+TEST(ConfigFilterTest, AddingConfigAfterMatchUpdatesResult) {
+  AxisConfigFilter filter;
+  filter.AddConfig(test::ParseConfigOrDie("fr"));
+  EXPECT_FALSE(filter.Match(test::ParseConfigOrDie("de")));
+  EXPECT_FALSE(filter.Match(test::ParseConfigOrDie("de")));
+
+  filter.AddConfig(test::ParseConfigOrDie("de"));
+  EXPECT_TRUE(filter.Match(test::ParseConfigOrDie("de")));
+}
+
 TEST(ConfigFilterTest, MatchesConfigWithSameValueAxisAndOtherUnrelatedAxis) {
   AxisConfigFilter filter;
   filter.AddConfig(test::ParseConfigOrDie("fr"));
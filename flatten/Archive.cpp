@@ -16,7 +16,15 @@
 
 #include "flatten/Archive.h"
 
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <algorithm>
 #include <cstdio>
+#include <limits>
 #include <memory>
 #include <string>
 #include <vector>
@@ -26,6 +34,7 @@
 #include "android-base/utf8.h"
 #include "androidfw/StringPiece.h"
 #include "ziparchive/zip_writer.h"
+#include "zlib.h"
 
 #include "util/Files.h"
 
@@ -120,7 +129,7 @@ class DirectoryWriter : public IArchiveWriter {
 
 class ZipFileWriter : public IArchiveWriter {
  public:
-  ZipFileWriter() = default;
+  explicit ZipFileWriter(ArchiveAlignment alignment) : alignment_(alignment) {}
 
   bool Open(const StringPiece& path) {
     file_ = {::android::base::utf8::fopen(path.to_string().c_str(), "w+b"), fclose};
@@ -142,11 +151,15 @@ class ZipFileWriter : public IArchiveWriter {
       zip_flags |= ZipWriter::kCompress;
     }
 
-    if (flags & ArchiveEntry::kAlign) {
-      zip_flags |= ZipWriter::kAlign32;
+    int32_t result;
+    if ((flags & ArchiveEntry::kCompress) == 0 && alignment_ == ArchiveAlignment::kPage) {
+      result = writer_->StartAlignedEntry(path.data(), zip_flags, kArchivePageSize);
+    } else {
+      if (flags & ArchiveEntry::kAlign) {
+        zip_flags |= ZipWriter::kAlign32;
+      }
+      result = writer_->StartEntry(path.data(), zip_flags);
     }
-
-    int32_t result = writer_->StartEntry(path.data(), zip_flags);
     if (result != 0) {
       error_ = ZipWriter::ErrorCodeString(result);
       return false;
@@ -221,6 +234,25 @@ class ZipFileWriter : public IArchiveWriter {
     }
   }
 
+  bool Finish() override {
+    if (!writer_) {
+      return file_ != nullptr && !HadError();
+    }
+
+    int32_t result = writer_->Finish();
+    writer_.reset();
+    if (result != 0) {
+      error_ = ZipWriter::ErrorCodeString(result);
+      return false;
+    }
+
+    if (fflush(file_.get()) != 0) {
+      error_ = SystemErrorCodeToString(errno);
+      return false;
+    }
+    return !HadError();
+  }
+
   bool HadError() const override { return !error_.empty(); }
 
   std::string GetError() const override { return error_; }
@@ -234,11 +266,436 @@ class ZipFileWriter : public IArchiveWriter {
  private:
   DISALLOW_COPY_AND_ASSIGN(ZipFileWriter);
 
+  ArchiveAlignment alignment_;
   std::unique_ptr<FILE, decltype(fclose)*> file_ = {nullptr, fclose};
   std::unique_ptr<ZipWriter> writer_;
   std::string error_;
 };
 
+// The sizes of the fixed parts of the ZIP records this writer emits.
+constexpr size_t kLocalFileHeaderSize = 30u;
+constexpr size_t kCentralDirectoryHeaderSize = 46u;
+
+// Where the CRC-32 and sizes start in a local file header.
+constexpr size_t kLocalFileHeaderCrcOffset = 14u;
+
+// The DOS date of 1980-01-01, the earliest a ZIP entry can record. Every new entry is stamped with
+// it so that writing the same files twice produces the same archive.
+constexpr uint16_t kZipEpochDate = (1u << 5) | 1u;
+
+static void PutUint16(uint16_t value, std::string* out) {
+  out->push_back(static_cast<char>(value & 0xffu));
+  out->push_back(static_cast<char>(value >> 8));
+}
+
+static void PutUint32(uint32_t value, std::string* out) {
+  PutUint16(static_cast<uint16_t>(value & 0xffffu), out);
+  PutUint16(static_cast<uint16_t>(value >> 16), out);
+}
+
+// Writes the ZIP format itself instead of going through ZipWriter, so that entries of other
+// archives can be copied in without being inflated and compressed again. New entries are deflated
+// as they are written, and their CRC-32 and sizes are filled into the local header once they are
+// finished. Like ZipWriter, this doesn't support ZIP64: archives larger than 4GiB or with more
+// than 65535 entries fail to be written.
+class EntryCopyingZipFileWriter : public IArchiveWriter {
+ public:
+  explicit EntryCopyingZipFileWriter(ArchiveAlignment alignment) : alignment_(alignment) {}
+
+  bool Open(const StringPiece& path) {
+    file_ = {::android::base::utf8::fopen(path.to_string().c_str(), "wb"), fclose};
+    if (!file_) {
+      error_ = SystemErrorCodeToString(errno);
+      return false;
+    }
+    return true;
+  }
+
+  bool StartEntry(const StringPiece& path, uint32_t flags) override {
+    if (!file_ || finished_ || in_entry_ || HadError()) {
+      return false;
+    }
+
+    Entry entry;
+    entry.path = path.to_string();
+    entry.compressed = (flags & ArchiveEntry::kCompress) != 0;
+    entry.local_header_offset = offset_;
+
+    // The CRC-32 and sizes are written by FinishEntry().
+    if (!WriteLocalHeader(entry, flags)) {
+      return false;
+    }
+
+    if (entry.compressed) {
+      deflater_ = {};
+      if (deflateInit2(&deflater_, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8 /*memLevel*/,
+                       Z_DEFAULT_STRATEGY) != Z_OK) {
+        error_ = "failed to initialize zlib";
+        return false;
+      }
+    }
+
+    in_entry_ = true;
+    entry_ = std::move(entry);
+    entry_crc32_ = static_cast<uint32_t>(crc32(0L, Z_NULL, 0));
+    entry_data_offset_ = offset_;
+    entry_uncompressed_size_ = 0u;
+    return true;
+  }
+
+  bool Write(const void* data, int len) override {
+    if (!in_entry_ || len < 0) {
+      return false;
+    }
+
+    entry_uncompressed_size_ += static_cast<size_t>(len);
+    entry_crc32_ = static_cast<uint32_t>(
+        crc32(entry_crc32_, reinterpret_cast<const Bytef*>(data), static_cast<uInt>(len)));
+    if (!entry_.compressed) {
+      return WriteBytes(data, static_cast<size_t>(len));
+    }
+
+    deflater_.next_in = reinterpret_cast<Bytef*>(const_cast<void*>(data));
+    deflater_.avail_in = static_cast<uInt>(len);
+    return Deflate(Z_NO_FLUSH);
+  }
+
+  bool FinishEntry() override {
+    if (!in_entry_) {
+      return false;
+    }
+    in_entry_ = false;
+
+    if (entry_.compressed) {
+      deflater_.next_in = nullptr;
+      deflater_.avail_in = 0u;
+      const bool deflated = Deflate(Z_FINISH);
+      deflateEnd(&deflater_);
+      if (!deflated) {
+        return false;
+      }
+    }
+
+    const size_t compressed_size = offset_ - entry_data_offset_;
+    if (!CheckFitsWithoutZip64(compressed_size) || !CheckFitsWithoutZip64(entry_uncompressed_size_)) {
+      return false;
+    }
+    entry_.crc32 = entry_crc32_;
+    entry_.compressed_size = static_cast<uint32_t>(compressed_size);
+    entry_.uncompressed_size = static_cast<uint32_t>(entry_uncompressed_size_);
+
+    std::string sizes;
+    PutUint32(entry_.crc32, &sizes);
+    PutUint32(entry_.compressed_size, &sizes);
+    PutUint32(entry_.uncompressed_size, &sizes);
+    const size_t end = offset_;
+    if (!SeekTo(entry_.local_header_offset + kLocalFileHeaderCrcOffset) ||
+        !WriteBytes(sizes.data(), sizes.size()) || !SeekTo(end)) {
+      return false;
+    }
+
+    entries_.push_back(std::move(entry_));
+    return true;
+  }
+
+  bool WriteFile(const StringPiece& path, uint32_t flags, io::InputStream* in) override {
+    while (true) {
+      if (!StartEntry(path, flags)) {
+        return false;
+      }
+
+      const void* data = nullptr;
+      size_t len = 0;
+      while (in->Next(&data, &len)) {
+        if (!Write(data, static_cast<int>(len))) {
+          return false;
+        }
+      }
+
+      if (in->HadError()) {
+        error_ = in->GetError();
+        return false;
+      }
+
+      if (!FinishEntry()) {
+        return false;
+      }
+
+      // Check to see if the file was compressed enough. This is preserving behavior of AAPT.
+      const Entry& last_entry = entries_.back();
+      if ((flags & ArchiveEntry::kCompress) != 0 && in->CanRewind() &&
+          last_entry.compressed_size + (last_entry.compressed_size / 10) >
+              last_entry.uncompressed_size) {
+        // The file was not compressed enough, rewind and store it uncompressed.
+        if (!in->Rewind()) {
+          // Well we tried, may as well keep what we had.
+          return true;
+        }
+
+        if (!DiscardLastEntry()) {
+          return false;
+        }
+        flags &= ~ArchiveEntry::kCompress;
+        continue;
+      }
+      return true;
+    }
+  }
+
+  bool CanWriteEncodedFiles() const override {
+    return true;
+  }
+
+  bool WriteEncodedFile(const StringPiece& path, uint32_t flags,
+                        const io::EncodedData& data) override {
+    if (!file_ || finished_ || in_entry_ || HadError() || !data.data) {
+      return false;
+    }
+
+    if (!CheckFitsWithoutZip64(data.data->size()) ||
+        !CheckFitsWithoutZip64(data.uncompressed_size)) {
+      return false;
+    }
+
+    Entry entry;
+    entry.path = path.to_string();
+    entry.compressed = data.compressed;
+    entry.crc32 = data.crc32;
+    entry.compressed_size = static_cast<uint32_t>(data.data->size());
+    entry.uncompressed_size = static_cast<uint32_t>(data.uncompressed_size);
+    entry.local_header_offset = offset_;
+    if (!WriteLocalHeader(entry, flags) || !WriteBytes(data.data->data(), data.data->size())) {
+      return false;
+    }
+    entries_.push_back(std::move(entry));
+    return true;
+  }
+
+  bool Finish() override {
+    if (finished_) {
+      return !HadError();
+    }
+    finished_ = true;
+
+    if (!file_ || HadError()) {
+      return false;
+    }
+
+    if (in_entry_) {
+      error_ = "archive finished while an entry was being written";
+      return false;
+    }
+    return WriteCentralDirectory();
+  }
+
+  bool HadError() const override {
+    return !error_.empty();
+  }
+
+  std::string GetError() const override {
+    return error_;
+  }
+
+  virtual ~EntryCopyingZipFileWriter() {
+    if (in_entry_ && entry_.compressed) {
+      deflateEnd(&deflater_);
+    }
+    Finish();
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(EntryCopyingZipFileWriter);
+
+  struct Entry {
+    std::string path;
+    bool compressed = false;
+    uint32_t crc32 = 0u;
+    uint32_t compressed_size = 0u;
+    uint32_t uncompressed_size = 0u;
+    size_t local_header_offset = 0u;
+  };
+
+  bool CheckFitsWithoutZip64(size_t value) {
+    if (value > std::numeric_limits<uint32_t>::max()) {
+      error_ = "archive is too large without ZIP64, which is not supported";
+      return false;
+    }
+    return true;
+  }
+
+  // Writes the local header of `entry`, padding the extra field so that the data of stored entries
+  // is aligned, as zipalign does.
+  bool WriteLocalHeader(const Entry& entry, uint32_t flags) {
+    if (!CheckFitsWithoutZip64(offset_) ||
+        entry.path.size() > std::numeric_limits<uint16_t>::max()) {
+      error_ = "archive is too large without ZIP64, which is not supported";
+      return false;
+    }
+
+    size_t alignment = 1u;
+    if (!entry.compressed) {
+      if (alignment_ == ArchiveAlignment::kPage) {
+        alignment = kArchivePageSize;
+      } else if ((flags & ArchiveEntry::kAlign) != 0) {
+        alignment = 4u;
+      }
+    }
+    const size_t data_offset = offset_ + kLocalFileHeaderSize + entry.path.size();
+    const size_t padding = (alignment - (data_offset % alignment)) % alignment;
+
+    std::string header;
+    PutUint32(0x04034b50u, &header);
+    PutFileHeaderFields(entry, &header);
+    PutUint16(static_cast<uint16_t>(padding), &header);
+    header += entry.path;
+    header.append(padding, '\0');
+    return WriteBytes(header.data(), header.size());
+  }
+
+  // Writes the fields that local file headers and central directory headers share, from the
+  // version needed to extract through the length of the file name.
+  static void PutFileHeaderFields(const Entry& entry, std::string* out) {
+    PutUint16(20u, out);  // Version needed to extract: 2.0, for deflate.
+    PutUint16(0u, out);   // General purpose flags.
+    PutUint16(entry.compressed ? 8u : 0u, out);
+    PutUint16(0u, out);  // Last modification time.
+    PutUint16(kZipEpochDate, out);
+    PutUint32(entry.crc32, out);
+    PutUint32(entry.compressed_size, out);
+    PutUint32(entry.uncompressed_size, out);
+    PutUint16(static_cast<uint16_t>(entry.path.size()), out);
+  }
+
+  // Runs the deflater over its pending input and writes out what it produces.
+  bool Deflate(int flush) {
+    uint8_t buffer[16 * 1024];
+    while (true) {
+      deflater_.next_out = buffer;
+      deflater_.avail_out = sizeof(buffer);
+      const int result = deflate(&deflater_, flush);
+      if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
+        error_ = "failed to deflate entry";
+        return false;
+      }
+
+      if (!WriteBytes(buffer, sizeof(buffer) - deflater_.avail_out)) {
+        return false;
+      }
+
+      if (flush == Z_FINISH ? result == Z_STREAM_END
+                            : deflater_.avail_in == 0u && deflater_.avail_out != 0u) {
+        return true;
+      }
+    }
+  }
+
+  // Removes the last finished entry, so that the next one is written in its place.
+  bool DiscardLastEntry() {
+    const size_t offset = entries_.back().local_header_offset;
+    entries_.pop_back();
+    return SeekTo(offset);
+  }
+
+  bool WriteCentralDirectory() {
+    if (entries_.size() > std::numeric_limits<uint16_t>::max() ||
+        !CheckFitsWithoutZip64(offset_)) {
+      error_ = "archive is too large without ZIP64, which is not supported";
+      return false;
+    }
+
+    const size_t directory_offset = offset_;
+    std::string directory;
+    directory.reserve(entries_.size() * (kCentralDirectoryHeaderSize + 32u));
+    for (const Entry& entry : entries_) {
+      PutUint32(0x02014b50u, &directory);
+      PutUint16(20u, &directory);  // Version made by.
+      PutFileHeaderFields(entry, &directory);
+      PutUint16(0u, &directory);  // Extra field length.
+      PutUint16(0u, &directory);  // File comment length.
+      PutUint16(0u, &directory);  // Disk number start.
+      PutUint16(0u, &directory);  // Internal file attributes.
+      PutUint32(0u, &directory);  // External file attributes.
+      PutUint32(static_cast<uint32_t>(entry.local_header_offset), &directory);
+      directory += entry.path;
+    }
+
+    if (!CheckFitsWithoutZip64(directory.size())) {
+      return false;
+    }
+
+    // The end of central directory record.
+    const uint16_t entry_count = static_cast<uint16_t>(entries_.size());
+    PutUint32(0x06054b50u, &directory);
+    PutUint16(0u, &directory);  // Number of this disk.
+    PutUint16(0u, &directory);  // Disk where the central directory starts.
+    PutUint16(entry_count, &directory);
+    PutUint16(entry_count, &directory);
+    PutUint32(static_cast<uint32_t>(directory.size() - 22u), &directory);
+    PutUint32(static_cast<uint32_t>(directory_offset), &directory);
+    PutUint16(0u, &directory);  // Comment length.
+    if (!WriteBytes(directory.data(), directory.size())) {
+      return false;
+    }
+
+    // A discarded entry may have left bytes past the end of the archive.
+    if (fflush(file_.get()) != 0 || (end_offset_ > offset_ && !Truncate(offset_))) {
+      error_ = SystemErrorCodeToString(errno);
+      return false;
+    }
+    return true;
+  }
+
+  bool WriteBytes(const void* data, size_t len) {
+    if (len != 0u && fwrite(data, 1, len, file_.get()) != len) {
+      error_ = SystemErrorCodeToString(errno);
+      return false;
+    }
+    offset_ += len;
+    end_offset_ = std::max(end_offset_, offset_);
+    return true;
+  }
+
+  bool SeekTo(size_t offset) {
+#ifdef _WIN32
+    const int result = _fseeki64(file_.get(), static_cast<int64_t>(offset), SEEK_SET);
+#else
+    const int result = fseeko(file_.get(), static_cast<off_t>(offset), SEEK_SET);
+#endif
+    if (result != 0) {
+      error_ = SystemErrorCodeToString(errno);
+      return false;
+    }
+    offset_ = offset;
+    return true;
+  }
+
+  bool Truncate(size_t size) {
+#ifdef _WIN32
+    return _chsize_s(_fileno(file_.get()), static_cast<int64_t>(size)) == 0;
+#else
+    return ftruncate(fileno(file_.get()), static_cast<off_t>(size)) == 0;
+#endif
+  }
+
+  ArchiveAlignment alignment_;
+  std::unique_ptr<FILE, decltype(fclose)*> file_ = {nullptr, fclose};
+  std::string error_;
+  bool finished_ = false;
+
+  // The offset at which the next record starts, and the furthest offset written so far.
+  size_t offset_ = 0u;
+  size_t end_offset_ = 0u;
+  std::vector<Entry> entries_;
+
+  // The entry being written between StartEntry() and FinishEntry().
+  bool in_entry_ = false;
+  Entry entry_;
+  z_stream deflater_ = {};
+  uint32_t entry_crc32_ = 0u;
+  size_t entry_data_offset_ = 0u;
+  size_t entry_uncompressed_size_ = 0u;
+};
+
 }  // namespace
 
 std::unique_ptr<IArchiveWriter> CreateDirectoryArchiveWriter(IDiagnostics* diag,
@@ -252,8 +709,20 @@ std::unique_ptr<IArchiveWriter> CreateDirectoryArchiveWriter(IDiagnostics* diag,
 }
 
 std::unique_ptr<IArchiveWriter> CreateZipFileArchiveWriter(IDiagnostics* diag,
-                                                           const StringPiece& path) {
-  std::unique_ptr<ZipFileWriter> writer = util::make_unique<ZipFileWriter>();
+                                                           const StringPiece& path,
+                                                           ArchiveAlignment alignment) {
+  std::unique_ptr<ZipFileWriter> writer = util::make_unique<ZipFileWriter>(alignment);
+  if (!writer->Open(path)) {
+    diag->Error(DiagMessage(path) << writer->GetError());
+    return {};
+  }
+  return std::move(writer);
+}
+
+std::unique_ptr<IArchiveWriter> CreateEntryCopyingZipFileArchiveWriter(
+    IDiagnostics* diag, const StringPiece& path, ArchiveAlignment alignment) {
+  std::unique_ptr<EntryCopyingZipFileWriter> writer =
+      util::make_unique<EntryCopyingZipFileWriter>(alignment);
   if (!writer->Open(path)) {
     diag->Error(DiagMessage(path) << writer->GetError());
     return {};
@@ -26,6 +26,7 @@
 #include "google/protobuf/io/zero_copy_stream_impl_lite.h"
 
 #include "Diagnostics.h"
+#include "io/File.h"
 #include "io/Io.h"
 #include "util/BigBuffer.h"
 #include "util/Files.h"
@@ -43,6 +44,18 @@ struct ArchiveEntry {
   size_t uncompressed_size;
 };
 
+// How the data of entries that are stored uncompressed is aligned within a ZIP archive.
+enum class ArchiveAlignment {
+  // Entries flagged with ArchiveEntry::kAlign are aligned to 4 bytes.
+  kDefault,
+
+  // Every stored entry is aligned to kArchivePageSize bytes, so that it can be mmapped directly
+  // from the installed APK without a separate zipalign pass.
+  kPage,
+};
+
+constexpr uint32_t kArchivePageSize = 4096u;
+
 class IArchiveWriter : public ::google::protobuf::io::CopyingOutputStream {
  public:
   virtual ~IArchiveWriter() = default;
@@ -62,6 +75,26 @@ class IArchiveWriter : public ::google::protobuf::io::CopyingOutputStream {
   // valid between calls to StartEntry and FinishEntry.
   virtual bool Write(const void* buffer, int size) = 0;
 
+  // Returns true if WriteEncodedFile() is supported.
+  virtual bool CanWriteEncodedFiles() const {
+    return false;
+  }
+
+  // Writes a file that is already encoded as a ZIP entry, such as an entry of another ZIP archive,
+  // without inflating or compressing it again. ArchiveEntry::kCompress in `flags` is ignored, since
+  // the data is written as it is encoded. Only valid if CanWriteEncodedFiles() returns true.
+  virtual bool WriteEncodedFile(const android::StringPiece& path, uint32_t flags,
+                                const io::EncodedData& data) {
+    return false;
+  }
+
+  // Writes whatever the archive needs after its last entry, such as the ZIP central directory, and
+  // flushes it. Returns false if the archive could not be completed. Writers that are destroyed
+  // without being finished finish themselves, but can't report errors then.
+  virtual bool Finish() {
+    return !HadError();
+  }
+
   // Returns true if there was an error writing to the archive.
   // The resulting error message can be retrieved from GetError().
   virtual bool HadError() const = 0;
@@ -73,8 +106,15 @@ class IArchiveWriter : public ::google::protobuf::io::CopyingOutputStream {
 std::unique_ptr<IArchiveWriter> CreateDirectoryArchiveWriter(IDiagnostics* diag,
                                                              const android::StringPiece& path);
 
-std::unique_ptr<IArchiveWriter> CreateZipFileArchiveWriter(IDiagnostics* diag,
-                                                           const android::StringPiece& path);
+std::unique_ptr<IArchiveWriter> CreateZipFileArchiveWriter(
+    IDiagnostics* diag, const android::StringPiece& path,
+    ArchiveAlignment alignment = ArchiveAlignment::kDefault);
+
+// Creates a ZIP archive writer that also supports WriteEncodedFile(), so that entries of other
+// archives can be copied into it verbatim.
+std::unique_ptr<IArchiveWriter> CreateEntryCopyingZipFileArchiveWriter(
+    IDiagnostics* diag, const android::StringPiece& path,
+    ArchiveAlignment alignment = ArchiveAlignment::kDefault);
 
 }  // namespace aapt
 
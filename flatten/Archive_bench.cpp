@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "flatten/Archive.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "benchmark/benchmark.h"
+
+#include "io/StringInputStream.h"
+#include "test/Context.h"
+#include "test/CorpusGenerator.h"
+#include "util/Files.h"
+
+using ::aapt::io::StringInputStream;
+
+namespace aapt {
+
+static void BM_ZipFileArchiveWriterWrite(benchmark::State& state, uint32_t flags) {
+  test::CorpusOptions options;
+  options.entries = 100;
+  options.layouts = state.range(0);
+  options.drawables = state.range(0);
+  const std::vector<test::CorpusFile> files = test::GenerateCorpus(options);
+
+  const char* tmp_dir = getenv("TMPDIR");
+  std::string path = tmp_dir != nullptr ? tmp_dir : "/tmp";
+  file::AppendPath(&path, "aapt2_benchmark.apk");
+
+  size_t bytes = 0u;
+  for (const test::CorpusFile& file : files) {
+    bytes += file.contents.size();
+  }
+
+  while (state.KeepRunning()) {
+    std::unique_ptr<IArchiveWriter> writer =
+        CreateZipFileArchiveWriter(test::GetDiagnostics(), path);
+    if (!writer) {
+      state.SkipWithError("failed to create archive");
+      break;
+    }
+
+    for (const test::CorpusFile& file : files) {
+      StringInputStream in(file.contents);
+      if (!writer->WriteFile(file.path, flags, &in)) {
+        state.SkipWithError("failed to write archive entry");
+        break;
+      }
+    }
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * bytes);
+  remove(path.c_str());
+}
+
+static void BM_ZipFileArchiveWriterWriteStored(benchmark::State& state) {
+  BM_ZipFileArchiveWriterWrite(state, 0u);
+}
+BENCHMARK(BM_ZipFileArchiveWriterWriteStored)->Range(8, 1 << 10);
+
+static void BM_ZipFileArchiveWriterWriteCompressed(benchmark::State& state) {
+  BM_ZipFileArchiveWriterWrite(state, ArchiveEntry::kCompress);
+}
+BENCHMARK(BM_ZipFileArchiveWriterWriteCompressed)->Range(8, 1 << 10);
+
+}  // namespace aapt
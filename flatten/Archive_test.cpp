@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flatten/Archive.h"
+
+#include "android-base/file.h"
+#include "android-base/test_utils.h"
+
+#include "io/BigBufferInputStream.h"
+#include "io/StringInputStream.h"
+#include "io/Util.h"
+#include "io/ZipArchive.h"
+#include "test/Test.h"
+
+using ::testing::Eq;
+using ::testing::NotNull;
+
+namespace aapt {
+
+static std::string ReadEntry(io::IFile* file) {
+  std::unique_ptr<io::IData> data = file->OpenAsData();
+  if (!data) {
+    return {};
+  }
+  return std::string(reinterpret_cast<const char*>(data->data()), data->size());
+}
+
+TEST(ArchiveTest, EntryCopyingWriterCopiesEncodedEntries) {
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder().Build();
+  const std::string stored_contents = "stored";
+  const std::string deflated_contents(4096u, 'a');
+
+  TemporaryFile original;
+  {
+    std::unique_ptr<IArchiveWriter> writer =
+        CreateEntryCopyingZipFileArchiveWriter(context->GetDiagnostics(), original.path);
+    ASSERT_THAT(writer, NotNull());
+    io::StringInputStream stored(stored_contents);
+    ASSERT_TRUE(writer->WriteFile("stored.txt", ArchiveEntry::kAlign, &stored));
+    io::StringInputStream deflated(deflated_contents);
+    ASSERT_TRUE(writer->WriteFile("deflated.txt", ArchiveEntry::kCompress, &deflated));    ASSERT_TRUE(writer->Finish()) << writer->GetError();
+  }
+
+  std::string error;
+  std::unique_ptr<io::ZipFileCollection> collection =
+      io::ZipFileCollection::Create(original.path, &error);
+  ASSERT_THAT(collection, NotNull()) << error;
+  io::IFile* stored = collection->FindFile("stored.txt");
+  io::IFile* deflated = collection->FindFile("deflated.txt");
+  ASSERT_THAT(stored, NotNull());
+  ASSERT_THAT(deflated, NotNull());
+  EXPECT_FALSE(stored->WasCompressed());
+  EXPECT_TRUE(deflated->WasCompressed());
+
+  io::EncodedData encoded;
+  ASSERT_TRUE(deflated->OpenAsEncodedData(&encoded));
+  EXPECT_TRUE(encoded.compressed);
+  EXPECT_THAT(encoded.uncompressed_size, Eq(deflated_contents.size()));
+  EXPECT_LT(encoded.data->size(), deflated_contents.size());
+
+  TemporaryFile copy;
+  {
+    std::unique_ptr<IArchiveWriter> writer =
+        CreateEntryCopyingZipFileArchiveWriter(context->GetDiagnostics(), copy.path);
+    ASSERT_THAT(writer, NotNull());
+    ASSERT_TRUE(writer->CanWriteEncodedFiles());
+    ASSERT_TRUE(io::CopyFileToArchive(context.get(), stored, "res/stored.txt",
+                                      ArchiveEntry::kAlign, writer.get()));
+    ASSERT_TRUE(io::CopyFileToArchive(context.get(), deflated, "res/deflated.txt",
+                                      ArchiveEntry::kCompress, writer.get()));    ASSERT_TRUE(writer->Finish()) << writer->GetError();
+  }
+
+  std::unique_ptr<io::ZipFileCollection> copied = io::ZipFileCollection::Create(copy.path, &error);
+  ASSERT_THAT(copied, NotNull()) << error;
+  io::IFile* copied_stored = copied->FindFile("res/stored.txt");
+  io::IFile* copied_deflated = copied->FindFile("res/deflated.txt");
+  ASSERT_THAT(copied_stored, NotNull());
+  ASSERT_THAT(copied_deflated, NotNull());
+  EXPECT_FALSE(copied_stored->WasCompressed());
+  EXPECT_TRUE(copied_deflated->WasCompressed());
+  ASSERT_TRUE(copied_deflated->GetCrc32());
+  EXPECT_THAT(copied_deflated->GetCrc32().value(), Eq(encoded.crc32));
+  EXPECT_THAT(ReadEntry(copied_stored), Eq(stored_contents));
+  EXPECT_THAT(ReadEntry(copied_deflated), Eq(deflated_contents));
+}
+
+TEST(ArchiveTest, EntryCopyingWriterStoresIncompressibleFiles) {
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder().Build();
+
+  // Bytes that deflate can't shrink, followed by an entry that deflates well, so that the stored
+  // copy of the first entry is written over its discarded deflated copy.
+  BigBuffer noise(1024u);
+  uint32_t state = 1u;
+  for (size_t i = 0u; i < 8192u; i++) {
+    state = state * 1103515245u + 12345u;
+    *noise.NextBlock<uint8_t>(1u) = static_cast<uint8_t>(state >> 24);
+  }
+  const std::string noise_contents = noise.to_string();
+
+  TemporaryFile archive;
+  {
+    std::unique_ptr<IArchiveWriter> writer =
+        CreateEntryCopyingZipFileArchiveWriter(context->GetDiagnostics(), archive.path);
+    ASSERT_THAT(writer, NotNull());
+    io::BigBufferInputStream noise_in(&noise);
+    ASSERT_TRUE(writer->WriteFile("noise.bin", ArchiveEntry::kCompress, &noise_in));
+    io::StringInputStream text(std::string(4096u, 't'));
+    ASSERT_TRUE(writer->WriteFile("text.txt", ArchiveEntry::kCompress, &text));
+    ASSERT_TRUE(writer->Finish()) << writer->GetError();
+  }
+
+  std::string error;
+  std::unique_ptr<io::ZipFileCollection> collection =
+      io::ZipFileCollection::Create(archive.path, &error);
+  ASSERT_THAT(collection, NotNull()) << error;
+  io::IFile* noise_file = collection->FindFile("noise.bin");
+  io::IFile* text_file = collection->FindFile("text.txt");
+  ASSERT_THAT(noise_file, NotNull());
+  ASSERT_THAT(text_file, NotNull());
+  EXPECT_FALSE(noise_file->WasCompressed());
+  EXPECT_TRUE(text_file->WasCompressed());
+  EXPECT_THAT(ReadEntry(noise_file), Eq(noise_contents));
+  EXPECT_THAT(ReadEntry(text_file), Eq(std::string(4096u, 't')));
+}
+
+TEST(ArchiveTest, PageAlignmentAlignsEveryStoredEntry) {
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder().Build();
+  const std::string table_contents = "the resource table";
+  const std::string asset_contents = "an uncompressed asset";
+
+  TemporaryFile archive;
+  {
+    std::unique_ptr<IArchiveWriter> writer = CreateEntryCopyingZipFileArchiveWriter(
+        context->GetDiagnostics(), archive.path, ArchiveAlignment::kPage);
+    ASSERT_THAT(writer, NotNull());
+    io::StringInputStream table(table_contents);
+    ASSERT_TRUE(writer->WriteFile("resources.arsc", ArchiveEntry::kAlign, &table));
+    io::StringInputStream manifest(std::string(1024u, 'm'));
+    ASSERT_TRUE(writer->WriteFile("AndroidManifest.xml", ArchiveEntry::kCompress, &manifest));
+    io::StringInputStream asset(asset_contents);
+    ASSERT_TRUE(writer->WriteFile("assets/asset.bin", 0u, &asset));    ASSERT_TRUE(writer->Finish()) << writer->GetError();
+  }
+
+  std::string contents;
+  ASSERT_TRUE(android::base::ReadFileToString(archive.path, &contents));
+  const size_t table_offset = contents.find(table_contents);
+  const size_t asset_offset = contents.find(asset_contents);
+  ASSERT_NE(std::string::npos, table_offset);
+  ASSERT_NE(std::string::npos, asset_offset);
+  EXPECT_THAT(table_offset % kArchivePageSize, Eq(0u));
+  EXPECT_THAT(asset_offset % kArchivePageSize, Eq(0u));
+
+  std::string error;
+  std::unique_ptr<io::ZipFileCollection> collection =
+      io::ZipFileCollection::Create(archive.path, &error);
+  ASSERT_THAT(collection, NotNull()) << error;
+  io::IFile* table = collection->FindFile("resources.arsc");
+  ASSERT_THAT(table, NotNull());
+  EXPECT_THAT(ReadEntry(table), Eq(table_contents));
+}
+
+}  // namespace aapt
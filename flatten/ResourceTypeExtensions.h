@@ -32,6 +32,36 @@ struct ResTable_entry_ext {
   uint32_t count;
 };
 
+/**
+ * The compact form of a ResTable_entry and its Res_value, which platforms
+ * from SDK_U onwards read. It can only encode simple items whose key index
+ * fits in 16 bits. The flags are at the same offset as in ResTable_entry, so
+ * that FLAG_COMPACT can be checked before knowing which form an entry uses.
+ * The high byte of the flags holds the Res_value data type.
+ */
+struct ResTable_entry_compact {
+  uint16_t key;
+  uint16_t flags;
+  uint32_t data;
+};
+
+/**
+ * ResTable_entry::FLAG_COMPACT, which marks a ResTable_entry_compact.
+ */
+constexpr uint16_t kResTableEntryFlagCompact = 0x0008u;
+
+/**
+ * ResTable_type::FLAG_OFFSET16, which marks a dense type whose entry offsets
+ * are 16 bit values holding the offset divided by 4.
+ */
+constexpr uint8_t kResTableTypeFlagOffset16 = 0x02u;
+
+/**
+ * The 16 bit offset of an entry that is not defined by a type with
+ * kResTableTypeFlagOffset16.
+ */
+constexpr uint16_t kResTableTypeNoEntryOffset16 = 0xffffu;
+
 }  // namespace aapt
 
 #endif  // AAPT_RESOURCE_TYPE_EXTENSIONS_H
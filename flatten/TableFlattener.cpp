@@ -17,6 +17,7 @@
 #include "flatten/TableFlattener.h"
 
 #include <algorithm>
+#include <cctype>
 #include <numeric>
 #include <sstream>
 #include <type_traits>
@@ -31,6 +32,7 @@
 #include "flatten/ChunkWriter.h"
 #include "flatten/ResourceTypeExtensions.h"
 #include "util/BigBuffer.h"
+#include "util/Util.h"
 
 using namespace android;
 
@@ -218,12 +220,13 @@ class MapFlattenVisitor : public RawValueVisitor {
 class PackageFlattener {
  public:
   PackageFlattener(IAaptContext* context, ResourceTablePackage* package,
-                   const std::map<size_t, std::string>* shared_libs, bool use_sparse_entries)
+                   const std::map<size_t, std::string>* shared_libs,
+                   const TableFlattenerOptions& options)
       : context_(context),
         diag_(context->GetDiagnostics()),
         package_(package),
         shared_libs_(shared_libs),
-        use_sparse_entries_(use_sparse_entries) {}
+        options_(options) {}
 
   bool FlattenPackage(BigBuffer* buffer) {
     ChunkWriter pkg_writer(buffer);
@@ -263,6 +266,12 @@ class PackageFlattener {
     }
 
     pkg_writer.Finish();
+
+    if (context_->IsVerbose() && options_.use_sparse_entries) {
+      diag_->Note(DiagMessage() << "sparse encoded " << sparse_type_count_ << " of " << type_count_
+                                << " types of package '" << package_->name << "', saving "
+                                << sparse_saved_bytes_ << " bytes");
+    }
     return true;
   }
 
@@ -295,8 +304,34 @@ class PackageFlattener {
     return result;
   }
 
-  bool FlattenValue(FlatEntry* entry, BigBuffer* buffer) {
+  // Writes a simple item as a ResTable_entry_compact, which holds the key index, flags, data type
+  // and data of the item in 8 bytes.
+  void WriteCompactEntry(FlatEntry* entry, const Item* item, BigBuffer* buffer) {
+    Res_value value = {};
+    CHECK(item->Flatten(&value)) << "flatten failed";
+
+    uint16_t flags = kResTableEntryFlagCompact | static_cast<uint16_t>(value.dataType << 8);
+    if (entry->entry->symbol_status.state == SymbolState::kPublic) {
+      flags |= ResTable_entry::FLAG_PUBLIC;
+    }
+
+    if (entry->value->IsWeak()) {
+      flags |= ResTable_entry::FLAG_WEAK;
+    }
+
+    ResTable_entry_compact* out_entry = buffer->NextBlock<ResTable_entry_compact>();
+    out_entry->key = util::HostToDevice16(static_cast<uint16_t>(entry->entry_key));
+    out_entry->flags = util::HostToDevice16(flags);
+    out_entry->data = value.data;
+  }
+
+  bool FlattenValue(FlatEntry* entry, bool compact, BigBuffer* buffer) {
     if (Item* item = ValueCast<Item>(entry->value)) {
+      if (compact && entry->entry_key <= std::numeric_limits<uint16_t>::max()) {
+        WriteCompactEntry(entry, item, buffer);
+        return true;
+      }
+
       WriteEntry<ResTable_entry, true>(entry, buffer);
       Res_value* outValue = buffer->NextBlock<Res_value>();
       CHECK(item->Flatten(outValue)) << "flatten failed";
@@ -327,11 +362,16 @@ class PackageFlattener {
     std::vector<uint32_t> offsets;
     offsets.resize(num_total_entries, 0xffffffffu);
 
+    // Only use compact entries if they will be read on platforms U+.
+    const bool compact =
+        options_.use_compact_entries &&
+        (context_->GetMinSdkVersion() >= SDK_U || config.sdkVersion >= SDK_U);
+
     BigBuffer values_buffer(512);
     for (FlatEntry& flat_entry : *entries) {
       CHECK(static_cast<size_t>(flat_entry.entry->id.value()) < num_total_entries);
       offsets[flat_entry.entry->id.value()] = values_buffer.size();
-      if (!FlattenValue(&flat_entry, &values_buffer)) {
+      if (!FlattenValue(&flat_entry, compact, &values_buffer)) {
         diag_->Error(DiagMessage()
                      << "failed to flatten resource '"
                      << ResourceNameRef(package_->name, type->type, flat_entry.entry->name)
@@ -340,7 +380,11 @@ class PackageFlattener {
       }
     }
 
-    bool sparse_encode = use_sparse_entries_;
+    // With compact entries, the offsets of a dense type are 16 bits wide when every offset fits in
+    // 16 bits once divided by 4.
+    const bool offset16 = compact && (values_buffer.size() / 4u) < kResTableTypeNoEntryOffset16;
+
+    bool sparse_encode = options_.use_sparse_entries;
 
     // Only sparse encode if the entries will be read on platforms O+.
     sparse_encode =
@@ -351,10 +395,23 @@ class PackageFlattener {
         sparse_encode && (values_buffer.size() / 4u) <= std::numeric_limits<uint16_t>::max();
 
     // Only sparse encode if the ratio of populated entries to total entries is below some
-    // threshold.
+    // threshold. Denser types would save too little to be worth a binary search on every lookup.
     sparse_encode =
         sparse_encode && ((100 * entries->size()) / num_total_entries) < kSparseEncodingThreshold;
 
+    // Only sparse encode if it makes the type smaller, once the cost of the binary search it adds
+    // to every lookup is accounted for.
+    if (sparse_encode) {
+      const TypeOffsetsCost cost =
+          CostOfTypeOffsets(num_total_entries, entries->size(), offset16, options_);
+      sparse_encode = cost.sparse_size + cost.sparse_lookup_cost < cost.dense_size;
+      if (sparse_encode) {
+        sparse_type_count_++;
+        sparse_saved_bytes_ += cost.dense_size - cost.sparse_size;
+      }
+    }
+    type_count_++;
+
     if (sparse_encode) {
       type_header->entryCount = util::HostToDevice32(entries->size());
       type_header->flags |= ResTable_type::FLAG_SPARSE;
@@ -368,6 +425,19 @@ class PackageFlattener {
           indices++;
         }
       }
+    } else if (offset16) {
+      type_header->entryCount = util::HostToDevice32(num_total_entries);
+      type_header->flags |= kResTableTypeFlagOffset16;
+      uint16_t* indices = type_writer.NextBlock<uint16_t>(num_total_entries);
+      for (size_t i = 0; i < num_total_entries; i++) {
+        if (offsets[i] == ResTable_type::NO_ENTRY) {
+          indices[i] = util::HostToDevice16(kResTableTypeNoEntryOffset16);
+        } else {
+          CHECK((offsets[i] & 0x03) == 0);
+          indices[i] = util::HostToDevice16(static_cast<uint16_t>(offsets[i] / 4u));
+        }
+      }
+      type_writer.buffer()->Align4();
     } else {
       type_header->entryCount = util::HostToDevice32(num_total_entries);
       uint32_t* indices = type_writer.NextBlock<uint32_t>(num_total_entries);
@@ -483,6 +553,10 @@ class PackageFlattener {
         continue;
       }
 
+      TraceSpan span(options_.trace, "flatten", ToString(type->type));
+      span.AddArg("entries", sorted_entries.size());
+      const size_t start_size = buffer->size();
+
       if (!FlattenTypeSpec(type, &sorted_entries, buffer)) {
         return false;
       }
@@ -498,7 +572,16 @@ class PackageFlattener {
       // table.
       std::map<ConfigDescription, std::vector<FlatEntry>> config_to_entry_list_map;
       for (ResourceEntry* entry : sorted_entries) {
-        const uint32_t key_index = (uint32_t)key_pool_.MakeRef(entry->name).index();
+        uint32_t key_index;
+        const bool collapse =
+            options_.collapse_key_stringpool &&
+            options_.whitelisted_resources.find(ResourceName({}, type->type, entry->name)) ==
+                options_.whitelisted_resources.end();
+        if (collapse || IsObfuscatedResourceName(entry->name)) {
+          key_index = (uint32_t)key_pool_.MakeRef(kObfuscatedResourceName).index();
+        } else {
+          key_index = (uint32_t)key_pool_.MakeRef(entry->name).index();
+        }
 
         // Group values by configuration.
         for (auto& config_value : entry->values) {
@@ -513,6 +596,8 @@ class PackageFlattener {
           return false;
         }
       }
+      span.AddArg("configs", config_to_entry_list_map.size());
+      span.AddArg("bytes", buffer->size() - start_size);
     }
     return true;
   }
@@ -549,13 +634,48 @@ class PackageFlattener {
   IDiagnostics* diag_;
   ResourceTablePackage* package_;
   const std::map<size_t, std::string>* shared_libs_;
-  bool use_sparse_entries_;
+  const TableFlattenerOptions& options_;
   StringPool type_pool_;
   StringPool key_pool_;
+
+  // The number of type chunks written and how many of them were sparse encoded, for verbose
+  // logging.
+  size_t type_count_ = 0;
+  size_t sparse_type_count_ = 0;
+  size_t sparse_saved_bytes_ = 0;
 };
 
 }  // namespace
 
+bool IsObfuscatedResourceName(const StringPiece& name) {
+  const StringPiece prefix = kObfuscatedResourceName;
+  constexpr size_t kIdDigits = 8u;
+  if (name.size() != prefix.size() + 1u + kIdDigits || !util::StartsWith(name, prefix) ||
+      name.data()[prefix.size()] != '_') {
+    return false;
+  }
+  const char* const id_start = name.data() + prefix.size() + 1u;
+  return std::all_of(id_start, id_start + kIdDigits, [](char c) { return isxdigit(c) != 0; });
+}
+
+TypeOffsetsCost CostOfTypeOffsets(size_t entry_count, size_t defined_entry_count, bool offset16,
+                                  const TableFlattenerOptions& options) {
+  TypeOffsetsCost cost;
+
+  // 16 bit offsets are padded so that the entries that follow them stay aligned.
+  cost.dense_size = offset16 ? (entry_count * sizeof(uint16_t) + 3u) / 4u * 4u
+                             : entry_count * sizeof(uint32_t);
+  cost.sparse_size = defined_entry_count * sizeof(ResTable_sparseTypeEntry);
+
+  // A sparse lookup binary searches the defined entries, where a dense lookup indexes its offset.
+  size_t lookup_steps = 0u;
+  for (size_t n = defined_entry_count; n > 1u; n = (n + 1u) / 2u) {
+    lookup_steps++;
+  }
+  cost.sparse_lookup_cost = lookup_steps * options.sparse_lookup_step_cost;
+  return cost;
+}
+
 bool TableFlattener::Consume(IAaptContext* context, ResourceTable* table) {
   // We must do this before writing the resources, since the string pool IDs may change.
   table->string_pool.Prune();
@@ -587,8 +707,7 @@ bool TableFlattener::Consume(IAaptContext* context, ResourceTable* table) {
 
   // Flatten each package.
   for (auto& package : table->packages) {
-    PackageFlattener flattener(context, package.get(), &table->included_packages_,
-                               options_.use_sparse_entries);
+    PackageFlattener flattener(context, package.get(), &table->included_packages_, options_);
     if (!flattener.FlattenPackage(&package_buffer)) {
       return false;
     }
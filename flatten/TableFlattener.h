@@ -17,26 +17,84 @@
 #ifndef AAPT_FLATTEN_TABLEFLATTENER_H
 #define AAPT_FLATTEN_TABLEFLATTENER_H
 
+#include <set>
+
 #include "android-base/macros.h"
+#include "androidfw/StringPiece.h"
 
 #include "ResourceTable.h"
 #include "process/IResourceTableConsumer.h"
 #include "util/BigBuffer.h"
+#include "util/Trace.h"
 
 namespace aapt {
 
-// The percentage of used entries for a type for which using a sparse encoding is
-// preferred.
+// Types with at least this percentage of their entries defined for a configuration are never
+// sparse encoded, so that their lookups stay constant time.
 constexpr const size_t kSparseEncodingThreshold = 60;
 
 struct TableFlattenerOptions {
-  // When true, types for configurations with a sparse set of entries are encoded
-  // as a sparse map of entry ID and offset to actual data.
+  // When true, the type of each configuration is encoded as a sparse map of entry ID and offset
+  // to actual data whenever it is less than kSparseEncodingThreshold percent defined and that is
+  // smaller than an offset for every entry of the type. See CostOfTypeOffsets().
   // This is only available on platforms O+ and will only be respected when
-  // minSdk is O+.
+  // minSdk is O+ or for configurations of O+.
   bool use_sparse_entries = false;
+
+  // The number of bytes a sparse type must save for every step of the binary search that a lookup
+  // in it takes. 0 sparse encodes every type below kSparseEncodingThreshold that is smaller that
+  // way.
+  size_t sparse_lookup_step_cost = 0;
+
+  // When true, simple items are encoded as 8 byte ResTable_entry_compact entries instead of a
+  // 16 byte ResTable_entry and Res_value, and the offsets of a dense type are encoded in 16 bits
+  // when its entries are small enough.
+  // This is only read by platforms U+ and will only be respected when minSdk is U+ or for
+  // configurations of U+.
+  bool use_compact_entries = false;
+
+  // When true, every entry shares the single key string kObfuscatedResourceName instead of its own
+  // name, which shrinks the key string pool to one string. Entries in `whitelisted_resources` keep
+  // their names, so that they can still be looked up by name at runtime.
+  bool collapse_key_stringpool = false;
+
+  // Names of the resources whose keys are kept when collapsing the key string pool. The package of
+  // each name is ignored.
+  std::set<ResourceName> whitelisted_resources;
+
+  // When not null, the time spent flattening each type, and the bytes it took, are recorded here.
+  TraceRecorder* trace = nullptr;
 };
 
+// The key that replaces the names of resource entries when the key string pool is collapsed. It is
+// not a valid resource name, so looking a collapsed resource up by name fails instead of finding
+// another resource.
+constexpr const char* kObfuscatedResourceName = "0_resource_name_obfuscated";
+
+// Returns true if `name` is the name BinaryResourceParser gives an entry whose key was collapsed,
+// kObfuscatedResourceName followed by '_' and the entry's ID in 8 hex digits. Such entries keep
+// the collapsed key when they are flattened again.
+bool IsObfuscatedResourceName(const android::StringPiece& name);
+
+// The bytes that the entry offsets of a type take up in each encoding.
+struct TypeOffsetsCost {
+  // An offset for each of the type's entries, 4 bytes wide, or 2 bytes wide with 16 bit offsets.
+  size_t dense_size = 0;
+
+  // An index and offset for each entry the type defines.
+  size_t sparse_size = 0;
+
+  // What the binary search of a sparse lookup costs, as bytes that sparse encoding must save.
+  size_t sparse_lookup_cost = 0;
+};
+
+// Costs the encodings of the offsets of a type with `entry_count` entries, `defined_entry_count`
+// of which are defined for the type's configuration. A type that is less than
+// kSparseEncodingThreshold percent defined is sparse encoded when
+// sparse_size + sparse_lookup_cost < dense_size.
+TypeOffsetsCost CostOfTypeOffsets(size_t entry_count, size_t defined_entry_count, bool offset16,
+                                  const TableFlattenerOptions& options);
+
 class TableFlattener : public IResourceTableConsumer {
  public:
   explicit TableFlattener(const TableFlattenerOptions& options, BigBuffer* buffer)
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "flatten/TableFlattener.h"
+
+#include "benchmark/benchmark.h"
+
+#include "SdkConstants.h"
+#include "test/Context.h"
+#include "test/CorpusGenerator.h"
+#include "util/BigBuffer.h"
+
+namespace aapt {
+
+static void BM_TableFlattenerFlatten(benchmark::State& state, bool use_sparse_entries) {
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder()
+                                              .SetCompilationPackage("com.app.test")
+                                              .SetPackageId(0x7f)
+                                              .SetMinSdkVersion(SDK_O)
+                                              .Build();
+  test::CorpusOptions options;
+  options.entries = state.range(0);
+  std::unique_ptr<ResourceTable> table =
+      test::BuildLinkedCorpusTable(context.get(), test::GenerateCorpus(options));
+  if (!table) {
+    state.SkipWithError("failed to build corpus table");
+    return;
+  }
+
+  TableFlattenerOptions flattener_options;
+  flattener_options.use_sparse_entries = use_sparse_entries;
+  while (state.KeepRunning()) {
+    BigBuffer buffer(1024);
+    TableFlattener flattener(flattener_options, &buffer);
+    if (!flattener.Consume(context.get(), table.get())) {
+      state.SkipWithError("failed to flatten table");
+      break;
+    }
+    benchmark::DoNotOptimize(buffer.size());
+  }
+}
+
+static void BM_TableFlattenerFlattenDense(benchmark::State& state) {
+  BM_TableFlattenerFlatten(state, false);
+}
+BENCHMARK(BM_TableFlattenerFlattenDense)->Range(64, 16 << 10);
+
+static void BM_TableFlattenerFlattenSparse(benchmark::State& state) {
+  BM_TableFlattenerFlatten(state, true);
+}
+BENCHMARK(BM_TableFlattenerFlattenSparse)->Range(64, 16 << 10);
+
+}  // namespace aapt
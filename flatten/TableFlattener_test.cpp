@@ -359,6 +359,217 @@ TEST_F(TableFlattenerTest, DoNotUseSparseEntryForDenseConfig) {
   EXPECT_EQ(no_sparse_contents.size(), sparse_contents.size());
 }
 
+// Returns a table with 100 integers, the first `defined_count` of which are also defined for
+// `config`.
+static std::unique_ptr<ResourceTable> BuildTableWithDefinedEntries(const ConfigDescription& config,
+                                                                   size_t defined_count) {
+  test::ResourceTableBuilder builder;
+  builder.SetPackageId("android", 0x01);
+  for (size_t i = 0; i < 100u; i++) {
+    const std::string name = base::StringPrintf("android:integer/foo_%zu", i);
+    const ResourceId id(0x01, 0x02, static_cast<uint16_t>(i));
+    const uint32_t data = static_cast<uint32_t>(i);
+    builder.AddValue(name, id, util::make_unique<BinaryPrimitive>(Res_value::TYPE_INT_DEC, data));
+    if (i < defined_count) {
+      builder.AddValue(name, config, id,
+                       util::make_unique<BinaryPrimitive>(Res_value::TYPE_INT_DEC, data));
+    }
+  }
+  return builder.Build();
+}
+
+TEST_F(TableFlattenerTest, UseSparseEntryOnlyBelowDensityThreshold) {
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder()
+                                              .SetCompilationPackage("android")
+                                              .SetPackageId(0x01)
+                                              .SetMinSdkVersion(SDK_O)
+                                              .Build();
+  const ConfigDescription config = test::ParseConfigOrDie("en-rGB");
+
+  TableFlattenerOptions options;
+  options.use_sparse_entries = true;
+
+  // Sparse encoding is smaller at every density below 100%, but types that are at least
+  // kSparseEncodingThreshold percent defined must keep their constant time lookups.
+  for (size_t defined_count : {50u, 60u, 90u}) {
+    std::unique_ptr<ResourceTable> table = BuildTableWithDefinedEntries(config, defined_count);
+
+    std::string dense_contents;
+    ASSERT_TRUE(Flatten(context.get(), {}, table.get(), &dense_contents));
+
+    std::string sparse_contents;
+    ASSERT_TRUE(Flatten(context.get(), options, table.get(), &sparse_contents));
+
+    if (defined_count < kSparseEncodingThreshold) {
+      // The entries missing from the config save an offset each.
+      EXPECT_EQ(dense_contents.size() - (100u - defined_count) * sizeof(uint32_t),
+                sparse_contents.size())
+          << defined_count << "% defined";
+    } else {
+      EXPECT_EQ(dense_contents.size(), sparse_contents.size()) << defined_count << "% defined";
+    }
+  }
+}
+
+TEST_F(TableFlattenerTest, UseSparseEntryOnlyWhenSavingsCoverLookupCost) {
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder()
+                                              .SetCompilationPackage("android")
+                                              .SetPackageId(0x01)
+                                              .SetMinSdkVersion(SDK_O)
+                                              .Build();
+  std::unique_ptr<ResourceTable> table =
+      BuildTableWithDefinedEntries(test::ParseConfigOrDie("en-rGB"), 50u);
+
+  std::string dense_contents;
+  ASSERT_TRUE(Flatten(context.get(), {}, table.get(), &dense_contents));
+
+  // The 50 missing entries save 200 bytes, which covers 6 binary search steps at 30 bytes each.
+  TableFlattenerOptions options;
+  options.use_sparse_entries = true;
+  options.sparse_lookup_step_cost = 30u;
+  std::string sparse_contents;
+  ASSERT_TRUE(Flatten(context.get(), options, table.get(), &sparse_contents));
+  EXPECT_EQ(dense_contents.size() - 50u * sizeof(uint32_t), sparse_contents.size());
+
+  // It doesn't cover them at 40 bytes each, which keeps the type dense.
+  options.sparse_lookup_step_cost = 40u;
+  std::string costly_contents;
+  ASSERT_TRUE(Flatten(context.get(), options, table.get(), &costly_contents));
+  EXPECT_EQ(dense_contents.size(), costly_contents.size());
+}
+
+TEST(TableFlattenerCostTest, CostOfTypeOffsets) {
+  TableFlattenerOptions options;
+  TypeOffsetsCost cost = CostOfTypeOffsets(100u, 60u, false /*offset16*/, options);
+  EXPECT_EQ(400u, cost.dense_size);
+  EXPECT_EQ(240u, cost.sparse_size);
+  EXPECT_EQ(0u, cost.sparse_lookup_cost);
+
+  // 16 bit offsets are padded to 4 bytes and make sparse encoding less attractive.
+  cost = CostOfTypeOffsets(101u, 60u, true /*offset16*/, options);
+  EXPECT_EQ(204u, cost.dense_size);
+  EXPECT_EQ(240u, cost.sparse_size);
+
+  // Finding one of 60 entries takes 6 steps of binary search.
+  options.sparse_lookup_step_cost = 10u;
+  cost = CostOfTypeOffsets(100u, 60u, false /*offset16*/, options);
+  EXPECT_EQ(60u, cost.sparse_lookup_cost);
+
+  cost = CostOfTypeOffsets(100u, 1u, false /*offset16*/, options);
+  EXPECT_EQ(0u, cost.sparse_lookup_cost);
+}
+
+TEST_F(TableFlattenerTest, FlattenCompactEntriesWithMinSdkU) {
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder()
+                                              .SetCompilationPackage("android")
+                                              .SetPackageId(0x01)
+                                              .SetMinSdkVersion(SDK_U)
+                                              .Build();
+  std::unique_ptr<ResourceTable> table =
+      test::ResourceTableBuilder()
+          .SetPackageId("android", 0x01)
+          .AddString("android:string/foo", ResourceId(0x01030000), "foo")
+          .SetSymbolState("android:string/foo", ResourceId(0x01030000), SymbolState::kPublic)
+          .AddValue("android:integer/one", ResourceId(0x01040000),
+                    util::make_unique<BinaryPrimitive>(Res_value::TYPE_INT_DEC, 1u))
+          .AddValue("android:style/Theme", ResourceId(0x01050000),
+                    test::StyleBuilder()
+                        .AddItem("android:attr/bar", ResourceId(0x01010000),
+                                 ResourceUtils::TryParseInt("2"))
+                        .Build())
+          .Build();
+
+  TableFlattenerOptions options;
+  options.use_compact_entries = true;
+
+  std::string full_contents;
+  ASSERT_TRUE(Flatten(context.get(), {}, table.get(), &full_contents));
+
+  std::string compact_contents;
+  ASSERT_TRUE(Flatten(context.get(), options, table.get(), &compact_contents));
+
+  EXPECT_GT(full_contents.size(), compact_contents.size());
+
+  ResourceTable compact_table;
+  BinaryResourceParser parser(context.get(), &compact_table, Source("test.arsc"),
+                              compact_contents.data(), compact_contents.size());
+  ASSERT_TRUE(parser.Parse());
+
+  String* str = test::GetValue<String>(&compact_table, "android:string/foo");
+  ASSERT_THAT(str, NotNull());
+  EXPECT_EQ("foo", *str->value);
+
+  Maybe<ResourceTable::SearchResult> result =
+      compact_table.FindResource(test::ParseNameOrDie("android:string/foo"));
+  ASSERT_TRUE(result);
+  EXPECT_EQ(SymbolState::kPublic, result.value().entry->symbol_status.state);
+
+  BinaryPrimitive* one = test::GetValue<BinaryPrimitive>(&compact_table, "android:integer/one");
+  ASSERT_THAT(one, NotNull());
+  EXPECT_EQ(Res_value::TYPE_INT_DEC, one->value.dataType);
+  EXPECT_EQ(1u, one->value.data);
+
+  Style* style = test::GetValue<Style>(&compact_table, "android:style/Theme");
+  ASSERT_THAT(style, NotNull());
+  ASSERT_EQ(1u, style->entries.size());
+}
+
+TEST_F(TableFlattenerTest, FlattenSparseCompactEntriesWithMinSdkU) {
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder()
+                                              .SetCompilationPackage("android")
+                                              .SetPackageId(0x01)
+                                              .SetMinSdkVersion(SDK_U)
+                                              .Build();
+
+  const ConfigDescription sparse_config = test::ParseConfigOrDie("en-rGB");
+  auto table_in = BuildTableWithSparseEntries(context.get(), sparse_config, 0.25f);
+
+  TableFlattenerOptions options;
+  options.use_sparse_entries = true;
+  options.use_compact_entries = true;
+
+  std::string contents;
+  ASSERT_TRUE(Flatten(context.get(), options, table_in.get(), &contents));
+
+  ResourceTable table;
+  BinaryResourceParser parser(context.get(), &table, Source("test.arsc"), contents.data(),
+                              contents.size());
+  ASSERT_TRUE(parser.Parse());
+
+  auto value =
+      test::GetValueForConfig<BinaryPrimitive>(&table, "android:string/foo_4", sparse_config);
+  ASSERT_THAT(value, NotNull());
+  EXPECT_EQ(4u, value->value.data);
+  EXPECT_THAT(
+      test::GetValueForConfig<BinaryPrimitive>(&table, "android:string/foo_1", sparse_config),
+      IsNull());
+
+  value = test::GetValue<BinaryPrimitive>(&table, "android:string/foo_99");
+  ASSERT_THAT(value, NotNull());
+  EXPECT_EQ(99u, value->value.data);
+}
+
+TEST_F(TableFlattenerTest, DoNotUseCompactEntriesBelowSdkU) {
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder()
+                                              .SetCompilationPackage("android")
+                                              .SetPackageId(0x01)
+                                              .SetMinSdkVersion(SDK_O)
+                                              .Build();
+  auto table_in = BuildTableWithSparseEntries(context.get(), test::ParseConfigOrDie("en-rGB"),
+                                              0.25f);
+
+  TableFlattenerOptions options;
+  options.use_compact_entries = true;
+
+  std::string full_contents;
+  ASSERT_TRUE(Flatten(context.get(), {}, table_in.get(), &full_contents));
+
+  std::string compact_contents;
+  ASSERT_TRUE(Flatten(context.get(), options, table_in.get(), &compact_contents));
+
+  EXPECT_EQ(full_contents, compact_contents);
+}
+
 TEST_F(TableFlattenerTest, FlattenSharedLibrary) {
   std::unique_ptr<IAaptContext> context =
       test::ContextBuilder().SetCompilationPackage("lib").SetPackageId(0x00).Build();
@@ -467,4 +678,77 @@ TEST_F(TableFlattenerTest, LongSharedLibraryPackageNameIsIllegal) {
   ASSERT_FALSE(Flatten(context.get(), {}, table.get(), &result));
 }
 
+TEST_F(TableFlattenerTest, ObfuscatingResourceNamesKeepsWhitelistedNames) {
+  std::unique_ptr<ResourceTable> table =
+      test::ResourceTableBuilder()
+          .SetPackageId("com.app.test", 0x7f)
+          .AddSimple("com.app.test:id/one", ResourceId(0x7f020000))
+          .AddString("com.app.test:string/kept", ResourceId(0x7f030000), "kept")
+          .AddString("com.app.test:string/collapsed", ResourceId(0x7f030001), "collapsed")
+          .Build();
+
+  TableFlattenerOptions options;
+  options.collapse_key_stringpool = true;
+  options.whitelisted_resources.insert(ResourceName({}, ResourceType::kString, "kept"));
+
+  ResourceTable result;
+  ASSERT_TRUE(Flatten(context_.get(), options, table.get(), &result));
+
+  EXPECT_THAT(test::GetValue<Id>(&result, "com.app.test:id/one"), IsNull());
+  EXPECT_THAT(test::GetValue<String>(&result, "com.app.test:string/collapsed"), IsNull());
+
+  String* kept = test::GetValue<String>(&result, "com.app.test:string/kept");
+  ASSERT_THAT(kept, NotNull());
+  EXPECT_EQ("kept", *kept->value);
+
+  EXPECT_THAT(
+      test::GetValue<Id>(&result, "com.app.test:id/0_resource_name_obfuscated_7f020000"),
+      NotNull());
+  String* collapsed = test::GetValue<String>(
+      &result, "com.app.test:string/0_resource_name_obfuscated_7f030001");
+  ASSERT_THAT(collapsed, NotNull());
+  EXPECT_EQ("collapsed", *collapsed->value);
+}
+
+TEST_F(TableFlattenerTest, CollapsedNamesStayCollapsedWhenFlattenedAgain) {
+  std::unique_ptr<ResourceTable> table =
+      test::ResourceTableBuilder()
+          .SetPackageId("com.app.test", 0x7f)
+          .AddString("com.app.test:string/one", ResourceId(0x7f030000), "one")
+          .AddString("com.app.test:string/two", ResourceId(0x7f030001), "two")
+          .AddString("com.app.test:string/three", ResourceId(0x7f030002), "three")
+          .Build();
+
+  TableFlattenerOptions options;
+  options.collapse_key_stringpool = true;
+  std::string collapsed;
+  ASSERT_TRUE(Flatten(context_.get(), options, table.get(), &collapsed));
+
+  ResourceTable parsed;
+  BinaryResourceParser parser(context_.get(), &parsed, {}, collapsed.data(), collapsed.size());
+  ASSERT_TRUE(parser.Parse());
+
+  // Without --collapse-resource-names, the per-ID names must not each become a key.
+  std::string reflattened;
+  ASSERT_TRUE(Flatten(context_.get(), {}, &parsed, &reflattened));
+  EXPECT_EQ(collapsed.size(), reflattened.size());
+
+  ResourceTable result;
+  BinaryResourceParser result_parser(context_.get(), &result, {}, reflattened.data(),
+                                     reflattened.size());
+  ASSERT_TRUE(result_parser.Parse());
+  String* two = test::GetValue<String>(
+      &result, "com.app.test:string/0_resource_name_obfuscated_7f030001");
+  ASSERT_THAT(two, NotNull());
+  EXPECT_EQ("two", *two->value);
+}
+
+TEST(TableFlattenerObfuscationTest, IsObfuscatedResourceName) {
+  EXPECT_TRUE(IsObfuscatedResourceName("0_resource_name_obfuscated_7f030001"));
+  EXPECT_FALSE(IsObfuscatedResourceName("0_resource_name_obfuscated"));
+  EXPECT_FALSE(IsObfuscatedResourceName("0_resource_name_obfuscated_7f03000"));
+  EXPECT_FALSE(IsObfuscatedResourceName("0_resource_name_obfuscated_7f03000g"));
+  EXPECT_FALSE(IsObfuscatedResourceName("resource_7f030001"));
+}
+
 }  // namespace aapt
@@ -133,6 +133,58 @@ class MmappedData : public IData {
   size_t next_read_ = 0;
 };
 
+// Implementation of IData that exposes a region of a memory mapped file that is shared with other
+// instances. The mapping is released when the last instance referring to it is destroyed.
+class SharedMmappedData : public IData {
+ public:
+  SharedMmappedData(std::shared_ptr<const android::FileMap> map, size_t offset, size_t len)
+      : map_(std::move(map)), offset_(offset), len_(len) {}
+  virtual ~SharedMmappedData() = default;
+
+  const void* data() const override {
+    return reinterpret_cast<const uint8_t*>(map_->getDataPtr()) + offset_;
+  }
+
+  size_t size() const override { return len_; }
+
+  bool Next(const void** data, size_t* size) override {
+    if (next_read_ == len_) {
+      return false;
+    }
+    *data = reinterpret_cast<const uint8_t*>(map_->getDataPtr()) + offset_ + next_read_;
+    *size = len_ - next_read_;
+    next_read_ = len_;
+    return true;
+  }
+
+  void BackUp(size_t count) override {
+    if (count > next_read_) {
+      next_read_ = 0;
+    } else {
+      next_read_ -= count;
+    }
+  }
+
+  bool CanRewind() const override { return true; }
+
+  bool Rewind() override {
+    next_read_ = 0;
+    return true;
+  }
+
+  size_t ByteCount() const override { return next_read_; }
+
+  bool HadError() const override { return false; }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(SharedMmappedData);
+
+  std::shared_ptr<const android::FileMap> map_;
+  size_t offset_;
+  size_t len_;
+  size_t next_read_ = 0;
+};
+
 // Implementation of IData that exposes a block of memory that was malloc'ed (new'ed).
 // The memory is owned by this object.
 class MallocData : public IData {
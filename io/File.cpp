@@ -27,17 +27,28 @@ IFile* IFile::CreateFileSegment(size_t offset, size_t len) {
   return file_segment;
 }
 
-std::unique_ptr<IData> FileSegment::OpenAsData() {
-  std::unique_ptr<IData> data = file_->OpenAsData();
+std::unique_ptr<IData> IFile::OpenRangeAsData(size_t offset, size_t len) {
+  std::unique_ptr<IData> data = OpenAsData();
   if (!data) {
     return {};
   }
 
-  if (offset_ <= data->size() - len_) {
-    return util::make_unique<DataSegment>(std::move(data), offset_, len_);
+  if (offset <= data->size() && len <= data->size() - offset) {
+    return util::make_unique<DataSegment>(std::move(data), offset, len);
   }
   return {};
 }
 
+std::unique_ptr<IData> FileSegment::OpenAsData() {
+  return file_->OpenRangeAsData(offset_, len_);
+}
+
+std::unique_ptr<IData> FileSegment::OpenRangeAsData(size_t offset, size_t len) {
+  if (offset > len_ || len > len_ - offset) {
+    return {};
+  }
+  return file_->OpenRangeAsData(offset_ + offset, len);
+}
+
 }  // namespace io
 }  // namespace aapt
@@ -30,6 +30,18 @@
 namespace aapt {
 namespace io {
 
+// The contents of a file as they are encoded in a ZIP archive, along with what is needed to
+// describe them in another archive's headers.
+struct EncodedData {
+  // The bytes of the entry, deflated if `compressed` is true.
+  std::unique_ptr<IData> data;
+  bool compressed = false;
+
+  // The CRC-32 and size of the uncompressed contents.
+  uint32_t crc32 = 0u;
+  size_t uncompressed_size = 0u;
+};
+
 // Interface for a file, which could be a real file on the file system, or a
 // file inside a ZIP archive.
 class IFile {
@@ -43,6 +55,11 @@ class IFile {
   // Returns nullptr on failure.
   virtual std::unique_ptr<IData> OpenAsData() = 0;
 
+  // Opens `len` bytes of the file starting at `offset`. Implementations that memory map the file
+  // map only that range. By default, the whole file is opened and a view into it is returned.
+  // Returns nullptr on failure or if the range extends past the end of the file.
+  virtual std::unique_ptr<IData> OpenRangeAsData(size_t offset, size_t len);
+
   // Returns the source of this file. This is for presentation to the user and
   // may not be a valid file system path (for example, it may contain a '@' sign to separate
   // the files within a ZIP archive from the path to the containing ZIP archive.
@@ -55,6 +72,19 @@ class IFile {
     return false;
   }
 
+  // Returns the CRC-32 of the file's uncompressed contents, if it is known without reading the
+  // file (as it is for entries of a ZIP archive, where it is recorded in the central directory).
+  virtual Maybe<uint32_t> GetCrc32() {
+    return {};
+  }
+
+  // Opens the file as it is encoded in its ZIP archive, so that it can be copied into another
+  // archive without being inflated and compressed again. Returns false if the file is not an entry
+  // of a ZIP archive or can't be opened.
+  virtual bool OpenAsEncodedData(EncodedData* out_data) {
+    return false;
+  }
+
  private:
   // Any segments created from this IFile need to be owned by this IFile, so
   // keep them
@@ -71,6 +101,7 @@ class FileSegment : public IFile {
       : file_(file), offset_(offset), len_(len) {}
 
   std::unique_ptr<IData> OpenAsData() override;
+  std::unique_ptr<IData> OpenRangeAsData(size_t offset, size_t len) override;
 
   const Source& GetSource() const override { return file_->GetSource(); }
 
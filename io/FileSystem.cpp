@@ -42,6 +42,16 @@ std::unique_ptr<IData> RegularFile::OpenAsData() {
   return {};
 }
 
+std::unique_ptr<IData> RegularFile::OpenRangeAsData(size_t offset, size_t len) {
+  if (Maybe<android::FileMap> map = file::MmapPath(source_.path, offset, len, nullptr)) {
+    if (map.value().getDataPtr() && map.value().getDataLength() > 0) {
+      return util::make_unique<MmappedData>(std::move(map.value()));
+    }
+    return util::make_unique<EmptyData>();
+  }
+  return {};
+}
+
 const Source& RegularFile::GetSource() const { return source_; }
 
 FileCollectionIterator::FileCollectionIterator(FileCollection* collection)
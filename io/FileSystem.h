@@ -32,6 +32,7 @@ class RegularFile : public IFile {
   explicit RegularFile(const Source& source);
 
   std::unique_ptr<IData> OpenAsData() override;
+  std::unique_ptr<IData> OpenRangeAsData(size_t offset, size_t len) override;
   const Source& GetSource() const override;
 
  private:
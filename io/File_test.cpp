@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "io/File.h"
+
+#include <cstring>
+
+#include "test/Test.h"
+
+using ::testing::Eq;
+using ::testing::IsNull;
+using ::testing::NotNull;
+
+namespace aapt {
+namespace io {
+
+namespace {
+
+// An in-memory file that uses the default IFile::OpenRangeAsData().
+class MemoryFile : public IFile {
+ public:
+  explicit MemoryFile(const std::string& contents) : contents_(contents), source_("test.flat") {
+  }
+
+  std::unique_ptr<IData> OpenAsData() override {
+    std::unique_ptr<uint8_t[]> data(new uint8_t[contents_.size()]);
+    memcpy(data.get(), contents_.data(), contents_.size());
+    return util::make_unique<MallocData>(std::move(data), contents_.size());
+  }
+
+  const Source& GetSource() const override {
+    return source_;
+  }
+
+ private:
+  std::string contents_;
+  Source source_;
+};
+
+std::string ToString(const IData& data) {
+  return std::string(static_cast<const char*>(data.data()), data.size());
+}
+
+}  // namespace
+
+TEST(FileTest, SegmentOpensItsRange) {
+  MemoryFile file("headerpayload");
+  IFile* segment = file.CreateFileSegment(6u, 7u);
+
+  std::unique_ptr<IData> data = segment->OpenAsData();
+  ASSERT_THAT(data, NotNull());
+  EXPECT_THAT(ToString(*data), Eq("payload"));
+
+  data = segment->OpenRangeAsData(3u, 4u);
+  ASSERT_THAT(data, NotNull());
+  EXPECT_THAT(ToString(*data), Eq("load"));
+}
+
+TEST(FileTest, RangePastTheEndFails) {
+  MemoryFile file("header");
+  EXPECT_THAT(file.OpenRangeAsData(0u, 7u), IsNull());
+  EXPECT_THAT(file.OpenRangeAsData(7u, 0u), IsNull());
+  EXPECT_THAT(file.CreateFileSegment(4u, 4u)->OpenAsData(), IsNull());
+
+  IFile* segment = file.CreateFileSegment(2u, 2u);
+  EXPECT_THAT(segment->OpenRangeAsData(1u, 2u), IsNull());
+  EXPECT_THAT(segment->OpenRangeAsData(2u, 0u), NotNull());
+}
+
+}  // namespace io
+}  // namespace aapt
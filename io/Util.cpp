@@ -37,6 +37,23 @@ bool CopyInputStreamToArchive(IAaptContext* context, InputStream* in, const std:
 
 bool CopyFileToArchive(IAaptContext* context, io::IFile* file, const std::string& out_path,
                        uint32_t compression_flags, IArchiveWriter* writer) {
+  // Copy the encoded bytes as they are when they are already stored the way they are wanted,
+  // which saves inflating and deflating entries of the input APK again.
+  io::EncodedData encoded;
+  if (writer->CanWriteEncodedFiles() && file->OpenAsEncodedData(&encoded) &&
+      encoded.compressed == ((compression_flags & ArchiveEntry::kCompress) != 0)) {
+    if (context->IsVerbose()) {
+      context->GetDiagnostics()->Note(DiagMessage() << "writing " << out_path << " to archive");
+    }
+
+    if (!writer->WriteEncodedFile(out_path, compression_flags, encoded)) {
+      context->GetDiagnostics()->Error(DiagMessage() << "failed to write " << out_path
+                                                     << " to archive: " << writer->GetError());
+      return false;
+    }
+    return true;
+  }
+
   std::unique_ptr<io::IData> data = file->OpenAsData();
   if (!data) {
     context->GetDiagnostics()->Error(DiagMessage(file->GetSource()) << "failed to open file");
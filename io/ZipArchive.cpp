@@ -16,6 +16,10 @@
 
 #include "io/ZipArchive.h"
 
+#include <sys/stat.h>
+
+#include <limits>
+
 #include "utils/FileMap.h"
 #include "ziparchive/zip_archive.h"
 
@@ -28,20 +32,15 @@ namespace aapt {
 namespace io {
 
 ZipFile::ZipFile(ZipArchiveHandle handle, const ZipEntry& entry,
-                 const Source& source)
-    : zip_handle_(handle), zip_entry_(entry), source_(source) {}
+                 const Source& source, std::shared_ptr<const android::FileMap> archive_map)
+    : zip_handle_(handle),
+      zip_entry_(entry),
+      source_(source),
+      archive_map_(std::move(archive_map)) {}
 
 std::unique_ptr<IData> ZipFile::OpenAsData() {
   if (zip_entry_.method == kCompressStored) {
-    int fd = GetFileDescriptor(zip_handle_);
-
-    android::FileMap file_map;
-    bool result = file_map.create(nullptr, fd, zip_entry_.offset,
-                                  zip_entry_.uncompressed_length, true);
-    if (!result) {
-      return {};
-    }
-    return util::make_unique<MmappedData>(std::move(file_map));
+    return OpenRangeAsData(0u, zip_entry_.uncompressed_length);
 
   } else {
     std::unique_ptr<uint8_t[]> data =
@@ -57,12 +56,77 @@ std::unique_ptr<IData> ZipFile::OpenAsData() {
   }
 }
 
+std::unique_ptr<IData> ZipFile::OpenRangeAsData(size_t offset, size_t len) {
+  if (zip_entry_.method != kCompressStored) {
+    // Compressed entries must be inflated from the start.
+    return IFile::OpenRangeAsData(offset, len);
+  }
+
+  const size_t entry_len = zip_entry_.uncompressed_length;
+  if (offset > entry_len || len > entry_len - offset) {
+    return {};
+  }
+
+  if (len == 0u) {
+    return util::make_unique<EmptyData>();
+  }
+
+  if (archive_map_) {
+    const size_t map_len = archive_map_->getDataLength();
+    const uint64_t start = static_cast<uint64_t>(zip_entry_.offset) + offset;
+    if (start <= map_len && len <= map_len - start) {
+      return util::make_unique<SharedMmappedData>(archive_map_, static_cast<size_t>(start), len);
+    }
+  }
+
+  // Stored entries are mapped straight out of the archive, so only the requested bytes
+  // are ever paged in.
+  int fd = GetFileDescriptor(zip_handle_);
+  android::FileMap file_map;
+  bool result = file_map.create(nullptr, fd, zip_entry_.offset + offset, len, true);
+  if (!result) {
+    return {};
+  }
+  return util::make_unique<MmappedData>(std::move(file_map));
+}
+
 const Source& ZipFile::GetSource() const { return source_; }
 
 bool ZipFile::WasCompressed() {
   return zip_entry_.method != kCompressStored;
 }
 
+Maybe<uint32_t> ZipFile::GetCrc32() {
+  return zip_entry_.crc32;
+}
+
+bool ZipFile::OpenAsEncodedData(EncodedData* out_data) {
+  if (zip_entry_.method != kCompressStored && zip_entry_.method != kCompressDeflated) {
+    return false;
+  }
+
+  const size_t len = zip_entry_.compressed_length;
+  if (len == 0u) {
+    out_data->data = util::make_unique<EmptyData>();
+  } else if (archive_map_ &&
+             static_cast<uint64_t>(zip_entry_.offset) <= archive_map_->getDataLength() &&
+             len <= archive_map_->getDataLength() - zip_entry_.offset) {
+    out_data->data = util::make_unique<SharedMmappedData>(
+        archive_map_, static_cast<size_t>(zip_entry_.offset), len);
+  } else {
+    android::FileMap file_map;
+    if (!file_map.create(nullptr, GetFileDescriptor(zip_handle_), zip_entry_.offset, len, true)) {
+      return false;
+    }
+    out_data->data = util::make_unique<MmappedData>(std::move(file_map));
+  }
+
+  out_data->compressed = zip_entry_.method != kCompressStored;
+  out_data->crc32 = zip_entry_.crc32;
+  out_data->uncompressed_size = zip_entry_.uncompressed_length;
+  return true;
+}
+
 ZipFileCollectionIterator::ZipFileCollectionIterator(
     ZipFileCollection* collection)
     : current_(collection->files_.begin()), end_(collection->files_.end()) {}
@@ -97,6 +161,20 @@ std::unique_ptr<ZipFileCollection> ZipFileCollection::Create(
     return {};
   }
 
+  // Map the whole archive once so that opening each stored entry doesn't cost an mmap and munmap
+  // of its own. This matters for archives of compiled files (.flata), which hold thousands of
+  // small entries. If the mapping fails, entries are mapped one at a time.
+  std::shared_ptr<const android::FileMap> archive_map;
+  const int fd = GetFileDescriptor(collection->handle_);
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size > 0 &&
+      static_cast<uint64_t>(st.st_size) <= std::numeric_limits<size_t>::max()) {
+    auto file_map = std::make_shared<android::FileMap>();
+    if (file_map->create(nullptr, fd, 0, static_cast<size_t>(st.st_size), true)) {
+      archive_map = std::move(file_map);
+    }
+  }
+
   void* cookie = nullptr;
   result = StartIteration(collection->handle_, &cookie, nullptr, nullptr);
   if (result != 0) {
@@ -115,7 +193,7 @@ std::unique_ptr<ZipFileCollection> ZipFileCollection::Create(
                     zip_entry_name.name_length);
     std::string nested_path = path.to_string() + "@" + zip_entry_path;
     std::unique_ptr<IFile> file =
-        util::make_unique<ZipFile>(collection->handle_, zip_data, Source(nested_path));
+        util::make_unique<ZipFile>(collection->handle_, zip_data, Source(nested_path), archive_map);
     collection->files_by_name_[zip_entry_path] = file.get();
     collection->files_.push_back(std::move(file));
   }
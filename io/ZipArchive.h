@@ -20,8 +20,10 @@
 #include "ziparchive/zip_archive.h"
 
 #include <map>
+#include <memory>
 
 #include "androidfw/StringPiece.h"
+#include "utils/FileMap.h"
 
 #include "io/File.h"
 
@@ -33,19 +35,27 @@ namespace io {
  * it is uncompressed
  * and copied into memory when opened. Otherwise it is mmapped from the ZIP
  * archive.
+ *
+ * If `archive_map` is set, it is a mapping of the whole archive that stored
+ * entries are served from, instead of mapping each entry separately.
  */
 class ZipFile : public IFile {
  public:
-  ZipFile(ZipArchiveHandle handle, const ZipEntry& entry, const Source& source);
+  ZipFile(ZipArchiveHandle handle, const ZipEntry& entry, const Source& source,
+          std::shared_ptr<const android::FileMap> archive_map = {});
 
   std::unique_ptr<IData> OpenAsData() override;
+  std::unique_ptr<IData> OpenRangeAsData(size_t offset, size_t len) override;
   const Source& GetSource() const override;
   bool WasCompressed() override;
+  Maybe<uint32_t> GetCrc32() override;
+  bool OpenAsEncodedData(EncodedData* out_data) override;
 
  private:
   ZipArchiveHandle zip_handle_;
   ZipEntry zip_entry_;
   Source source_;
+  std::shared_ptr<const android::FileMap> archive_map_;
 };
 
 class ZipFileCollection;
@@ -16,9 +16,15 @@
 
 #include "java/ProguardRules.h"
 
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <memory>
+#include <sstream>
 #include <string>
 
+#include "android-base/errors.h"
 #include "android-base/macros.h"
 
 #include "util/Util.h"
@@ -300,17 +306,170 @@ bool WriteKeepSet(std::ostream* out, const KeepSet& keep_set) {
     for (const Source& source : entry.second) {
       *out << "# Referenced at " << source << "\n";
     }
-    *out << "-keep class " << entry.first << " { <init>(...); }\n" << std::endl;
+    *out << "-keep class " << entry.first << " { <init>(...); }\n\n";
   }
 
   for (const auto& entry : keep_set.keep_method_set_) {
     for (const Source& source : entry.second) {
       *out << "# Referenced at " << source << "\n";
     }
-    *out << "-keepclassmembers class * { *** " << entry.first << "(...); }\n" << std::endl;
+    *out << "-keepclassmembers class * { *** " << entry.first << "(...); }\n\n";
   }
   return true;
 }
 
+constexpr const char* kKeepRuleCacheHeader = "aapt2-keep-rules";
+constexpr int kKeepRuleCacheVersion = 1;
+
+// The rules of a file depend on its contents, on its path, which they are attributed to, on its
+// type, which decides which rules are collected, and on the aapt2 that collects them.
+static uint64_t GetKeepRuleCacheKey(uint64_t content_digest, const Source& source,
+                                    ResourceType type) {
+  return util::Hasher()
+      .Update(util::GetMajorVersion())
+      .Update(util::GetMinorVersion())
+      .Update(source.path)
+      .UpdateInt(static_cast<uint64_t>(type))
+      .UpdateInt(content_digest)
+      .Digest();
+}
+
+void KeepRuleCache::AddRules(const KeepSet& rules, KeepSet* keep_set) {
+  for (const auto& entry : rules.keep_set_) {
+    keep_set->keep_set_[entry.first].insert(entry.second.begin(), entry.second.end());
+  }
+  for (const auto& entry : rules.keep_method_set_) {
+    keep_set->keep_method_set_[entry.first].insert(entry.second.begin(), entry.second.end());
+  }
+}
+
+void KeepRuleCache::Load(const std::string& path) {
+  entries_.clear();
+
+  std::ifstream fin(path, std::ifstream::binary);
+  std::string line;
+  if (!fin || !std::getline(fin, line)) {
+    return;
+  }
+
+  char header[32] = {};
+  int version = 0;
+  if (sscanf(line.c_str(), "%31s %d", header, &version) != 2 ||
+      strcmp(header, kKeepRuleCacheHeader) != 0 || version != kKeepRuleCacheVersion) {
+    return;
+  }
+
+  while (std::getline(fin, line)) {
+    uint64_t key = 0u;
+    uint64_t rule_count = 0u;
+    int path_offset = 0;
+    if (sscanf(line.c_str(), "file %" SCNx64 " %" SCNu64 " %n", &key, &rule_count,
+               &path_offset) != 2 ||
+        path_offset == 0 || static_cast<size_t>(path_offset) >= line.size()) {
+      // A corrupt cache only costs us collecting the rules again.
+      entries_.clear();
+      return;
+    }
+
+    Entry& entry = entries_[key];
+    entry.path = line.substr(path_offset);
+    for (uint64_t i = 0; i < rule_count; i++) {
+      char kind[8] = {};
+      uint64_t line_number = 0u;
+      int name_offset = 0;
+      if (!std::getline(fin, line) ||
+          sscanf(line.c_str(), "%7s %" SCNu64 " %n", kind, &line_number, &name_offset) != 2 ||
+          name_offset == 0 || static_cast<size_t>(name_offset) >= line.size()) {
+        entries_.clear();
+        return;
+      }
+
+      const Source source = line_number != 0u
+                                ? Source(entry.path, static_cast<size_t>(line_number))
+                                : Source(entry.path);
+      if (strcmp(kind, "class") == 0) {
+        entry.rules.AddClass(source, line.substr(name_offset));
+      } else if (strcmp(kind, "method") == 0) {
+        entry.rules.AddMethod(source, line.substr(name_offset));
+      } else {
+        entries_.clear();
+        return;
+      }
+    }
+  }
+}
+
+bool KeepRuleCache::Save(const std::string& path, std::string* out_error) const {
+  std::ostringstream out;
+  out << kKeepRuleCacheHeader << " " << kKeepRuleCacheVersion << "\n";
+
+  auto write_rules = [&](const char* kind,
+                         const std::map<std::string, std::set<Source>>& rules) -> void {
+    for (const auto& rule : rules) {
+      for (const Source& source : rule.second) {
+        out << kind << " " << (source.line ? source.line.value() : 0u) << " " << rule.first
+            << "\n";
+      }
+    }
+  };
+
+  for (const auto& entry : entries_) {
+    const Entry& cached = entry.second;
+    if (!cached.used) {
+      continue;
+    }
+
+    // Every field ends at the end of its line, so a rule whose name spans several lines can't be
+    // stored. Such files are walked again next time.
+    size_t rule_count = 0u;
+    bool storable = cached.path.find('\n') == std::string::npos;
+    for (const auto* rules : {&cached.rules.keep_set_, &cached.rules.keep_method_set_}) {
+      for (const auto& rule : *rules) {
+        storable = storable && rule.first.find('\n') == std::string::npos;
+        rule_count += rule.second.size();
+      }
+    }
+    if (!storable) {
+      continue;
+    }
+
+    char key[17] = {};
+    snprintf(key, sizeof(key), "%016" PRIx64, entry.first);
+    out << "file " << key << " " << rule_count << " " << cached.path << "\n";
+    write_rules("class", cached.rules.keep_set_);
+    write_rules("method", cached.rules.keep_method_set_);
+  }
+
+  std::ofstream fout(path, std::ofstream::binary);
+  const std::string out_str = out.str();
+  if (!fout || !fout.write(out_str.data(), out_str.size())) {
+    if (out_error) *out_error = android::base::SystemErrorCodeToString(errno);
+    return false;
+  }
+  return true;
+}
+
+bool KeepRuleCache::CollectProguardRules(uint64_t content_digest, const Source& source,
+                                         xml::XmlResource* res, KeepSet* keep_set) {
+  const uint64_t key = GetKeepRuleCacheKey(content_digest, source, res->file.name.type);
+  auto iter = entries_.find(key);
+  if (iter != entries_.end() && iter->second.path == source.path) {
+    iter->second.used = true;
+    hit_count_++;
+    AddRules(iter->second.rules, keep_set);
+    return true;
+  }
+
+  Entry entry;
+  entry.path = source.path;
+  entry.used = true;
+  if (!proguard::CollectProguardRules(source, res, &entry.rules)) {
+    return false;
+  }
+  AddRules(entry.rules, keep_set);
+  entries_[key] = std::move(entry);
+  return true;
+}
+
 }  // namespace proguard
 }  // namespace aapt
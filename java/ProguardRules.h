@@ -17,11 +17,14 @@
 #ifndef AAPT_PROGUARD_RULES_H
 #define AAPT_PROGUARD_RULES_H
 
+#include <cstdint>
 #include <map>
 #include <ostream>
 #include <set>
 #include <string>
 
+#include "android-base/macros.h"
+
 #include "Resource.h"
 #include "Source.h"
 #include "xml/XmlDom.h"
@@ -40,6 +43,7 @@ class KeepSet {
   }
 
  private:
+  friend class KeepRuleCache;
   friend bool WriteKeepSet(std::ostream* out, const KeepSet& keep_set);
 
   std::map<std::string, std::set<Source>> keep_set_;
@@ -54,6 +58,46 @@ bool CollectProguardRules(const Source& source, xml::XmlResource* res,
 
 bool WriteKeepSet(std::ostream* out, const KeepSet& keep_set);
 
+// Remembers the keep rules collected from each XML file, keyed by a digest of the file's contents,
+// its path and type and the version of aapt2. Persisted across links, it lets an incremental link
+// add the rules of every unchanged file without walking the file again.
+class KeepRuleCache {
+ public:
+  KeepRuleCache() = default;
+
+  // Loads a cache written by Save(). A missing or corrupt cache leaves this one empty.
+  void Load(const std::string& path);
+
+  // Writes the rules of every file that was collected or found since Load(), so that rules of
+  // files that are no longer linked are dropped.
+  bool Save(const std::string& path, std::string* out_error) const;
+
+  // Adds the keep rules of `res`, whose compiled contents digest to `content_digest`, to
+  // `keep_set`. The rules are taken from the cache if they were collected from the same contents
+  // at the same path before, and collected and cached otherwise.
+  bool CollectProguardRules(uint64_t content_digest, const Source& source, xml::XmlResource* res,
+                            KeepSet* keep_set);
+
+  // The number of files whose rules were taken from the cache.
+  size_t hit_count() const {
+    return hit_count_;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(KeepRuleCache);
+
+  static void AddRules(const KeepSet& rules, KeepSet* keep_set);
+
+  struct Entry {
+    std::string path;
+    KeepSet rules;
+    bool used = false;
+  };
+
+  std::map<uint64_t, Entry> entries_;
+  size_t hit_count_ = 0u;
+};
+
 }  // namespace proguard
 }  // namespace aapt
 
@@ -16,6 +16,8 @@
 
 #include "java/ProguardRules.h"
 
+#include "android-base/test_utils.h"
+
 #include "test/Test.h"
 
 using ::testing::HasSubstr;
@@ -116,4 +118,117 @@ TEST(ProguardRulesTest, MenuRulesAreEmitted) {
   EXPECT_THAT(actual, Not(HasSubstr("com.foo.Bat")));
 }
 
+TEST(ProguardRulesTest, RulesAreSeparatedByBlankLines) {
+  proguard::KeepSet set;
+  set.AddClass(Source("res/layout/foo.xml", 3u), "com.foo.Bar");
+  set.AddMethod(Source("res/layout/foo.xml", 5u), "onClick");
+
+  std::stringstream out;
+  ASSERT_TRUE(proguard::WriteKeepSet(&out, set));
+
+  EXPECT_EQ(
+      "# Referenced at res/layout/foo.xml:3\n"
+      "-keep class com.foo.Bar { <init>(...); }\n"
+      "\n"
+      "# Referenced at res/layout/foo.xml:5\n"
+      "-keepclassmembers class * { *** onClick(...); }\n"
+      "\n",
+      out.str());
+}
+
+static std::unique_ptr<xml::XmlResource> BuildLayout(const std::string& xml) {
+  std::unique_ptr<xml::XmlResource> layout = test::BuildXmlDom(xml);
+  layout->file.name = test::ParseNameOrDie("layout/foo");
+  return layout;
+}
+
+static std::string WriteKeepSetToString(const proguard::KeepSet& set) {
+  std::stringstream out;
+  proguard::WriteKeepSet(&out, set);
+  return out.str();
+}
+
+TEST(KeepRuleCacheTest, RulesOfUnchangedFilesAreReused) {
+  const Source source("res/layout/foo.xml");
+  std::unique_ptr<xml::XmlResource> layout = BuildLayout(R"(
+      <fragment xmlns:android="http://schemas.android.com/apk/res/android"
+          android:name="com.foo.Bar"
+          android:onClick="onFoo"/>)");
+
+  TemporaryFile cache_file;
+  proguard::KeepSet set;
+  {
+    proguard::KeepRuleCache cache;
+    ASSERT_TRUE(cache.CollectProguardRules(1u, source, layout.get(), &set));
+    EXPECT_EQ(0u, cache.hit_count());
+    std::string error;
+    ASSERT_TRUE(cache.Save(cache_file.path, &error)) << error;
+  }
+
+  // A cached file isn't walked again, so the rules of the original contents are added even
+  // though this document has none.
+  std::unique_ptr<xml::XmlResource> empty_layout = BuildLayout("<fragment/>");
+  proguard::KeepRuleCache cache;
+  cache.Load(cache_file.path);
+  proguard::KeepSet cached_set;
+  ASSERT_TRUE(cache.CollectProguardRules(1u, source, empty_layout.get(), &cached_set));
+  EXPECT_EQ(1u, cache.hit_count());
+  EXPECT_EQ(WriteKeepSetToString(set), WriteKeepSetToString(cached_set));
+  EXPECT_THAT(WriteKeepSetToString(cached_set), HasSubstr("res/layout/foo.xml:"));
+}
+
+TEST(KeepRuleCacheTest, ChangedFilesAreCollectedAgain) {
+  std::unique_ptr<xml::XmlResource> layout =
+      BuildLayout(R"(<fragment class="com.foo.Bar"/>)");
+  std::unique_ptr<xml::XmlResource> changed_layout =
+      BuildLayout(R"(<fragment class="com.foo.Baz"/>)");
+
+  TemporaryFile cache_file;
+  {
+    proguard::KeepRuleCache cache;
+    proguard::KeepSet set;
+    ASSERT_TRUE(cache.CollectProguardRules(1u, Source("res/layout/foo.xml"), layout.get(), &set));
+    ASSERT_TRUE(cache.Save(cache_file.path, nullptr));
+  }
+
+  proguard::KeepRuleCache cache;
+  cache.Load(cache_file.path);
+
+  proguard::KeepSet set;
+  ASSERT_TRUE(
+      cache.CollectProguardRules(2u, Source("res/layout/foo.xml"), changed_layout.get(), &set));
+  ASSERT_TRUE(
+      cache.CollectProguardRules(1u, Source("res/layout/bar.xml"), changed_layout.get(), &set));
+  EXPECT_EQ(0u, cache.hit_count());
+
+  const std::string actual = WriteKeepSetToString(set);
+  EXPECT_THAT(actual, HasSubstr("com.foo.Baz"));
+  EXPECT_THAT(actual, Not(HasSubstr("com.foo.Bar")));
+}
+
+TEST(KeepRuleCacheTest, FilesThatAreNoLongerLinkedAreDropped) {
+  std::unique_ptr<xml::XmlResource> layout =
+      BuildLayout(R"(<fragment class="com.foo.Bar"/>)");
+
+  TemporaryFile cache_file;
+  {
+    proguard::KeepRuleCache cache;
+    proguard::KeepSet set;
+    ASSERT_TRUE(cache.CollectProguardRules(1u, Source("res/layout/foo.xml"), layout.get(), &set));
+    ASSERT_TRUE(cache.Save(cache_file.path, nullptr));
+  }
+
+  {
+    proguard::KeepRuleCache cache;
+    cache.Load(cache_file.path);
+    ASSERT_TRUE(cache.Save(cache_file.path, nullptr));
+  }
+
+  proguard::KeepRuleCache cache;
+  cache.Load(cache_file.path);
+  proguard::KeepSet set;
+  ASSERT_TRUE(cache.CollectProguardRules(1u, Source("res/layout/foo.xml"), layout.get(), &set));
+  EXPECT_EQ(0u, cache.hit_count());
+}
+
 }  // namespace aapt
@@ -16,6 +16,9 @@
 
 #include "link/ReferenceLinker.h"
 
+#include <algorithm>
+#include <vector>
+
 #include "android-base/logging.h"
 #include "androidfw/ResourceTypes.h"
 
@@ -36,6 +39,55 @@ namespace aapt {
 
 namespace {
 
+/**
+ * Copies only the parts of a Reference that are needed to resolve it. The
+ * Source and comment are left out, since they would otherwise be copied for
+ * every reference in the table.
+ */
+Reference CopyReferenceForLookup(const Reference& reference) {
+  Reference lookup_reference;
+  lookup_reference.name = reference.name;
+  lookup_reference.id = reference.id;
+  lookup_reference.reference_type = reference.reference_type;
+  lookup_reference.private_reference = reference.private_reference;
+  return lookup_reference;
+}
+
+/**
+ * The number of entries of a type that are linked together as one task.
+ */
+constexpr size_t kEntriesPerShard = 256u;
+
+/**
+ * A run of entries of one type that are linked together, possibly on another
+ * thread, and what linking them leaves for the calling thread to apply once
+ * all shards are linked.
+ */
+struct LinkShard {
+  ResourceTablePackage* package;
+  ResourceTableType* type;
+  size_t begin;
+  size_t end;
+
+  /**
+   * Strings created while linking are added to this pool first. They are moved
+   * to the table's pool in the order of the shards, so that the table's pool
+   * is the same for any number of threads.
+   */
+  StringPool string_pool;
+  std::vector<String*> new_strings;
+
+  /**
+   * Values that were replaced by more specific ones. They still refer to
+   * strings in the table's pool, which must only be released by the calling
+   * thread.
+   */
+  std::vector<std::unique_ptr<Item>> replaced_values;
+
+  BufferedDiagnostics diagnostics;
+  bool error = false;
+};
+
 /**
  * The ReferenceLinkerVisitor will follow all references and make sure they
  * point
@@ -52,12 +104,12 @@ class ReferenceLinkerVisitor : public ValueVisitor {
   using ValueVisitor::Visit;
 
   ReferenceLinkerVisitor(const CallSite& callsite, IAaptContext* context, SymbolTable* symbols,
-                         StringPool* string_pool, xml::IPackageDeclStack* decl)
+                         LinkShard* shard, xml::IPackageDeclStack* decl)
       : callsite_(callsite),
         context_(context),
         symbols_(symbols),
         package_decls_(decl),
-        string_pool_(string_pool) {}
+        shard_(shard) {}
 
   void Visit(Reference* ref) override {
     if (!ReferenceLinker::LinkReference(callsite_, ref, context_, symbols_, package_decls_)) {
@@ -87,7 +139,7 @@ class ReferenceLinkerVisitor : public ValueVisitor {
       // resources if
       // there was a '*' in the reference or if the package came from the
       // private namespace.
-      Reference transformed_reference = entry.key;
+      Reference transformed_reference = CopyReferenceForLookup(entry.key);
       TransformReferenceFromNamespace(package_decls_,
                                       context_->GetCompilationPackage(),
                                       &transformed_reference);
@@ -97,13 +149,17 @@ class ReferenceLinkerVisitor : public ValueVisitor {
       const SymbolTable::Symbol* symbol = ReferenceLinker::ResolveAttributeCheckVisibility(
           transformed_reference, callsite_, symbols_, &err_str);
       if (symbol) {
+        // Linking the value below looks up other symbols, after which `symbol`
+        // may be gone, so hold on to its attribute.
+        const std::shared_ptr<Attribute> attribute = symbol->attribute;
+
         // Assign our style key the correct ID.
         // The ID may not exist.
         entry.key.id = symbol->id;
 
         // Try to convert the value to a more specific, typed value based on the
         // attribute it is set to.
-        entry.value = ParseValueWithAttribute(std::move(entry.value), symbol->attribute.get());
+        entry.value = ParseValueWithAttribute(std::move(entry.value), attribute.get());
 
         // Link/resolve the final value (mostly if it's a reference).
         entry.value->Accept(this);
@@ -111,13 +167,13 @@ class ReferenceLinkerVisitor : public ValueVisitor {
         // Now verify that the type of this item is compatible with the
         // attribute it is defined for. We pass `nullptr` as the DiagMessage so that this
         // check is fast and we avoid creating a DiagMessage when the match is successful.
-        if (!symbol->attribute->Matches(*entry.value, nullptr)) {
+        if (!attribute->Matches(*entry.value, nullptr)) {
           // The actual type of this item is incompatible with the attribute.
           DiagMessage msg(entry.key.GetSource());
 
           // Call the matches method again, this time with a DiagMessage so we
           // fill in the actual error message.
-          symbol->attribute->Matches(*entry.value, &msg);
+          attribute->Matches(*entry.value, &msg);
           context_->GetDiagnostics()->Error(msg);
           error_ = true;
         }
@@ -155,11 +211,15 @@ class ReferenceLinkerVisitor : public ValueVisitor {
         util::StringBuilder string_builder;
         string_builder.Append(*raw_string->value);
         if (string_builder) {
-          transformed = util::make_unique<String>(string_pool_->MakeRef(string_builder.ToString()));
+          std::unique_ptr<String> str =
+              util::make_unique<String>(shard_->string_pool.MakeRef(string_builder.ToString()));
+          shard_->new_strings.push_back(str.get());
+          transformed = std::move(str);
         }
       }
 
       if (transformed) {
+        shard_->replaced_values.push_back(std::move(value));
         return transformed;
       }
     }
@@ -170,7 +230,7 @@ class ReferenceLinkerVisitor : public ValueVisitor {
   IAaptContext* context_;
   SymbolTable* symbols_;
   xml::IPackageDeclStack* package_decls_;
-  StringPool* string_pool_;
+  LinkShard* shard_;
   bool error_ = false;
 };
 
@@ -191,6 +251,45 @@ class EmptyDeclStack : public xml::IPackageDeclStack {
   DISALLOW_COPY_AND_ASSIGN(EmptyDeclStack);
 };
 
+void LinkEntries(IAaptContext* context, TraceRecorder* trace, LinkShard* shard) {
+  TraceSpan span(trace, "link", ToString(shard->type->type));
+  span.AddArg("first_entry", shard->begin);
+  span.AddArg("entries", shard->end - shard->begin);
+
+  DiagnosticsOverrideContext shard_context(context, &shard->diagnostics);
+  EmptyDeclStack decl_stack;
+
+  // Symbols found by this shard are cached by it, so that its lookups mostly don't lock the
+  // shared table, and the symbols it was given outlive evictions by other shards.
+  SymbolTable shard_symbols(context->GetExternalSymbols());
+  SymbolTable* symbols = &shard_symbols;
+  ResourceTablePackage* package = shard->package;
+  ResourceTableType* type = shard->type;
+  for (size_t i = shard->begin; i < shard->end; i++) {
+    ResourceEntry* entry = type->entries[i].get();
+
+    // Symbol state information may be lost if there is no value for the
+    // resource.
+    if (entry->symbol_status.state != SymbolState::kUndefined && entry->values.empty()) {
+      shard->diagnostics.Error(DiagMessage(entry->symbol_status.source)
+                               << "no definition for declared symbol '"
+                               << ResourceNameRef(package->name, type->type, entry->name) << "'");
+      shard->error = true;
+    }
+
+    CallSite callsite = {ResourceNameRef(package->name, type->type, entry->name)};
+    ReferenceLinkerVisitor visitor(callsite, &shard_context, symbols, shard, &decl_stack);
+
+    for (auto& config_value : entry->values) {
+      config_value->value->Accept(&visitor);
+    }
+
+    if (visitor.HasError()) {
+      shard->error = true;
+    }
+  }
+}
+
 }  // namespace
 
 /**
@@ -298,7 +397,7 @@ bool ReferenceLinker::LinkReference(const CallSite& callsite, Reference* referen
     return true;
   }
 
-  Reference transformed_reference = *reference;
+  Reference transformed_reference = CopyReferenceForLookup(*reference);
   TransformReferenceFromNamespace(decls, context->GetCompilationPackage(), &transformed_reference);
 
   std::string err_str;
@@ -321,35 +420,47 @@ bool ReferenceLinker::LinkReference(const CallSite& callsite, Reference* referen
 }
 
 bool ReferenceLinker::Consume(IAaptContext* context, ResourceTable* table) {
-  EmptyDeclStack decl_stack;
-  bool error = false;
+  std::vector<std::unique_ptr<LinkShard>> shards;
   for (auto& package : table->packages) {
     for (auto& type : package->types) {
-      for (auto& entry : type->entries) {
-        // Symbol state information may be lost if there is no value for the
-        // resource.
-        if (entry->symbol_status.state != SymbolState::kUndefined &&
-            entry->values.empty()) {
-          context->GetDiagnostics()->Error(
-              DiagMessage(entry->symbol_status.source)
-              << "no definition for declared symbol '"
-              << ResourceNameRef(package->name, type->type, entry->name)
-              << "'");
-          error = true;
-        }
+      for (size_t begin = 0u; begin < type->entries.size(); begin += kEntriesPerShard) {
+        std::unique_ptr<LinkShard> shard = util::make_unique<LinkShard>();
+        shard->package = package.get();
+        shard->type = type.get();
+        shard->begin = begin;
+        shard->end = std::min(begin + kEntriesPerShard, type->entries.size());
+        shards.push_back(std::move(shard));
+      }
+    }
+  }
 
-        CallSite callsite = {ResourceNameRef(package->name, type->type, entry->name)};
-        ReferenceLinkerVisitor visitor(callsite, context, context->GetExternalSymbols(),
-                                       &table->string_pool, &decl_stack);
+  // Attributes are linked first, on this thread. Looking up an attribute in a
+  // ResourceTableSymbolSource copies it, so attributes must not change while
+  // the other shards are linked.
+  std::vector<LinkShard*> parallel_shards;
+  for (auto& shard : shards) {
+    if (shard->type->type == ResourceType::kAttr ||
+        shard->type->type == ResourceType::kAttrPrivate) {
+      LinkEntries(context, trace_, shard.get());
+    } else {
+      parallel_shards.push_back(shard.get());
+    }
+  }
 
-        for (auto& config_value : entry->values) {
-          config_value->value->Accept(&visitor);
-        }
+  util::ParallelFor(parallel_shards.size(), jobs_,
+                    [&](size_t i) { LinkEntries(context, trace_, parallel_shards[i]); });
 
-        if (visitor.HasError()) {
-          error = true;
-        }
-      }
+  // Apply what each shard left behind in the order of the table, as linking
+  // on a single thread would.
+  bool error = false;
+  for (auto& shard : shards) {
+    for (String* str : shard->new_strings) {
+      str->value = table->string_pool.MakeRef(*str->value);
+    }
+    shard->replaced_values.clear();
+    shard->diagnostics.FlushTo(context->GetDiagnostics());
+    if (shard->error) {
+      error = true;
     }
   }
   return !error;
@@ -25,6 +25,7 @@
 #include "link/Linkers.h"
 #include "process/IResourceTableConsumer.h"
 #include "process/SymbolTable.h"
+#include "util/Trace.h"
 #include "xml/XmlDom.h"
 
 namespace aapt {
@@ -38,7 +39,14 @@ namespace aapt {
  */
 class ReferenceLinker : public IResourceTableConsumer {
  public:
-  ReferenceLinker() = default;
+  /**
+   * Links the entries of the table on up to `jobs` threads. 0 uses one thread
+   * per core. The result and the order of the diagnostics don't depend on the
+   * number of threads. When `trace` is not null, the time spent linking each
+   * run of entries of a type is recorded to it.
+   */
+  explicit ReferenceLinker(size_t jobs = 0u, TraceRecorder* trace = nullptr)
+      : jobs_(jobs), trace_(trace) {}
 
   /**
    * Returns true if the symbol is visible by the reference and from the
@@ -110,6 +118,9 @@ class ReferenceLinker : public IResourceTableConsumer {
 
  private:
   DISALLOW_COPY_AND_ASSIGN(ReferenceLinker);
+
+  size_t jobs_;
+  TraceRecorder* trace_;
 };
 
 }  // namespace aapt
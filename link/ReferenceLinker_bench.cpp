@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "link/ReferenceLinker.h"
+
+#include "benchmark/benchmark.h"
+
+#include "test/Context.h"
+#include "test/CorpusGenerator.h"
+
+namespace aapt {
+
+// Links a table whose references are already linked. Every reference is still looked up in the
+// symbol table, so this measures the same work as linking it the first time.
+static void LinkCorpusTable(benchmark::State& state, size_t jobs) {
+  std::unique_ptr<IAaptContext> context =
+      test::ContextBuilder().SetCompilationPackage("com.app.test").SetPackageId(0x7f).Build();
+  test::CorpusOptions options;
+  options.entries = state.range(0);
+  std::unique_ptr<ResourceTable> table =
+      test::BuildLinkedCorpusTable(context.get(), test::GenerateCorpus(options));
+  if (!table) {
+    state.SkipWithError("failed to build corpus table");
+    return;
+  }
+
+  while (state.KeepRunning()) {
+    ReferenceLinker linker(jobs);
+    if (!linker.Consume(context.get(), table.get())) {
+      state.SkipWithError("failed to link references");
+      break;
+    }
+  }
+}
+
+static void BM_ReferenceLinkerLink(benchmark::State& state) {
+  LinkCorpusTable(state, 1u);
+}
+BENCHMARK(BM_ReferenceLinkerLink)->Range(64, 16 << 10);
+
+// The same, with one thread per core.
+static void BM_ReferenceLinkerLinkParallel(benchmark::State& state) {
+  LinkCorpusTable(state, 0u);
+}
+BENCHMARK(BM_ReferenceLinkerLinkParallel)->Range(64, 16 << 10)->UseRealTime();
+
+}  // namespace aapt
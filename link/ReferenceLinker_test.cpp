@@ -293,4 +293,75 @@ TEST(ReferenceLinkerTest, AppsWithDifferentPackageCanNotUseEachOthersAttribute)
   EXPECT_TRUE(error.empty());
 }
 
+// Builds a table with enough styles to be linked in several shards. Each style sets the attribute
+// com.app.test:attr/text to a raw string, which linking turns into a String.
+static std::unique_ptr<ResourceTable> BuildTableWithStyles(size_t count) {
+  test::ResourceTableBuilder builder;
+  builder.SetPackageId("com.app.test", 0x7f)
+      .AddValue("com.app.test:attr/text", ResourceId(0x7f010000),
+                test::AttributeBuilder().SetTypeMask(ResTable_map::TYPE_STRING).Build());
+  for (size_t i = 0u; i < count; i++) {
+    builder.AddValue("com.app.test:style/Style" + std::to_string(i),
+                     ResourceId(0x7f020000 + static_cast<uint32_t>(i)),
+                     test::StyleBuilder()
+                         .SetParent("android:style/Theme")
+                         .AddItem("com.app.test:attr/text", {} /* placeholder */)
+                         .Build());
+  }
+  std::unique_ptr<ResourceTable> table = builder.Build();
+
+  for (size_t i = 0u; i < count; i++) {
+    const std::string name = "com.app.test:style/Style" + std::to_string(i);
+    Style* style = test::GetValue<Style>(table.get(), name);
+    style->entries.back().value = util::make_unique<RawString>(
+        table->string_pool.MakeRef("text " + std::to_string(count - i)));
+  }
+  return table;
+}
+
+TEST(ReferenceLinkerTest, LinkingOnSeveralThreadsMatchesLinkingOnOne) {
+  const size_t kStyleCount = 2000u;
+  std::unique_ptr<ResourceTable> serial_table = BuildTableWithStyles(kStyleCount);
+  std::unique_ptr<ResourceTable> parallel_table = BuildTableWithStyles(kStyleCount);
+
+  for (ResourceTable* table : {serial_table.get(), parallel_table.get()}) {
+    std::unique_ptr<IAaptContext> context =
+        test::ContextBuilder()
+            .SetCompilationPackage("com.app.test")
+            .SetPackageId(0x7f)
+            .SetNameManglerPolicy(NameManglerPolicy{"com.app.test"})
+            .AddSymbolSource(util::make_unique<ResourceTableSymbolSource>(table))
+            .AddSymbolSource(test::StaticSymbolSourceBuilder()
+                                 .AddPublicSymbol("android:style/Theme", ResourceId(0x01060000))
+                                 .Build())
+            .Build();
+
+    ReferenceLinker linker(table == serial_table.get() ? 1u : 4u);
+    ASSERT_TRUE(linker.Consume(context.get(), table));
+  }
+
+  for (size_t i = 0u; i < kStyleCount; i++) {
+    const std::string name = "com.app.test:style/Style" + std::to_string(i);
+    Style* style = test::GetValue<Style>(parallel_table.get(), name);
+    ASSERT_THAT(style, NotNull());
+    ASSERT_TRUE(style->parent.value().id);
+    EXPECT_EQ(ResourceId(0x01060000), style->parent.value().id.value());
+    ASSERT_EQ(1u, style->entries.size());
+    ASSERT_TRUE(style->entries[0].key.id);
+    EXPECT_EQ(ResourceId(0x7f010000), style->entries[0].key.id.value());
+
+    String* str = ValueCast<String>(style->entries[0].value.get());
+    ASSERT_THAT(str, NotNull());
+    EXPECT_EQ("text " + std::to_string(kStyleCount - i), *str->value);
+  }
+
+  // The new strings are added to the table's pool in the same order.
+  const auto& serial_strings = serial_table->string_pool.strings();
+  const auto& parallel_strings = parallel_table->string_pool.strings();
+  ASSERT_EQ(serial_strings.size(), parallel_strings.size());
+  for (size_t i = 0u; i < serial_strings.size(); i++) {
+    EXPECT_EQ(serial_strings[i]->value, parallel_strings[i]->value);
+  }
+}
+
 }  // namespace aapt
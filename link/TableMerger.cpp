@@ -16,6 +16,9 @@
 
 #include "link/TableMerger.h"
 
+#include <algorithm>
+#include <iterator>
+
 #include "android-base/logging.h"
 
 #include "ResourceTable.h"
@@ -84,7 +87,7 @@ bool TableMerger::MergeImpl(const Source& src, ResourceTable* table,
       // Also, when linking, we convert references with no package name to use
       // the compilation package name.
       error |= !DoMerge(src, table, package.get(), false /* mangle */, overlay,
-                        allow_new, callback);
+                        allow_new, false /* move_values */, callback);
     }
   }
   return !error;
@@ -125,11 +128,94 @@ bool TableMerger::MergeAndMangle(const Source& src,
     };
 
     error |= !DoMerge(src, table, package.get(), mangle, false /* overlay */,
-                      true /* allow new */, callback);
+                      true /* allow new */, false /* move_values */, callback);
+  }
+  return !error;
+}
+
+bool TableMerger::MergeAndMangleAll(const std::vector<StaticLibrary>& libraries, size_t jobs) {
+  if (libraries.empty()) {
+    return true;
+  } else if (libraries.size() == 1u) {
+    const StaticLibrary& library = libraries.front();
+    return MergeAndMangle(library.source, library.package, library.table, library.collection);
+  }
+
+  // The libraries of a subtree, merged into one table.
+  struct MergeNode {
+    Source source;
+    ResourceTable table;
+    BufferedDiagnostics diagnostics;
+    bool error = false;
+  };
+
+  bool error = false;
+  auto flush_nodes = [&](std::vector<std::unique_ptr<MergeNode>>* nodes) {
+    for (std::unique_ptr<MergeNode>& node : *nodes) {
+      node->diagnostics.FlushTo(context_->GetDiagnostics());
+      if (node->error) {
+        error = true;
+      }
+    }
+  };
+
+  std::vector<std::unique_ptr<MergeNode>> nodes(libraries.size());
+  std::vector<std::set<std::string>> merged_packages(libraries.size());
+  util::ParallelFor(libraries.size(), jobs, [&](size_t i) {
+    const StaticLibrary& library = libraries[i];
+    std::unique_ptr<MergeNode> node = util::make_unique<MergeNode>();
+    node->source = library.source;
+
+    DiagnosticsOverrideContext node_context(context_, &node->diagnostics);
+    TableMerger merger(&node_context, &node->table, options_);
+    node->error =
+        !merger.MergeAndMangle(library.source, library.package, library.table, library.collection);
+    merged_packages[i] = merger.merged_packages();
+    nodes[i] = std::move(node);
+  });
+  for (const std::set<std::string>& packages : merged_packages) {
+    merged_packages_.insert(packages.begin(), packages.end());
+  }
+  flush_nodes(&nodes);
+
+  while (nodes.size() > 1u) {
+    std::vector<std::unique_ptr<MergeNode>> parents((nodes.size() + 1u) / 2u);
+    util::ParallelFor(parents.size(), jobs, [&](size_t i) {
+      std::unique_ptr<MergeNode> node = std::move(nodes[2u * i]);
+      if (2u * i + 1u < nodes.size()) {
+        std::unique_ptr<MergeNode> other = std::move(nodes[2u * i + 1u]);
+        DiagnosticsOverrideContext node_context(context_, &node->diagnostics);
+        TableMerger merger(&node_context, &node->table, options_);
+        if (!merger.MergeMovingValues(other->source, &other->table)) {
+          node->error = true;
+        }
+      }
+      parents[i] = std::move(node);
+    });
+    nodes = std::move(parents);
+    flush_nodes(&nodes);
+  }
+
+  // The root table is copied, so that its strings are shared with the rest of the master table.
+  MergeNode* root = nodes.front().get();
+  if (!Merge(root->source, &root->table)) {
+    error = true;
   }
   return !error;
 }
 
+bool TableMerger::MergeMovingValues(const Source& src, ResourceTable* table) {
+  bool error = false;
+  for (auto& package : table->packages) {
+    error |= !DoMerge(src, table, package.get(), false /* mangle */, false /* overlay */,
+                      true /* allow new */, true /* move_values */, {});
+  }
+
+  // The moved values refer to strings of `table`.
+  master_table_->string_pool.Merge(std::move(table->string_pool));
+  return !error;
+}
+
 static bool MergeType(IAaptContext* context, const Source& src,
                       ResourceTableType* dst_type,
                       ResourceTableType* src_type) {
@@ -240,10 +326,103 @@ static ResourceTable::CollisionResult MergeConfigValue(IAaptContext* context,
   return collision_result;
 }
 
+namespace {
+
+// Finds or creates the entries of a type for names that arrive in sorted order, as they do when
+// walking the entries of another table's type. Each lookup resumes where the previous one ended,
+// and new entries are held aside until Flush() merges them into the sorted entry list in one pass.
+// Inserting them one at a time would shift the tail of the list for every new entry, which is
+// quadratic when merging many large libraries.
+class SortedEntryInserter {
+ public:
+  explicit SortedEntryInserter(ResourceTableType* type) : type_(type) {
+  }
+
+  ResourceEntry* FindEntry(const StringPiece& name) {
+    std::vector<std::unique_ptr<ResourceEntry>>& entries = type_->entries;
+    auto begin = entries.begin() + hint_;
+    if (hint_ > 0 && Compare(entries[hint_ - 1]->name, name) >= 0) {
+      // Out of order, search from the start.
+      begin = entries.begin();
+    }
+
+    auto iter = std::lower_bound(
+        begin, entries.end(), name,
+        [](const std::unique_ptr<ResourceEntry>& lhs, const StringPiece& rhs) {
+          return Compare(lhs->name, rhs) < 0;
+        });
+    hint_ = static_cast<size_t>(iter - entries.begin());
+    if (iter != entries.end() && name == (*iter)->name) {
+      return iter->get();
+    }
+    return nullptr;
+  }
+
+  ResourceEntry* FindOrCreateEntry(const StringPiece& name) {
+    if (ResourceEntry* entry = FindEntry(name)) {
+      return entry;
+    }
+
+    if (!new_entries_.empty() && name == new_entries_.back()->name) {
+      return new_entries_.back().get();
+    }
+    new_entries_.push_back(util::make_unique<ResourceEntry>(name));
+    return new_entries_.back().get();
+  }
+
+  // Adds the entries created since the last call to the type.
+  void Flush() {
+    if (new_entries_.empty()) {
+      return;
+    }
+
+    auto less_than = [](const std::unique_ptr<ResourceEntry>& lhs,
+                        const std::unique_ptr<ResourceEntry>& rhs) {
+      return Compare(lhs->name, rhs->name) < 0;
+    };
+    if (!std::is_sorted(new_entries_.begin(), new_entries_.end(), less_than)) {
+      std::sort(new_entries_.begin(), new_entries_.end(), less_than);
+    }
+
+    std::vector<std::unique_ptr<ResourceEntry>>& entries = type_->entries;
+    if (new_entries_.size() == 1u) {
+      // Common when merging a single file. Inserting in place avoids reallocating the list.
+      auto iter = std::upper_bound(entries.begin(), entries.end(), new_entries_.front(), less_than);
+      entries.insert(iter, std::move(new_entries_.front()));
+      new_entries_.clear();
+      hint_ = 0u;
+      return;
+    }
+
+    std::vector<std::unique_ptr<ResourceEntry>> merged;
+    merged.reserve(entries.size() + new_entries_.size());
+    std::merge(std::make_move_iterator(entries.begin()), std::make_move_iterator(entries.end()),
+               std::make_move_iterator(new_entries_.begin()),
+               std::make_move_iterator(new_entries_.end()), std::back_inserter(merged), less_than);
+    entries = std::move(merged);
+    new_entries_.clear();
+    hint_ = 0u;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(SortedEntryInserter);
+
+  // Same ordering as ResourceTableType::FindOrCreateEntry().
+  static int Compare(const std::string& lhs, const StringPiece& rhs) {
+    return lhs.compare(0, lhs.size(), rhs.data(), rhs.size());
+  }
+
+  ResourceTableType* type_;
+  size_t hint_ = 0u;
+  std::vector<std::unique_ptr<ResourceEntry>> new_entries_;
+};
+
+}  // namespace
+
 bool TableMerger::DoMerge(const Source& src, ResourceTable* src_table,
                           ResourceTablePackage* src_package,
                           const bool mangle_package, const bool overlay,
-                          const bool allow_new_resources,
+                          const bool allow_new_resources, const bool move_values,
                           const FileMergeCallback& callback) {
   bool error = false;
 
@@ -254,17 +433,20 @@ bool TableMerger::DoMerge(const Source& src, ResourceTable* src_table,
       continue;
     }
 
+    SortedEntryInserter dst_entries(dst_type);
+    std::string mangled_name;
     for (auto& src_entry : src_type->entries) {
-      std::string entry_name = src_entry->name;
+      const std::string* entry_name = &src_entry->name;
       if (mangle_package) {
-        entry_name = NameMangler::MangleEntry(src_package->name, src_entry->name);
+        mangled_name = NameMangler::MangleEntry(src_package->name, src_entry->name);
+        entry_name = &mangled_name;
       }
 
       ResourceEntry* dst_entry;
       if (allow_new_resources || src_entry->symbol_status.allow_new) {
-        dst_entry = dst_type->FindOrCreateEntry(entry_name);
+        dst_entry = dst_entries.FindOrCreateEntry(*entry_name);
       } else {
-        dst_entry = dst_type->FindEntry(entry_name);
+        dst_entry = dst_entries.FindEntry(*entry_name);
       }
 
       const ResourceNameRef res_name(src_package->name, src_type->type, src_entry->name);
@@ -306,7 +488,9 @@ bool TableMerger::DoMerge(const Source& src, ResourceTable* src_table,
 
         // Continue if we're taking the new resource.
 
-        if (FileReference* f = ValueCast<FileReference>(src_config_value->value.get())) {
+        if (move_values) {
+          dst_config_value->value = std::move(src_config_value->value);
+        } else if (FileReference* f = ValueCast<FileReference>(src_config_value->value.get())) {
           std::unique_ptr<FileReference> new_file_ref;
           if (mangle_package) {
             new_file_ref = CloneAndMangleFile(src_package->name, *f);
@@ -328,6 +512,7 @@ bool TableMerger::DoMerge(const Source& src, ResourceTable* src_table,
         }
       }
     }
+    dst_entries.Flush();
   }
   return !error;
 }
@@ -362,7 +547,7 @@ bool TableMerger::MergeFileImpl(const ResourceFile& file_desc, io::IFile* file,
       ->value = std::move(file_ref);
 
   return DoMerge(file->GetSource(), &table, pkg, false /* mangle */,
-                 overlay /* overlay */, true /* allow_new */, {});
+                 overlay /* overlay */, true /* allow_new */, false /* move_values */, {});
 }
 
 bool TableMerger::MergeFile(const ResourceFile& file_desc, io::IFile* file) {
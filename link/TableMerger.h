@@ -19,6 +19,8 @@
 
 #include <functional>
 #include <map>
+#include <set>
+#include <vector>
 
 #include "android-base/macros.h"
 
@@ -99,6 +101,28 @@ class TableMerger {
   bool MergeAndMangle(const Source& src, const android::StringPiece& package, ResourceTable* table,
                       io::IFileCollection* collection);
 
+  /**
+   * A static library to merge with MergeAndMangleAll().
+   */
+  struct StaticLibrary {
+    Source source;
+    std::string package;
+    ResourceTable* table;
+    io::IFileCollection* collection;
+  };
+
+  /**
+   * Merges static libraries as if MergeAndMangle() was called for each of them
+   * in order. Each library is first mangled into a table of its own. Then
+   * neighbouring tables are merged pairwise until one is left, which is merged
+   * into the master table. The merges of each level run on up to `jobs`
+   * threads, and 0 uses one thread per core. An earlier library is always on
+   * the existing side of a merge, so collisions resolve as they would if the
+   * libraries were merged one by one. Diagnostics are reported level by level,
+   * in the order of the libraries.
+   */
+  bool MergeAndMangleAll(const std::vector<StaticLibrary>& libraries, size_t jobs = 0u);
+
   /**
    * Merges a compiled file that belongs to this same or empty package. This is
    * for local sources.
@@ -129,10 +153,17 @@ class TableMerger {
   bool MergeImpl(const Source& src, ResourceTable* src_table,
                  io::IFileCollection* collection, bool overlay, bool allow_new);
 
+  /**
+   * Merges a table built by another TableMerger for the same package, moving
+   * its values and strings instead of copying them. The values left in `table`
+   * refer to strings of the master table, so it must be destroyed first.
+   */
+  bool MergeMovingValues(const Source& src, ResourceTable* table);
+
   bool DoMerge(const Source& src, ResourceTable* src_table,
                ResourceTablePackage* src_package, const bool mangle_package,
                const bool overlay, const bool allow_new_resources,
-               const FileMergeCallback& callback);
+               const bool move_values, const FileMergeCallback& callback);
 
   std::unique_ptr<FileReference> CloneAndMangleFile(const std::string& package,
                                                     const FileReference& value);
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "link/TableMerger.h"
+
+#include "benchmark/benchmark.h"
+
+#include "ValueVisitor.h"
+#include "io/FileSystem.h"
+#include "test/Context.h"
+#include "test/CorpusGenerator.h"
+
+namespace aapt {
+
+static void BM_TableMergerMerge(benchmark::State& state) {
+  std::unique_ptr<IAaptContext> context =
+      test::ContextBuilder().SetCompilationPackage("com.app.test").SetPackageId(0x7f).Build();
+  test::CorpusOptions options;
+  options.entries = state.range(0);
+  std::unique_ptr<ResourceTable> table =
+      test::BuildCorpusTable(context.get(), test::GenerateCorpus(options));
+  if (!table) {
+    state.SkipWithError("failed to build corpus table");
+    return;
+  }
+
+  while (state.KeepRunning()) {
+    ResourceTable final_table;
+    TableMerger merger(context.get(), &final_table, TableMergerOptions{});
+    if (!merger.Merge({}, table.get())) {
+      state.SkipWithError("failed to merge");
+      break;
+    }
+  }
+}
+BENCHMARK(BM_TableMergerMerge)->Range(64, 16 << 10);
+
+// Builds `count` static libraries with `entries` entries each, in the packages com.lib0, com.lib1,
+// and so on.
+static std::vector<std::unique_ptr<ResourceTable>> BuildStaticLibraries(size_t count,
+                                                                        size_t entries) {
+  test::CorpusOptions options;
+  options.entries = entries;
+  const std::vector<test::CorpusFile> files = test::GenerateCorpus(options);
+
+  std::vector<std::unique_ptr<ResourceTable>> tables;
+  for (size_t i = 0u; i < count; i++) {
+    const std::string package = "com.lib" + std::to_string(i);
+    std::unique_ptr<IAaptContext> context =
+        test::ContextBuilder().SetCompilationPackage(package).SetPackageId(0x7f).Build();
+    std::unique_ptr<ResourceTable> table = test::BuildCorpusTable(context.get(), files);
+    if (!table) {
+      return {};
+    }
+    tables.push_back(std::move(table));
+  }
+  return tables;
+}
+
+// Merges state.range(0) static libraries of 1024 entries each into an app, one after the other
+// when `tree` is false, and with MergeAndMangleAll() otherwise.
+static void MergeStaticLibraries(benchmark::State& state, bool tree) {
+  std::unique_ptr<IAaptContext> context =
+      test::ContextBuilder().SetCompilationPackage("com.app.test").SetPackageId(0x7f).Build();
+  std::vector<std::unique_ptr<ResourceTable>> tables =
+      BuildStaticLibraries(state.range(0), 1024u);
+  if (tables.empty()) {
+    state.SkipWithError("failed to build corpus tables");
+    return;
+  }
+
+  // Every library refers to the files of the corpus at the same paths.
+  io::FileCollection collection;
+  for (const auto& package : tables[0]->packages) {
+    for (const auto& type : package->types) {
+      for (const auto& entry : type->entries) {
+        for (const auto& config_value : entry->values) {
+          if (FileReference* file = ValueCast<FileReference>(config_value->value.get())) {
+            collection.InsertFile(*file->path);
+          }
+        }
+      }
+    }
+  }
+
+  std::vector<TableMerger::StaticLibrary> libraries;
+  for (size_t i = 0u; i < tables.size(); i++) {
+    libraries.push_back(TableMerger::StaticLibrary{Source("lib" + std::to_string(i) + ".apk"),
+                                                   "com.lib" + std::to_string(i),
+                                                   tables[i].get(), &collection});
+  }
+
+  while (state.KeepRunning()) {
+    ResourceTable final_table;
+    TableMerger merger(context.get(), &final_table, TableMergerOptions{});
+    bool result = true;
+    if (tree) {
+      result = merger.MergeAndMangleAll(libraries);
+    } else {
+      for (const TableMerger::StaticLibrary& library : libraries) {
+        result &= merger.MergeAndMangle(library.source, library.package, library.table,
+                                        library.collection);
+      }
+    }
+    if (!result) {
+      state.SkipWithError("failed to merge");
+      break;
+    }
+  }
+}
+
+static void BM_TableMergerMergeStaticLibraries(benchmark::State& state) {
+  MergeStaticLibraries(state, false);
+}
+BENCHMARK(BM_TableMergerMergeStaticLibraries)->Range(2, 256)->UseRealTime();
+
+static void BM_TableMergerMergeStaticLibrariesTree(benchmark::State& state) {
+  MergeStaticLibraries(state, true);
+}
+BENCHMARK(BM_TableMergerMergeStaticLibrariesTree)->Range(2, 256)->UseRealTime();
+
+}  // namespace aapt
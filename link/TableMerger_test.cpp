@@ -16,6 +16,9 @@
 
 #include "link/TableMerger.h"
 
+#include <algorithm>
+#include <sstream>
+
 #include "filter/ConfigFilter.h"
 #include "io/FileSystem.h"
 #include "test/Test.h"
@@ -365,4 +368,147 @@ TEST_F(TableMergerTest, OverlaidStyleablesAndStylesShouldBeMerged) {
               Eq(make_value(Reference(test::ParseNameOrDie("com.app.a:style/OverlayParent")))));
 }
 
+TEST_F(TableMergerTest, InterleavedEntriesStaySorted) {
+  std::unique_ptr<ResourceTable> table_a = test::ResourceTableBuilder()
+                                               .SetPackageId("com.app.a", 0x7f)
+                                               .AddSimple("com.app.a:id/b")
+                                               .AddSimple("com.app.a:id/d")
+                                               .AddSimple("com.app.a:id/f")
+                                               .Build();
+
+  std::unique_ptr<ResourceTable> table_b = test::ResourceTableBuilder()
+                                               .SetPackageId("com.app.a", 0x7f)
+                                               .AddSimple("com.app.a:id/a")
+                                               .AddSimple("com.app.a:id/c")
+                                               .AddSimple("com.app.a:id/d")
+                                               .AddSimple("com.app.a:id/g")
+                                               .Build();
+
+  ResourceTable final_table;
+  TableMerger merger(context_.get(), &final_table, TableMergerOptions{});
+
+  ASSERT_TRUE(merger.Merge({}, table_a.get()));
+  ASSERT_TRUE(merger.Merge({}, table_b.get()));
+
+  ResourceTablePackage* package = final_table.FindPackage("com.app.a");
+  ASSERT_THAT(package, NotNull());
+  ResourceTableType* type = package->FindType(ResourceType::kId);
+  ASSERT_THAT(type, NotNull());
+
+  std::vector<std::string> names;
+  for (const auto& entry : type->entries) {
+    names.push_back(entry->name);
+  }
+  EXPECT_EQ((std::vector<std::string>{"a", "b", "c", "d", "f", "g"}), names);
+  EXPECT_THAT(type->FindEntry("c"), NotNull());
+}
+
+// Builds static libraries in which the same names collide, so that the order of the merges
+// decides which values are kept.
+static std::vector<std::unique_ptr<ResourceTable>> BuildStaticLibraries() {
+  std::vector<std::unique_ptr<ResourceTable>> tables;
+  tables.push_back(
+      test::ResourceTableBuilder()
+          .SetPackageId("com.app.b", 0x7f)
+          .AddValue("com.app.b:id/shared", test::ValueBuilder<Id>().SetSource("lib0.xml").Build())
+          .AddValue("com.app.b:id/override",
+                    test::ValueBuilder<Id>().SetSource("lib0.xml").Build())
+          .AddFileReference("com.app.b:xml/file", "res/xml/file.xml")
+          .Build());
+  tables.push_back(test::ResourceTableBuilder()
+                       .SetPackageId("com.app.c", 0x7f)
+                       .AddString("com.app.c:string/foo", "c")
+                       .AddSimple("com.app.c:id/shared")
+                       .Build());
+  tables.push_back(
+      test::ResourceTableBuilder()
+          .SetPackageId("com.app.b", 0x7f)
+          .AddValue("com.app.b:id/shared", test::ValueBuilder<Id>().SetSource("lib2.xml").Build())
+          .AddString("com.app.b:string/foo", "b")
+          .Build());
+  tables.push_back(test::ResourceTableBuilder()
+                       .SetPackageId("com.app.d", 0x7f)
+                       .AddString("com.app.d:string/foo", "d")
+                       .Build());
+  tables.push_back(test::ResourceTableBuilder()
+                       .SetPackageId("com.app.b", 0x7f)
+                       .AddString("com.app.b:id/override", "strong")
+                       .Build());
+  return tables;
+}
+
+// Prints every value of `table`, with its name, configuration and source.
+static std::string DumpTable(ResourceTable* table) {
+  std::ostringstream out;
+  for (const auto& package : table->packages) {
+    for (const auto& type : package->types) {
+      for (const auto& entry : type->entries) {
+        for (const auto& config_value : entry->values) {
+          out << package->name << ":" << type->type << "/" << entry->name << " "
+              << config_value->config << " ";
+          config_value->value->Print(&out);
+          out << " " << config_value->value->GetSource();
+          if (FileReference* f = ValueCast<FileReference>(config_value->value.get())) {
+            out << " file=" << (f->file != nullptr);
+          }
+          out << "\n";
+        }
+      }
+    }
+  }
+  return out.str();
+}
+
+static std::vector<std::string> SortedStrings(StringPool* pool) {
+  pool->Prune();
+  std::vector<std::string> strings;
+  for (const auto& entry : pool->strings()) {
+    strings.push_back(entry->value);
+  }
+  std::sort(strings.begin(), strings.end());
+  return strings;
+}
+
+TEST_F(TableMergerTest, MergeAndMangleAllMatchesMergingOneByOne) {
+  io::FileCollection collection;
+  collection.InsertFile("res/xml/file.xml");
+  const std::vector<std::string> packages = {"com.app.b", "com.app.c", "com.app.b", "com.app.d",
+                                             "com.app.b"};
+
+  std::vector<std::unique_ptr<ResourceTable>> tables = BuildStaticLibraries();
+  ResourceTable serial_table;
+  TableMerger serial_merger(context_.get(), &serial_table, TableMergerOptions{});
+  for (size_t i = 0u; i < tables.size(); i++) {
+    ASSERT_TRUE(serial_merger.MergeAndMangle(Source("lib" + std::to_string(i) + ".apk"),
+                                             packages[i], tables[i].get(), &collection));
+  }
+
+  tables = BuildStaticLibraries();
+  std::vector<TableMerger::StaticLibrary> libraries;
+  for (size_t i = 0u; i < tables.size(); i++) {
+    libraries.push_back(TableMerger::StaticLibrary{Source("lib" + std::to_string(i) + ".apk"),
+                                                   packages[i], tables[i].get(), &collection});
+  }
+  ResourceTable tree_table;
+  TableMerger tree_merger(context_.get(), &tree_table, TableMergerOptions{});
+  ASSERT_TRUE(tree_merger.MergeAndMangleAll(libraries, 2u));
+
+  EXPECT_EQ(serial_merger.merged_packages(), tree_merger.merged_packages());
+  EXPECT_EQ(DumpTable(&serial_table), DumpTable(&tree_table));
+  EXPECT_EQ(SortedStrings(&serial_table.string_pool), SortedStrings(&tree_table.string_pool));
+
+  // The first of two weak values is kept, and a strong value replaces a weak one.
+  Id* id = test::GetValue<Id>(&tree_table, "com.app.a:id/com.app.b$shared");
+  ASSERT_THAT(id, NotNull());
+  EXPECT_EQ(std::string("lib0.xml"), id->GetSource().path);
+  String* str = test::GetValue<String>(&tree_table, "com.app.a:id/com.app.b$override");
+  ASSERT_THAT(str, NotNull());
+  EXPECT_EQ(std::string("strong"), *str->value);
+
+  FileReference* f = test::GetValue<FileReference>(&tree_table, "com.app.a:xml/com.app.b$file");
+  ASSERT_THAT(f, NotNull());
+  EXPECT_EQ(std::string("res/xml/com.app.b$file.xml"), *f->path);
+  EXPECT_THAT(f->file, NotNull());
+}
+
 }  // namespace aapt
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "optimize/ResourceDeduper.h"
+
+#include "benchmark/benchmark.h"
+
+#include "test/Context.h"
+#include "test/CorpusGenerator.h"
+
+namespace aapt {
+
+static void BM_ResourceDeduperDedupe(benchmark::State& state) {
+  std::unique_ptr<IAaptContext> context =
+      test::ContextBuilder().SetCompilationPackage("com.app.test").SetPackageId(0x7f).Build();
+  test::CorpusOptions options;
+  options.entries = state.range(0);
+  options.densities = 5;
+  const std::vector<test::CorpusFile> files = test::GenerateCorpus(options);
+
+  while (state.KeepRunning()) {
+    // Deduping removes values, so every iteration needs a fresh table.
+    state.PauseTiming();
+    std::unique_ptr<ResourceTable> table = test::BuildCorpusTable(context.get(), files);
+    state.ResumeTiming();
+    if (!table) {
+      state.SkipWithError("failed to build corpus table");
+      break;
+    }
+
+    ResourceDeduper deduper;
+    if (!deduper.Consume(context.get(), table.get())) {
+      state.SkipWithError("failed to dedupe table");
+      break;
+    }
+  }
+}
+BENCHMARK(BM_ResourceDeduperDedupe)->Range(64, 16 << 10);
+
+}  // namespace aapt
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "optimize/ResourcePathShortener.h"
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#include "ResourceTable.h"
+#include "ResourceValues.h"
+#include "ValueVisitor.h"
+#include "util/Util.h"
+
+using ::android::StringPiece;
+
+namespace aapt {
+
+// The characters of the URL-safe base64 alphabet, which are all valid in zip entry names.
+constexpr const char kShortNameChars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+constexpr size_t kShortNameBase = sizeof(kShortNameChars) - 1;
+
+// Returns the first `len` characters of the base64 encoding of `hash`. Longer names only append
+// characters, so a colliding name can be made unique by growing it.
+static std::string EncodeHash(uint64_t hash, size_t len) {
+  std::string name;
+  for (size_t i = 0; i < len; i++) {
+    name += kShortNameChars[hash % kShortNameBase];
+    hash /= kShortNameBase;
+  }
+  return name;
+}
+
+// Returns the extension of the ZIP entry at `path`, starting at the first '.' of its file name so
+// that extensions like ".9.png" are kept whole. ZIP paths always use '/', whatever the host OS.
+static StringPiece GetZipPathExtension(const StringPiece& path) {
+  const char* const end = path.end();
+  const char* name = path.begin();
+  for (const char* c = path.begin(); c != end; ++c) {
+    if (*c == '/') {
+      name = c + 1;
+    }
+  }
+
+  const char* ext = std::find(name, end, '.');
+  return StringPiece(ext, end - ext);
+}
+
+bool ResourcePathShortener::Consume(IAaptContext* /*context*/, ResourceTable* table) {
+  std::vector<FileReference*> file_refs;
+  for (auto& package : table->packages) {
+    for (auto& type : package->types) {
+      for (auto& entry : type->entries) {
+        for (auto& config_value : entry->values) {
+          FileReference* file_ref = ValueCast<FileReference>(config_value->value.get());
+          if (file_ref != nullptr) {
+            file_refs.push_back(file_ref);
+          }
+        }
+      }
+    }
+  }
+
+  // Start with the shortest names that leave room for twice as many files, so that most names
+  // don't collide and stay that short.
+  size_t min_len = 1u;
+  for (size_t capacity = kShortNameBase; capacity < file_refs.size() * 2u;
+       capacity *= kShortNameBase) {
+    min_len++;
+  }
+
+  // Paths that are not renamed still occupy their names.
+  std::set<std::string> used_paths;
+  for (FileReference* file_ref : file_refs) {
+    used_paths.insert(*file_ref->path);
+  }
+
+  for (FileReference* file_ref : file_refs) {
+    const std::string original_path = *file_ref->path;
+    auto iter = path_map_->find(original_path);
+    if (iter == path_map_->end()) {
+      const uint64_t hash = util::Hasher().Update(original_path).Digest();
+      const std::string ext = GetZipPathExtension(original_path).to_string();
+
+      // 64 bits need at most 11 characters. Beyond that, names are told apart by a counter.
+      std::string short_path;
+      for (size_t len = min_len, suffix = 0u;
+           short_path.empty() || used_paths.find(short_path) != used_paths.end(); len++) {
+        if (len <= 11u) {
+          short_path = "res/" + EncodeHash(hash, len) + ext;
+        } else {
+          short_path = "res/" + EncodeHash(hash, 11u) + std::to_string(suffix++) + ext;
+        }
+      }
+
+      if (short_path.size() >= original_path.size()) {
+        // A path that is already short is kept.
+        short_path = original_path;
+      }
+      used_paths.insert(short_path);
+      iter = path_map_->insert({original_path, short_path}).first;
+    }
+
+    if (iter->second != original_path) {
+      file_ref->path = table->string_pool.MakeRef(iter->second, file_ref->path.GetContext());
+    }
+  }
+  return true;
+}
+
+}  // namespace aapt
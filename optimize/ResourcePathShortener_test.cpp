@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "optimize/ResourcePathShortener.h"
+
+#include "ResourceTable.h"
+#include "test/Test.h"
+
+using ::testing::Eq;
+using ::testing::Ne;
+using ::testing::NotNull;
+using ::testing::SizeIs;
+
+namespace aapt {
+
+TEST(ResourcePathShortenerTest, FilesAreRenamedAndKeepTheirExtensions) {
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder().Build();
+  std::unique_ptr<ResourceTable> table =
+      test::ResourceTableBuilder()
+          .AddFileReference("android:drawable/icon", "res/drawable/icon.png")
+          .AddFileReference("android:drawable/icon", "res/drawable-hdpi-v4/icon.png",
+                            test::ParseConfigOrDie("hdpi-v4"))
+          .AddFileReference("android:drawable/button", "res/drawable/button.9.png")
+          .AddFileReference("android:layout/main", "res/layout/main.xml")
+          .AddFileReference("android:raw/data", "res/raw.extra/data.bin")
+          .Build();
+
+  std::map<std::string, std::string> path_map;
+  ASSERT_TRUE(ResourcePathShortener(&path_map).Consume(context.get(), table.get()));
+  ASSERT_THAT(path_map, SizeIs(5u));
+
+  FileReference* icon = test::GetValue<FileReference>(table.get(), "android:drawable/icon");
+  ASSERT_THAT(icon, NotNull());
+  FileReference* icon_hdpi = test::GetValueForConfig<FileReference>(
+      table.get(), "android:drawable/icon", test::ParseConfigOrDie("hdpi-v4"));
+  ASSERT_THAT(icon_hdpi, NotNull());
+  FileReference* button = test::GetValue<FileReference>(table.get(), "android:drawable/button");
+  ASSERT_THAT(button, NotNull());
+
+  EXPECT_THAT(*icon->path, Eq(path_map["res/drawable/icon.png"]));
+  EXPECT_THAT(*icon->path, Ne(*icon_hdpi->path));
+  EXPECT_TRUE(util::StartsWith(*icon->path, "res/"));
+  EXPECT_TRUE(util::EndsWith(*icon->path, ".png"));
+  EXPECT_LT(icon->path->size(), std::string("res/drawable/icon.png").size());
+  EXPECT_TRUE(util::EndsWith(*button->path, ".9.png"));
+
+  // Only the file name's extension is kept, not everything after a '.' in a directory name.
+  FileReference* data = test::GetValue<FileReference>(table.get(), "android:raw/data");
+  ASSERT_THAT(data, NotNull());
+  EXPECT_THAT(*data->path, Eq(path_map["res/raw.extra/data.bin"]));
+  EXPECT_TRUE(util::EndsWith(*data->path, ".bin"));
+  EXPECT_THAT(data->path->find('.'), Eq(data->path->size() - 4u));
+}
+
+TEST(ResourcePathShortenerTest, SharedFilesKeepSharingTheirPath) {
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder().Build();
+  std::unique_ptr<ResourceTable> table =
+      test::ResourceTableBuilder()
+          .AddFileReference("android:drawable/icon", "res/drawable/icon.png")
+          .AddFileReference("android:drawable/alias", "res/drawable/icon.png")
+          .Build();
+
+  std::map<std::string, std::string> path_map;
+  ASSERT_TRUE(ResourcePathShortener(&path_map).Consume(context.get(), table.get()));
+
+  FileReference* icon = test::GetValue<FileReference>(table.get(), "android:drawable/icon");
+  ASSERT_THAT(icon, NotNull());
+  FileReference* alias = test::GetValue<FileReference>(table.get(), "android:drawable/alias");
+  ASSERT_THAT(alias, NotNull());
+  EXPECT_THAT(*icon->path, Eq(*alias->path));
+}
+
+TEST(ResourcePathShortenerTest, NamesGrowInsteadOfColliding) {
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder().Build();
+  test::ResourceTableBuilder builder;
+  for (size_t i = 0; i < 500u; i++) {
+    const std::string name = "android:drawable/icon_" + std::to_string(i);
+    builder.AddFileReference(name, "res/drawable/icon_" + std::to_string(i) + ".png");
+  }
+  std::unique_ptr<ResourceTable> table = builder.Build();
+
+  std::map<std::string, std::string> path_map;
+  ASSERT_TRUE(ResourcePathShortener(&path_map).Consume(context.get(), table.get()));
+
+  std::set<std::string> short_paths;
+  for (const auto& entry : path_map) {
+    short_paths.insert(entry.second);
+  }
+  EXPECT_THAT(short_paths, SizeIs(500u));
+}
+
+}  // namespace aapt
@@ -21,6 +21,8 @@
 #include <list>
 #include <sstream>
 
+#include "android-base/macros.h"
+
 #include "Diagnostics.h"
 #include "NameMangler.h"
 #include "Resource.h"
@@ -52,6 +54,53 @@ struct IAaptContext {
   virtual int GetMinSdkVersion() = 0;
 };
 
+// Forwards to another context, except that diagnostics are reported to `diag`. Work that runs on
+// another thread logs to a BufferedDiagnostics this way, so that its messages can be forwarded in
+// a deterministic order once it is done.
+class DiagnosticsOverrideContext : public IAaptContext {
+ public:
+  DiagnosticsOverrideContext(IAaptContext* context, IDiagnostics* diag)
+      : context_(context), diag_(diag) {}
+
+  PackageType GetPackageType() override {
+    return context_->GetPackageType();
+  }
+
+  SymbolTable* GetExternalSymbols() override {
+    return context_->GetExternalSymbols();
+  }
+
+  IDiagnostics* GetDiagnostics() override {
+    return diag_;
+  }
+
+  const std::string& GetCompilationPackage() override {
+    return context_->GetCompilationPackage();
+  }
+
+  uint8_t GetPackageId() override {
+    return context_->GetPackageId();
+  }
+
+  NameMangler* GetNameMangler() override {
+    return context_->GetNameMangler();
+  }
+
+  bool IsVerbose() override {
+    return context_->IsVerbose();
+  }
+
+  int GetMinSdkVersion() override {
+    return context_->GetMinSdkVersion();
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(DiagnosticsOverrideContext);
+
+  IAaptContext* context_;
+  IDiagnostics* diag_;
+};
+
 struct IResourceTableConsumer {
   virtual ~IResourceTableConsumer() = default;
 
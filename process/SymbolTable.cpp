@@ -41,8 +41,14 @@ SymbolTable::SymbolTable(NameMangler* mangler)
       id_cache_(200) {
 }
 
+SymbolTable::SymbolTable(SymbolTable* parent)
+    : mangler_(parent->mangler_), parent_(parent), cache_(200), id_cache_(200) {
+}
+
 void SymbolTable::SetDelegate(std::unique_ptr<ISymbolTableDelegate> delegate) {
   CHECK(delegate != nullptr) << "can't set a nullptr delegate";
+  CHECK(parent_ == nullptr) << "can't set the delegate of a table with a parent";
+  std::lock_guard<std::mutex> lock(lock_);
   delegate_ = std::move(delegate);
 
   // Clear the cache in case this delegate changes the order of lookup.
@@ -50,6 +56,8 @@ void SymbolTable::SetDelegate(std::unique_ptr<ISymbolTableDelegate> delegate) {
 }
 
 void SymbolTable::AppendSource(std::unique_ptr<ISymbolSource> source) {
+  CHECK(parent_ == nullptr) << "can't add a source to a table with a parent";
+  std::lock_guard<std::mutex> lock(lock_);
   sources_.push_back(std::move(source));
 
   // We do not clear the cache, because sources earlier in the list take
@@ -57,6 +65,8 @@ void SymbolTable::AppendSource(std::unique_ptr<ISymbolSource> source) {
 }
 
 void SymbolTable::PrependSource(std::unique_ptr<ISymbolSource> source) {
+  CHECK(parent_ == nullptr) << "can't add a source to a table with a parent";
+  std::lock_guard<std::mutex> lock(lock_);
   sources_.insert(sources_.begin(), std::move(source));
 
   // We must clear the cache in case we did a lookup before adding this
@@ -65,6 +75,88 @@ void SymbolTable::PrependSource(std::unique_ptr<ISymbolSource> source) {
 }
 
 const SymbolTable::Symbol* SymbolTable::FindByName(const ResourceName& name) {
+  if (parent_ != nullptr) {
+    // Only one thread uses a table with a parent, so a hit takes no lock and doesn't touch the
+    // reference count that the other threads share.
+    if (const std::shared_ptr<Symbol>& s = cache_.get(name)) {
+      return s.get();
+    }
+  }
+
+  // The cache of this table keeps the symbol alive until a later lookup evicts it.
+  return FindByNameShared(name).get();
+}
+
+const SymbolTable::Symbol* SymbolTable::FindById(const ResourceId& id) {
+  if (parent_ != nullptr) {
+    if (const std::shared_ptr<Symbol>& s = id_cache_.get(id)) {
+      return s.get();
+    }
+  }
+  return FindByIdShared(id).get();
+}
+
+const SymbolTable::Symbol* SymbolTable::FindByReference(const Reference& ref) {
+  // First try the ID. This is because when we lookup by ID, we only fill in the ID cache.
+  // Looking up by name fills in the name and ID cache. So a cache miss will cause a failed
+  // ID lookup, then a successful name lookup. Subsequent look ups will hit immediately
+  // because the ID is cached too.
+  //
+  // If we looked up by name first, a cache miss would mean we failed to lookup by name, then
+  // succeeded to lookup by ID. Subsequent lookups will miss then hit.
+  const Symbol* symbol = nullptr;
+  if (ref.id) {
+    symbol = FindById(ref.id.value());
+  }
+
+  if (ref.name && !symbol) {
+    symbol = FindByName(ref.name.value());
+  }
+  return symbol;
+}
+
+std::shared_ptr<SymbolTable::Symbol> SymbolTable::FindByNameShared(const ResourceName& name) {
+  if (parent_ == nullptr) {
+    std::lock_guard<std::mutex> lock(lock_);
+    return FindByNameLocked(name);
+  }
+
+  if (const std::shared_ptr<Symbol>& s = cache_.get(name)) {
+    return s;
+  }
+
+  std::shared_ptr<Symbol> symbol = parent_->FindByNameShared(name);
+  if (symbol == nullptr) {
+    return nullptr;
+  }
+
+  cache_.put(name, symbol);
+  if (symbol->id) {
+    id_cache_.put(symbol->id.value(), symbol);
+  }
+  return symbol;
+}
+
+std::shared_ptr<SymbolTable::Symbol> SymbolTable::FindByIdShared(const ResourceId& id) {
+  if (parent_ == nullptr) {
+    std::lock_guard<std::mutex> lock(lock_);
+    return FindByIdLocked(id);
+  }
+
+  if (const std::shared_ptr<Symbol>& s = id_cache_.get(id)) {
+    return s;
+  }
+
+  std::shared_ptr<Symbol> symbol = parent_->FindByIdShared(id);
+  if (symbol == nullptr) {
+    return nullptr;
+  }
+
+  id_cache_.put(id, symbol);
+  return symbol;
+}
+
+std::shared_ptr<SymbolTable::Symbol> SymbolTable::FindByNameLocked(const ResourceName& name) {
   const ResourceName* name_with_package = &name;
 
   // Fill in the package name if necessary.
@@ -78,7 +170,7 @@ const SymbolTable::Symbol* SymbolTable::FindByName(const ResourceName& name) {
 
   // We store the name unmangled in the cache, so look it up as-is.
   if (const std::shared_ptr<Symbol>& s = cache_.get(*name_with_package)) {
-    return s.get();
+    return s;
   }
 
   // The name was not found in the cache. Mangle it (if necessary) and find it in our sources.
@@ -107,15 +199,12 @@ const SymbolTable::Symbol* SymbolTable::FindByName(const ResourceName& name) {
     // The symbol has an ID, so we can also cache this!
     id_cache_.put(shared_symbol->id.value(), shared_symbol);
   }
-
-  // Returns the raw pointer. Callers are not expected to hold on to this
-  // between calls to Find*.
-  return shared_symbol.get();
+  return shared_symbol;
 }
 
-const SymbolTable::Symbol* SymbolTable::FindById(const ResourceId& id) {
+std::shared_ptr<SymbolTable::Symbol> SymbolTable::FindByIdLocked(const ResourceId& id) {
   if (const std::shared_ptr<Symbol>& s = id_cache_.get(id)) {
-    return s.get();
+    return s;
   }
 
   // We did not find it in the cache, so look through the sources.
@@ -128,29 +217,7 @@ const SymbolTable::Symbol* SymbolTable::FindById(const ResourceId& id) {
   // doesn't support unique_ptr.
   std::shared_ptr<Symbol> shared_symbol(std::move(symbol));
   id_cache_.put(id, shared_symbol);
-
-  // Returns the raw pointer. Callers are not expected to hold on to this
-  // between calls to Find*.
-  return shared_symbol.get();
-}
-
-const SymbolTable::Symbol* SymbolTable::FindByReference(const Reference& ref) {
-  // First try the ID. This is because when we lookup by ID, we only fill in the ID cache.
-  // Looking up by name fills in the name and ID cache. So a cache miss will cause a failed
-  // ID lookup, then a successful name lookup. Subsequent look ups will hit immediately
-  // because the ID is cached too.
-  //
-  // If we looked up by name first, a cache miss would mean we failed to lookup by name, then
-  // succeeded to lookup by ID. Subsequent lookups will miss then hit.
-  const SymbolTable::Symbol* symbol = nullptr;
-  if (ref.id) {
-    symbol = FindById(ref.id.value());
-  }
-
-  if (ref.name && !symbol) {
-    symbol = FindByName(ref.name.value());
-  }
-  return symbol;
+  return shared_symbol;
 }
 
 std::unique_ptr<SymbolTable::Symbol> DefaultSymbolTableDelegate::FindByName(
@@ -19,6 +19,7 @@
 
 #include <algorithm>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 #include "android-base/macros.h"
@@ -72,6 +73,11 @@ class SymbolTable {
 
   SymbolTable(NameMangler* mangler);
 
+  // Creates a table that looks up symbols in `parent` and caches them for one thread of work,
+  // such as a shard of the linker. Lookups that hit its own cache don't lock `parent`, and the
+  // symbols it holds stay alive even if `parent` evicts them. It has no sources of its own.
+  explicit SymbolTable(SymbolTable* parent);
+
   // Overrides the default ISymbolTableDelegate, which allows a custom defined strategy for
   // looking up resources from a set of sources.
   void SetDelegate(std::unique_ptr<ISymbolTableDelegate> delegate);
@@ -84,6 +90,12 @@ class SymbolTable {
   // cause the existing cache to be cleared.
   void PrependSource(std::unique_ptr<ISymbolSource> source);
 
+  // The FindByXXX methods may be called from several threads at once. The sources
+  // and the delegate are only used while the table is locked, so they don't need
+  // to be thread-safe themselves. A lookup by one thread may evict the result of
+  // another, so work that runs on several threads looks up symbols through its
+  // own SymbolTable(parent) instead.
+  //
   // NOTE: Never hold on to the result between calls to FindByXXX. The
   // results are stored in a cache which may evict entries on subsequent calls.
   const Symbol* FindByName(const ResourceName& name);
@@ -99,7 +111,23 @@ class SymbolTable {
   const Symbol* FindByReference(const Reference& ref);
 
  private:
+  // Look up a symbol in the cache of this table, and if it isn't there, in the cache of the
+  // parent or the sources.
+  std::shared_ptr<Symbol> FindByNameShared(const ResourceName& name);
+  std::shared_ptr<Symbol> FindByIdShared(const ResourceId& id);
+
+  std::shared_ptr<Symbol> FindByNameLocked(const ResourceName& name);
+  std::shared_ptr<Symbol> FindByIdLocked(const ResourceId& id);
+
   NameMangler* mangler_;
+
+  // The table that misses are looked up in, or nullptr if this table has its own sources.
+  SymbolTable* parent_ = nullptr;
+
+  // Guards everything below, unless this table has a parent. A table with a parent is only used
+  // by one thread at a time.
+  std::mutex lock_;
+
   std::unique_ptr<ISymbolTableDelegate> delegate_;
   std::vector<std::unique_ptr<ISymbolSource>> sources_;
 
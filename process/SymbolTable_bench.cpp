@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "process/SymbolTable.h"
+
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "NameMangler.h"
+#include "test/Builders.h"
+#include "test/Common.h"
+
+namespace aapt {
+
+// The number of distinct names looked up, few enough to stay in the caches, as the attributes
+// and styles referenced all over a table do.
+constexpr int kNameCount = 64;
+
+static std::vector<ResourceName> MakeNames() {
+  std::vector<ResourceName> names;
+  for (int i = 0; i < kNameCount; i++) {
+    names.push_back(test::ParseNameOrDie("com.app.test:id/id" + std::to_string(i)));
+  }
+  return names;
+}
+
+// A symbol table shared by all threads of a benchmark, as the one of the link context is.
+static SymbolTable* GetSharedSymbolTable() {
+  static NameMangler mangler(NameManglerPolicy{"com.app.test"});
+  static std::unique_ptr<ResourceTable> table = []() {
+    test::ResourceTableBuilder builder;
+    for (const ResourceName& name : MakeNames()) {
+      builder.AddSimple(name.to_string());
+    }
+    return builder.Build();
+  }();
+  static SymbolTable* symbol_table = []() {
+    SymbolTable* symbols = new SymbolTable(&mangler);
+    symbols->AppendSource(util::make_unique<ResourceTableSymbolSource>(table.get()));
+    return symbols;
+  }();
+  return symbol_table;
+}
+
+static void FindNames(benchmark::State& state, SymbolTable* symbols,
+                      const std::vector<ResourceName>& names) {
+  size_t i = 0u;
+  while (state.KeepRunning()) {
+    if (symbols->FindByName(names[i++ % names.size()]) == nullptr) {
+      state.SkipWithError("symbol not found");
+      break;
+    }
+  }
+}
+
+// Every thread looks up symbols in the shared table, and so takes its lock for each lookup.
+static void BM_SymbolTableFindByNameShared(benchmark::State& state) {
+  const std::vector<ResourceName> names = MakeNames();
+  FindNames(state, GetSharedSymbolTable(), names);
+}
+BENCHMARK(BM_SymbolTableFindByNameShared)->ThreadRange(1, 8)->UseRealTime();
+
+// Every thread looks up symbols through its own table, as each shard of the linker does. Only
+// the first lookup of each name locks the shared table.
+static void BM_SymbolTableFindByNameWithParent(benchmark::State& state) {
+  const std::vector<ResourceName> names = MakeNames();
+  SymbolTable symbols(GetSharedSymbolTable());
+  FindNames(state, &symbols, names);
+}
+BENCHMARK(BM_SymbolTableFindByNameWithParent)->ThreadRange(1, 8)->UseRealTime();
+
+}  // namespace aapt
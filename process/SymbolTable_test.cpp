@@ -68,4 +68,30 @@ TEST(SymbolTableTest, FindByName) {
   EXPECT_NE(nullptr, symbol_table.FindByName(test::ParseNameOrDie("com.android.lib:id/foo")));
 }
 
+TEST(SymbolTableTest, TableWithParentKeepsItsSymbolsWhenTheParentEvictsThem) {
+  test::ResourceTableBuilder builder;
+  for (int i = 0; i < 500; i++) {
+    builder.AddSimple("com.android.app:id/foo" + std::to_string(i));
+  }
+  std::unique_ptr<ResourceTable> table = builder.Build();
+
+  NameMangler mangler(NameManglerPolicy{"com.android.app"});
+  SymbolTable symbol_table(&mangler);
+  symbol_table.AppendSource(util::make_unique<ResourceTableSymbolSource>(table.get()));
+  SymbolTable shard_symbols(&symbol_table);
+
+  const SymbolTable::Symbol* symbol =
+      shard_symbols.FindByName(test::ParseNameOrDie("com.android.app:id/foo0"));
+  ASSERT_NE(nullptr, symbol);
+
+  // Fill the cache of the parent with other symbols.
+  for (int i = 1; i < 500; i++) {
+    ASSERT_NE(nullptr, symbol_table.FindByName(
+                           test::ParseNameOrDie("com.android.app:id/foo" + std::to_string(i))));
+  }
+
+  EXPECT_EQ(symbol, shard_symbols.FindByName(test::ParseNameOrDie("com.android.app:id/foo0")));
+  EXPECT_EQ(nullptr, shard_symbols.FindByName(test::ParseNameOrDie("com.android.app:id/bar")));
+}
+
 }  // namespace aapt
@@ -18,7 +18,6 @@
 
 #include <algorithm>
 #include <map>
-#include <set>
 #include <unordered_set>
 #include <unordered_map>
 #include <vector>
@@ -114,8 +113,8 @@ class SplitValueSelector {
  private:
   DISALLOW_COPY_AND_ASSIGN(SplitValueSelector);
 
-  std::set<ConfigDescription> density_independent_configs_;
-  std::map<ConfigDescription, uint16_t>
+  std::unordered_set<ConfigDescription> density_independent_configs_;
+  std::unordered_map<ConfigDescription, uint16_t>
       density_dependent_config_to_density_map_;
 };
 
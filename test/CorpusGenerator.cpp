@@ -0,0 +1,374 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "test/CorpusGenerator.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+#include "android-base/macros.h"
+
+#include "ConfigDescription.h"
+#include "ResourceParser.h"
+#include "compile/IdAssigner.h"
+#include "link/ReferenceLinker.h"
+#include "link/TableMerger.h"
+#include "process/SymbolTable.h"
+#include "util/Util.h"
+#include "xml/XmlPullParser.h"
+
+namespace aapt {
+namespace test {
+
+constexpr const char* kXmlPreamble = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n";
+
+constexpr const char* kLocales[] = {
+    "fr", "de", "es", "it", "ja", "ko", "ru", "ar",
+    "nl", "pl", "sv", "tr", "pt-rBR", "zh-rCN", "zh-rTW", "en-rGB",
+};
+
+constexpr const char* kDensities[] = {"mdpi", "hdpi", "xhdpi", "xxhdpi", "xxxhdpi"};
+
+constexpr const char* kWords[] = {
+    "the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog", "settings", "account",
+    "open", "close", "share", "message", "network", "retry", "cancel", "download",
+};
+
+namespace {
+
+// std::minstd_rand is fully specified by the standard, unlike the distributions, so the corpus is
+// the same with every standard library.
+class Random {
+ public:
+  explicit Random(uint32_t seed) : engine_(seed) {
+  }
+
+  // Returns a number in [0, n), or 0 if n is 0.
+  size_t Next(size_t n) {
+    return n == 0u ? 0u : static_cast<size_t>(engine_()) % n;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Random);
+
+  std::minstd_rand engine_;
+};
+
+class CorpusWriter {
+ public:
+  explicit CorpusWriter(const CorpusOptions& options)
+      : options_(options),
+        random_(options.seed),
+        locale_count_(std::min(options.locales, arraysize(kLocales))),
+        density_count_(std::min(options.densities, arraysize(kDensities))) {
+  }
+
+  std::vector<CorpusFile> Write() {
+    WriteDefaultValues();
+    for (size_t i = 0; i < locale_count_; i++) {
+      WriteTranslatedValues(kLocales[i]);
+    }
+    for (size_t i = 0; i < density_count_; i++) {
+      WriteDensityValues(kDensities[i]);
+    }
+    for (size_t i = 0; i < options_.drawables; i++) {
+      WriteDrawables(i);
+    }
+    for (size_t i = 0; i < options_.layouts; i++) {
+      WriteLayout(i);
+    }
+    return std::move(files_);
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(CorpusWriter);
+
+  void AddFile(const std::string& path, const std::string& contents) {
+    files_.push_back(CorpusFile{path, contents});
+  }
+
+  std::string MakeText(size_t word_count) {
+    std::string text;
+    for (size_t i = 0; i < word_count; i++) {
+      if (i != 0) {
+        text += ' ';
+      }
+      text += kWords[random_.Next(arraysize(kWords))];
+    }
+    return text;
+  }
+
+  std::string MakeColor() {
+    std::ostringstream out;
+    out << "#ff" << std::hex << std::setw(6) << std::setfill('0') << random_.Next(0x1000000);
+    return out.str();
+  }
+
+  std::string MakeDimen() {
+    std::ostringstream out;
+    out << (1 + random_.Next(64)) << "dp";
+    return out.str();
+  }
+
+  void WriteDefaultValues() {
+    const size_t n = options_.entries;
+    std::ostringstream out;
+    out << kXmlPreamble << "<resources>\n";
+    for (size_t i = 0; i < n; i++) {
+      out << "  <attr name=\"attr_" << i << "\" format=\"reference|dimension|color\" />\n";
+    }
+
+    for (size_t i = 0; i < n; i++) {
+      out << "  <string name=\"string_" << i << "\">";
+      if (i != 0 && random_.Next(8) == 0) {
+        out << "@string/string_" << random_.Next(i);
+      } else {
+        default_strings_.push_back(MakeText(1 + random_.Next(8)));
+        out << default_strings_.back();
+      }
+      out << "</string>\n";
+    }
+
+    for (size_t i = 0; i < n; i++) {
+      default_dimens_.push_back(MakeDimen());
+      out << "  <dimen name=\"dimen_" << i << "\">" << default_dimens_.back() << "</dimen>\n";
+    }
+
+    for (size_t i = 0; i < n; i++) {
+      out << "  <color name=\"color_" << i << "\">" << MakeColor() << "</color>\n";
+    }
+
+    for (size_t i = 0; i < n; i++) {
+      out << "  <style name=\"Style_" << i << "\"";
+      if (i != 0) {
+        out << " parent=\"Style_" << random_.Next(i) << "\"";
+      }
+      out << ">\n";
+      const size_t attr = random_.Next(n);
+      out << "    <item name=\"attr_" << attr << "\">@dimen/dimen_" << random_.Next(n)
+          << "</item>\n";
+      if (n > 1) {
+        out << "    <item name=\"attr_" << (attr + 1) % n << "\">@color/color_"
+            << random_.Next(n) << "</item>\n";
+      }
+      out << "  </style>\n";
+    }
+    out << "</resources>\n";
+    AddFile("res/values/values.xml", out.str());
+  }
+
+  // Translates every string, keeping a quarter of them the same as the default.
+  void WriteTranslatedValues(const std::string& locale) {
+    std::ostringstream out;
+    out << kXmlPreamble << "<resources>\n";
+    for (size_t i = 0; i < options_.entries; i++) {
+      out << "  <string name=\"string_" << i << "\">";
+      if (random_.Next(4) == 0 && !default_strings_.empty()) {
+        out << default_strings_[random_.Next(default_strings_.size())];
+      } else {
+        out << locale << " " << MakeText(1 + random_.Next(8));
+      }
+      out << "</string>\n";
+    }
+    out << "</resources>\n";
+    AddFile("res/values-" + locale + "/values.xml", out.str());
+  }
+
+  // Overrides every fourth dimen, half of them with the default value so that they can be
+  // deduplicated.
+  void WriteDensityValues(const std::string& density) {
+    std::ostringstream out;
+    out << kXmlPreamble << "<resources>\n";
+    for (size_t i = 0; i < options_.entries; i += 4) {
+      out << "  <dimen name=\"dimen_" << i << "\">"
+          << (random_.Next(2) == 0 ? default_dimens_[i] : MakeDimen()) << "</dimen>\n";
+    }
+    out << "</resources>\n";
+    AddFile("res/values-" + density + "/values.xml", out.str());
+  }
+
+  std::string MakeDrawable() {
+    std::ostringstream out;
+    out << kXmlPreamble
+        << "<vector xmlns:android=\"http://schemas.android.com/apk/res/android\"\n"
+        << "    android:width=\"24dp\" android:height=\"24dp\"\n"
+        << "    android:viewportWidth=\"24\" android:viewportHeight=\"24\">\n";
+    const size_t paths = 1 + random_.Next(4);
+    for (size_t i = 0; i < paths; i++) {
+      // Each call is sequenced separately, since the order in which the operands of a single
+      // expression are evaluated is unspecified.
+      const std::string color = MakeColor();
+      const size_t x0 = random_.Next(24);
+      const size_t y0 = random_.Next(24);
+      const size_t x1 = random_.Next(24);
+      const size_t y1 = random_.Next(24);
+      out << "  <path android:fillColor=\"" << color << "\" android:pathData=\"M" << x0 << ","
+          << y0 << "L" << x1 << "," << y1 << "Z\" />\n";
+    }
+    out << "</vector>\n";
+    return out.str();
+  }
+
+  // Writes a default drawable and, for every other drawable, an override for each density.
+  void WriteDrawables(size_t index) {
+    std::ostringstream name;
+    name << "drawable_" << index << ".xml";
+    AddFile("res/drawable/" + name.str(), MakeDrawable());
+    if (index % 2 == 0) {
+      for (size_t i = 0; i < density_count_; i++) {
+        AddFile(std::string("res/drawable-") + kDensities[i] + "/" + name.str(), MakeDrawable());
+      }
+    }
+  }
+
+  void WriteView(std::ostream* out, const std::string& indent) {
+    if (random_.Next(2) == 0 || options_.drawables == 0) {
+      *out << indent << "<TextView android:layout_width=\"match_parent\"\n"
+           << indent << "    android:layout_height=\"wrap_content\"";
+      if (options_.entries != 0) {
+        const size_t string = random_.Next(options_.entries);
+        const size_t dimen = random_.Next(options_.entries);
+        *out << "\n"
+             << indent << "    android:text=\"@string/string_" << string << "\"\n"
+             << indent << "    android:textSize=\"@dimen/dimen_" << dimen << "\"";
+      }
+      *out << " />\n";
+    } else {
+      *out << indent << "<ImageView android:layout_width=\"wrap_content\"\n"
+           << indent << "    android:layout_height=\"wrap_content\"\n"
+           << indent << "    android:src=\"@drawable/drawable_" << random_.Next(options_.drawables)
+           << "\" />\n";
+    }
+  }
+
+  // Writes a LinearLayout of FrameLayouts that each hold up to five views.
+  void WriteLayout(size_t index) {
+    std::ostringstream out;
+    out << kXmlPreamble
+        << "<LinearLayout xmlns:android=\"http://schemas.android.com/apk/res/android\"\n"
+        << "    android:layout_width=\"match_parent\"\n"
+        << "    android:layout_height=\"match_parent\"\n"
+        << "    android:orientation=\"vertical\">\n";
+    for (size_t i = 0; i < options_.views_per_layout; i += 5) {
+      out << "  <FrameLayout android:layout_width=\"match_parent\"\n"
+          << "      android:layout_height=\"wrap_content\">\n";
+      const size_t end = std::min(i + 5, options_.views_per_layout);
+      for (size_t j = i; j < end; j++) {
+        WriteView(&out, "    ");
+      }
+      out << "  </FrameLayout>\n";
+    }
+    out << "</LinearLayout>\n";
+
+    std::ostringstream path;
+    path << "res/layout/layout_" << index << ".xml";
+    AddFile(path.str(), out.str());
+  }
+
+  const CorpusOptions& options_;
+  Random random_;
+  const size_t locale_count_;
+  const size_t density_count_;
+
+  std::vector<std::string> default_strings_;
+  std::vector<std::string> default_dimens_;
+  std::vector<CorpusFile> files_;
+};
+
+}  // namespace
+
+std::vector<CorpusFile> GenerateCorpus(const CorpusOptions& options) {
+  return CorpusWriter(options).Write();
+}
+
+std::unique_ptr<ResourceTable> BuildCorpusTable(IAaptContext* context,
+                                                const std::vector<CorpusFile>& files) {
+  // Every file is compiled into the same table, which is then merged into the app's package.
+  ResourceTable compiled_table;
+  for (const CorpusFile& file : files) {
+    // The path is always "res/<type>[-<qualifiers>]/<name>.xml".
+    const std::vector<std::string> parts = util::Split(file.path, '/');
+    if (parts.size() != 3u) {
+      context->GetDiagnostics()->Error(DiagMessage(file.path) << "invalid corpus path");
+      return {};
+    }
+
+    const std::string& dir = parts[1];
+    const size_t dash = dir.find('-');
+    const std::string type_str = dir.substr(0, dash);
+    ConfigDescription config;
+    if (dash != std::string::npos && !ConfigDescription::Parse(dir.substr(dash + 1), &config)) {
+      context->GetDiagnostics()->Error(DiagMessage(file.path) << "invalid configuration");
+      return {};
+    }
+
+    if (type_str == "values") {
+      ResourceParser parser(context->GetDiagnostics(), &compiled_table, Source(file.path), config);
+      xml::XmlPullParser xml_parser(file.contents.data(), file.contents.size());
+      if (!parser.Parse(&xml_parser)) {
+        return {};
+      }
+      continue;
+    }
+
+    const ResourceType* type = ParseResourceType(type_str);
+    if (!type) {
+      context->GetDiagnostics()->Error(DiagMessage(file.path) << "invalid resource type");
+      return {};
+    }
+
+    const std::string name = parts[2].substr(0, parts[2].find('.'));
+    if (!compiled_table.AddResource(
+            ResourceNameRef({}, *type, name), config, {},
+            util::make_unique<FileReference>(compiled_table.string_pool.MakeRef(file.path)),
+            context->GetDiagnostics())) {
+      return {};
+    }
+  }
+
+  std::unique_ptr<ResourceTable> table = util::make_unique<ResourceTable>();
+  TableMerger merger(context, table.get(), TableMergerOptions{});
+  if (!merger.Merge(Source("corpus"), &compiled_table)) {
+    return {};
+  }
+  return table;
+}
+
+std::unique_ptr<ResourceTable> BuildLinkedCorpusTable(IAaptContext* context,
+                                                      const std::vector<CorpusFile>& files) {
+  std::unique_ptr<ResourceTable> table = BuildCorpusTable(context, files);
+  if (!table) {
+    return {};
+  }
+
+  IdAssigner id_assigner;
+  if (!id_assigner.Consume(context, table.get())) {
+    return {};
+  }
+
+  context->GetExternalSymbols()->PrependSource(
+      util::make_unique<ResourceTableSymbolSource>(table.get()));
+  ReferenceLinker linker;
+  if (!linker.Consume(context, table.get())) {
+    return {};
+  }
+  return table;
+}
+
+}  // namespace test
+}  // namespace aapt
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAPT_TEST_CORPUSGENERATOR_H
+#define AAPT_TEST_CORPUSGENERATOR_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ResourceTable.h"
+#include "process/IResourceTableConsumer.h"
+
+namespace aapt {
+namespace test {
+
+// Describes the size and shape of a synthetic resource tree.
+struct CorpusOptions {
+  // The number of each of strings, dimens, colors, attributes and styles in res/values.
+  size_t entries = 1000;
+
+  // The number of locales every string is translated to, in res/values-<locale>.
+  // At most 16 locales are generated.
+  size_t locales = 4;
+
+  // The number of densities that dimens and drawables are overridden for, in
+  // res/values-<density> and res/drawable-<density>. At most 5 densities are generated.
+  size_t densities = 2;
+
+  size_t layouts = 50;
+  size_t views_per_layout = 20;
+  size_t drawables = 50;
+
+  // Seeds the choices made while generating, such as which values reference each other and
+  // which overrides equal their default. The same options always produce the same corpus.
+  uint32_t seed = 1;
+};
+
+struct CorpusFile {
+  // The path of the file relative to the project, such as "res/values-fr/values.xml".
+  std::string path;
+  std::string contents;
+};
+
+// Generates the XML files of a resource tree, as they would appear in a project's res directory.
+std::vector<CorpusFile> GenerateCorpus(const CorpusOptions& options);
+
+// Parses the values files of `files` and adds a file reference for every other file, producing
+// the same table that compiling each file and merging them into an app package would. The table
+// has no IDs assigned and its references are not linked.
+std::unique_ptr<ResourceTable> BuildCorpusTable(IAaptContext* context,
+                                                const std::vector<CorpusFile>& files);
+
+// Builds the table of `files` and then assigns IDs and links its references the way
+// `aapt2 link` does. `context` must be an app context whose compilation package and package ID
+// are set. Returns nullptr if linking fails.
+std::unique_ptr<ResourceTable> BuildLinkedCorpusTable(IAaptContext* context,
+                                                      const std::vector<CorpusFile>& files);
+
+}  // namespace test
+}  // namespace aapt
+
+#endif  // AAPT_TEST_CORPUSGENERATOR_H
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "test/CorpusGenerator.h"
+
+#include "test/Test.h"
+
+using ::testing::NotNull;
+
+namespace aapt {
+namespace test {
+
+static bool operator==(const CorpusFile& a, const CorpusFile& b) {
+  return a.path == b.path && a.contents == b.contents;
+}
+
+TEST(CorpusGeneratorTest, SameOptionsGenerateSameCorpus) {
+  CorpusOptions options;
+  options.entries = 50;
+  EXPECT_TRUE(GenerateCorpus(options) == GenerateCorpus(options));
+
+  CorpusOptions other_options = options;
+  other_options.seed = 2;
+  EXPECT_FALSE(GenerateCorpus(options) == GenerateCorpus(other_options));
+}
+
+TEST(CorpusGeneratorTest, CorpusLinks) {
+  std::unique_ptr<IAaptContext> context =
+      ContextBuilder().SetCompilationPackage("com.app.test").SetPackageId(0x7f).Build();
+  CorpusOptions options;
+  options.entries = 50;
+  options.layouts = 5;
+  options.drawables = 5;
+
+  std::unique_ptr<ResourceTable> table =
+      BuildLinkedCorpusTable(context.get(), GenerateCorpus(options));
+  ASSERT_THAT(table, NotNull());
+
+  Style* style = GetValue<Style>(table.get(), "com.app.test:style/Style_1");
+  ASSERT_THAT(style, NotNull());
+  ASSERT_TRUE(style->parent);
+  EXPECT_TRUE(style->parent.value().id);
+
+  EXPECT_THAT(GetValue<FileReference>(table.get(), "com.app.test:layout/layout_0"), NotNull());
+  EXPECT_THAT(GetValueForConfig<FileReference>(table.get(), "com.app.test:drawable/drawable_0",
+                                               ParseConfigOrDie("hdpi")),
+              NotNull());
+  EXPECT_THAT(GetValueForConfig<String>(table.get(), "com.app.test:string/string_0",
+                                        ParseConfigOrDie("fr")),
+              NotNull());
+}
+
+}  // namespace test
+}  // namespace aapt
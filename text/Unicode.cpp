@@ -16,7 +16,6 @@
 
 #include "text/Unicode.h"
 
-#include <algorithm>
 #include <array>
 
 #include "text/Utf8Iterator.h"
@@ -33,27 +32,18 @@ struct CharacterProperties {
     kXidStart = 1 << 0,
     kXidContinue = 1 << 1,
   };
-
-  char32_t first_char;
-  char32_t last_char;
-  uint32_t properties;
 };
 
-// Incude the generated data table.
+// Incude the generated data tables.
 #include "text/Unicode_data.cpp"
 
-bool CompareCharacterProperties(const CharacterProperties& a, char32_t codepoint) {
-  return a.last_char < codepoint;
-}
-
 uint32_t FindCharacterProperties(char32_t codepoint) {
-  const auto iter_end = sCharacterProperties.end();
-  const auto iter = std::lower_bound(sCharacterProperties.begin(), iter_end, codepoint,
-                                     CompareCharacterProperties);
-  if (iter != iter_end && codepoint >= iter->first_char) {
-    return iter->properties;
+  const size_t block = codepoint / kCharacterPropertiesBlockSize;
+  if (block >= sCharacterPropertiesBlockIndex.size()) {
+    return 0u;
   }
-  return 0u;
+  return sCharacterPropertiesBlocks[sCharacterPropertiesBlockIndex[block]]
+                                   [codepoint % kCharacterPropertiesBlockSize];
 }
 
 }  // namespace
@@ -41,6 +41,12 @@ TEST(UnicodeTest, IsXidContinue) {
   EXPECT_THAT(invalid_input, Each(ResultOf(IsXidContinue, Eq(false))));
 }
 
+TEST(UnicodeTest, PropertiesOutsideTheTableAreFalse) {
+  EXPECT_FALSE(IsXidStart(U'\uffff'));
+  EXPECT_FALSE(IsXidContinue(0x10ffff));
+  EXPECT_FALSE(IsXidContinue(0xffffffff));
+}
+
 TEST(UnicodeTest, IsJavaIdentifier) {
   EXPECT_TRUE(IsJavaIdentifier("FøøBar_12"));
   EXPECT_TRUE(IsJavaIdentifier("Føø$Bar"));
@@ -31,6 +31,17 @@ Utf8Iterator::Utf8Iterator(const StringPiece& str)
 
 void Utf8Iterator::DoNext() {
   current_pos_ = next_pos_;
+
+  // Most resource names and strings are ASCII, which need no decoding.
+  if (current_pos_ < str_.size()) {
+    const unsigned char c = static_cast<unsigned char>(str_.data()[current_pos_]);
+    if (c < 0x80u) {
+      current_codepoint_ = static_cast<char32_t>(c);
+      next_pos_ = current_pos_ + 1;
+      return;
+    }
+  }
+
   int32_t result = utf32_from_utf8_at(str_.data(), str_.size(), current_pos_, &next_pos_);
   if (result == -1) {
     current_codepoint_ = 0u;
@@ -1,7 +1,8 @@
 #!/bin/env python3
 
 """Extracts the XID_Start and XID_Continue Derived core properties from the ICU data files
-and emits a std::array<> for binary searching.
+and emits a two-level lookup table: an index from the high bits of a code point to a block of
+properties for the 256 code points that share those bits. Identical blocks are stored once.
 """
 
 import re
@@ -18,23 +19,6 @@ class CharacterProperty:
         self.last_char = last_char
         self.prop_type = prop_type
 
-    def key(self):
-        return self.first_char
-
-    def merge(self, other):
-        if self.last_char + 1 == other.first_char and self.prop_type == other.prop_type:
-            self.last_char = other.last_char
-        else:
-            raise KeyError()
-
-    def __repr__(self):
-        types = []
-        for enum_int, enum_str in CharacterPropertyEnumMap.items():
-            if enum_int & self.prop_type:
-                types.append(enum_str)
-        return "{}0x{:04x}, 0x{:04x}, {}{}".format(
-                "{", self.first_char, self.last_char, ' | '.join(types), "}")
-
 def extract_unicode_properties(f, props, chars_out):
     prog = re.compile(r"^(?P<first>\w{4})(..(?P<last>\w{4}))?\W+;\W+(?P<prop>\w+)")
     for line in f:
@@ -53,17 +37,31 @@ def extract_unicode_properties(f, props, chars_out):
                     chars_out[char].prop_type |= prop_type
     return chars_out
 
-def flatten_unicode_properties(chars):
-    result = []
-    for char_prop in sorted(chars.values(), key=CharacterProperty.key):
-        if len(result) == 0:
-            result.append(char_prop)
-        else:
-            try:
-                result[len(result) - 1].merge(char_prop)
-            except KeyError:
-                result.append(char_prop)
-    return result
+BLOCK_SIZE = 256
+
+def build_property_blocks(chars):
+    """Returns (block_index, blocks) covering every code point up to the last one in `chars`."""
+    last_char = max(chars.values(), key=lambda c: c.last_char).last_char
+    block_count = last_char // BLOCK_SIZE + 1
+    props = [0] * (block_count * BLOCK_SIZE)
+    for char_prop in chars.values():
+        for char in range(char_prop.first_char, char_prop.last_char + 1):
+            props[char] |= char_prop.prop_type
+
+    block_index = []
+    blocks = []
+    block_ids = {}
+    for i in range(block_count):
+        block = tuple(props[i * BLOCK_SIZE:(i + 1) * BLOCK_SIZE])
+        if block not in block_ids:
+            block_ids[block] = len(blocks)
+            blocks.append(block)
+        block_index.append(block_ids[block])
+    return block_index, blocks
+
+def print_values(values, per_line):
+    for i in range(0, len(values), per_line):
+        print("    {},".format(", ".join(str(v) for v in values[i:i + per_line])))
 
 license = """/*
  * Copyright (C) 2017 The Android Open Source Project
@@ -93,10 +91,19 @@ if __name__ == "__main__":
     for file_path in sys.argv[1:]:
         with open(file_path) as f:
             extract_unicode_properties(f, props, char_props)
-    result = flatten_unicode_properties(char_props)
-    print("{}\nconst static std::array<CharacterProperties, {}> sCharacterProperties = {}"
-            .format(license, len(result), "{{"))
-    for prop in result:
-        print("    {},".format(prop))
-    print("}};")
+    block_index, blocks = build_property_blocks(char_props)
+    print(license)
+    print("// Each value is a bitmask of CharacterProperties flags.")
+    print("constexpr const size_t kCharacterPropertiesBlockSize = {};\n".format(BLOCK_SIZE))
+    print("const static std::array<uint8_t, {}> sCharacterPropertiesBlockIndex = {}"
+            .format(len(block_index), "{{"))
+    print_values(block_index, 16)
+    print("}};\n")
+    print("const static uint8_t sCharacterPropertiesBlocks[{}][kCharacterPropertiesBlockSize] = {}"
+            .format(len(blocks), "{"))
+    for block in blocks:
+        print("  {")
+        print_values(block, 32)
+        print("  },")
+    print("};")
 
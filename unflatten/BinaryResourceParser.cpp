@@ -24,14 +24,15 @@
 #include "android-base/macros.h"
 #include "android-base/stringprintf.h"
 #include "androidfw/ResourceTypes.h"
-#include "androidfw/TypeWrappers.h"
 
 #include "ResourceTable.h"
 #include "ResourceUtils.h"
 #include "ResourceValues.h"
 #include "Source.h"
 #include "ValueVisitor.h"
+#include "flatten/TableFlattener.h"
 #include "unflatten/ResChunkPullParser.h"
+#include "unflatten/ResTableTypeReader.h"
 #include "util/Util.h"
 
 namespace aapt {
@@ -350,30 +351,29 @@ bool BinaryResourceParser::ParseType(const ResourceTablePackage* package,
     return false;
   }
 
-  TypeVariant tv(type);
-  for (auto it = tv.beginEntries(); it != tv.endEntries(); ++it) {
-    const ResTable_entry* entry = *it;
-    if (!entry) {
-      continue;
-    }
+  std::vector<TypeEntry> entries;
+  std::string error;
+  if (!ReadTypeEntries(type, &entries, &error)) {
+    context_->GetDiagnostics()->Error(DiagMessage(source_) << "corrupt ResTable_type chunk: "
+                                                           << error);
+    return false;
+  }
 
-    const ResourceName name(
-        package->name, *parsed_type,
-        util::GetString(key_pool_, util::DeviceToHost32(entry->key.index)));
+  for (const TypeEntry& entry : entries) {
+    const ResourceId res_id(package->id.value(), type->id, entry.index);
 
-    const ResourceId res_id(package->id.value(), type->id,
-                            static_cast<uint16_t>(it.index()));
+    std::string entry_name = util::GetString(key_pool_, entry.key);
+    if (entry_name == kObfuscatedResourceName) {
+      // A collapsed key is shared by many entries, so tell them apart by their IDs.
+      entry_name = StringPrintf("%s_%08x", kObfuscatedResourceName, res_id.id);
+    }
+    const ResourceName name(package->name, *parsed_type, entry_name);
 
     std::unique_ptr<Value> resource_value;
-    if (entry->flags & ResTable_entry::FLAG_COMPLEX) {
-      const ResTable_map_entry* mapEntry = static_cast<const ResTable_map_entry*>(entry);
-
-      // TODO(adamlesinski): Check that the entry count is valid.
-      resource_value = ParseMapEntry(name, config, mapEntry);
+    if (entry.map_entry != nullptr) {
+      resource_value = ParseMapEntry(name, config, entry.map_entry);
     } else {
-      const Res_value* value =
-          (const Res_value*)((const uint8_t*)entry + util::DeviceToHost32(entry->size));
-      resource_value = ParseValue(name, config, *value);
+      resource_value = ParseValue(name, config, entry.value);
     }
 
     if (!resource_value) {
@@ -389,7 +389,7 @@ bool BinaryResourceParser::ParseType(const ResourceTablePackage* package,
       return false;
     }
 
-    if ((entry->flags & ResTable_entry::FLAG_PUBLIC) != 0) {
+    if ((entry.flags & ResTable_entry::FLAG_PUBLIC) != 0) {
       Symbol symbol;
       symbol.state = SymbolState::kPublic;
       symbol.source = source_.WithLine(0);
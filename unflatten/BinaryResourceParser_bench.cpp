@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "unflatten/BinaryResourceParser.h"
+
+#include "benchmark/benchmark.h"
+
+#include "flatten/TableFlattener.h"
+#include "test/Context.h"
+#include "test/CorpusGenerator.h"
+#include "util/BigBuffer.h"
+
+namespace aapt {
+
+static void BM_BinaryResourceParserParse(benchmark::State& state) {
+  std::unique_ptr<IAaptContext> context =
+      test::ContextBuilder().SetCompilationPackage("com.app.test").SetPackageId(0x7f).Build();
+  test::CorpusOptions options;
+  options.entries = state.range(0);
+  std::unique_ptr<ResourceTable> table =
+      test::BuildLinkedCorpusTable(context.get(), test::GenerateCorpus(options));
+  if (!table) {
+    state.SkipWithError("failed to build corpus table");
+    return;
+  }
+
+  BigBuffer buffer(1024);
+  TableFlattener flattener({}, &buffer);
+  if (!flattener.Consume(context.get(), table.get())) {
+    state.SkipWithError("failed to flatten table");
+    return;
+  }
+  const std::string data = buffer.to_string();
+
+  while (state.KeepRunning()) {
+    ResourceTable parsed_table;
+    BinaryResourceParser parser(context.get(), &parsed_table, Source("resources.arsc"),
+                                data.data(), data.size());
+    if (!parser.Parse()) {
+      state.SkipWithError("failed to parse table");
+      break;
+    }
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * data.size());
+}
+BENCHMARK(BM_BinaryResourceParserParse)->Range(64, 16 << 10);
+
+}  // namespace aapt
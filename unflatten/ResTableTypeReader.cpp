@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "unflatten/ResTableTypeReader.h"
+
+#include <cstring>
+#include <utility>
+
+#include "flatten/ResourceTypeExtensions.h"
+#include "util/Util.h"
+
+using namespace android;
+
+namespace aapt {
+
+// Collects the index and offset (relative to entriesStart) of every entry the type defines.
+static bool ReadEntryOffsets(const ResTable_type* type,
+                             std::vector<std::pair<uint16_t, uint32_t>>* out_offsets,
+                             std::string* out_error) {
+  const size_t header_size = util::DeviceToHost16(type->header.headerSize);
+  const size_t entries_start = util::DeviceToHost32(type->entriesStart);
+  const size_t entry_count = util::DeviceToHost32(type->entryCount);
+  if (entries_start < header_size || entries_start > util::DeviceToHost32(type->header.size)) {
+    *out_error = "entriesStart is out of bounds";
+    return false;
+  }
+
+  const uint8_t* indices = reinterpret_cast<const uint8_t*>(type) + header_size;
+  const size_t indices_size = entries_start - header_size;
+
+  if ((type->flags & ResTable_type::FLAG_SPARSE) != 0) {
+    if (entry_count > indices_size / sizeof(ResTable_sparseTypeEntry)) {
+      *out_error = "sparse entry indices are out of bounds";
+      return false;
+    }
+
+    const ResTable_sparseTypeEntry* sparse_indices =
+        reinterpret_cast<const ResTable_sparseTypeEntry*>(indices);
+    for (size_t i = 0; i < entry_count; i++) {
+      out_offsets->push_back({util::DeviceToHost16(sparse_indices[i].idx),
+                              util::DeviceToHost16(sparse_indices[i].offset) * 4u});
+    }
+  } else if ((type->flags & kResTableTypeFlagOffset16) != 0) {
+    if (entry_count > indices_size / sizeof(uint16_t)) {
+      *out_error = "16 bit entry offsets are out of bounds";
+      return false;
+    }
+
+    const uint16_t* offsets = reinterpret_cast<const uint16_t*>(indices);
+    for (size_t i = 0; i < entry_count; i++) {
+      const uint16_t offset = util::DeviceToHost16(offsets[i]);
+      if (offset != kResTableTypeNoEntryOffset16) {
+        out_offsets->push_back({static_cast<uint16_t>(i), offset * 4u});
+      }
+    }
+  } else {
+    if (entry_count > indices_size / sizeof(uint32_t)) {
+      *out_error = "entry offsets are out of bounds";
+      return false;
+    }
+
+    const uint32_t* offsets = reinterpret_cast<const uint32_t*>(indices);
+    for (size_t i = 0; i < entry_count; i++) {
+      const uint32_t offset = util::DeviceToHost32(offsets[i]);
+      if (offset != ResTable_type::NO_ENTRY) {
+        out_offsets->push_back({static_cast<uint16_t>(i), offset});
+      }
+    }
+  }
+  return true;
+}
+
+bool ReadTypeEntries(const ResTable_type* type, std::vector<TypeEntry>* out_entries,
+                     std::string* out_error) {
+  std::vector<std::pair<uint16_t, uint32_t>> offsets;
+  if (!ReadEntryOffsets(type, &offsets, out_error)) {
+    return false;
+  }
+
+  const size_t entries_start = util::DeviceToHost32(type->entriesStart);
+  const uint8_t* entries = reinterpret_cast<const uint8_t*>(type) + entries_start;
+  const size_t entries_size = util::DeviceToHost32(type->header.size) - entries_start;
+
+  for (const auto& index_and_offset : offsets) {
+    const size_t offset = index_and_offset.second;
+    if ((offset & 0x03) != 0 || offset > entries_size ||
+        entries_size - offset < sizeof(ResTable_entry)) {
+      *out_error = "entry is out of bounds";
+      return false;
+    }
+
+    // Both forms of entry are at least as large as a ResTable_entry and keep their flags at the
+    // same offset.
+    static_assert(sizeof(ResTable_entry_compact) == sizeof(ResTable_entry),
+                  "a compact entry must be as large as a ResTable_entry");
+    const ResTable_entry* entry = reinterpret_cast<const ResTable_entry*>(entries + offset);
+    const size_t available = entries_size - offset;
+
+    TypeEntry type_entry;
+    type_entry.index = index_and_offset.first;
+    const uint16_t flags = util::DeviceToHost16(entry->flags);
+    if ((flags & kResTableEntryFlagCompact) != 0) {
+      const ResTable_entry_compact* compact_entry =
+          reinterpret_cast<const ResTable_entry_compact*>(entry);
+      type_entry.flags = flags & 0x00ffu;
+      type_entry.key = util::DeviceToHost16(compact_entry->key);
+      type_entry.size = sizeof(ResTable_entry_compact);
+      type_entry.value.size = util::HostToDevice16(sizeof(Res_value));
+      type_entry.value.dataType = static_cast<uint8_t>(flags >> 8);
+      type_entry.value.data = compact_entry->data;
+    } else {
+      const size_t entry_size = util::DeviceToHost16(entry->size);
+      type_entry.flags = flags;
+      type_entry.key = util::DeviceToHost32(entry->key.index);
+      if ((flags & ResTable_entry::FLAG_COMPLEX) != 0) {
+        if (entry_size < sizeof(ResTable_map_entry) || entry_size > available) {
+          *out_error = "map entry is out of bounds";
+          return false;
+        }
+
+        type_entry.map_entry = static_cast<const ResTable_map_entry*>(entry);
+        const size_t count = util::DeviceToHost32(type_entry.map_entry->count);
+        if (count > (available - entry_size) / sizeof(ResTable_map)) {
+          *out_error = "map entry is out of bounds";
+          return false;
+        }
+        type_entry.size = entry_size + count * sizeof(ResTable_map);
+      } else {
+        if (entry_size < sizeof(ResTable_entry) || entry_size > available ||
+            available - entry_size < sizeof(Res_value)) {
+          *out_error = "entry value is out of bounds";
+          return false;
+        }
+
+        memcpy(&type_entry.value, reinterpret_cast<const uint8_t*>(entry) + entry_size,
+               sizeof(Res_value));
+        type_entry.size = entry_size + sizeof(Res_value);
+      }
+    }
+    out_entries->push_back(type_entry);
+  }
+  return true;
+}
+
+}  // namespace aapt
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAPT_UNFLATTEN_RESTABLETYPEREADER_H
+#define AAPT_UNFLATTEN_RESTABLETYPEREADER_H
+
+#include <string>
+#include <vector>
+
+#include "androidfw/ResourceTypes.h"
+
+namespace aapt {
+
+/**
+ * An entry of a ResTable_type chunk, which is either a ResTable_entry
+ * followed by its value or map, or a ResTable_entry_compact.
+ */
+struct TypeEntry {
+  /** The index of the entry within its type. */
+  uint16_t index = 0;
+
+  /** The ResTable_entry flags, without the data type of a compact entry. */
+  uint16_t flags = 0;
+
+  /** The index of the entry's name in the key string pool. */
+  uint32_t key = 0;
+
+  /** The number of bytes the entry takes up, including its value or map. */
+  size_t size = 0;
+
+  /** The map of an entry with FLAG_COMPLEX, or nullptr. */
+  const android::ResTable_map_entry* map_entry = nullptr;
+
+  /** The value of a simple entry, in device byte order. */
+  android::Res_value value = {};
+};
+
+/**
+ * Reads the entries of `type`, whether its offsets are dense, sparse or 16
+ * bits wide and whether its entries are compact or not. The entries are
+ * ordered by index. Returns false and sets `out_error` if the chunk is
+ * corrupt.
+ */
+bool ReadTypeEntries(const android::ResTable_type* type, std::vector<TypeEntry>* out_entries,
+                     std::string* out_error);
+
+}  // namespace aapt
+
+#endif  // AAPT_UNFLATTEN_RESTABLETYPEREADER_H
@@ -0,0 +1,421 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "unflatten/TableSizeReport.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "androidfw/ResourceTypes.h"
+
+#include "ConfigDescription.h"
+#include "flatten/ResourceTypeExtensions.h"
+#include "flatten/TableFlattener.h"
+#include "unflatten/ResChunkPullParser.h"
+#include "unflatten/ResTableTypeReader.h"
+#include "util/Util.h"
+
+using namespace android;
+
+using ::android::StringPiece;
+
+namespace aapt {
+
+static void WriteCsvField(const StringPiece& field, std::ostream* out) {
+  bool needs_quotes = false;
+  for (const char c : field) {
+    if (c == ',' || c == '"' || c == '\n' || c == '\r') {
+      needs_quotes = true;
+      break;
+    }
+  }
+
+  if (!needs_quotes) {
+    *out << field;
+    return;
+  }
+
+  *out << '"';
+  for (const char c : field) {
+    if (c == '"') {
+      *out << '"';
+    }
+    *out << c;
+  }
+  *out << '"';
+}
+
+SizeReportPrinter::SizeReportPrinter(std::ostream* out, SizeReportFormat format)
+    : out_(out), format_(format) {
+  if (format_ == SizeReportFormat::kCsv) {
+    *out_ << "kind,name,config,size,path\n";
+  }
+}
+
+void SizeReportPrinter::PrintRow(const StringPiece& kind, const StringPiece& name,
+                                 const StringPiece& config, size_t size,
+                                 const StringPiece& path) {
+  if (format_ == SizeReportFormat::kJson) {
+    *out_ << "{\"kind\":";
+    util::WriteJsonString(kind, out_);
+    *out_ << ",\"name\":";
+    util::WriteJsonString(name, out_);
+    *out_ << ",\"config\":";
+    util::WriteJsonString(config, out_);
+    *out_ << ",\"size\":" << size << ",\"path\":";
+    util::WriteJsonString(path, out_);
+    *out_ << "}\n";
+  } else {
+    WriteCsvField(kind, out_);
+    *out_ << ',';
+    WriteCsvField(name, out_);
+    *out_ << ',';
+    WriteCsvField(config, out_);
+    *out_ << ',' << size << ',';
+    WriteCsvField(path, out_);
+    *out_ << '\n';
+  }
+}
+
+namespace {
+
+// Walks the chunks of a binary resource table the same way BinaryResourceParser does, but only
+// measures them.
+class TableSizeReporter {
+ public:
+  TableSizeReporter(IAaptContext* context, const Source& source, SizeReportPrinter* printer,
+                    std::map<std::string, SizeReportFileOwner>* file_owners)
+      : context_(context), source_(source), printer_(printer), file_owners_(file_owners) {
+  }
+
+  bool Report(const void* data, size_t len) {
+    ResChunkPullParser parser(data, len);
+    if (!ResChunkPullParser::IsGoodEvent(parser.Next())) {
+      context_->GetDiagnostics()->Error(DiagMessage(source_)
+                                        << "corrupt resources.arsc: " << parser.error());
+      return false;
+    }
+
+    if (util::DeviceToHost16(parser.chunk()->type) != RES_TABLE_TYPE) {
+      context_->GetDiagnostics()->Error(DiagMessage(source_) << "not a resource table");
+      return false;
+    }
+
+    if (!ReportTable(parser.chunk())) {
+      return false;
+    }
+
+    while (ResChunkPullParser::IsGoodEvent(parser.Next())) {
+      printer_->PrintRow("unknown_chunk", {}, {}, util::DeviceToHost32(parser.chunk()->size));
+    }
+    return true;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(TableSizeReporter);
+
+  bool ReportTable(const ResChunk_header* chunk) {
+    const ResTable_header* table_header = ConvertTo<ResTable_header>(chunk);
+    if (!table_header) {
+      context_->GetDiagnostics()->Error(DiagMessage(source_) << "corrupt ResTable_header chunk");
+      return false;
+    }
+    printer_->PrintRow("table_header", {}, {}, util::DeviceToHost16(chunk->headerSize));
+
+    ResChunkPullParser parser(GetChunkData(chunk), GetChunkDataLen(chunk));
+    while (ResChunkPullParser::IsGoodEvent(parser.Next())) {
+      switch (util::DeviceToHost16(parser.chunk()->type)) {
+        case RES_STRING_POOL_TYPE:
+          if (value_pool_.getError() == NO_INIT) {
+            if (value_pool_.setTo(parser.chunk(), util::DeviceToHost32(parser.chunk()->size)) !=
+                NO_ERROR) {
+              context_->GetDiagnostics()->Error(DiagMessage(source_)
+                                                << "corrupt value string pool in ResTable");
+              return false;
+            }
+            ReportStringPool(parser.chunk(), "value_pool", {});
+          } else {
+            printer_->PrintRow("unknown_chunk", {}, {},
+                               util::DeviceToHost32(parser.chunk()->size));
+          }
+          break;
+
+        case RES_TABLE_PACKAGE_TYPE:
+          if (!ReportPackage(parser.chunk())) {
+            return false;
+          }
+          break;
+
+        default:
+          printer_->PrintRow("unknown_chunk", {}, {}, util::DeviceToHost32(parser.chunk()->size));
+          break;
+      }
+    }
+
+    if (parser.event() == ResChunkPullParser::Event::kBadDocument) {
+      context_->GetDiagnostics()->Error(DiagMessage(source_)
+                                        << "corrupt resource table: " << parser.error());
+      return false;
+    }
+    return true;
+  }
+
+  // Splits a string pool into its header, its string and style index arrays, the string data and
+  // the style data. `pool` prefixes the kind of each row.
+  void ReportStringPool(const ResChunk_header* chunk, const std::string& pool,
+                        const StringPiece& name) {
+    const size_t size = util::DeviceToHost32(chunk->size);
+    const size_t header_size = util::DeviceToHost16(chunk->headerSize);
+    printer_->PrintRow(pool + "_header", name, {}, header_size);
+
+    size_t strings_start = size;
+    size_t strings_end = size;
+    const ResStringPool_header* pool_header = ConvertTo<ResStringPool_header>(chunk);
+    if (pool_header) {
+      const size_t start = util::DeviceToHost32(pool_header->stringsStart);
+      if (start >= header_size && start <= size) {
+        strings_start = start;
+      }
+
+      const size_t styles_start = util::DeviceToHost32(pool_header->stylesStart);
+      if (util::DeviceToHost32(pool_header->styleCount) != 0 && styles_start >= strings_start &&
+          styles_start <= size) {
+        strings_end = styles_start;
+      }
+    }
+
+    printer_->PrintRow(pool + "_indices", name, {}, strings_start - header_size);
+    printer_->PrintRow(pool + "_strings", name, {}, strings_end - strings_start);
+    if (strings_end != size) {
+      printer_->PrintRow(pool + "_styles", name, {}, size - strings_end);
+    }
+  }
+
+  bool ReportPackage(const ResChunk_header* chunk) {
+    constexpr size_t kMinPackageSize =
+        sizeof(ResTable_package) - sizeof(ResTable_package::typeIdOffset);
+    const ResTable_package* package_header = ConvertTo<ResTable_package, kMinPackageSize>(chunk);
+    if (!package_header) {
+      context_->GetDiagnostics()->Error(DiagMessage(source_) << "corrupt ResTable_package chunk");
+      return false;
+    }
+
+    size_t len = strnlen16((const char16_t*)package_header->name, arraysize(package_header->name));
+    std::u16string package_name;
+    package_name.resize(len);
+    for (size_t i = 0; i < len; i++) {
+      package_name[i] = util::DeviceToHost16(package_header->name[i]);
+    }
+    package_name_ = util::Utf16ToUtf8(package_name);
+    printer_->PrintRow("package_header", package_name_, {}, util::DeviceToHost16(chunk->headerSize));
+
+    type_pool_.uninit();
+    key_pool_.uninit();
+    type_entry_counts_.clear();
+
+    ResChunkPullParser parser(GetChunkData(chunk), GetChunkDataLen(chunk));
+    while (ResChunkPullParser::IsGoodEvent(parser.Next())) {
+      const ResChunk_header* child = parser.chunk();
+      switch (util::DeviceToHost16(child->type)) {
+        case RES_STRING_POOL_TYPE:
+          if (type_pool_.getError() == NO_INIT) {
+            if (type_pool_.setTo(child, util::DeviceToHost32(child->size)) != NO_ERROR) {
+              context_->GetDiagnostics()->Error(DiagMessage(source_)
+                                                << "corrupt type string pool in ResTable_package");
+              return false;
+            }
+            ReportStringPool(child, "type_pool", package_name_);
+          } else if (key_pool_.getError() == NO_INIT) {
+            if (key_pool_.setTo(child, util::DeviceToHost32(child->size)) != NO_ERROR) {
+              context_->GetDiagnostics()->Error(DiagMessage(source_)
+                                                << "corrupt key string pool in ResTable_package");
+              return false;
+            }
+            ReportStringPool(child, "key_pool", package_name_);
+          } else {
+            printer_->PrintRow("unknown_chunk", package_name_, {},
+                               util::DeviceToHost32(child->size));
+          }
+          break;
+
+        case RES_TABLE_TYPE_SPEC_TYPE:
+          if (!ReportTypeSpec(child)) {
+            return false;
+          }
+          break;
+
+        case RES_TABLE_TYPE_TYPE:
+          if (!ReportType(child)) {
+            return false;
+          }
+          break;
+
+        case RES_TABLE_LIBRARY_TYPE:
+          printer_->PrintRow("library", package_name_, {}, util::DeviceToHost32(child->size));
+          break;
+
+        default:
+          printer_->PrintRow("unknown_chunk", package_name_, {},
+                             util::DeviceToHost32(child->size));
+          break;
+      }
+    }
+
+    if (parser.event() == ResChunkPullParser::Event::kBadDocument) {
+      context_->GetDiagnostics()->Error(DiagMessage(source_)
+                                        << "corrupt ResTable_package: " << parser.error());
+      return false;
+    }
+    return true;
+  }
+
+  bool ReportTypeSpec(const ResChunk_header* chunk) {
+    const ResTable_typeSpec* type_spec = ConvertTo<ResTable_typeSpec>(chunk);
+    if (!type_spec || type_spec->id == 0) {
+      context_->GetDiagnostics()->Error(DiagMessage(source_)
+                                        << "corrupt ResTable_typeSpec chunk");
+      return false;
+    }
+
+    type_entry_counts_[type_spec->id] = util::DeviceToHost32(type_spec->entryCount);
+    printer_->PrintRow("type_spec", GetTypeName(type_spec->id), {},
+                       util::DeviceToHost32(chunk->size));
+    return true;
+  }
+
+  // Reports the header and offsets of a type as "type_header", which is the per-config overhead,
+  // followed by the size of each entry in it.
+  bool ReportType(const ResChunk_header* chunk) {
+    if (key_pool_.getError() != NO_ERROR) {
+      context_->GetDiagnostics()->Error(DiagMessage(source_) << "missing key string pool");
+      return false;
+    }
+
+    // Specify a manual size, because ResTable_type contains ResTable_config, which changes
+    // a lot and has its own code to handle variable size.
+    const ResTable_type* type = ConvertTo<ResTable_type, kResTableTypeMinSize>(chunk);
+    if (!type || type->id == 0) {
+      context_->GetDiagnostics()->Error(DiagMessage(source_) << "corrupt ResTable_type chunk");
+      return false;
+    }
+
+    const size_t size = util::DeviceToHost32(chunk->size);
+    const size_t entries_start = util::DeviceToHost32(type->entriesStart);
+    if (entries_start > size) {
+      context_->GetDiagnostics()->Error(DiagMessage(source_) << "corrupt ResTable_type chunk");
+      return false;
+    }
+
+    ConfigDescription config;
+    config.copyFromDtoH(type->config);
+    const std::string config_str = config.toString().string();
+    const std::string type_name = GetTypeName(type->id);
+    const bool is_string_type = util::GetString(type_pool_, type->id - 1) == "string";
+    printer_->PrintRow("type_header", type_name, config_str, entries_start);
+
+    std::vector<TypeEntry> entries;
+    std::string error;
+    if (!ReadTypeEntries(type, &entries, &error)) {
+      context_->GetDiagnostics()->Error(DiagMessage(source_) << "corrupt ResTable_type chunk: "
+                                                             << error);
+      return false;
+    }
+
+    if ((type->flags & ResTable_type::FLAG_SPARSE) != 0) {
+      // The flattener would have used 16 bit dense offsets if the entries are compact and all of
+      // their offsets fit, so compare against the dense offsets it would have written instead.
+      auto iter = type_entry_counts_.find(type->id);
+      const size_t entry_count = util::DeviceToHost32(type->entryCount);
+      if (iter != type_entry_counts_.end()) {
+        const bool compact =
+            std::any_of(entries.begin(), entries.end(), [](const TypeEntry& entry) {
+              return (entry.flags & kResTableEntryFlagCompact) != 0;
+            });
+        const bool offset16 =
+            compact && (size - entries_start) / 4u < kResTableTypeNoEntryOffset16;
+        const TypeOffsetsCost cost =
+            CostOfTypeOffsets(iter->second, entry_count, offset16, TableFlattenerOptions{});
+        if (cost.dense_size > cost.sparse_size) {
+          printer_->PrintRow("sparse_savings", type_name, config_str,
+                             cost.dense_size - cost.sparse_size);
+        }
+      }
+    }
+
+    size_t entries_size = 0u;
+    for (const TypeEntry& entry : entries) {
+      entries_size += entry.size;
+      const std::string entry_name = type_name + "/" + util::GetString(key_pool_, entry.key);
+      printer_->PrintRow("entry", entry_name, config_str, entry.size);
+      if (!is_string_type) {
+        RecordFileOwner(entry_name, config_str, entry);
+      }
+    }
+
+    if (entries_size < size - entries_start) {
+      printer_->PrintRow("type_padding", type_name, config_str,
+                         size - entries_start - entries_size);
+    }
+    return true;
+  }
+
+  // Remembers which resource references a file, the same way BinaryResourceParser tells a
+  // FileReference apart from a string: a string outside of the string type that starts with
+  // "res/".
+  void RecordFileOwner(const std::string& entry_name, const std::string& config_str,
+                       const TypeEntry& entry) {
+    if (!file_owners_ || entry.map_entry || entry.value.dataType != Res_value::TYPE_STRING ||
+        value_pool_.getError() != NO_ERROR) {
+      return;
+    }
+
+    const std::string path =
+        util::GetString(value_pool_, util::DeviceToHost32(entry.value.data));
+    if (util::StartsWith(path, "res/")) {
+      file_owners_->insert({path, SizeReportFileOwner{entry_name, config_str}});
+    }
+  }
+
+  std::string GetTypeName(uint8_t type_id) {
+    return package_name_ + ":" + util::GetString(type_pool_, type_id - 1);
+  }
+
+  IAaptContext* context_;
+  Source source_;
+  SizeReportPrinter* printer_;
+  std::map<std::string, SizeReportFileOwner>* file_owners_;
+
+  ResStringPool value_pool_;
+  std::string package_name_;
+  ResStringPool type_pool_;
+  ResStringPool key_pool_;
+
+  // The number of entries declared by each type spec of the current package, keyed by type ID.
+  std::map<uint8_t, size_t> type_entry_counts_;
+};
+
+}  // namespace
+
+bool PrintTableSizeReport(IAaptContext* context, const Source& source, const void* data,
+                          size_t len, SizeReportPrinter* printer,
+                          std::map<std::string, SizeReportFileOwner>* out_file_owners) {
+  TableSizeReporter reporter(context, source, printer, out_file_owners);
+  return reporter.Report(data, len);
+}
+
+}  // namespace aapt
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAPT_UNFLATTEN_TABLESIZEREPORT_H
+#define AAPT_UNFLATTEN_TABLESIZEREPORT_H
+
+#include <map>
+#include <ostream>
+#include <string>
+
+#include "android-base/macros.h"
+#include "androidfw/StringPiece.h"
+
+#include "Source.h"
+#include "process/IResourceTableConsumer.h"
+
+namespace aapt {
+
+enum class SizeReportFormat {
+  kCsv,
+  kJson,
+};
+
+// Writes the rows of a size report as soon as they are produced, so that the report of a large
+// table is never held in memory. Each row attributes `size` bytes to one part of an APK:
+//
+//   kind   - what the bytes encode, such as "entry", "type_header", "key_pool_strings" or "file".
+//   name   - the resource, type or package the bytes belong to. For a "file" row, the resource
+//            that references the file, or the file's path if no resource does.
+//   config - the configuration of "type_header", "entry" and "sparse_savings" rows, and of
+//            "file" rows of resources.
+//   path   - the path of the file in the APK, for "file" rows.
+//
+// Grouping rows by name and config gives the total size of each resource, including its file.
+// "sparse_savings" rows are the bytes that sparse encoding saved on a type's offsets, so they are
+// not part of the file and must not be summed with the others.
+//
+// CSV reports start with a "kind,name,config,size,path" header. JSON reports have one object per
+// line.
+class SizeReportPrinter {
+ public:
+  SizeReportPrinter(std::ostream* out, SizeReportFormat format);
+
+  void PrintRow(const android::StringPiece& kind, const android::StringPiece& name,
+                const android::StringPiece& config, size_t size,
+                const android::StringPiece& path = {});
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(SizeReportPrinter);
+
+  std::ostream* out_;
+  SizeReportFormat format_;
+};
+
+// The resource and configuration whose value is the path of a file in the APK.
+struct SizeReportFileOwner {
+  std::string name;
+  std::string config;
+};
+
+// Attributes every byte of the binary resource table (resources.arsc) in `data` to the chunk
+// header, string pool slice or resource entry that it encodes, without building a ResourceTable.
+// If `out_file_owners` is not null, it receives the first resource found to reference each file
+// path.
+bool PrintTableSizeReport(IAaptContext* context, const Source& source, const void* data,
+                          size_t len, SizeReportPrinter* printer,
+                          std::map<std::string, SizeReportFileOwner>* out_file_owners = nullptr);
+
+}  // namespace aapt
+
+#endif  // AAPT_UNFLATTEN_TABLESIZEREPORT_H
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "unflatten/TableSizeReport.h"
+
+#include <map>
+#include <sstream>
+
+#include "ResourceUtils.h"
+#include "SdkConstants.h"
+#include "flatten/TableFlattener.h"
+#include "test/Test.h"
+
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+
+namespace aapt {
+
+TEST(TableSizeReportTest, RowsAddUpToTheTableSize) {
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder()
+                                              .SetCompilationPackage("com.app.test")
+                                              .SetPackageId(0x7f)
+                                              .Build();
+  std::unique_ptr<ResourceTable> table =
+      test::ResourceTableBuilder()
+          .SetPackageId("com.app.test", 0x7f)
+          .AddSimple("com.app.test:id/one", ResourceId(0x7f020000))
+          .AddString("com.app.test:string/foo", ResourceId(0x7f030000), "foo")
+          .AddString("com.app.test:string/foo", test::ParseConfigOrDie("fr"),
+                     ResourceId(0x7f030000), "le foo")
+          .Build();
+
+  BigBuffer buffer(1024);
+  TableFlattener flattener({}, &buffer);
+  ASSERT_TRUE(flattener.Consume(context.get(), table.get()));
+  const std::string content = buffer.to_string();
+
+  std::ostringstream out;
+  SizeReportPrinter printer(&out, SizeReportFormat::kCsv);
+  ASSERT_TRUE(PrintTableSizeReport(context.get(), Source("test.arsc"), content.data(),
+                                   content.size(), &printer));
+
+  std::istringstream in(out.str());
+  std::string line;
+  ASSERT_TRUE(std::getline(in, line));
+  EXPECT_EQ("kind,name,config,size,path", line);
+
+  size_t total = 0u;
+  std::vector<std::string> entries;
+  while (std::getline(in, line)) {
+    // The rows of a table have no path, so the size is the last but one field.
+    ASSERT_TRUE(util::EndsWith(line, ","));
+    line.pop_back();
+    const size_t size_start = line.rfind(',') + 1;
+    total += std::stoul(line.substr(size_start));
+    if (util::StartsWith(line, "entry,")) {
+      entries.push_back(line.substr(0, size_start));
+    }
+  }
+
+  EXPECT_EQ(content.size(), total);
+  EXPECT_THAT(entries, ElementsAre("entry,com.app.test:id/one,,", "entry,com.app.test:string/foo,,",
+                                   "entry,com.app.test:string/foo,fr,"));
+}
+
+TEST(TableSizeReportTest, FilesAreAttributedToTheResourcesThatReferenceThem) {
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder()
+                                              .SetCompilationPackage("com.app.test")
+                                              .SetPackageId(0x7f)
+                                              .Build();
+  std::unique_ptr<ResourceTable> table =
+      test::ResourceTableBuilder()
+          .SetPackageId("com.app.test", 0x7f)
+          .AddFileReference("com.app.test:drawable/icon", ResourceId(0x7f020000),
+                            "res/drawable/icon.png")
+          .AddFileReference("com.app.test:drawable/icon", "res/drawable-hdpi/icon.png",
+                            test::ParseConfigOrDie("hdpi"))
+          .AddString("com.app.test:string/path", ResourceId(0x7f030000), "res/raw/not_a_file")
+          .Build();
+
+  BigBuffer buffer(1024);
+  TableFlattener flattener({}, &buffer);
+  ASSERT_TRUE(flattener.Consume(context.get(), table.get()));
+  const std::string content = buffer.to_string();
+
+  std::ostringstream out;
+  SizeReportPrinter printer(&out, SizeReportFormat::kCsv);
+  std::map<std::string, SizeReportFileOwner> file_owners;
+  ASSERT_TRUE(PrintTableSizeReport(context.get(), Source("test.arsc"), content.data(),
+                                   content.size(), &printer, &file_owners));
+
+  ASSERT_EQ(2u, file_owners.size());
+  EXPECT_EQ("com.app.test:drawable/icon", file_owners["res/drawable/icon.png"].name);
+  EXPECT_EQ("", file_owners["res/drawable/icon.png"].config);
+  EXPECT_EQ("com.app.test:drawable/icon", file_owners["res/drawable-hdpi/icon.png"].name);
+  EXPECT_EQ("hdpi", file_owners["res/drawable-hdpi/icon.png"].config);
+}
+
+TEST(TableSizeReportTest, SparseSavingsAccountForSixteenBitOffsets) {
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder()
+                                              .SetCompilationPackage("com.app.test")
+                                              .SetPackageId(0x7f)
+                                              .SetMinSdkVersion(SDK_U)
+                                              .Build();
+  const ConfigDescription sparse_config = test::ParseConfigOrDie("fr");
+  test::ResourceTableBuilder builder;
+  builder.SetPackageId("com.app.test", 0x7f);
+  for (uint16_t i = 0; i < 40u; i++) {
+    builder.AddValue("com.app.test:integer/int_" + std::to_string(i), ResourceId(0x7f020000 | i),
+                     ResourceUtils::TryParseInt("1"));
+  }
+  builder.AddValue("com.app.test:integer/int_39", sparse_config, ResourceId(0x7f020027),
+                   ResourceUtils::TryParseInt("2"));
+  std::unique_ptr<ResourceTable> table = builder.Build();
+
+  TableFlattenerOptions options;
+  options.use_sparse_entries = true;
+  options.use_compact_entries = true;
+  BigBuffer buffer(1024);
+  TableFlattener flattener(options, &buffer);
+  ASSERT_TRUE(flattener.Consume(context.get(), table.get()));
+  const std::string content = buffer.to_string();
+
+  std::ostringstream out;
+  SizeReportPrinter printer(&out, SizeReportFormat::kCsv);
+  ASSERT_TRUE(PrintTableSizeReport(context.get(), Source("test.arsc"), content.data(),
+                                   content.size(), &printer));
+
+  // 40 dense 16 bit offsets take 80 bytes, where one sparse entry takes 4.
+  EXPECT_THAT(out.str(), HasSubstr("\nsparse_savings,com.app.test:integer,fr,76,\n"));
+}
+
+TEST(TableSizeReportTest, JsonRowsAreObjects) {
+  std::ostringstream out;
+  SizeReportPrinter printer(&out, SizeReportFormat::kJson);
+  printer.PrintRow("file", "com.app.test:raw/a", {}, 42u, "res/a,\"b\".xml");
+  EXPECT_EQ(
+      "{\"kind\":\"file\",\"name\":\"com.app.test:raw/a\",\"config\":\"\",\"size\":42,"
+      "\"path\":\"res/a,\\\"b\\\".xml\"}\n",
+      out.str());
+}
+
+TEST(TableSizeReportTest, CsvFieldsAreQuotedWhenNeeded) {
+  std::ostringstream out;
+  SizeReportPrinter printer(&out, SizeReportFormat::kCsv);
+  printer.PrintRow("file", "res/a,\"b\".xml", {}, 42u, "res/a,\"b\".xml");
+  EXPECT_EQ(
+      "kind,name,config,size,path\n"
+      "file,\"res/a,\"\"b\"\".xml\",,42,\"res/a,\"\"b\"\".xml\"\n",
+      out.str());
+}
+
+}  // namespace aapt
@@ -46,22 +46,9 @@ using ::android::base::unique_fd;
 namespace aapt {
 namespace file {
 
-FileType GetFileType(const std::string& path) {
-// TODO(adamlesinski): I'd like to move this to ::android::base::utf8 but Windows does some macro
-// trickery with 'stat' and things don't override very well.
-#ifdef _WIN32
-  std::wstring path_utf16;
-  if (!::android::base::UTF8PathToWindowsLongPath(path.c_str(), &path_utf16)) {
-    return FileType::kNonexistant;
-  }
-
-  struct _stat64 sb;
-  int result = _wstat64(path_utf16.c_str(), &sb);
-#else
-  struct stat sb;
-  int result = stat(path.c_str(), &sb);
-#endif
-
+// Returns the type of a file from the result of stat()ing it, which failed with errno or found
+// the file to have `mode`.
+static FileType GetFileTypeFromStat(int result, unsigned int mode) {
   if (result == -1) {
     if (errno == ENOENT || errno == ENOTDIR) {
       return FileType::kNonexistant;
@@ -69,22 +56,22 @@ FileType GetFileType(const std::string& path) {
     return FileType::kUnknown;
   }
 
-  if (S_ISREG(sb.st_mode)) {
+  if (S_ISREG(mode)) {
     return FileType::kRegular;
-  } else if (S_ISDIR(sb.st_mode)) {
+  } else if (S_ISDIR(mode)) {
     return FileType::kDirectory;
-  } else if (S_ISCHR(sb.st_mode)) {
+  } else if (S_ISCHR(mode)) {
     return FileType::kCharDev;
-  } else if (S_ISBLK(sb.st_mode)) {
+  } else if (S_ISBLK(mode)) {
     return FileType::kBlockDev;
-  } else if (S_ISFIFO(sb.st_mode)) {
+  } else if (S_ISFIFO(mode)) {
     return FileType::kFifo;
 #if defined(S_ISLNK)
-  } else if (S_ISLNK(sb.st_mode)) {
+  } else if (S_ISLNK(mode)) {
     return FileType::kSymlink;
 #endif
 #if defined(S_ISSOCK)
-  } else if (S_ISSOCK(sb.st_mode)) {
+  } else if (S_ISSOCK(mode)) {
     return FileType::kSocket;
 #endif
   } else {
@@ -92,6 +79,54 @@ FileType GetFileType(const std::string& path) {
   }
 }
 
+FileType GetFileType(const std::string& path) {
+// TODO(adamlesinski): I'd like to move this to ::android::base::utf8 but Windows does some macro
+// trickery with 'stat' and things don't override very well.
+#ifdef _WIN32
+  std::wstring path_utf16;
+  if (!::android::base::UTF8PathToWindowsLongPath(path.c_str(), &path_utf16)) {
+    return FileType::kNonexistant;
+  }
+
+  struct _stat64 sb;
+  int result = _wstat64(path_utf16.c_str(), &sb);
+#else
+  struct stat sb;
+  int result = stat(path.c_str(), &sb);
+#endif
+  return GetFileTypeFromStat(result, sb.st_mode);
+}
+
+FileType GetFileType(const std::string& path, DIR* dir, const struct dirent* entry) {
+#if defined(_DIRENT_HAVE_D_TYPE) || defined(DT_DIR)
+  switch (entry->d_type) {
+    case DT_REG:
+      return FileType::kRegular;
+    case DT_DIR:
+      return FileType::kDirectory;
+    case DT_CHR:
+      return FileType::kCharDev;
+    case DT_BLK:
+      return FileType::kBlockDev;
+    case DT_FIFO:
+      return FileType::kFifo;
+    case DT_SOCK:
+      return FileType::kSocket;
+    default:
+      // Symlinks are followed, like stat() does, and some file systems don't fill in d_type.
+      break;
+  }
+#endif
+
+#ifdef _WIN32
+  return GetFileType(path);
+#else
+  struct stat sb;
+  int result = fstatat(dirfd(dir), entry->d_name, &sb, 0);
+  return GetFileTypeFromStat(result, sb.st_mode);
+#endif
+}
+
 bool mkdirs(const std::string& path) {
   constexpr const mode_t mode = S_IRUSR | S_IWUSR | S_IXUSR | S_IRGRP | S_IXGRP;
   // Start after the first character so that we don't consume the root '/'.
@@ -195,6 +230,48 @@ Maybe<FileMap> MmapPath(const std::string& path, std::string* out_error) {
   return std::move(filemap);
 }
 
+Maybe<FileMap> MmapPath(const std::string& path, size_t offset, size_t len,
+                        std::string* out_error) {
+  int flags = O_RDONLY | O_CLOEXEC | O_BINARY;
+  unique_fd fd(TEMP_FAILURE_RETRY(::android::base::utf8::open(path.c_str(), flags)));
+  if (fd == -1) {
+    if (out_error) {
+      *out_error = SystemErrorCodeToString(errno);
+    }
+    return {};
+  }
+
+  struct stat filestats = {};
+  if (fstat(fd, &filestats) != 0) {
+    if (out_error) {
+      *out_error = SystemErrorCodeToString(errno);
+    }
+    return {};
+  }
+
+  const size_t file_size = static_cast<size_t>(filestats.st_size);
+  if (offset > file_size || len > file_size - offset) {
+    if (out_error) {
+      *out_error = "range is out of bounds";
+    }
+    return {};
+  }
+
+  FileMap filemap;
+  if (len == 0) {
+    // mmap doesn't like a length of 0. Instead we return an empty FileMap.
+    return std::move(filemap);
+  }
+
+  if (!filemap.create(path.c_str(), fd, offset, len, true)) {
+    if (out_error) {
+      *out_error = SystemErrorCodeToString(errno);
+    }
+    return {};
+  }
+  return std::move(filemap);
+}
+
 bool AppendArgsFromFile(const StringPiece& path, std::vector<std::string>* out_arglist,
                         std::string* out_error) {
   std::string contents;
@@ -298,7 +375,7 @@ Maybe<std::vector<std::string>> FindFiles(const android::StringPiece& path, IDia
     std::string file_name = entry->d_name;
     std::string full_path = root_dir;
     AppendPath(&full_path, file_name);
-    const FileType file_type = GetFileType(full_path);
+    const FileType file_type = GetFileType(full_path, d.get(), entry);
 
     if (filter != nullptr) {
       if (!(*filter)(file_name, file_type)) {
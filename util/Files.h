@@ -17,6 +17,8 @@
 #ifndef AAPT_FILES_H
 #define AAPT_FILES_H
 
+#include <dirent.h>
+
 #include <memory>
 #include <string>
 #include <vector>
@@ -54,6 +56,11 @@ enum class FileType {
 
 FileType GetFileType(const std::string& path);
 
+// Returns the type of `entry`, which was read from `dir` and lives at `path`. Where the file
+// system reports the type in the entry itself, no stat() is made. Symlinks and unknown types are
+// stat()ed relative to `dir`, so that the kernel doesn't walk `path` again.
+FileType GetFileType(const std::string& path, DIR* dir, const struct dirent* entry);
+
 // Appends a path to `base`, separated by the directory separator.
 void AppendPath(std::string* base, android::StringPiece part);
 
@@ -76,6 +83,11 @@ std::string PackageToPath(const android::StringPiece& package);
 // Creates a FileMap for the file at path.
 Maybe<android::FileMap> MmapPath(const std::string& path, std::string* out_error);
 
+// Creates a FileMap for `len` bytes of the file at path, starting at `offset`. Fails if the range
+// extends past the end of the file. A zero-length range yields an empty FileMap.
+Maybe<android::FileMap> MmapPath(const std::string& path, size_t offset, size_t len,
+                                 std::string* out_error);
+
 // Reads the file at path and appends each line to the outArgList vector.
 bool AppendArgsFromFile(const android::StringPiece& path, std::vector<std::string>* out_arglist,
                         std::string* out_error);
@@ -16,10 +16,18 @@
 
 #include "util/Files.h"
 
+#include <sys/stat.h>
+
+#include <map>
 #include <sstream>
 
+#include "android-base/file.h"
+#include "android-base/test_utils.h"
+
 #include "test/Test.h"
 
+using ::testing::Eq;
+
 namespace aapt {
 namespace file {
 
@@ -55,5 +63,33 @@ TEST_F(FilesTest, AppendPathWithLeadingOrTrailingSeparators) {
   EXPECT_EQ(expected_path_, base);
 }
 
+#ifndef _WIN32
+TEST_F(FilesTest, GetFileTypeOfEntryWithUnknownTypeStatsRelativeToTheDirectory) {
+  TemporaryDir dir;
+  std::string file_path = dir.path;
+  AppendPath(&file_path, "file.xml");
+  ASSERT_TRUE(android::base::WriteStringToFile("<x/>", file_path));
+  std::string subdir_path = dir.path;
+  AppendPath(&subdir_path, "values");
+  ASSERT_THAT(mkdir(subdir_path.c_str(), 0700), Eq(0));
+
+  std::unique_ptr<DIR, decltype(closedir)*> d(opendir(dir.path), closedir);
+  ASSERT_TRUE(d);
+  std::map<std::string, FileType> types;
+  while (struct dirent* entry = readdir(d.get())) {
+    // Some file systems, such as XFS and network file systems, leave d_type unset.
+    struct dirent unknown_entry = *entry;
+    unknown_entry.d_type = DT_UNKNOWN;
+
+    // A path that doesn't exist shows that the type comes from the directory, not the path.
+    types[entry->d_name] = GetFileType("does-not-exist", d.get(), &unknown_entry);
+  }
+
+  EXPECT_THAT(types["file.xml"], Eq(FileType::kRegular));
+  EXPECT_THAT(types["values"], Eq(FileType::kDirectory));
+  EXPECT_THAT(types["."], Eq(FileType::kDirectory));
+}
+#endif
+
 }  // namespace files
 }  // namespace aapt
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "util/Trace.h"
+
+#include <fstream>
+
+#include "util/Util.h"
+
+using ::android::StringPiece;
+
+namespace aapt {
+
+TraceRecorder::TraceRecorder() : origin_(Clock::now()) {
+  thread_ids_[std::this_thread::get_id()] = 1u;
+}
+
+void TraceRecorder::AddSpan(const StringPiece& category, const StringPiece& name,
+                            Clock::time_point start, Clock::time_point end, Args args) {
+  using std::chrono::duration_cast;
+  using std::chrono::microseconds;
+  Event event{category.to_string(), name.to_string(),
+              duration_cast<microseconds>(start - origin_).count(),
+              duration_cast<microseconds>(end - start).count(), 0u, std::move(args)};
+
+  std::lock_guard<std::mutex> lock(lock_);
+  auto result = thread_ids_.insert(
+      std::make_pair(std::this_thread::get_id(), static_cast<uint32_t>(thread_ids_.size() + 1u)));
+  event.tid = result.first->second;
+  events_.push_back(std::move(event));
+}
+
+void TraceRecorder::WriteToStream(std::ostream* out) const {
+  std::lock_guard<std::mutex> lock(lock_);
+  *out << "{\"traceEvents\":[";
+  bool first = true;
+  for (const Event& event : events_) {
+    if (!first) {
+      *out << ",";
+    }
+    first = false;
+
+    *out << "\n{\"name\":";
+    util::WriteJsonString(event.name, out);
+    *out << ",\"cat\":";
+    util::WriteJsonString(event.category, out);
+    *out << ",\"ph\":\"X\",\"ts\":" << event.start_us << ",\"dur\":" << event.duration_us
+         << ",\"pid\":1,\"tid\":" << event.tid;
+    if (!event.args.empty()) {
+      *out << ",\"args\":{";
+      for (auto iter = event.args.begin(); iter != event.args.end(); ++iter) {
+        if (iter != event.args.begin()) {
+          *out << ",";
+        }
+        util::WriteJsonString(iter->first, out);
+        *out << ":" << iter->second;
+      }
+      *out << "}";
+    }
+    *out << "}";
+  }
+  *out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+bool TraceRecorder::WriteToFile(const std::string& path, std::string* out_error) const {
+  std::ofstream fout(path, std::ofstream::binary);
+  if (!fout) {
+    *out_error = "failed to open";
+    return false;
+  }
+
+  WriteToStream(&fout);
+  fout.flush();
+  if (!fout) {
+    *out_error = "failed to write";
+    return false;
+  }
+  return true;
+}
+
+TraceSpan::TraceSpan(TraceRecorder* recorder, const StringPiece& category, const StringPiece& name)
+    : recorder_(recorder) {
+  if (recorder_ != nullptr) {
+    category_ = category.to_string();
+    name_ = name.to_string();
+    start_ = TraceRecorder::Clock::now();
+  }
+}
+
+TraceSpan::~TraceSpan() {
+  End();
+}
+
+void TraceSpan::AddArg(const StringPiece& key, uint64_t value) {
+  if (recorder_ != nullptr) {
+    args_.push_back(std::make_pair(key.to_string(), value));
+  }
+}
+
+void TraceSpan::End() {
+  if (recorder_ != nullptr) {
+    recorder_->AddSpan(category_, name_, start_, TraceRecorder::Clock::now(), std::move(args_));
+    recorder_ = nullptr;
+  }
+}
+
+}  // namespace aapt
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAPT_UTIL_TRACE_H
+#define AAPT_UTIL_TRACE_H
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "android-base/macros.h"
+#include "androidfw/StringPiece.h"
+
+namespace aapt {
+
+// Collects timed spans and writes them out in the Chrome trace-event JSON format, so that a
+// build can be inspected with chrome://tracing or Perfetto. Spans may be added from several
+// threads at once. Each is attributed to the thread that added it, numbered from 1 for the thread
+// that created the recorder.
+class TraceRecorder {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using Args = std::vector<std::pair<std::string, uint64_t>>;
+
+  TraceRecorder();
+
+  // Records a complete span of the calling thread that started at `start` and ended at `end`.
+  void AddSpan(const android::StringPiece& category, const android::StringPiece& name,
+               Clock::time_point start, Clock::time_point end, Args args);
+
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(lock_);
+    return events_.size();
+  }
+
+  void WriteToStream(std::ostream* out) const;
+
+  // Writes the trace to `path`. On failure, returns false and sets `out_error`.
+  bool WriteToFile(const std::string& path, std::string* out_error) const;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(TraceRecorder);
+
+  struct Event {
+    std::string category;
+    std::string name;
+    int64_t start_us;
+    int64_t duration_us;
+    uint32_t tid;
+    Args args;
+  };
+
+  Clock::time_point origin_;
+
+  // Guards everything below.
+  mutable std::mutex lock_;
+  std::unordered_map<std::thread::id, uint32_t> thread_ids_;
+  std::vector<Event> events_;
+};
+
+// Times the scope it lives in and records it to a TraceRecorder when destroyed (or when End() is
+// called). When the recorder is nullptr, tracing is disabled and the span does nothing.
+class TraceSpan {
+ public:
+  TraceSpan(TraceRecorder* recorder, const android::StringPiece& category,
+            const android::StringPiece& name);
+  ~TraceSpan();
+
+  // Attaches a counter (bytes written, files processed, ...) to the span.
+  void AddArg(const android::StringPiece& key, uint64_t value);
+
+  // Ends the span early. Subsequent calls do nothing.
+  void End();
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(TraceSpan);
+
+  TraceRecorder* recorder_;
+  std::string category_;
+  std::string name_;
+  TraceRecorder::Clock::time_point start_;
+  TraceRecorder::Args args_;
+};
+
+}  // namespace aapt
+
+#endif  // AAPT_UTIL_TRACE_H
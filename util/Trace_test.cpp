@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "util/Trace.h"
+
+#include <sstream>
+#include <thread>
+
+#include "test/Test.h"
+
+using ::testing::ContainsRegex;
+using ::testing::HasSubstr;
+
+namespace aapt {
+
+TEST(TraceTest, NullRecorderDisablesSpans) {
+  TraceSpan span(nullptr, "link", "merge");
+  span.AddArg("files", 3u);
+  span.End();
+}
+
+TEST(TraceTest, SpansAreWrittenAsCompleteEvents) {
+  TraceRecorder recorder;
+  {
+    TraceSpan outer(&recorder, "link", "link");
+    TraceSpan inner(&recorder, "link", "flatten \"table\"");
+    inner.AddArg("bytes", 1024u);
+  }
+  EXPECT_EQ(2u, recorder.size());
+
+  std::stringstream out;
+  recorder.WriteToStream(&out);
+  const std::string json = out.str();
+  EXPECT_THAT(json, HasSubstr("{\"traceEvents\":["));
+  EXPECT_THAT(json, HasSubstr("\"name\":\"flatten \\\"table\\\"\",\"cat\":\"link\",\"ph\":\"X\""));
+  EXPECT_THAT(json, HasSubstr("\"args\":{\"bytes\":1024}"));
+  EXPECT_THAT(json, HasSubstr("\"name\":\"link\""));
+}
+
+TEST(TraceTest, EndRecordsSpanOnce) {
+  TraceRecorder recorder;
+  {
+    TraceSpan span(&recorder, "compile", "file");
+    span.End();
+    span.End();
+  }
+  EXPECT_EQ(1u, recorder.size());
+}
+
+TEST(TraceTest, SpansAreAttributedToTheThreadThatAddedThem) {
+  TraceRecorder recorder;
+  std::thread worker([&]() { TraceSpan span(&recorder, "link", "worker"); });
+  worker.join();
+  { TraceSpan span(&recorder, "link", "main"); }
+
+  std::stringstream out;
+  recorder.WriteToStream(&out);
+  const std::string json = out.str();
+
+  // The thread that created the recorder is always thread 1.
+  EXPECT_THAT(json, ContainsRegex("\"name\":\"main\"[^}]*\"tid\":1}"));
+  EXPECT_THAT(json, ContainsRegex("\"name\":\"worker\"[^}]*\"tid\":2}"));
+}
+
+TEST(TraceTest, SpansCanBeAddedFromSeveralThreadsAtOnce) {
+  TraceRecorder recorder;
+  util::ParallelFor(1000u, 8u, [&](size_t) { TraceSpan span(&recorder, "link", "shard"); });
+  EXPECT_EQ(1000u, recorder.size());
+}
+
+}  // namespace aapt
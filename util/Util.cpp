@@ -17,8 +17,11 @@
 #include "util/Util.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cstdio>
 #include <ostream>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "androidfw/StringPiece.h"
@@ -441,7 +444,23 @@ StringBuilder& StringBuilder::Append(const StringPiece& str) {
   return *this;
 }
 
+// Returns true if every code unit in [data, data + len) is ASCII. Written without an early exit
+// so that the compiler can vectorize it.
+template <typename T>
+static bool IsAllAscii(const T* data, size_t len) {
+  T bits = 0;
+  for (size_t i = 0; i < len; i++) {
+    bits |= data[i];
+  }
+  return (static_cast<uint32_t>(bits) & ~0x7fu) == 0u;
+}
+
 std::u16string Utf8ToUtf16(const StringPiece& utf8) {
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(utf8.data());
+  if (IsAllAscii(data, utf8.size())) {
+    return std::u16string(data, data + utf8.size());
+  }
+
   ssize_t utf16_length = utf8_to_utf16_length(
       reinterpret_cast<const uint8_t*>(utf8.data()), utf8.length());
   if (utf16_length <= 0) {
@@ -456,6 +475,10 @@ std::u16string Utf8ToUtf16(const StringPiece& utf8) {
 }
 
 std::string Utf16ToUtf8(const StringPiece16& utf16) {
+  if (IsAllAscii(utf16.data(), utf16.size())) {
+    return std::string(utf16.data(), utf16.data() + utf16.size());
+  }
+
   ssize_t utf8_length = utf16_to_utf8_length(utf16.data(), utf16.length());
   if (utf8_length <= 0) {
     return {};
@@ -476,6 +499,36 @@ bool WriteAll(std::ostream& out, const BigBuffer& buffer) {
   return true;
 }
 
+void WriteJsonString(const StringPiece& str, std::ostream* out) {
+  *out << '"';
+  for (const char c : str) {
+    switch (c) {
+      case '"':
+        *out << "\\\"";
+        break;
+      case '\\':
+        *out << "\\\\";
+        break;
+      case '\n':
+        *out << "\\n";
+        break;
+      case '\t':
+        *out << "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char buf[8];
+          snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned int>(c));
+          *out << buf;
+        } else {
+          *out << c;
+        }
+        break;
+    }
+  }
+  *out << '"';
+}
+
 std::unique_ptr<uint8_t[]> Copy(const BigBuffer& buffer) {
   std::unique_ptr<uint8_t[]> data =
       std::unique_ptr<uint8_t[]>(new uint8_t[buffer.size()]);
@@ -487,6 +540,29 @@ std::unique_ptr<uint8_t[]> Copy(const BigBuffer& buffer) {
   return data;
 }
 
+void ParallelFor(size_t count, size_t jobs, const std::function<void(size_t)>& fn) {
+  if (jobs == 0u) {
+    jobs = std::thread::hardware_concurrency();
+  }
+  jobs = std::max<size_t>(1u, std::min(jobs, count));
+
+  std::atomic<size_t> next_index(0u);
+  auto run = [&]() {
+    for (size_t i = next_index++; i < count; i = next_index++) {
+      fn(i);
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (size_t i = 1u; i < jobs; i++) {
+    workers.emplace_back(run);
+  }
+  run();
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+}
+
 typename Tokenizer::iterator& Tokenizer::iterator::operator++() {
   const char* start = token_.end();
   const char* end = str_.end();
@@ -554,6 +630,65 @@ bool ExtractResFilePathParts(const StringPiece& path, StringPiece* out_prefix,
   return true;
 }
 
+Hasher& Hasher::Update(const void* data, size_t len) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+  const uint8_t* const end = p + len;
+  uint64_t hash = hash_;
+  for (; p != end; ++p) {
+    hash ^= *p;
+    hash *= 0x100000001b3u;
+  }
+  hash_ = hash;
+  return *this;
+}
+
+Hasher& Hasher::Update(const StringPiece& str) {
+  // Include the length so that consecutive strings can't be shifted into each other.
+  UpdateInt(str.size());
+  return Update(str.data(), str.size());
+}
+
+Hasher& Hasher::Update(const BigBuffer& buffer) {
+  UpdateInt(buffer.size());
+  for (const auto& block : buffer) {
+    Update(block.buffer.get(), block.size);
+  }
+  return *this;
+}
+
+Hasher& Hasher::UpdateInt(uint64_t value) {
+  uint8_t bytes[sizeof(value)];
+  for (size_t i = 0; i < sizeof(value); i++) {
+    bytes[i] = static_cast<uint8_t>(value >> (i * 8));
+  }
+  return Update(bytes, sizeof(bytes));
+}
+
+std::string Hasher::HexDigest() const {
+  static const char kHexChars[] = "0123456789abcdef";
+  std::string hex(16, '0');
+  uint64_t value = hash_;
+  for (size_t i = hex.size(); i > 0; i--) {
+    hex[i - 1] = kHexChars[value & 0x0f];
+    value >>= 4;
+  }
+  return hex;
+}
+
+// DO NOT UPDATE, this is more of a marketing version.
+static const char* sMajorVersion = "2";
+
+// Update minor version whenever a feature or flag is added.
+static const char* sMinorVersion = "20";
+
+const char* GetMajorVersion() {
+  return sMajorVersion;
+}
+
+const char* GetMinorVersion() {
+  return sMinorVersion;
+}
+
 StringPiece16 GetString16(const android::ResStringPool& pool, size_t idx) {
   size_t len;
   const char16_t* str = pool.stringAt(idx, &len);
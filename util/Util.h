@@ -210,16 +210,63 @@ inline StringBuilder::operator bool() const { return error_.empty(); }
 std::u16string Utf8ToUtf16(const android::StringPiece& utf8);
 std::string Utf16ToUtf8(const android::StringPiece16& utf16);
 
+/**
+ * Incrementally computes a 64-bit FNV-1a hash. Unlike std::hash, the result is stable across
+ * platforms, standard libraries and runs, so it may be persisted (eg. as a cache key).
+ */
+class Hasher {
+ public:
+  Hasher& Update(const void* data, size_t len);
+  Hasher& Update(const android::StringPiece& str);
+  Hasher& Update(const BigBuffer& buffer);
+
+  /**
+   * Hashes the value in little-endian byte order.
+   */
+  Hasher& UpdateInt(uint64_t value);
+
+  uint64_t Digest() const;
+
+  /**
+   * Returns the digest as a 16 character lowercase hex string.
+   */
+  std::string HexDigest() const;
+
+ private:
+  uint64_t hash_ = 0xcbf29ce484222325u;
+};
+
+inline uint64_t Hasher::Digest() const { return hash_; }
+
+/**
+ * Returns the version of this aapt2 build, eg. "2" and "19".
+ */
+const char* GetMajorVersion();
+const char* GetMinorVersion();
+
 /**
  * Writes the entire BigBuffer to the output stream.
  */
 bool WriteAll(std::ostream& out, const BigBuffer& buffer);
 
+/**
+ * Writes `str` to the output stream as a quoted and escaped JSON string.
+ */
+void WriteJsonString(const android::StringPiece& str, std::ostream* out);
+
 /*
  * Copies the entire BigBuffer into a single buffer.
  */
 std::unique_ptr<uint8_t[]> Copy(const BigBuffer& buffer);
 
+/**
+ * Calls `fn` with each index in [0, count) on up to `jobs` threads, one of
+ * which is the calling thread. 0 jobs uses one thread per core. Indices are
+ * handed out in increasing order, and the function returns once every call
+ * has returned.
+ */
+void ParallelFor(size_t count, size_t jobs, const std::function<void(size_t)>& fn);
+
 /**
  * A Tokenizer implemented as an iterable collection. It does not allocate
  * any memory on the heap nor use standard containers.
@@ -17,10 +17,12 @@
 #include "util/Util.h"
 
 #include <string>
+#include <vector>
 
 #include "test/Test.h"
 
 using ::android::StringPiece;
+using ::testing::Each;
 using ::testing::Eq;
 using ::testing::Ne;
 using ::testing::SizeIs;
@@ -174,4 +176,36 @@ TEST(UtilTest, VerifyJavaStringFormat) {
   ASSERT_FALSE(util::VerifyJavaStringFormat("%09f %08s"));
 }
 
+TEST(UtilTest, ConvertsBetweenUtf8AndUtf16) {
+  EXPECT_THAT(util::Utf8ToUtf16("hello"), Eq(u"hello"));
+  EXPECT_THAT(util::Utf8ToUtf16("h\u00e9llo \u4e16"), Eq(u"h\u00e9llo \u4e16"));
+  EXPECT_THAT(util::Utf8ToUtf16(""), Eq(u""));
+
+  EXPECT_THAT(util::Utf16ToUtf8(u"hello"), Eq("hello"));
+  EXPECT_THAT(util::Utf16ToUtf8(u"h\u00e9llo \u4e16"), Eq("h\u00e9llo \u4e16"));
+  EXPECT_THAT(util::Utf16ToUtf8(u""), Eq(""));
+}
+
+TEST(UtilTest, HasherMatchesFnv1a) {
+  EXPECT_THAT(util::Hasher().Digest(), Eq(0xcbf29ce484222325u));
+  EXPECT_THAT(util::Hasher().Update("a", 1).Digest(), Eq(0xaf63dc4c8601ec8cu));
+  EXPECT_THAT(util::Hasher().Update("a", 1).HexDigest(), Eq("af63dc4c8601ec8c"));
+}
+
+TEST(UtilTest, HasherSeparatesStrings) {
+  EXPECT_THAT(util::Hasher().Update(StringPiece("ab")).Update(StringPiece("c")).Digest(),
+              Ne(util::Hasher().Update(StringPiece("a")).Update(StringPiece("bc")).Digest()));
+}
+
+TEST(UtilTest, ParallelForCallsEachIndexOnce) {
+  std::vector<int> calls(1000u, 0);
+  util::ParallelFor(calls.size(), 4u, [&](size_t i) { calls[i]++; });
+  EXPECT_THAT(calls, Each(Eq(1)));
+
+  size_t sum = 0u;
+  util::ParallelFor(0u, 4u, [&](size_t i) { sum += i; });
+  util::ParallelFor(3u, 1u, [&](size_t i) { sum += i; });
+  EXPECT_THAT(sum, Eq(3u));
+}
+
 }  // namespace aapt
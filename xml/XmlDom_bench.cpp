@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "xml/XmlDom.h"
+
+#include "benchmark/benchmark.h"
+
+#include "io/StringInputStream.h"
+#include "test/Context.h"
+#include "test/CorpusGenerator.h"
+
+using ::aapt::io::StringInputStream;
+
+namespace aapt {
+
+static void BM_XmlInflateLayout(benchmark::State& state) {
+  test::CorpusOptions options;
+  options.entries = 100;
+  options.locales = 0;
+  options.densities = 0;
+  options.drawables = 100;
+  options.layouts = 1;
+  options.views_per_layout = state.range(0);
+  const std::string input = test::GenerateCorpus(options).back().contents;
+
+  while (state.KeepRunning()) {
+    StringInputStream in(input);
+    if (!xml::Inflate(&in, test::GetDiagnostics(), Source("layout.xml"))) {
+      state.SkipWithError("failed to inflate layout");
+      break;
+    }
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * input.size());
+}
+BENCHMARK(BM_XmlInflateLayout)->Range(8, 4 << 10);
+
+}  // namespace aapt
@@ -17,12 +17,14 @@
 #include <iostream>
 #include <string>
 
+#include "io/StringInputStream.h"
 #include "util/Maybe.h"
 #include "util/Util.h"
 #include "xml/XmlPullParser.h"
 #include "xml/XmlUtil.h"
 
 using ::aapt::io::InputStream;
+using ::aapt::io::StringInputStream;
 using ::android::StringPiece;
 
 namespace aapt {
@@ -30,7 +32,26 @@ namespace xml {
 
 constexpr char kXmlNamespaceSep = 1;
 
-XmlPullParser::XmlPullParser(InputStream* in) : in_(in), empty_(), depth_(0) {
+constexpr const char* kXmlNamespaceUri = "http://www.w3.org/XML/1998/namespace";
+
+XmlPullParser::XmlPullParser(InputStream* in)
+    : event_{Event::kStartDocument, 0, 0}, depth_(1), in_(in) {
+  CreateExpatParser();
+}
+
+XmlPullParser::XmlPullParser(const void* data, size_t len)
+    : event_{Event::kStartDocument, 0, 0}, depth_(1) {
+  if (XmlTokenizer::IsSupported(data, len)) {
+    tokenizer_ = util::make_unique<XmlTokenizer>(data, len);
+  } else {
+    owned_in_ = util::make_unique<StringInputStream>(
+        StringPiece(reinterpret_cast<const char*>(data), len));
+    in_ = owned_in_.get();
+    CreateExpatParser();
+  }
+}
+
+void XmlPullParser::CreateExpatParser() {
   parser_ = XML_ParserCreateNS(nullptr, kXmlNamespaceSep);
   XML_SetUserData(parser_, this);
   XML_SetElementHandler(parser_, StartElementHandler, EndElementHandler);
@@ -38,11 +59,13 @@ XmlPullParser::XmlPullParser(InputStream* in) : in_(in), empty_(), depth_(0) {
                               EndNamespaceHandler);
   XML_SetCharacterDataHandler(parser_, CharacterDataHandler);
   XML_SetCommentHandler(parser_, CommentDataHandler);
-  event_queue_.push(EventData{Event::kStartDocument, 0, depth_++});
+  event_queue_.push(ExpatEventData{Event::kStartDocument, 0, 0});
 }
 
 XmlPullParser::~XmlPullParser() {
-  XML_ParserFree(parser_);
+  if (parser_ != nullptr) {
+    XML_ParserFree(parser_);
+  }
 }
 
 XmlPullParser::Event XmlPullParser::Next() {
@@ -51,15 +74,49 @@ XmlPullParser::Event XmlPullParser::Next() {
     return currentEvent;
   }
 
+  if (tokenizer_) {
+    NextToken();
+  } else {
+    NextExpatEvent();
+  }
+
+  Event next_event = event();
+
+  // Record namespace prefixes and package names so that we can do our own
+  // handling of references that use namespace aliases.
+  if (next_event == Event::kStartNamespace ||
+      next_event == Event::kEndNamespace) {
+    Maybe<ExtractedPackage> result =
+        ExtractPackageFromNamespace(namespace_uri().to_string());
+    if (next_event == Event::kStartNamespace) {
+      if (result) {
+        package_aliases_.emplace_back(
+            PackageDecl{namespace_prefix().to_string(), std::move(result.value())});
+      }
+    } else {
+      if (result) {
+        package_aliases_.pop_back();
+      }
+    }
+  }
+
+  return next_event;
+}
+
+void XmlPullParser::NextExpatEvent() {
   event_queue_.pop();
-  while (event_queue_.empty()) {
+
+  // Keep feeding expat while the last queued event is text, so that character data that expat
+  // reports in pieces (at line breaks, entity references and input buffer boundaries) is handed
+  // out as a single Text event.
+  while (event_queue_.empty() || event_queue_.back().event == Event::kText) {
     const char* buffer = nullptr;
     size_t buffer_size = 0;
     bool done = false;
     if (!in_->Next(reinterpret_cast<const void**>(&buffer), &buffer_size)) {
       if (in_->HadError()) {
         error_ = in_->GetError();
-        event_queue_.push(EventData{Event::kBadDocument});
+        event_queue_.push(ExpatEventData{Event::kBadDocument});
         break;
       }
 
@@ -68,77 +125,285 @@ XmlPullParser::Event XmlPullParser::Next() {
 
     if (XML_Parse(parser_, buffer, buffer_size, done) == XML_STATUS_ERROR) {
       error_ = XML_ErrorString(XML_GetErrorCode(parser_));
-      event_queue_.push(EventData{Event::kBadDocument});
+      event_queue_.push(ExpatEventData{Event::kBadDocument});
       break;
     }
 
     if (done) {
-      event_queue_.push(EventData{Event::kEndDocument, 0, 0});
+      event_queue_.push(ExpatEventData{Event::kEndDocument, 0, 0});
     }
   }
 
-  Event next_event = event();
+  // The front of the queue isn't modified or moved while it is the current event.
+  const ExpatEventData& data = event_queue_.front();
+  event_ = EventData{data.event, data.line_number, data.depth, data.data1, data.data2};
+  text_needs_decoding_ = false;
 
-  // Record namespace prefixes and package names so that we can do our own
-  // handling of references that use namespace aliases.
-  if (next_event == Event::kStartNamespace ||
-      next_event == Event::kEndNamespace) {
-    Maybe<ExtractedPackage> result =
-        ExtractPackageFromNamespace(namespace_uri());
-    if (next_event == Event::kStartNamespace) {
-      if (result) {
-        package_aliases_.emplace_back(
-            PackageDecl{namespace_prefix(), std::move(result.value())});
+  attributes_.clear();
+  for (size_t i = 0; i + 2 < data.attributes.size(); i += 3) {
+    attributes_.push_back(
+        Attribute{data.attributes[i], data.attributes[i + 1], data.attributes[i + 2]});
+  }
+  std::sort(attributes_.begin(), attributes_.end());
+}
+
+void XmlPullParser::NextToken() {
+  if (next_pending_event_ < pending_events_.size()) {
+    event_ = pending_events_[next_pending_event_++];
+    return;
+  }
+
+  // The namespaces of the last end tag were still needed for its events.
+  namespace_bindings_.resize(namespace_bindings_.size() - expired_bindings_);
+  decoded_namespace_uris_.resize(decoded_namespace_uris_.size() - expired_bindings_);
+  expired_bindings_ = 0u;
+  pending_events_.clear();
+  next_pending_event_ = 0u;
+
+  switch (tokenizer_->Next()) {
+    case XmlTokenizer::Token::kBadDocument:
+      SetBadDocument(tokenizer_->error(), tokenizer_->line_number());
+      return;
+
+    case XmlTokenizer::Token::kEndDocument:
+      event_ = EventData{Event::kEndDocument, 0, 0};
+      return;
+
+    case XmlTokenizer::Token::kText:
+      event_ = EventData{Event::kText, tokenizer_->line_number(), depth_, tokenizer_->text()};
+      text_needs_decoding_ = tokenizer_->text_needs_decoding();
+      text_decoded_ = false;
+      return;
+
+    case XmlTokenizer::Token::kComment:
+      event_ = EventData{Event::kComment, tokenizer_->line_number(), depth_, tokenizer_->text()};
+      text_needs_decoding_ = tokenizer_->text_needs_decoding();
+      text_decoded_ = false;
+      return;
+
+    case XmlTokenizer::Token::kStartTag:
+      if (!ReadStartTag()) {
+        return;
       }
+      break;
+
+    case XmlTokenizer::Token::kEndTag:
+      ReadEndTag();
+      break;
+  }
+  event_ = pending_events_[next_pending_event_++];
+}
+
+bool XmlPullParser::ResolveName(const StringPiece& qualified_name, bool is_element,
+                                StringPiece* out_namespace_uri, StringPiece* out_name) {
+  StringPiece prefix;
+  *out_name = qualified_name;
+  const char* colon = std::find(qualified_name.begin(), qualified_name.end(), ':');
+  if (colon != qualified_name.end()) {
+    prefix = qualified_name.substr(qualified_name.begin(), colon);
+    *out_name = qualified_name.substr(colon + 1, qualified_name.end());
+  } else if (!is_element) {
+    // Attributes without a prefix are not in the default namespace.
+    *out_namespace_uri = {};
+    return true;
+  }
+
+  if (prefix == "xml") {
+    *out_namespace_uri = kXmlNamespaceUri;
+    return true;
+  }
+
+  const auto end_iter = namespace_bindings_.rend();
+  for (auto iter = namespace_bindings_.rbegin(); iter != end_iter; ++iter) {
+    if (iter->prefix == prefix) {
+      *out_namespace_uri = iter->uri;
+      return true;
+    }
+  }
+
+  if (!prefix.empty()) {
+    SetBadDocument("unbound prefix", tokenizer_->line_number());
+    return false;
+  }
+  *out_namespace_uri = {};
+  return true;
+}
+
+bool XmlPullParser::ReadStartTag() {
+  const size_t line_number = tokenizer_->line_number();
+  const std::vector<XmlTokenizer::Attribute>& tag_attributes = tokenizer_->attributes();
+
+  // Namespace declarations apply to the element itself and to its other attributes.
+  size_t binding_count = 0u;
+  for (const XmlTokenizer::Attribute& attr : tag_attributes) {
+    StringPiece prefix;
+    if (attr.name == "xmlns") {
+      prefix = {};
+    } else if (attr.name.size() > 6u && attr.name.substr(0, 6u) == "xmlns:") {
+      prefix = attr.name.substr(6u);
     } else {
-      if (result) {
-        package_aliases_.pop_back();
-      }
+      continue;
+    }
+
+    decoded_namespace_uris_.emplace_back();
+    StringPiece uri = attr.value;
+    if (attr.needs_decoding) {
+      XmlTokenizer::DecodeAttributeValue(attr.value, &decoded_namespace_uris_.back());
+      uri = decoded_namespace_uris_.back();
     }
+
+    if (!prefix.empty() && uri.empty()) {
+      SetBadDocument("unbinding a prefix is not allowed", line_number);
+      return false;
+    }
+
+    namespace_bindings_.push_back(NamespaceBinding{prefix, uri});
+    binding_count++;
+    pending_events_.push_back(
+        EventData{Event::kStartNamespace, line_number, depth_++, prefix, uri});
   }
+  element_binding_counts_.push_back(binding_count);
 
-  return next_event;
+  StringPiece element_namespace;
+  StringPiece element_name;
+  if (!ResolveName(tokenizer_->name(), true /*is_element*/, &element_namespace, &element_name)) {
+    return false;
+  }
+
+  attributes_.clear();
+  decoded_attribute_values_.clear();
+  std::vector<std::pair<size_t, size_t>> decoded_ranges;
+  for (const XmlTokenizer::Attribute& attr : tag_attributes) {
+    if (attr.name == "xmlns" || (attr.name.size() > 6u && attr.name.substr(0, 6u) == "xmlns:")) {
+      continue;
+    }
+
+    Attribute attribute;
+    if (!ResolveName(attr.name, false /*is_element*/, &attribute.namespace_uri, &attribute.name)) {
+      return false;
+    }
+
+    attribute.value = attr.value;
+    if (attr.needs_decoding) {
+      // Point the value at the decoded copy once all values are decoded, since the buffer may
+      // still grow.
+      const size_t start = decoded_attribute_values_.size();
+      XmlTokenizer::DecodeAttributeValue(attr.value, &decoded_attribute_values_);
+      decoded_ranges.push_back({start, decoded_attribute_values_.size() - start});
+      attribute.value = {};
+    } else {
+      decoded_ranges.push_back({0u, std::string::npos});
+    }
+    attributes_.push_back(attribute);
+  }
+
+  for (size_t i = 0; i < attributes_.size(); i++) {
+    if (decoded_ranges[i].second != std::string::npos) {
+      attributes_[i].value = StringPiece(decoded_attribute_values_.data() + decoded_ranges[i].first,
+                                         decoded_ranges[i].second);
+    }
+  }
+
+  // Attributes with different prefixes may still resolve to the same name.
+  std::sort(attributes_.begin(), attributes_.end());
+  if (std::adjacent_find(attributes_.begin(), attributes_.end()) != attributes_.end()) {
+    SetBadDocument("duplicate attribute", line_number);
+    return false;
+  }
+
+  pending_events_.push_back(
+      EventData{Event::kStartElement, line_number, depth_++, element_namespace, element_name});
+  return true;
+}
+
+void XmlPullParser::ReadEndTag() {
+  const size_t line_number = tokenizer_->line_number();
+
+  // The tokenizer checked that the tag matches the start tag, which resolved its name.
+  StringPiece element_namespace;
+  StringPiece element_name;
+  ResolveName(tokenizer_->name(), true /*is_element*/, &element_namespace, &element_name);
+  pending_events_.push_back(
+      EventData{Event::kEndElement, line_number, --depth_, element_namespace, element_name});
+
+  // Namespaces go out of scope in the reverse order of their declarations.
+  const size_t binding_count = element_binding_counts_.back();
+  element_binding_counts_.pop_back();
+  for (size_t i = 0; i < binding_count; i++) {
+    const NamespaceBinding& binding = namespace_bindings_[namespace_bindings_.size() - 1 - i];
+    pending_events_.push_back(
+        EventData{Event::kEndNamespace, line_number, --depth_, binding.prefix, binding.uri});
+  }
+  expired_bindings_ = binding_count;
+}
+
+void XmlPullParser::SetBadDocument(const std::string& error, size_t line_number) {
+  error_ = error;
+  event_ = EventData{Event::kBadDocument, line_number, depth_};
+  pending_events_.clear();
+  next_pending_event_ = 0u;
 }
 
 XmlPullParser::Event XmlPullParser::event() const {
-  return event_queue_.front().event;
+  return event_.event;
 }
 
 const std::string& XmlPullParser::error() const { return error_; }
 
-const std::string& XmlPullParser::comment() const {
-  return event_queue_.front().data1;
+StringPiece XmlPullParser::comment() const {
+  if (event() != Event::kComment) {
+    return {};
+  }
+
+  if (text_needs_decoding_) {
+    if (!text_decoded_) {
+      decoded_text_.clear();
+      XmlTokenizer::NormalizeLineEndings(event_.data1, &decoded_text_);
+      text_decoded_ = true;
+    }
+    return decoded_text_;
+  }
+  return event_.data1;
 }
 
 size_t XmlPullParser::line_number() const {
-  return event_queue_.front().line_number;
+  return event_.line_number;
 }
 
-size_t XmlPullParser::depth() const { return event_queue_.front().depth; }
+size_t XmlPullParser::depth() const { return event_.depth; }
 
-const std::string& XmlPullParser::text() const {
+StringPiece XmlPullParser::text() const {
   if (event() != Event::kText) {
-    return empty_;
+    return {};
   }
-  return event_queue_.front().data1;
+
+  if (text_needs_decoding_) {
+    if (!text_decoded_) {
+      decoded_text_.clear();
+      XmlTokenizer::DecodeText(event_.data1, &decoded_text_);
+      text_decoded_ = true;
+    }
+    return decoded_text_;
+  }
+  return event_.data1;
 }
 
-const std::string& XmlPullParser::namespace_prefix() const {
+StringPiece XmlPullParser::namespace_prefix() const {
   const Event current_event = event();
   if (current_event != Event::kStartNamespace &&
       current_event != Event::kEndNamespace) {
-    return empty_;
+    return {};
   }
-  return event_queue_.front().data1;
+  return event_.data1;
 }
 
-const std::string& XmlPullParser::namespace_uri() const {
+StringPiece XmlPullParser::namespace_uri() const {
   const Event current_event = event();
   if (current_event != Event::kStartNamespace &&
       current_event != Event::kEndNamespace) {
-    return empty_;
+    return {};
   }
-  return event_queue_.front().data2;
+  return event_.data2;
 }
 
 Maybe<ExtractedPackage> XmlPullParser::TransformPackageAlias(
@@ -159,37 +424,41 @@ Maybe<ExtractedPackage> XmlPullParser::TransformPackageAlias(
   return {};
 }
 
-const std::string& XmlPullParser::element_namespace() const {
+StringPiece XmlPullParser::element_namespace() const {
   const Event current_event = event();
   if (current_event != Event::kStartElement &&
       current_event != Event::kEndElement) {
-    return empty_;
+    return {};
   }
-  return event_queue_.front().data1;
+  return event_.data1;
 }
 
-const std::string& XmlPullParser::element_name() const {
+StringPiece XmlPullParser::element_name() const {
   const Event current_event = event();
   if (current_event != Event::kStartElement &&
       current_event != Event::kEndElement) {
-    return empty_;
+    return {};
   }
-  return event_queue_.front().data2;
+  return event_.data2;
 }
 
 XmlPullParser::const_iterator XmlPullParser::begin_attributes() const {
-  return event_queue_.front().attributes.begin();
+  // The attributes of a tokenized start tag are kept while its namespace events are handed out.
+  if (event() != Event::kStartElement) {
+    return attributes_.end();
+  }
+  return attributes_.begin();
 }
 
 XmlPullParser::const_iterator XmlPullParser::end_attributes() const {
-  return event_queue_.front().attributes.end();
+  return attributes_.end();
 }
 
 size_t XmlPullParser::attribute_count() const {
   if (event() != Event::kStartElement) {
     return 0;
   }
-  return event_queue_.front().attributes.size();
+  return attributes_.size();
 }
 
 /**
@@ -217,9 +486,9 @@ void XMLCALL XmlPullParser::StartNamespaceHandler(void* user_data,
   std::string namespace_uri = uri != nullptr ? uri : std::string();
   parser->namespace_uris_.push(namespace_uri);
   parser->event_queue_.push(
-      EventData{Event::kStartNamespace,
-                XML_GetCurrentLineNumber(parser->parser_), parser->depth_++,
-                prefix != nullptr ? prefix : std::string(), namespace_uri});
+      ExpatEventData{Event::kStartNamespace,
+                     XML_GetCurrentLineNumber(parser->parser_), parser->depth_++,
+                     prefix != nullptr ? prefix : std::string(), namespace_uri});
 }
 
 void XMLCALL XmlPullParser::StartElementHandler(void* user_data,
@@ -227,20 +496,18 @@ void XMLCALL XmlPullParser::StartElementHandler(void* user_data,
                                                 const char** attrs) {
   XmlPullParser* parser = reinterpret_cast<XmlPullParser*>(user_data);
 
-  EventData data = {Event::kStartElement,
-                    XML_GetCurrentLineNumber(parser->parser_),
-                    parser->depth_++};
+  ExpatEventData data = {Event::kStartElement,
+                         XML_GetCurrentLineNumber(parser->parser_),
+                         parser->depth_++};
   SplitName(name, &data.data1, &data.data2);
 
   while (*attrs) {
-    Attribute attribute;
-    SplitName(*attrs++, &attribute.namespace_uri, &attribute.name);
-    attribute.value = *attrs++;
-
-    // Insert in sorted order.
-    auto iter = std::lower_bound(data.attributes.begin(), data.attributes.end(),
-                                 attribute);
-    data.attributes.insert(iter, std::move(attribute));
+    std::string namespace_uri;
+    std::string attr_name;
+    SplitName(*attrs++, &namespace_uri, &attr_name);
+    data.attributes.push_back(std::move(namespace_uri));
+    data.attributes.push_back(std::move(attr_name));
+    data.attributes.push_back(*attrs++);
   }
 
   // Move the structure into the queue (no copy).
@@ -251,17 +518,27 @@ void XMLCALL XmlPullParser::CharacterDataHandler(void* user_data, const char* s,
                                                  int len) {
   XmlPullParser* parser = reinterpret_cast<XmlPullParser*>(user_data);
 
-  parser->event_queue_.push(EventData{Event::kText, XML_GetCurrentLineNumber(parser->parser_),
-                                      parser->depth_, std::string(s, len)});
+  // Append to a preceding Text event instead of queueing a new one for every fragment.
+  if (!parser->event_queue_.empty()) {
+    ExpatEventData& last = parser->event_queue_.back();
+    if (last.event == Event::kText) {
+      last.data1.append(s, len);
+      return;
+    }
+  }
+
+  parser->event_queue_.push(ExpatEventData{Event::kText,
+                                           XML_GetCurrentLineNumber(parser->parser_),
+                                           parser->depth_, std::string(s, len)});
 }
 
 void XMLCALL XmlPullParser::EndElementHandler(void* user_data,
                                               const char* name) {
   XmlPullParser* parser = reinterpret_cast<XmlPullParser*>(user_data);
 
-  EventData data = {Event::kEndElement,
-                    XML_GetCurrentLineNumber(parser->parser_),
-                    --(parser->depth_)};
+  ExpatEventData data = {Event::kEndElement,
+                         XML_GetCurrentLineNumber(parser->parser_),
+                         --(parser->depth_)};
   SplitName(name, &data.data1, &data.data2);
 
   // Move the data into the queue (no copy).
@@ -273,9 +550,9 @@ void XMLCALL XmlPullParser::EndNamespaceHandler(void* user_data,
   XmlPullParser* parser = reinterpret_cast<XmlPullParser*>(user_data);
 
   parser->event_queue_.push(
-      EventData{Event::kEndNamespace, XML_GetCurrentLineNumber(parser->parser_),
-                --(parser->depth_), prefix != nullptr ? prefix : std::string(),
-                parser->namespace_uris_.top()});
+      ExpatEventData{Event::kEndNamespace, XML_GetCurrentLineNumber(parser->parser_),
+                     --(parser->depth_), prefix != nullptr ? prefix : std::string(),
+                     parser->namespace_uris_.top()});
   parser->namespace_uris_.pop();
 }
 
@@ -283,9 +560,9 @@ void XMLCALL XmlPullParser::CommentDataHandler(void* user_data,
                                                const char* comment) {
   XmlPullParser* parser = reinterpret_cast<XmlPullParser*>(user_data);
 
-  parser->event_queue_.push(EventData{Event::kComment,
-                                      XML_GetCurrentLineNumber(parser->parser_),
-                                      parser->depth_, comment});
+  parser->event_queue_.push(ExpatEventData{Event::kComment,
+                                           XML_GetCurrentLineNumber(parser->parser_),
+                                           parser->depth_, comment});
 }
 
 Maybe<StringPiece> FindAttribute(const XmlPullParser* parser,
@@ -20,7 +20,9 @@
 #include <expat.h>
 
 #include <algorithm>
+#include <deque>
 #include <istream>
+#include <memory>
 #include <ostream>
 #include <queue>
 #include <stack>
@@ -34,6 +36,7 @@
 #include "io/Io.h"
 #include "process/IResourceTableConsumer.h"
 #include "util/Maybe.h"
+#include "xml/XmlTokenizer.h"
 #include "xml/XmlUtil.h"
 
 namespace aapt {
@@ -65,7 +68,20 @@ class XmlPullParser : public IPackageDeclStack {
   static bool SkipCurrentElement(XmlPullParser* parser);
   static bool IsGoodEvent(Event event);
 
+  /**
+   * Parses the document read from `in` with expat. Every string that is handed out is a copy
+   * that stays valid until the next call to Next().
+   */
   explicit XmlPullParser(io::InputStream* in);
+
+  /**
+   * Parses the document in `data` in place, which must stay valid and unchanged for the lifetime
+   * of the parser. Names, attribute values, text and comments that are handed out refer to `data`
+   * where possible, and text is only decoded (entities, CDATA sections and line endings) when it is
+   * read. Documents that declare a DTD or an encoding other than UTF-8 are parsed with expat.
+   */
+  XmlPullParser(const void* data, size_t len);
+
   ~XmlPullParser();
 
   /**
@@ -85,28 +101,29 @@ class XmlPullParser : public IPackageDeclStack {
   // These are available for all nodes.
   //
 
-  const std::string& comment() const;
+  android::StringPiece comment() const;
   size_t line_number() const;
   size_t depth() const;
 
   /**
-   * Returns the character data for a Text event.
+   * Returns the character data for a Text event. Adjacent character data, including text
+   * separated by line breaks or entity references, is reported as a single Text event.
    */
-  const std::string& text() const;
+  android::StringPiece text() const;
 
   //
   // Namespace prefix and URI are available for StartNamespace and EndNamespace.
   //
 
-  const std::string& namespace_prefix() const;
-  const std::string& namespace_uri() const;
+  android::StringPiece namespace_prefix() const;
+  android::StringPiece namespace_uri() const;
 
   //
   // These are available for StartElement and EndElement.
   //
 
-  const std::string& element_namespace() const;
-  const std::string& element_name() const;
+  android::StringPiece element_namespace() const;
+  android::StringPiece element_name() const;
 
   /*
    * Uses the current stack of namespaces to resolve the package. Eg:
@@ -131,9 +148,9 @@ class XmlPullParser : public IPackageDeclStack {
   //
 
   struct Attribute {
-    std::string namespace_uri;
-    std::string name;
-    std::string value;
+    android::StringPiece namespace_uri;
+    android::StringPiece name;
+    android::StringPiece value;
 
     int compare(const Attribute& rhs) const;
     bool operator<(const Attribute& rhs) const;
@@ -161,23 +178,71 @@ class XmlPullParser : public IPackageDeclStack {
   static void XMLCALL EndNamespaceHandler(void* user_data, const char* prefix);
   static void XMLCALL CommentDataHandler(void* user_data, const char* comment);
 
+  // The current event. Its strings refer to the document, to the expat event it was made from,
+  // or to strings that the parser decoded.
   struct EventData {
+    Event event;
+    size_t line_number;
+    size_t depth;
+    android::StringPiece data1;
+    android::StringPiece data2;
+  };
+
+  // An event reported by expat, which owns its strings.
+  struct ExpatEventData {
     Event event;
     size_t line_number;
     size_t depth;
     std::string data1;
     std::string data2;
-    std::vector<Attribute> attributes;
+
+    // The namespace URI, name and value of each attribute.
+    std::vector<std::string> attributes;
   };
 
-  io::InputStream* in_;
-  XML_Parser parser_;
-  std::queue<EventData> event_queue_;
+  // A namespace declared by an open element of the tokenized document.
+  struct NamespaceBinding {
+    android::StringPiece prefix;
+    android::StringPiece uri;
+  };
+
+  void CreateExpatParser();
+  void NextExpatEvent();
+  void NextToken();
+  bool ReadStartTag();
+  void ReadEndTag();
+  bool ResolveName(const android::StringPiece& qualified_name, bool is_element,
+                   android::StringPiece* out_namespace_uri, android::StringPiece* out_name);
+  void SetBadDocument(const std::string& error, size_t line_number);
+
+  EventData event_;
+  std::vector<Attribute> attributes_;
+  bool text_needs_decoding_ = false;
+  mutable bool text_decoded_ = false;
+  mutable std::string decoded_text_;
   std::string error_;
-  const std::string empty_;
   size_t depth_;
+
+  // Parsing with expat.
+  io::InputStream* in_ = nullptr;
+  std::unique_ptr<io::InputStream> owned_in_;
+  XML_Parser parser_ = nullptr;
+  std::queue<ExpatEventData> event_queue_;
   std::stack<std::string> namespace_uris_;
 
+  // Parsing in place.
+  std::unique_ptr<XmlTokenizer> tokenizer_;
+  std::vector<EventData> pending_events_;
+  size_t next_pending_event_ = 0u;
+  std::vector<NamespaceBinding> namespace_bindings_;
+  // Decoded namespace URIs, one for each binding (empty if the URI didn't need decoding).
+  std::deque<std::string> decoded_namespace_uris_;
+  // The number of bindings that each open element declared.
+  std::vector<size_t> element_binding_counts_;
+  // Bindings that went out of scope with the last end tag, once its events are handed out.
+  size_t expired_bindings_ = 0u;
+  std::string decoded_attribute_values_;
+
   struct PackageDecl {
     std::string prefix;
     ExtractedPackage package;
@@ -301,12 +366,10 @@ inline XmlPullParser::const_iterator XmlPullParser::FindAttribute(
       std::pair<android::StringPiece, android::StringPiece>(namespace_uri, name),
       [](const Attribute& attr,
          const std::pair<android::StringPiece, android::StringPiece>& rhs) -> bool {
-        int cmp = attr.namespace_uri.compare(
-            0, attr.namespace_uri.size(), rhs.first.data(), rhs.first.size());
+        int cmp = attr.namespace_uri.compare(rhs.first);
         if (cmp < 0) return true;
         if (cmp > 0) return false;
-        cmp = attr.name.compare(0, attr.name.size(), rhs.second.data(),
-                                rhs.second.size());
+        cmp = attr.name.compare(rhs.second);
         if (cmp < 0) return true;
         return false;
       });
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "xml/XmlPullParser.h"
+
+#include "benchmark/benchmark.h"
+
+#include "io/StringInputStream.h"
+#include "test/CorpusGenerator.h"
+
+using ::aapt::io::StringInputStream;
+
+namespace aapt {
+
+// Returns a translated values file with `entries` strings, like the translations of a large app.
+static std::string GenerateTranslations(size_t entries) {
+  test::CorpusOptions options;
+  options.entries = entries;
+  options.locales = 1;
+  options.densities = 0;
+  options.layouts = 0;
+  options.drawables = 0;
+  for (test::CorpusFile& file : test::GenerateCorpus(options)) {
+    if (file.path != "res/values/values.xml") {
+      return std::move(file.contents);
+    }
+  }
+  return {};
+}
+
+// Reads every event and the strings a ResourceParser reads, so that lazily decoded text is
+// decoded too.
+static bool ReadAllEvents(xml::XmlPullParser* parser) {
+  size_t size = 0u;
+  while (xml::XmlPullParser::IsGoodEvent(parser->Next())) {
+    size += parser->element_name().size() + parser->text().size();
+    for (auto iter = parser->begin_attributes(); iter != parser->end_attributes(); ++iter) {
+      size += iter->value.size();
+    }
+  }
+  benchmark::DoNotOptimize(size);
+  return parser->event() == xml::XmlPullParser::Event::kEndDocument;
+}
+
+static void BM_XmlPullParserExpat(benchmark::State& state) {
+  const std::string input = GenerateTranslations(state.range(0));
+  while (state.KeepRunning()) {
+    StringInputStream in(input);
+    xml::XmlPullParser parser(&in);
+    if (!ReadAllEvents(&parser)) {
+      state.SkipWithError("failed to parse translations");
+      break;
+    }
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * input.size());
+}
+BENCHMARK(BM_XmlPullParserExpat)->Range(1 << 10, 64 << 10);
+
+static void BM_XmlPullParserInPlace(benchmark::State& state) {
+  const std::string input = GenerateTranslations(state.range(0));
+  while (state.KeepRunning()) {
+    xml::XmlPullParser parser(input.data(), input.size());
+    if (!ReadAllEvents(&parser)) {
+      state.SkipWithError("failed to parse translations");
+      break;
+    }
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * input.size());
+}
+BENCHMARK(BM_XmlPullParserInPlace)->Range(1 << 10, 64 << 10);
+
+}  // namespace aapt
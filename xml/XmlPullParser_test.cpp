@@ -16,6 +16,8 @@
 
 #include "xml/XmlPullParser.h"
 
+#include <sstream>
+
 #include "androidfw/StringPiece.h"
 
 #include "io/StringInputStream.h"
@@ -57,4 +59,125 @@ TEST(XmlPullParserTest, NextChildNodeTraversesCorrectly) {
   EXPECT_EQ(xml::XmlPullParser::Event::kEndDocument, parser.event());
 }
 
+TEST(XmlPullParserTest, AdjacentTextIsReportedAsOneEvent) {
+  std::string str = "<a>hello\n  there &amp;\n  world<b/>tail</a>";
+  StringInputStream input(str);
+  xml::XmlPullParser parser(&input);
+
+  ASSERT_EQ(xml::XmlPullParser::Event::kStartElement, parser.Next());
+  EXPECT_EQ(StringPiece("a"), StringPiece(parser.element_name()));
+
+  ASSERT_EQ(xml::XmlPullParser::Event::kText, parser.Next());
+  EXPECT_EQ(StringPiece("hello\n  there &\n  world"), StringPiece(parser.text()));
+  EXPECT_EQ(1u, parser.line_number());
+
+  ASSERT_EQ(xml::XmlPullParser::Event::kStartElement, parser.Next());
+  EXPECT_EQ(StringPiece("b"), StringPiece(parser.element_name()));
+  ASSERT_EQ(xml::XmlPullParser::Event::kEndElement, parser.Next());
+
+  ASSERT_EQ(xml::XmlPullParser::Event::kText, parser.Next());
+  EXPECT_EQ(StringPiece("tail"), StringPiece(parser.text()));
+
+  ASSERT_EQ(xml::XmlPullParser::Event::kEndElement, parser.Next());
+  EXPECT_EQ(xml::XmlPullParser::Event::kEndDocument, parser.Next());
+}
+
+// Writes every event of `parser` and everything that is available for it, one event per line.
+static std::string DumpEvents(xml::XmlPullParser* parser) {
+  std::stringstream out;
+  while (xml::XmlPullParser::IsGoodEvent(parser->Next())) {
+    out << parser->event() << " line=" << parser->line_number() << " depth=" << parser->depth();
+    switch (parser->event()) {
+      case xml::XmlPullParser::Event::kStartNamespace:
+      case xml::XmlPullParser::Event::kEndNamespace:
+        out << " " << parser->namespace_prefix() << "=" << parser->namespace_uri();
+        break;
+      case xml::XmlPullParser::Event::kStartElement:
+      case xml::XmlPullParser::Event::kEndElement:
+        out << " {" << parser->element_namespace() << "}" << parser->element_name();
+        for (auto iter = parser->begin_attributes(); iter != parser->end_attributes(); ++iter) {
+          out << " {" << iter->namespace_uri << "}" << iter->name << "=[" << iter->value << "]";
+        }
+        break;
+      case xml::XmlPullParser::Event::kText:
+        out << " [" << parser->text() << "]";
+        break;
+      case xml::XmlPullParser::Event::kComment:
+        out << " [" << parser->comment() << "]";
+        break;
+      default:
+        break;
+    }
+    out << "\n";
+  }
+  out << parser->event() << "\n";
+  return out.str();
+}
+
+TEST(XmlPullParserTest, InPlaceParserReportsTheSameEventsAsExpat) {
+  const std::vector<std::string> documents = {
+      R"(<?xml version="1.0" encoding="utf-8"?>
+         <!-- Copyright -->
+         <resources xmlns:xliff="urn:oasis:names:tc:xliff:document:1.2"
+             xmlns:app="http://schemas.android.com/apk/res-auto">
+           <!-- The greeting. -->
+           <string name="hello" app:product="tablet">Hi <xliff:g id="user">%1$s</xliff:g></string>
+           <string name="quoted">"It&apos;s" &lt;b&gt; &#x1F600; &#65;</string>
+           <string name="styled"><b>bold</b> and <i attr="a&amp;b	c">italic</i></string>
+           <item type="id" name="empty"/>
+           <string name="cdata"><![CDATA[<not a tag> &amp;]]> after<?ignored pi?>text</string>
+           <nested xmlns="urn:default" xmlns:xliff="urn:other">
+             <xliff:g/><inner a="1"/>
+           </nested>
+         </resources>)",
+      "<a>\r\n  line\r\n  <!-- c\r\n -->\r\n</a>\r\n",
+      "\xef\xbb\xbf<a\n  b = 'one\ntwo'\n  c=\"&quot;\"\n/>",
+  };
+
+  for (const std::string& str : documents) {
+    StringInputStream input(str);
+    xml::XmlPullParser expat_parser(&input);
+    xml::XmlPullParser in_place_parser(str.data(), str.size());
+    EXPECT_EQ(DumpEvents(&expat_parser), DumpEvents(&in_place_parser));
+  }
+}
+
+TEST(XmlPullParserTest, InPlaceParserRefersToTheDocument) {
+  const std::string str = R"(<resources><string name="foo">bar</string></resources>)";
+  xml::XmlPullParser parser(str.data(), str.size());
+
+  ASSERT_EQ(xml::XmlPullParser::Event::kStartElement, parser.Next());
+  ASSERT_EQ(xml::XmlPullParser::Event::kStartElement, parser.Next());
+  EXPECT_EQ(str.data() + str.find("string"), parser.element_name().data());
+  Maybe<StringPiece> name = xml::FindAttribute(&parser, "name");
+  ASSERT_TRUE(name);
+  EXPECT_EQ(str.data() + str.find("foo"), name.value().data());
+  ASSERT_EQ(xml::XmlPullParser::Event::kText, parser.Next());
+  EXPECT_EQ(str.data() + str.find("bar"), parser.text().data());
+}
+
+TEST(XmlPullParserTest, InPlaceParserReportsErrorsWithTheirLine) {
+  const std::string str = "<resources>\n  <string name=\"foo\">&unknown;</string>\n</resources>";
+  xml::XmlPullParser parser(str.data(), str.size());
+  while (xml::XmlPullParser::IsGoodEvent(parser.Next())) {
+  }
+  EXPECT_EQ(xml::XmlPullParser::Event::kBadDocument, parser.event());
+  EXPECT_EQ(2u, parser.line_number());
+  EXPECT_FALSE(parser.error().empty());
+
+  const std::string unbound = "<resources><foo:bar/></resources>";
+  xml::XmlPullParser unbound_parser(unbound.data(), unbound.size());
+  while (xml::XmlPullParser::IsGoodEvent(unbound_parser.Next())) {
+  }
+  EXPECT_EQ(xml::XmlPullParser::Event::kBadDocument, unbound_parser.event());
+}
+
+TEST(XmlPullParserTest, DocumentsWithDtdsAreParsedWithExpat) {
+  const std::string str = R"(<!DOCTYPE a [<!ENTITY foo "bar">]><a>&foo;</a>)";
+  xml::XmlPullParser parser(str.data(), str.size());
+  ASSERT_EQ(xml::XmlPullParser::Event::kStartElement, parser.Next());
+  ASSERT_EQ(xml::XmlPullParser::Event::kText, parser.Next());
+  EXPECT_EQ(StringPiece("bar"), parser.text());
+}
+
 }  // namespace aapt
@@ -0,0 +1,679 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "xml/XmlTokenizer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+using ::android::StringPiece;
+
+namespace aapt {
+namespace xml {
+
+// Bounds the search for the ';' that ends a reference. The predefined entities and every valid
+// character reference without excess leading zeros are shorter than this.
+constexpr size_t kMaxReferenceLength = 16u;
+
+static bool IsWhitespace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static bool IsNameChar(char c) {
+  switch (c) {
+    case ' ':
+    case '\t':
+    case '\n':
+    case '\r':
+    case '<':
+    case '>':
+    case '/':
+    case '=':
+    case '"':
+    case '\'':
+    case '&':
+    case '?':
+    case '!':
+      return false;
+    default:
+      return true;
+  }
+}
+
+static bool StartsWith(const char* p, const char* end, const char* prefix) {
+  const size_t len = strlen(prefix);
+  return static_cast<size_t>(end - p) >= len && memcmp(p, prefix, len) == 0;
+}
+
+// Returns the first occurrence of `str` in [begin, end), or nullptr.
+static const char* Search(const char* begin, const char* end, const char* str) {
+  const char* found = std::search(begin, end, str, str + strlen(str));
+  return found != end ? found : nullptr;
+}
+
+static bool IsValidChar(uint32_t c) {
+  return c == 0x09u || c == 0x0au || c == 0x0du || (c >= 0x20u && c <= 0xd7ffu) ||
+         (c >= 0xe000u && c <= 0xfffdu) || (c >= 0x10000u && c <= 0x10ffffu);
+}
+
+static int DecimalValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  return -1;
+}
+
+static int HexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+enum class ReferenceError {
+  kNone,
+  kSyntax,
+  kUndefinedEntity,
+  kInvalidCharacter,
+};
+
+// Parses the reference that starts at `p`, just after its '&'. On success, sets `out_char` to the
+// character it refers to and `out_next` to the character after its ';'.
+static ReferenceError ParseReference(const char* p, const char* end, uint32_t* out_char,
+                                     const char** out_next) {
+  const size_t max_len = std::min(static_cast<size_t>(end - p), kMaxReferenceLength);
+  const char* semicolon = reinterpret_cast<const char*>(memchr(p, ';', max_len));
+  if (semicolon == nullptr || semicolon == p) {
+    return ReferenceError::kSyntax;
+  }
+  *out_next = semicolon + 1;
+
+  const StringPiece name(p, semicolon - p);
+  if (name.data()[0] != '#') {
+    if (name == "amp") {
+      *out_char = '&';
+    } else if (name == "lt") {
+      *out_char = '<';
+    } else if (name == "gt") {
+      *out_char = '>';
+    } else if (name == "apos") {
+      *out_char = '\'';
+    } else if (name == "quot") {
+      *out_char = '"';
+    } else {
+      return ReferenceError::kUndefinedEntity;
+    }
+    return ReferenceError::kNone;
+  }
+
+  const bool hex = name.size() > 1u && name.data()[1] == 'x';
+  const char* digit = name.data() + (hex ? 2u : 1u);
+  if (digit == semicolon) {
+    return ReferenceError::kSyntax;
+  }
+
+  uint32_t c = 0u;
+  for (; digit != semicolon; ++digit) {
+    const int value = hex ? HexValue(*digit) : DecimalValue(*digit);
+    if (value < 0) {
+      return ReferenceError::kSyntax;
+    }
+    c = c * (hex ? 16u : 10u) + static_cast<uint32_t>(value);
+    if (c > 0x10ffffu) {
+      return ReferenceError::kInvalidCharacter;
+    }
+  }
+
+  if (!IsValidChar(c)) {
+    return ReferenceError::kInvalidCharacter;
+  }
+  *out_char = c;
+  return ReferenceError::kNone;
+}
+
+static void AppendUtf8(uint32_t c, std::string* out) {
+  if (c < 0x80u) {
+    *out += static_cast<char>(c);
+  } else if (c < 0x800u) {
+    *out += static_cast<char>(0xc0u | (c >> 6));
+    *out += static_cast<char>(0x80u | (c & 0x3fu));
+  } else if (c < 0x10000u) {
+    *out += static_cast<char>(0xe0u | (c >> 12));
+    *out += static_cast<char>(0x80u | ((c >> 6) & 0x3fu));
+    *out += static_cast<char>(0x80u | (c & 0x3fu));
+  } else {
+    *out += static_cast<char>(0xf0u | (c >> 18));
+    *out += static_cast<char>(0x80u | ((c >> 12) & 0x3fu));
+    *out += static_cast<char>(0x80u | ((c >> 6) & 0x3fu));
+    *out += static_cast<char>(0x80u | (c & 0x3fu));
+  }
+}
+
+// Decodes the reference at `p`, which the tokenizer has already checked, and returns the
+// character after it.
+static const char* DecodeReference(const char* p, const char* end, std::string* out) {
+  uint32_t c = 0u;
+  const char* next = end;
+  if (ParseReference(p + 1, end, &c, &next) != ReferenceError::kNone) {
+    // Unreachable for text that the tokenizer accepted; keep the text as it is.
+    *out += '&';
+    return p + 1;
+  }
+  AppendUtf8(c, out);
+  return next;
+}
+
+bool XmlTokenizer::IsSupported(const void* data, size_t len) {
+  const char* p = reinterpret_cast<const char*>(data);
+  const char* const end = p + len;
+
+  // UTF-16, with or without a byte order mark.
+  if (len >= 2u && (p[0] == '\0' || p[1] == '\0' || (p[0] == '\xfe' && p[1] == '\xff') ||
+                    (p[0] == '\xff' && p[1] == '\xfe'))) {
+    return false;
+  }
+
+  if (StartsWith(p, end, "\xef\xbb\xbf")) {
+    p += 3;
+  }
+
+  if (StartsWith(p, end, "<?xml") && p + 5 != end && IsWhitespace(p[5])) {
+    const char* decl_end = Search(p, end, "?>");
+    if (decl_end == nullptr) {
+      return false;
+    }
+
+    if (const char* encoding = Search(p, decl_end, "encoding")) {
+      const char* quote = std::find_if(encoding, decl_end, [](char c) -> bool {
+        return c == '"' || c == '\'';
+      });
+      if (quote == decl_end) {
+        return false;
+      }
+      const char* value_end = std::find(quote + 1, decl_end, *quote);
+      const std::string value(quote + 1, value_end);
+      std::string lower_value;
+      for (char c : value) {
+        lower_value += static_cast<char>(tolower(static_cast<unsigned char>(c)));
+      }
+      if (lower_value != "utf-8" && lower_value != "us-ascii") {
+        return false;
+      }
+    }
+    p = decl_end + 2;
+  }
+
+  // Look for a DTD in the rest of the prolog.
+  while (p != end) {
+    if (IsWhitespace(*p)) {
+      ++p;
+    } else if (StartsWith(p, end, "<?")) {
+      const char* pi_end = Search(p, end, "?>");
+      if (pi_end == nullptr) {
+        return true;
+      }
+      p = pi_end + 2;
+    } else if (StartsWith(p, end, "<!--")) {
+      const char* comment_end = Search(p, end, "-->");
+      if (comment_end == nullptr) {
+        return true;
+      }
+      p = comment_end + 3;
+    } else {
+      return !StartsWith(p, end, "<!DOCTYPE");
+    }
+  }
+  return true;
+}
+
+void XmlTokenizer::DecodeText(const StringPiece& raw, std::string* out) {
+  const char* p = raw.begin();
+  const char* const end = raw.end();
+  while (p != end) {
+    switch (*p) {
+      case '&':
+        p = DecodeReference(p, end, out);
+        break;
+
+      case '<':
+        if (StartsWith(p, end, "<![CDATA[")) {
+          const char* cdata_end = Search(p, end, "]]>");
+          NormalizeLineEndings(StringPiece(p + 9, cdata_end - (p + 9)), out);
+          p = cdata_end + 3;
+        } else {
+          // A processing instruction, which is not part of the text.
+          p = Search(p, end, "?>") + 2;
+        }
+        break;
+
+      case '\r':
+        *out += '\n';
+        if (++p != end && *p == '\n') {
+          ++p;
+        }
+        break;
+
+      default: {
+        const char* run_end = std::find_if(p, end, [](char c) -> bool {
+          return c == '&' || c == '<' || c == '\r';
+        });
+        out->append(p, run_end - p);
+        p = run_end;
+      } break;
+    }
+  }
+}
+
+void XmlTokenizer::DecodeAttributeValue(const StringPiece& raw, std::string* out) {
+  const char* p = raw.begin();
+  const char* const end = raw.end();
+  while (p != end) {
+    switch (*p) {
+      case '&':
+        p = DecodeReference(p, end, out);
+        break;
+
+      case '\r':
+        // A line ending is normalized to '\n' first, and then like any other whitespace to ' '.
+        *out += ' ';
+        if (++p != end && *p == '\n') {
+          ++p;
+        }
+        break;
+
+      case '\t':
+      case '\n':
+        *out += ' ';
+        ++p;
+        break;
+
+      default:
+        *out += *p++;
+        break;
+    }
+  }
+}
+
+void XmlTokenizer::NormalizeLineEndings(const StringPiece& raw, std::string* out) {
+  const char* p = raw.begin();
+  const char* const end = raw.end();
+  while (p != end) {
+    const char* cr = reinterpret_cast<const char*>(memchr(p, '\r', end - p));
+    if (cr == nullptr) {
+      out->append(p, end - p);
+      return;
+    }
+    out->append(p, cr - p);
+    *out += '\n';
+    p = cr + 1;
+    if (p != end && *p == '\n') {
+      ++p;
+    }
+  }
+}
+
+XmlTokenizer::XmlTokenizer(const void* data, size_t len)
+    : begin_(reinterpret_cast<const char*>(data)), end_(begin_ + len), pos_(begin_) {
+  if (StartsWith(pos_, end_, "\xef\xbb\xbf")) {
+    pos_ += 3;
+  }
+
+  // Skip the XML declaration. IsSupported() checks its encoding.
+  if (StartsWith(pos_, end_, "<?xml") && pos_ + 5 != end_ && IsWhitespace(pos_[5])) {
+    if (const char* decl_end = Find("?>")) {
+      AdvanceTo(decl_end + 2);
+    }
+  }
+}
+
+XmlTokenizer::Token XmlTokenizer::Error(const std::string& error) {
+  token_line_ = line_;
+  error_ = error;
+  return token_ = Token::kBadDocument;
+}
+
+void XmlTokenizer::AdvanceTo(const char* p) {
+  line_ += std::count(pos_, p, '\n');
+  pos_ = p;
+}
+
+bool XmlTokenizer::SkipWhitespace() {
+  const char* p = pos_;
+  while (p != end_ && IsWhitespace(*p)) {
+    ++p;
+  }
+  const bool skipped = p != pos_;
+  AdvanceTo(p);
+  return skipped;
+}
+
+StringPiece XmlTokenizer::ReadName() {
+  const char* start = pos_;
+  while (pos_ != end_ && IsNameChar(*pos_)) {
+    ++pos_;
+  }
+  const StringPiece name(start, pos_ - start);
+
+  // A name doesn't start with a digit, '-' or '.', and it has at most one ':', between a prefix
+  // and a local name. Returns an empty name if this one is invalid.
+  if (name.empty() || (*start >= '0' && *start <= '9') || *start == '-' || *start == '.') {
+    return {};
+  }
+  const char* colon = std::find(name.begin(), name.end(), ':');
+  if (colon != name.end() &&
+      (colon == name.begin() || colon + 1 == name.end() ||
+       std::find(colon + 1, name.end(), ':') != name.end())) {
+    return {};
+  }
+  return name;
+}
+
+const char* XmlTokenizer::Find(const char* str) const {
+  return Search(pos_, end_, str);
+}
+
+bool XmlTokenizer::CheckReferences(const char* start, const char* end) {
+  const char* p = start;
+  while (const char* amp = reinterpret_cast<const char*>(memchr(p, '&', end - p))) {
+    uint32_t c = 0u;
+    switch (ParseReference(amp + 1, end, &c, &p)) {
+      case ReferenceError::kNone:
+        break;
+      case ReferenceError::kSyntax:
+        AdvanceTo(amp);
+        Error("not well-formed (invalid token)");
+        return false;
+      case ReferenceError::kUndefinedEntity:
+        AdvanceTo(amp);
+        Error("undefined entity");
+        return false;
+      case ReferenceError::kInvalidCharacter:
+        AdvanceTo(amp);
+        Error("reference to invalid character number");
+        return false;
+    }
+  }
+  return true;
+}
+
+XmlTokenizer::Token XmlTokenizer::Next() {
+  if (token_ == Token::kEndDocument || !error_.empty()) {
+    return token_;
+  }
+
+  if (pending_end_tag_) {
+    // The end of an empty element tag, which has the same name. Like expat, report the line on
+    // which the tag ends.
+    pending_end_tag_ = false;
+    token_line_ = line_;
+    attributes_.clear();
+    return token_ = Token::kEndTag;
+  }
+
+  while (open_elements_.empty()) {
+    // Outside of the root element, only whitespace, comments and processing instructions are
+    // allowed.
+    SkipWhitespace();
+    token_line_ = line_;
+    if (pos_ == end_) {
+      if (!seen_root_) {
+        return Error("no element found");
+      }
+      return token_ = Token::kEndDocument;
+    }
+
+    if (StartsWith(pos_, end_, "<?")) {
+      const char* pi_end = SkipProcessingInstruction(pos_);
+      if (pi_end == nullptr) {
+        return token_;
+      }
+      AdvanceTo(pi_end);
+    } else if (StartsWith(pos_, end_, "<!--")) {
+      return ReadComment();
+    } else if (seen_root_) {
+      return Error("junk after document element");
+    } else if (*pos_ != '<') {
+      return Error("syntax error");
+    } else if (StartsWith(pos_, end_, "<!DOCTYPE")) {
+      return Error("DTDs are not supported");
+    } else {
+      return ReadStartTag();
+    }
+  }
+
+  token_line_ = line_;
+  if (pos_ == end_) {
+    return Error("no element found");
+  }
+
+  if (*pos_ == '<') {
+    if (StartsWith(pos_, end_, "</")) {
+      return ReadEndTag();
+    } else if (StartsWith(pos_, end_, "<!--")) {
+      return ReadComment();
+    } else if (StartsWith(pos_, end_, "<![CDATA[") || StartsWith(pos_, end_, "<?")) {
+      return ReadText();
+    } else if (StartsWith(pos_, end_, "<!")) {
+      return Error("not well-formed (invalid token)");
+    }
+    return ReadStartTag();
+  }
+  return ReadText();
+}
+
+XmlTokenizer::Token XmlTokenizer::ReadStartTag() {
+  AdvanceTo(pos_ + 1);
+  name_ = ReadName();
+  if (name_.empty()) {
+    return Error("not well-formed (invalid token)");
+  }
+
+  attributes_.clear();
+  while (true) {
+    const bool separated = SkipWhitespace();
+    if (pos_ == end_) {
+      return Error("unclosed token");
+    }
+
+    if (*pos_ == '>') {
+      AdvanceTo(pos_ + 1);
+      open_elements_.push_back(name_);
+      seen_root_ = true;
+      return token_ = Token::kStartTag;
+    }
+
+    if (*pos_ == '/') {
+      if (pos_ + 1 == end_ || pos_[1] != '>') {
+        return Error("not well-formed (invalid token)");
+      }
+      AdvanceTo(pos_ + 2);
+      pending_end_tag_ = true;
+      seen_root_ = true;
+      return token_ = Token::kStartTag;
+    }
+
+    if (!separated) {
+      return Error("not well-formed (invalid token)");
+    }
+
+    Attribute attr;
+    attr.name = ReadName();
+    if (attr.name.empty()) {
+      return Error("not well-formed (invalid token)");
+    }
+
+    SkipWhitespace();
+    if (pos_ == end_ || *pos_ != '=') {
+      return Error("not well-formed (invalid token)");
+    }
+    AdvanceTo(pos_ + 1);
+    SkipWhitespace();
+    if (pos_ == end_ || (*pos_ != '"' && *pos_ != '\'')) {
+      return Error("not well-formed (invalid token)");
+    }
+
+    const char* value_start = pos_ + 1;
+    const char* value_end =
+        reinterpret_cast<const char*>(memchr(value_start, *pos_, end_ - value_start));
+    if (value_end == nullptr) {
+      return Error("unclosed token");
+    }
+
+    attr.value = StringPiece(value_start, value_end - value_start);
+    attr.needs_decoding = false;
+    for (char c : attr.value) {
+      if (c == '<') {
+        return Error("not well-formed (invalid token)");
+      } else if (c == '&' || c == '\t' || c == '\n' || c == '\r') {
+        attr.needs_decoding = true;
+      }
+    }
+
+    if (attr.needs_decoding && !CheckReferences(value_start, value_end)) {
+      return token_;
+    }
+
+    for (const Attribute& other : attributes_) {
+      if (other.name == attr.name) {
+        return Error("duplicate attribute");
+      }
+    }
+
+    attributes_.push_back(attr);
+    AdvanceTo(value_end + 1);
+  }
+}
+
+XmlTokenizer::Token XmlTokenizer::ReadEndTag() {
+  AdvanceTo(pos_ + 2);
+  name_ = ReadName();
+  SkipWhitespace();
+  if (pos_ == end_ || *pos_ != '>') {
+    return Error("not well-formed (invalid token)");
+  }
+
+  if (name_ != open_elements_.back()) {
+    return Error("mismatched tag");
+  }
+  open_elements_.pop_back();
+  attributes_.clear();
+  AdvanceTo(pos_ + 1);
+  return token_ = Token::kEndTag;
+}
+
+XmlTokenizer::Token XmlTokenizer::ReadComment() {
+  const char* start = pos_ + 4;
+  const char* comment_end = Search(start, end_, "-->");
+  if (comment_end == nullptr) {
+    return Error("unclosed token");
+  }
+
+  // "--" is not allowed within a comment.
+  if (const char* dashes = Search(start, comment_end + 1, "--")) {
+    AdvanceTo(dashes);
+    return Error("not well-formed (invalid token)");
+  }
+
+  text_ = StringPiece(start, comment_end - start);
+  text_needs_decoding_ = memchr(start, '\r', comment_end - start) != nullptr;
+  AdvanceTo(comment_end + 3);
+  return token_ = Token::kComment;
+}
+
+XmlTokenizer::Token XmlTokenizer::ReadText() {
+  const char* start = pos_;
+  const char* p = pos_;
+  bool has_chars = false;
+  bool needs_decoding = false;
+  while (p != end_) {
+    const char* lt = reinterpret_cast<const char*>(memchr(p, '<', end_ - p));
+    if (lt == nullptr) {
+      lt = end_;
+    }
+
+    if (lt != p) {
+      has_chars = true;
+      if (!needs_decoding && (memchr(p, '&', lt - p) != nullptr ||
+                              memchr(p, '\r', lt - p) != nullptr)) {
+        needs_decoding = true;
+      }
+      if (!CheckReferences(p, lt)) {
+        return token_;
+      }
+
+      // The end of a CDATA section is not allowed outside of one.
+      if (memchr(p, ']', lt - p) != nullptr) {
+        if (const char* cdata_end = Search(p, lt, "]]>")) {
+          AdvanceTo(cdata_end);
+          return Error("not well-formed (invalid token)");
+        }
+      }
+    }
+
+    p = lt;
+    if (StartsWith(p, end_, "<![CDATA[")) {
+      const char* cdata_end = Search(p + 9, end_, "]]>");
+      if (cdata_end == nullptr) {
+        AdvanceTo(p);
+        return Error("unclosed CDATA section");
+      }
+      has_chars |= cdata_end != p + 9;
+      needs_decoding = true;
+      p = cdata_end + 3;
+    } else if (StartsWith(p, end_, "<?")) {
+      p = SkipProcessingInstruction(p);
+      if (p == nullptr) {
+        return token_;
+      }
+      needs_decoding = true;
+    } else {
+      break;
+    }
+  }
+
+  text_ = StringPiece(start, p - start);
+  text_needs_decoding_ = needs_decoding;
+  AdvanceTo(p);
+  if (!has_chars) {
+    // Only processing instructions, or empty CDATA sections.
+    return Next();
+  }
+  return token_ = Token::kText;
+}
+
+const char* XmlTokenizer::SkipProcessingInstruction(const char* p) {
+  const char* pi_end = Search(p + 2, end_, "?>");
+  if (pi_end == nullptr) {
+    AdvanceTo(p);
+    Error("unclosed token");
+    return nullptr;
+  }
+
+  // Only the XML declaration at the start of the document may use the target "xml".
+  const char* target_end = std::find_if(p + 2, pi_end + 1, [](char c) -> bool {
+    return IsWhitespace(c) || c == '?';
+  });
+  if (target_end - (p + 2) == 3 && tolower(static_cast<unsigned char>(p[2])) == 'x' &&
+      tolower(static_cast<unsigned char>(p[3])) == 'm' &&
+      tolower(static_cast<unsigned char>(p[4])) == 'l') {
+    AdvanceTo(p);
+    Error("XML or text declaration not at start of entity");
+    return nullptr;
+  }
+  return pi_end + 2;
+}
+
+}  // namespace xml
+}  // namespace aapt
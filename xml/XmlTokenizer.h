@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAPT_XML_XMLTOKENIZER_H
+#define AAPT_XML_XMLTOKENIZER_H
+
+#include <string>
+#include <vector>
+
+#include "android-base/macros.h"
+#include "androidfw/StringPiece.h"
+
+namespace aapt {
+namespace xml {
+
+// Splits a UTF-8 XML document that is fully in memory (usually a mapping of the file) into tags,
+// text and comments without copying it. Every name, attribute value, text and comment that is
+// handed out refers to the document, which must outlive the tokenizer. Entity references,
+// character references, CDATA sections and line endings are left as they are written; the Decode
+// functions below turn the raw text into its value when it is needed.
+//
+// The tokenizer checks that the document is well-formed: tags must nest and match, attributes
+// must be quoted and unique, and references must name one of the predefined entities or a valid
+// character. It doesn't resolve namespaces, and it doesn't support documents with a DTD or in an
+// encoding other than UTF-8 (see IsSupported()).
+class XmlTokenizer {
+ public:
+  enum class Token {
+    kBadDocument,
+    kEndDocument,
+
+    // A start tag, with its name and attributes. An empty element tag (<a/>) is reported as a
+    // kStartTag followed by a kEndTag on the line where the tag ends.
+    kStartTag,
+    kEndTag,
+
+    // A run of character data. Character data interrupted by CDATA sections, references or
+    // processing instructions is reported as one kText token.
+    kText,
+
+    kComment,
+  };
+
+  struct Attribute {
+    // The qualified name, as written.
+    android::StringPiece name;
+
+    // The raw value, between the quotes.
+    android::StringPiece value;
+
+    // True if the value contains references or whitespace that must be normalized, in which case
+    // DecodeAttributeValue() must be used to get its value.
+    bool needs_decoding;
+  };
+
+  // Returns false if `data` declares a DTD or an encoding other than UTF-8, which the tokenizer
+  // doesn't support. Only the prolog, up to the root element, is read.
+  static bool IsSupported(const void* data, size_t len);
+
+  // Appends the value of the raw character data `raw` (see text()) to `out`.
+  static void DecodeText(const android::StringPiece& raw, std::string* out);
+
+  // Appends the value of the raw attribute value `raw` to `out`.
+  static void DecodeAttributeValue(const android::StringPiece& raw, std::string* out);
+
+  // Appends `raw` to `out` with its line endings normalized to '\n'.
+  static void NormalizeLineEndings(const android::StringPiece& raw, std::string* out);
+
+  XmlTokenizer(const void* data, size_t len);
+
+  Token Next();
+
+  Token token() const {
+    return token_;
+  }
+
+  const std::string& error() const {
+    return error_;
+  }
+
+  // The line on which the current token starts, or on which the error was found.
+  size_t line_number() const {
+    return token_line_;
+  }
+
+  // The qualified name of the current kStartTag or kEndTag.
+  android::StringPiece name() const {
+    return name_;
+  }
+
+  // The attributes of the current kStartTag, in the order in which they are written.
+  const std::vector<Attribute>& attributes() const {
+    return attributes_;
+  }
+
+  // The raw character data of the current kText, or the contents of the current kComment.
+  android::StringPiece text() const {
+    return text_;
+  }
+
+  // True if the current kText contains references, CDATA sections, processing instructions or
+  // carriage returns, in which case DecodeText() must be used to get its value. For a kComment,
+  // true if it contains carriage returns.
+  bool text_needs_decoding() const {
+    return text_needs_decoding_;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(XmlTokenizer);
+
+  Token Error(const std::string& error);
+
+  // Moves to `p`, counting the lines in between.
+  void AdvanceTo(const char* p);
+
+  bool SkipWhitespace();
+  android::StringPiece ReadName();
+  const char* Find(const char* str) const;
+  bool CheckReferences(const char* start, const char* end);
+
+  Token ReadStartTag();
+  Token ReadEndTag();
+  Token ReadComment();
+  Token ReadText();
+  // Returns the end of the processing instruction at `p`, or nullptr if it is invalid.
+  const char* SkipProcessingInstruction(const char* p);
+
+  const char* const begin_;
+  const char* const end_;
+  const char* pos_;
+  size_t line_ = 1u;
+
+  Token token_ = Token::kBadDocument;
+  size_t token_line_ = 1u;
+  std::string error_;
+
+  android::StringPiece name_;
+  std::vector<Attribute> attributes_;
+  android::StringPiece text_;
+  bool text_needs_decoding_ = false;
+
+  // The names of the open elements.
+  std::vector<android::StringPiece> open_elements_;
+  bool seen_root_ = false;
+  bool pending_end_tag_ = false;
+};
+
+}  // namespace xml
+}  // namespace aapt
+
+#endif  // AAPT_XML_XMLTOKENIZER_H
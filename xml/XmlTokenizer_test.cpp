@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "xml/XmlTokenizer.h"
+
+#include "test/Test.h"
+
+using ::android::StringPiece;
+using ::testing::Eq;
+using ::testing::SizeIs;
+
+namespace aapt {
+namespace xml {
+
+using Token = XmlTokenizer::Token;
+
+static std::string DecodeText(const StringPiece& raw) {
+  std::string out;
+  XmlTokenizer::DecodeText(raw, &out);
+  return out;
+}
+
+static std::string DecodeAttributeValue(const StringPiece& raw) {
+  std::string out;
+  XmlTokenizer::DecodeAttributeValue(raw, &out);
+  return out;
+}
+
+static bool IsSupported(const std::string& str) {
+  return XmlTokenizer::IsSupported(str.data(), str.size());
+}
+
+TEST(XmlTokenizerTest, TokensReferToTheDocument) {
+  const std::string str =
+      "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+      "<!-- header -->\n"
+      "<resources xmlns:xliff=\"urn:oasis:names:tc:xliff:document:1.2\">\n"
+      "  <string name='hello' translatable=\"false\">Hello <b>world</b></string>\n"
+      "  <empty/>\n"
+      "</resources>\n";
+  XmlTokenizer tokenizer(str.data(), str.size());
+
+  ASSERT_THAT(tokenizer.Next(), Eq(Token::kComment));
+  EXPECT_THAT(tokenizer.text(), Eq(StringPiece(" header ")));
+  EXPECT_THAT(tokenizer.line_number(), Eq(2u));
+
+  ASSERT_THAT(tokenizer.Next(), Eq(Token::kStartTag));
+  EXPECT_THAT(tokenizer.name(), Eq(StringPiece("resources")));
+  EXPECT_THAT(tokenizer.line_number(), Eq(3u));
+  ASSERT_THAT(tokenizer.attributes(), SizeIs(1u));
+  EXPECT_THAT(tokenizer.attributes()[0].name, Eq(StringPiece("xmlns:xliff")));
+  EXPECT_THAT(tokenizer.attributes()[0].value,
+              Eq(StringPiece("urn:oasis:names:tc:xliff:document:1.2")));
+
+  ASSERT_THAT(tokenizer.Next(), Eq(Token::kText));
+  EXPECT_THAT(tokenizer.text(), Eq(StringPiece("\n  ")));
+
+  ASSERT_THAT(tokenizer.Next(), Eq(Token::kStartTag));
+  EXPECT_THAT(tokenizer.name(), Eq(StringPiece("string")));
+  EXPECT_THAT(tokenizer.line_number(), Eq(4u));
+  ASSERT_THAT(tokenizer.attributes(), SizeIs(2u));
+  EXPECT_THAT(tokenizer.attributes()[0].value, Eq(StringPiece("hello")));
+  EXPECT_FALSE(tokenizer.attributes()[0].needs_decoding);
+  EXPECT_THAT(tokenizer.attributes()[1].value, Eq(StringPiece("false")));
+
+  // Nothing is copied.
+  EXPECT_THAT(tokenizer.name().data(), Eq(str.data() + str.find("string name")));
+
+  ASSERT_THAT(tokenizer.Next(), Eq(Token::kText));
+  EXPECT_THAT(tokenizer.text(), Eq(StringPiece("Hello ")));
+  EXPECT_FALSE(tokenizer.text_needs_decoding());
+  ASSERT_THAT(tokenizer.Next(), Eq(Token::kStartTag));
+  EXPECT_THAT(tokenizer.name(), Eq(StringPiece("b")));
+  ASSERT_THAT(tokenizer.Next(), Eq(Token::kText));
+  ASSERT_THAT(tokenizer.Next(), Eq(Token::kEndTag));
+  EXPECT_THAT(tokenizer.name(), Eq(StringPiece("b")));
+  ASSERT_THAT(tokenizer.Next(), Eq(Token::kEndTag));
+  EXPECT_THAT(tokenizer.name(), Eq(StringPiece("string")));
+
+  ASSERT_THAT(tokenizer.Next(), Eq(Token::kText));
+  ASSERT_THAT(tokenizer.Next(), Eq(Token::kStartTag));
+  EXPECT_THAT(tokenizer.name(), Eq(StringPiece("empty")));
+  EXPECT_THAT(tokenizer.line_number(), Eq(5u));
+  ASSERT_THAT(tokenizer.Next(), Eq(Token::kEndTag));
+  EXPECT_THAT(tokenizer.name(), Eq(StringPiece("empty")));
+  EXPECT_THAT(tokenizer.line_number(), Eq(5u));
+
+  ASSERT_THAT(tokenizer.Next(), Eq(Token::kText));
+  ASSERT_THAT(tokenizer.Next(), Eq(Token::kEndTag));
+  EXPECT_THAT(tokenizer.line_number(), Eq(6u));
+  EXPECT_THAT(tokenizer.Next(), Eq(Token::kEndDocument));
+  EXPECT_THAT(tokenizer.Next(), Eq(Token::kEndDocument));
+}
+
+TEST(XmlTokenizerTest, TextIsDecodedOnRequest) {
+  const std::string str =
+      "<a>x &amp; y &#x1F600;&#65;<![CDATA[<b>&amp;</b>]]><?pi data?>\r\nz</a>";
+  XmlTokenizer tokenizer(str.data(), str.size());
+
+  ASSERT_THAT(tokenizer.Next(), Eq(Token::kStartTag));
+  ASSERT_THAT(tokenizer.Next(), Eq(Token::kText));
+  EXPECT_TRUE(tokenizer.text_needs_decoding());
+  EXPECT_THAT(tokenizer.text(),
+              Eq(StringPiece("x &amp; y &#x1F600;&#65;<![CDATA[<b>&amp;</b>]]><?pi data?>\r\nz")));
+  EXPECT_THAT(DecodeText(tokenizer.text()), Eq("x & y \xf0\x9f\x98\x80" "A<b>&amp;</b>\nz"));
+  ASSERT_THAT(tokenizer.Next(), Eq(Token::kEndTag));
+  EXPECT_THAT(tokenizer.Next(), Eq(Token::kEndDocument));
+}
+
+TEST(XmlTokenizerTest, ProcessingInstructionsAreSkipped) {
+  const std::string str = "<?xml version='1.0'?><?xml-stylesheet href='a'?><a/><?pi?>";
+  XmlTokenizer tokenizer(str.data(), str.size());
+
+  ASSERT_THAT(tokenizer.Next(), Eq(Token::kStartTag));
+  EXPECT_THAT(tokenizer.name(), Eq(StringPiece("a")));
+  ASSERT_THAT(tokenizer.Next(), Eq(Token::kEndTag));
+  EXPECT_THAT(tokenizer.Next(), Eq(Token::kEndDocument));
+}
+
+TEST(XmlTokenizerTest, AttributeValuesAreNormalized) {
+  const std::string str = "<a b=\"one\ttwo\r\nthree&#10;&lt;&quot;\"/>";
+  XmlTokenizer tokenizer(str.data(), str.size());
+
+  ASSERT_THAT(tokenizer.Next(), Eq(Token::kStartTag));
+  ASSERT_THAT(tokenizer.attributes(), SizeIs(1u));
+  EXPECT_TRUE(tokenizer.attributes()[0].needs_decoding);
+  EXPECT_THAT(DecodeAttributeValue(tokenizer.attributes()[0].value),
+              Eq("one two three\n<\""));
+}
+
+TEST(XmlTokenizerTest, MalformedDocumentsAreRejected) {
+  const std::vector<std::pair<std::string, size_t>> documents = {
+      {"<a>\n<b>\n</a>", 3u},
+      {"<a>\n&unknown;</a>", 2u},
+      {"<a>&#0;</a>", 1u},
+      {"<a b='1' b='2'/>", 1u},
+      {"<a b=1/>", 1u},
+      {"<a>\n<b>", 2u},
+      {"<a/><b/>", 1u},
+      {"text<a/>", 1u},
+      {"", 1u},
+      {"<a><![CDATA[x</a>", 1u},
+      {"\n<?xml version='1.0'?><a/>", 2u},
+      {"<a><?xml version='1.0'?></a>", 1u},
+  };
+
+  for (const auto& document : documents) {
+    const std::string& str = document.first;
+    XmlTokenizer tokenizer(str.data(), str.size());
+    Token token;
+    while ((token = tokenizer.Next()) != Token::kBadDocument && token != Token::kEndDocument) {
+    }
+    EXPECT_THAT(token, Eq(Token::kBadDocument)) << str;
+    EXPECT_FALSE(tokenizer.error().empty()) << str;
+    EXPECT_THAT(tokenizer.line_number(), Eq(document.second)) << str;
+  }
+}
+
+TEST(XmlTokenizerTest, DocumentsWithDtdsOrOtherEncodingsAreNotSupported) {
+  EXPECT_TRUE(IsSupported("<resources/>"));
+  EXPECT_TRUE(IsSupported("\xef\xbb\xbf<?xml version=\"1.0\" encoding=\"UTF-8\"?><resources/>"));
+  EXPECT_TRUE(IsSupported("<?xml version='1.0'?>\n<!-- <!DOCTYPE -->\n<resources/>"));
+
+  EXPECT_FALSE(IsSupported("<?xml version=\"1.0\" encoding=\"ISO-8859-1\"?><resources/>"));
+  EXPECT_FALSE(IsSupported("<!DOCTYPE resources [<!ENTITY foo \"bar\">]><resources/>"));
+  EXPECT_FALSE(IsSupported(std::string("\xff\xfe<\0r\0/\0>\0", 10u)));
+}
+
+}  // namespace xml
+}  // namespace aapt